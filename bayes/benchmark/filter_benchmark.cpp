@@ -0,0 +1,358 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2013-, Open Perception, Inc.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ * with the distribution.
+ * * Neither the name of the copyright holder(s) nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <benchmark/benchmark.h>
+#include <allFilters.hpp>
+#include <fixedFlt.hpp>
+#include <parSIRFlt.hpp>
+
+// Heap allocations counter (only the filter calls are accounted):
+static std::atomic<size_t> allocations(0);
+
+void*
+operator new(std::size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void* p = std::malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void
+operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void
+operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+namespace
+{
+  // Constant velocity models of the trackers: N positions and N velocities, position observations.
+  const double PERIOD = 1.0 / 30.0;
+  const double ACCELERATION_VARIANCE = 100.0;
+  const double POSITION_VARIANCE = 0.01;
+
+  template <int N>
+  class PredictModel : public Bayesian_filter::Linear_predict_model
+  {
+    public:
+      PredictModel() : Bayesian_filter::Linear_predict_model(2 * N, N)
+      {
+        Fx.clear();
+        G.clear();
+        for (int i = 0; i < N; i++)
+        {
+          Fx(i, i) = 1.0;
+          Fx(N + i, N + i) = 1.0;
+          Fx(i, N + i) = PERIOD;
+          G(i, i) = PERIOD * PERIOD / 2.0;
+          G(N + i, i) = PERIOD;
+          q[i] = ACCELERATION_VARIANCE;
+        }
+      }
+  };
+
+  template <int N>
+  class ObserveModel : public Bayesian_filter::Linear_uncorrelated_observe_model
+  {
+    public:
+      ObserveModel() : Bayesian_filter::Linear_uncorrelated_observe_model(2 * N, N)
+      {
+        Hx.clear();
+        for (int i = 0; i < N; i++)
+        {
+          Hx(i, i) = 1.0;
+          Zv[i] = POSITION_VARIANCE;
+        }
+      }
+  };
+
+  template <int N>
+  class FixedPredictModel : public Bayesian_filter::Fixed_linear_predict_model<2 * N, N>
+  {
+    public:
+      FixedPredictModel()
+      {
+        for (int i = 0; i < N; i++)
+        {
+          this->Fx(i, N + i) = PERIOD;
+          this->G(i, i) = PERIOD * PERIOD / 2.0;
+          this->G(N + i, i) = PERIOD;
+          this->q[i] = ACCELERATION_VARIANCE;
+        }
+      }
+  };
+
+  template <int N>
+  class FixedObserveModel : public Bayesian_filter::Fixed_linear_uncorrelated_observe_model<2 * N, N>
+  {
+    public:
+      FixedObserveModel()
+      {
+        for (int i = 0; i < N; i++)
+        {
+          this->Hx(i, i) = 1.0;
+          this->Zv[i] = POSITION_VARIANCE;
+        }
+      }
+  };
+
+  // Random helper of SIR_scheme:
+  class Random : public Bayesian_filter::SIR_random
+  {
+    public:
+      void
+      normal(Bayesian_filter_matrix::DenseVec& v)
+      {
+        for (std::size_t i = 0; i < v.size(); i++)
+          v[i] = normal_(rng_);
+      }
+
+      void
+      uniform_01(Bayesian_filter_matrix::DenseVec& v)
+      {
+        for (std::size_t i = 0; i < v.size(); i++)
+          v[i] = uniform_01_(rng_);
+      }
+
+    private:
+      std::mt19937 rng_;
+      std::normal_distribution<double> normal_;
+      std::uniform_real_distribution<double> uniform_01_;
+  };
+
+  // Unnormalized Gaussian likelihood of the observed position (as Linear_uncorrelated_block_observe_model):
+  template <int N>
+  class PositionLikelihoodModel : public Bayesian_filter::Likelihood_observe_model
+  {
+    public:
+      PositionLikelihoodModel() : Bayesian_filter::Likelihood_observe_model(N)
+      {
+      }
+
+      Float
+      L(const Bayesian_filter_matrix::Vec& x) const
+      {
+        Float d = 0;
+        for (int i = 0; i < N; i++)
+          d += (z[i] - x[i]) * (z[i] - x[i]) / POSITION_VARIANCE;
+        return std::exp(-0.5 * d);
+      }
+  };
+
+  // Position of the simulated target at step k:
+  inline double
+  position(int i, int k)
+  {
+    return (i + 1) + 0.5 * PERIOD * k;
+  }
+
+  void
+  reportAllocations(benchmark::State& state, size_t allocations_before)
+  {
+    state.counters["allocs_per_cycle"] = benchmark::Counter(double(allocations.load() - allocations_before) /
+        state.iterations());
+  }
+}
+
+// One predict/observe/update cycle of the uBLAS Unscented_scheme (as in KalmanFilter and KalmanFilter3D):
+template <int N>
+static void
+BM_UnscentedScheme(benchmark::State& state)
+{
+  PredictModel<N> predict_model;
+  ObserveModel<N> observe_model;
+  Bayesian_filter::Unscented_scheme filter(2 * N, N);
+
+  Bayesian_filter_matrix::Vec x(2 * N);
+  Bayesian_filter_matrix::SymMatrix X(2 * N, 2 * N);
+  x.clear();
+  X.clear();
+  for (int i = 0; i < N; i++)
+  {
+    x[i] = position(i, 0);
+    X(N + i, N + i) = 100.0;
+  }
+  filter.init_kalman(x, X);
+
+  Bayesian_filter_matrix::Vec z(N);
+  int k = 0;
+  size_t allocations_before = allocations.load();
+  for (auto _ : state)
+  {
+    ++k;
+    for (int i = 0; i < N; i++)
+      z[i] = position(i, k);
+    filter.predict(predict_model);
+    filter.observe(observe_model, z);
+    filter.update();
+    benchmark::DoNotOptimize(filter.x[0]);
+  }
+  reportAllocations(state, allocations_before);
+}
+
+// The same cycle with the fixed size scheme:
+template <int N>
+static void
+BM_FixedUnscentedScheme(benchmark::State& state)
+{
+  typedef Bayesian_filter::Fixed_unscented_scheme<2 * N, N> Filter;
+  FixedPredictModel<N> predict_model;
+  FixedObserveModel<N> observe_model;
+  Filter filter;
+
+  typename Filter::Vec x = Filter::Vec::Zero();
+  typename Filter::SymMatrix X = Filter::SymMatrix::Zero();
+  for (int i = 0; i < N; i++)
+  {
+    x[i] = position(i, 0);
+    X(N + i, N + i) = 100.0;
+  }
+  filter.init_kalman(x, X);
+
+  typename FixedObserveModel<N>::Vec_z z;
+  int k = 0;
+  size_t allocations_before = allocations.load();
+  for (auto _ : state)
+  {
+    ++k;
+    for (int i = 0; i < N; i++)
+      z[i] = position(i, k);
+    filter.predict(predict_model);
+    filter.observe(observe_model, z);
+    filter.update();
+    benchmark::DoNotOptimize(filter.x[0]);
+  }
+  reportAllocations(state, allocations_before);
+}
+
+// One predict/observe/resample cycle of SIR_scheme with the systematic resampler (3D constant velocity model):
+static void
+BM_SIRScheme(benchmark::State& state)
+{
+  const int N = 3;
+  const std::size_t particles = state.range(0);
+  Random random;
+  Bayesian_filter::Sampled_LiAd_predict_model predict_model(2 * N, N, random);
+  const PredictModel<N> linear_model;
+  predict_model.Fx = linear_model.Fx;
+  predict_model.G = linear_model.G;
+  predict_model.q = linear_model.q;
+  PositionLikelihoodModel<N> observe_model;
+  Bayesian_filter::Systematic_resampler resampler;
+
+  Bayesian_filter::SIR_scheme filter(2 * N, particles, random);
+  Bayesian_filter_matrix::ColMatrix S(2 * N, particles);
+  S.clear();
+  for (std::size_t j = 0; j < particles; j++)
+    for (int i = 0; i < N; i++)
+      S(i, j) = position(i, 0);
+  filter.init_sample(S);
+
+  Bayesian_filter_matrix::Vec z(N);
+  int k = 0;
+  for (auto _ : state)
+  {
+    ++k;
+    for (int i = 0; i < N; i++)
+      z[i] = position(i, k);
+    filter.predict(predict_model);
+    filter.observe(observe_model, z);
+    filter.update_resample(resampler);
+    benchmark::DoNotOptimize(filter.S(0, 0));
+  }
+  state.SetItemsProcessed(state.iterations() * particles);
+}
+
+// The same cycle with the data parallel scheme:
+static void
+BM_ParallelSIRScheme(benchmark::State& state)
+{
+  const int N = 3;
+  const std::size_t particles = state.range(0);
+  Bayesian_filter::Linear_block_predict_model predict_model(2 * N, N);
+  const FixedPredictModel<N> linear_model;
+  predict_model.Fx = linear_model.Fx;
+  predict_model.G = linear_model.G;
+  predict_model.q = linear_model.q;
+  Bayesian_filter::Linear_uncorrelated_block_observe_model observe_model(2 * N, N);
+  observe_model.Hx = FixedObserveModel<N>().Hx;
+  observe_model.Zv = FixedObserveModel<N>().Zv;
+
+  Bayesian_filter::Parallel_SIR_scheme filter(2 * N, particles);
+  Bayesian_filter::Parallel_SIR_scheme::Particles S = Bayesian_filter::Parallel_SIR_scheme::Particles::Zero(2 * N, particles);
+  for (int i = 0; i < N; i++)
+    S.row(i).setConstant(position(i, 0));
+  filter.init_sample(S);
+
+  Bayesian_filter::Parallel_SIR_scheme::Vec z(N);
+  int k = 0;
+  for (auto _ : state)
+  {
+    ++k;
+    for (int i = 0; i < N; i++)
+      z[i] = position(i, k);
+    filter.predict(predict_model);
+    filter.observe(observe_model, z);
+    filter.update_resample();
+    benchmark::DoNotOptimize(filter.S(0, 0));
+  }
+  state.SetItemsProcessed(state.iterations() * particles);
+}
+
+// 2D tracker (KalmanFilter) and 3D tracker (KalmanFilter3D) sizes:
+BENCHMARK_TEMPLATE(BM_UnscentedScheme, 2);
+BENCHMARK_TEMPLATE(BM_FixedUnscentedScheme, 2);
+BENCHMARK_TEMPLATE(BM_UnscentedScheme, 3);
+BENCHMARK_TEMPLATE(BM_FixedUnscentedScheme, 3);
+
+// Particle filters:
+BENCHMARK(BM_SIRScheme)->Arg(1 << 12)->Arg(1 << 16)->UseRealTime();
+BENCHMARK(BM_ParallelSIRScheme)->Arg(1 << 12)->Arg(1 << 16)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,389 @@
+#ifndef _BAYES_FILTER_FIXED
+#define _BAYES_FILTER_FIXED
+
+/*
+ * Bayes++ the Bayesian Filtering Library
+ * Copyright (c) 2002 Michael Stevens
+ * See accompanying Bayes++.htm for terms and conditions of use.
+ *
+ * $Id$
+ */
+
+/*
+ * Fixed size Unscented Filter Scheme.
+ *  The Unscented_scheme and the linear models for small filters whose state and
+ *  observation sizes are known at compile time.
+ *
+ * All vectors and matrices are Eigen fixed size types, so a filter and its models
+ * live entirely on the stack (or inside their owner) and predict/observe never
+ * allocate. Observations of different sizes up to z_max can be fused by the same
+ * scheme: the innovation s, S and SI are bounded Eigen types sized by the last observation.
+ *
+ * The numerics are those of Unscented_scheme with the default Kappa:
+ *  the same upper Cholesky factor generates the Unscented points and the same
+ *  reciprocal condition limits are checked. Only the inversion of the innovation
+ *  covariance uses a (pivoting) LDL' factorisation instead of UdU'.
+ *
+ * Models are bound at compile time. A predict model provides
+ *  Vec f(const Vec& x) const and SymMatrix Q(const Vec& x) const
+ * and an observe model provides
+ *  Vec_z h(const Vec& x) const, SymMatrix_z Z() const and normalise(Vec_z& z_denorm, const Vec_z& z_from) const
+ * as the Unscented_predict_model and Correlated_additive_observe_model do.
+ */
+#include "bayesFlt.hpp"
+#include <Eigen/Core>
+#include <Eigen/Cholesky>
+#include <cmath>
+
+/* Filter namespace */
+namespace Bayesian_filter
+{
+
+template <int x_size, int q_size>
+class Fixed_linear_predict_model
+/* Linear predict model with additive noise, fixed size
+ *  x(k|k-1) = Fx(k-1|k-1) * x(k-1|k-1) + G(k)w(k)
+ *  q(k) = state noise variance vector, q(k) is covariance of w(k)
+ * Equivalent of Linear_predict_model
+ */
+{
+public:
+	typedef Bayes_base::Float Float;
+	typedef Eigen::Matrix<Float, x_size, 1> Vec;
+	typedef Eigen::Matrix<Float, x_size, x_size> SymMatrix;
+
+	Fixed_linear_predict_model ()
+	{
+		Fx.setIdentity();
+		G.setZero();
+		q.setZero();
+	}
+
+	Vec f(const Vec& x) const
+	{	// Linear model
+		return Fx * x;
+	}
+	SymMatrix Q(const Vec& /*x*/) const
+	{	// Noise covariance Q = GqG'
+		return G * q.asDiagonal() * G.transpose();
+	}
+
+	Eigen::Matrix<Float, x_size, x_size> Fx;	// Model
+	Eigen::Matrix<Float, x_size, q_size> G;		// Noise coupling
+	Eigen::Matrix<Float, q_size, 1> q;			// Noise variance (always dense, use coupling to represent sparseness)
+
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+
+template <int x_size, int z_size>
+class Fixed_linear_uncorrelated_observe_model
+/* Linear observation model, uncorrelated additive observation noise, fixed size
+ *  z(k) = Hx(k) * x(k|k-1) + v(k)
+ *  Z(k) = I * Zv(k) observe noise variance vector Zv
+ * Equivalent of Linear_uncorrelated_observe_model
+ */
+{
+public:
+	typedef Bayes_base::Float Float;
+	typedef Eigen::Matrix<Float, x_size, 1> Vec;
+	typedef Eigen::Matrix<Float, z_size, 1> Vec_z;
+	typedef Eigen::Matrix<Float, z_size, z_size> SymMatrix_z;
+	enum { Z_size = z_size };
+
+	Fixed_linear_uncorrelated_observe_model ()
+	{
+		Hx.setZero();
+		Zv.setZero();
+	}
+
+	Vec_z h(const Vec& x) const
+	{	// Linear model
+		return Hx * x;
+	}
+	SymMatrix_z Z() const
+	{	// Noise covariance
+		return Zv.asDiagonal();
+	}
+	void normalise (Vec_z& /*z_denorm*/, const Vec_z& /*z_from*/) const
+	{}	// Linear observations are continuous
+
+	Eigen::Matrix<Float, z_size, x_size> Hx;	// Model
+	Vec_z Zv;									// Noise variance
+
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+
+template <int x_size, int z_max = x_size>
+class Fixed_unscented_scheme : public Bayes_base
+/* Unscented_scheme with the state size x_size and observations of at most z_max elements
+ *  Filter state x,X, the Unscented points XX and the last innovation s,S,SI are fixed size
+ */
+{
+public:
+	typedef Bayes_base::Float Float;
+	typedef Eigen::Matrix<Float, x_size, 1> Vec;
+	typedef Eigen::Matrix<Float, x_size, x_size> SymMatrix;
+	typedef Eigen::Matrix<Float, x_size, 2*x_size+1> ColMatrix;
+	typedef Eigen::Matrix<Float, Eigen::Dynamic, 1, 0, z_max, 1> Vec_z;
+	typedef Eigen::Matrix<Float, Eigen::Dynamic, Eigen::Dynamic, 0, z_max, z_max> SymMatrix_z;
+
+	Vec x;			// expected state
+	SymMatrix X;	// state covariance
+
+	ColMatrix XX;	// Unscented form of state, with associated Kappa
+	Float kappa;
+
+	Vec_z s;		// Innovation
+	SymMatrix_z S, SI;	// Innovation Covariance and Inverse
+
+	Numerical_rcond rclimit;
+
+	Fixed_unscented_scheme () :
+		kappa(0)
+	{
+		x.setZero();
+		X.setZero();
+		XX.setZero();
+	}
+	virtual ~Fixed_unscented_scheme ()
+	{}
+
+	void init_kalman (const Vec& x, const SymMatrix& X)
+	/* Initialise from a state and state covariance
+	 *  Post: x,X is PSD
+	 */
+	{
+		Fixed_unscented_scheme::x = x;
+		Fixed_unscented_scheme::X = X;
+		init ();
+	}
+
+	void init ()
+	/* Initialise state
+	 *  Pre : x,X
+	 *  Post: x,X is PSD
+	 */
+	{
+		SymMatrix UC = X;
+		if (!(UCfactor (UC) >= 0) || !X.isApprox (X.transpose()))
+			error (Numeric_exception("Initial X not PSD"));
+	}
+
+	void update ()
+	/* Update state
+	 *  Nothing to do, x,X are always up to date
+	 */
+	{}
+
+	template <class Predict_model>
+	void predict (const Predict_model& f)
+	/* Predict forward
+	 *  Pre : x,X
+	 *  Post: x,X is PSD
+	 */
+	{
+						// Create Unscented distribution
+		kappa = Float(3 - x_size);
+		Float x_kappa = Float(x_size) + kappa;
+		unscented (XX, x, X, x_kappa);
+
+						// Predict points of XX using supplied predict model
+		ColMatrix fXX;
+		for (int i = 0; i < XX.cols(); ++i) {
+			fXX.col(i) = f.f( XX.col(i) );
+		}
+						// Mean of predicted distribution: x
+		x = fXX.col(0) * kappa;
+		for (int i = 1; i < fXX.cols(); ++i) {
+			x += fXX.col(i) / Float(2);
+		}
+		x /= x_kappa;
+						// Covariance of distribution: X
+		const Vec fXX0 = fXX.col(0);
+		fXX.colwise() -= x;
+		X = (2*kappa) * fXX.col(0) * fXX.col(0).transpose();
+		for (int i = 1; i < fXX.cols(); ++i) {
+			X += fXX.col(i) * fXX.col(i).transpose();
+		}
+		X /= 2*x_kappa;
+						// Additive Noise Prediction, computed about center point
+		X += f.Q( fXX0 );
+	}
+
+	template <class Observe_model>
+	Float observe (const Observe_model& h, const typename Observe_model::Vec_z& z)
+	/* Observation fusion
+	 *  Pre : x,X
+	 *  Post: x,X is PSD
+	 */
+	{
+		enum { z_size = Observe_model::Z_size };
+		EIGEN_STATIC_ASSERT(z_size <= z_max, YOU_MADE_A_PROGRAMMING_MISTAKE);
+		typedef Eigen::Matrix<Float, z_size, 2*x_size+1> ColMatrix_z;
+		typedef typename Observe_model::Vec_z Obs_vec;
+		typedef typename Observe_model::SymMatrix_z Obs_sym_matrix;
+
+						// Create Unscented distribution
+		kappa = Float(3 - x_size);
+		Float x_kappa = Float(x_size) + kappa;
+		unscented (XX, x, X, x_kappa);
+
+						// Predict points of XX using supplied observation model
+		ColMatrix_z zXX;
+		{
+			const Obs_vec zXX0 = h.h( XX.col(0) );
+			zXX.col(0) = zXX0;
+			for (int i = 1; i < XX.cols(); ++i) {
+				Obs_vec zXXi = h.h( XX.col(i) );
+						// Normalise relative to zXX0
+				h.normalise (zXXi, zXX0);
+				zXX.col(i) = zXXi;
+			}
+		}
+						// Mean of predicted distribution: zp
+		Obs_vec zp = zXX.col(0) * kappa;
+		for (int i = 1; i < zXX.cols(); ++i) {
+			zp += zXX.col(i) / Float(2);
+		}
+		zp /= x_kappa;
+						// Covariance of observation predict: Xzz
+		zXX.colwise() -= zp;
+		Obs_sym_matrix Xzz = (2*kappa) * zXX.col(0) * zXX.col(0).transpose();
+		for (int i = 1; i < zXX.cols(); ++i) {
+			Xzz += zXX.col(i) * zXX.col(i).transpose();
+		}
+		Xzz /= 2*x_kappa;
+						// Correlation of state with observation: Xxz
+		Eigen::Matrix<Float, x_size, z_size> Xxz = (2*kappa) * (XX.col(0) - x) * zXX.col(0).transpose();
+		for (int i = 1; i < zXX.cols(); ++i) {
+			Xxz += (XX.col(i) - x) * zXX.col(i).transpose();
+		}
+		Xxz /= 2*x_kappa;
+
+						// Innovation covariance
+		const Obs_sym_matrix S_z = Xzz + h.Z();
+						// Inverse innovation covariance
+		Eigen::LDLT<Obs_sym_matrix> ldlt(S_z);
+		Float rcond = rcond_internal (ldlt.vectorD());
+		rclimit.check_PD(rcond, "S not PD in observe");
+		const Obs_sym_matrix SI_z = ldlt.solve (Obs_sym_matrix::Identity());
+						// Kalman gain
+		const Eigen::Matrix<Float, x_size, z_size> W = Xxz * SI_z;
+						// Normalised innovation
+		Obs_vec s_z = z;
+		h.normalise (s_z, zp);
+		s_z -= zp;
+						// Filter update
+		x += W * s_z;
+		X -= W * S_z * W.transpose();
+
+		s = s_z;
+		S = S_z;
+		SI = SI_z;
+		return rcond;
+	}
+
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+protected:
+	void unscented (ColMatrix& XX, const Vec& x, const SymMatrix& X, Float scale) const
+	/* Generate the Unscented point representing a distribution
+	 * Fails if scale is negative
+	 */
+	{
+						// Get a upper Cholesky factorisation
+		SymMatrix Sigma = X;
+		Float rcond = UCfactor (Sigma);
+		rclimit.check_PSD(rcond, "X not PSD");
+		Sigma.template triangularView<Eigen::StrictlyLower>().setZero();
+		Sigma *= std::sqrt(scale);
+
+						// Generate XX with the same sample Mean and Covariance as before
+		XX.col(0) = x;
+		for (int c = 0; c < x_size; ++c) {
+			XX.col(c+1) = x + Sigma.col(c);
+			XX.col(x_size+c+1) = x - Sigma.col(c);
+		}
+	}
+
+	static Float UCfactor (SymMatrix& M)
+	/* In place upper triangular Cholesky factor of a
+	 *  Positive definite or semi-definite matrix M, as UCfactor in UdU.cpp
+	 * Strict lower triangle of M is ignored in computation
+	 * Output: upper_triangle(M) = UC, with M = UC*UC'
+	 * Return:
+	 *    reciprocal condition number, -1 if negative, 0 if semi-definite (including zero)
+	 */
+	{
+		for (int j = x_size-1; j >= 0; --j) {
+			Float d = M(j,j);
+
+			// Diagonal element
+			if (d > 0)
+			{	// Positive definite
+				d = std::sqrt(d);
+				M(j,j) = d;
+				d = 1 / d;
+
+				for (int i = 0; i < j; ++i)
+				{
+					Float e = d*M(i,j);
+					M(i,j) = e;
+					for (int k = 0; k <= i; ++k)
+					{
+						M(k,i) -= e*M(k,j);
+					}
+				}
+			}
+			else if (d == 0)
+			{	// Possibly semi-definite, check not negative
+				for (int i = 0; i < j; ++i)
+				{
+					if (M(i,j) != 0)
+						return -1;
+				}
+			}
+			else
+			{	// Negative
+				return -1;
+			}
+		}
+
+		// Square to get rcond of original matrix, take care to propogate rcond's sign!
+		Float rcond = rcond_internal (M.diagonal());
+		return rcond < 0 ? -(rcond*rcond) : rcond*rcond;
+	}
+
+	template <class V>
+	static Float rcond_internal (const V& D)
+	/* Estimate the reciprocal condition number of a Diagonal Matrix for inversion
+	 *  rcond = min/max, as rcond_internal in UdU.cpp
+	 */
+	{
+		if (D.size() == 0)
+			return 0;
+
+		Float mind = D[0], maxd = 0;
+		for (int i = 0; i < D.size(); ++i) {
+			Float d = D[i];
+			if (d != d)				// NaN
+				return -1;
+			if (d < mind) mind = d;
+			if (d > maxd) maxd = d;
+		}
+
+		if (mind < 0)				// matrix is negative
+			return -1;
+
+		Float rcond = mind / maxd;	// rcond from min/max norm
+		if (rcond != rcond)			// NaN, singular due to (mind == maxd) == (zero or infinity)
+			rcond = 0;
+		return rcond;
+	}
+};
+
+
+}//namespace
+#endif
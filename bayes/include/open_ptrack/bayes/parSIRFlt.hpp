@@ -0,0 +1,228 @@
+#ifndef _BAYES_FILTER_PARALLEL_SIR
+#define _BAYES_FILTER_PARALLEL_SIR
+
+/*
+ * Bayes++ the Bayesian Filtering Library
+ * Copyright (c) 2002 Michael Stevens
+ * See accompanying Bayes++.htm for terms and conditions of use.
+ *
+ * $Id$
+ */
+
+/*
+ * Data parallel Sampling Importance Resampling Filter Scheme.
+ *  The bootstrap filter of SIR_scheme organised for many particles on many cores.
+ *
+ *  Particles are stored as a structure of arrays: S is a row major (x_size,s_size) array,
+ *  so each state element of all the particles is contiguous. Prediction, likelihood
+ *  weighting and roughening are defined on blocks of particles and vectorise over them.
+ *
+ *  The particles are split in fixed size blocks which are processed in parallel (OpenMP).
+ *  Each block draws from its own random stream, seeded from the filter seed and the block
+ *  index, so results depend on the seed and the block size but not on the number of threads.
+ *
+ *  Resampling is the systematic resampler of [2] (see SIRFlt.hpp) rewritten around a prefix sum:
+ *  once the cumulative weights of the blocks are known, each particle computes on its own how
+ *  many points of the systematic grid fall in its weight interval and where its copies go,
+ *  so resamples are written in parallel into a second particle buffer.
+ */
+#include "bayesFlt.hpp"
+#include <Eigen/Core>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+/* Filter namespace */
+namespace Bayesian_filter
+{
+
+class Block_predict_model : public Bayes_base
+/*
+ * Sampled predict model for blocks of particles, additive Gaussian noise
+ *  x(k|k-1) = f(x(k-1|k-1)) + G(k)w(k)
+ *  q(k) = state noise variance vector, q(k) is covariance of w(k)
+ * f is applied in place to a block of particles, one particle per column
+ */
+{
+public:
+	typedef Eigen::Array<Float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> Particles;
+	typedef Eigen::Block<Particles> Block;
+	typedef Eigen::Matrix<Float, Eigen::Dynamic, Eigen::Dynamic> Matrix;
+	typedef Eigen::Matrix<Float, Eigen::Dynamic, 1> Vec;
+
+	Block_predict_model (std::size_t x_size, std::size_t q_size);
+
+	virtual void f (Block P) const = 0;
+	// Functional part of the model applied to the particles P
+
+	Matrix G;		// Noise Coupling
+	Vec q;			// Noise variance (always dense, use coupling to represent sparseness)
+};
+
+class Linear_block_predict_model : public Block_predict_model
+/*
+ * Linear predict model for blocks of particles, additive Gaussian noise
+ *  x(k|k-1) = Fx * x(k-1|k-1) + G(k)w(k)
+ */
+{
+public:
+	Linear_block_predict_model (std::size_t x_size, std::size_t q_size);
+
+	void f (Block P) const
+	{
+		P.matrix() = Fx * P.matrix();
+	}
+
+	Matrix Fx;		// Model
+};
+
+
+class Block_likelihood_observe_model : public Bayes_base
+/*
+ * Likelihood observe model L(z |x) for blocks of particles
+ */
+{
+public:
+	typedef Eigen::Array<Float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> Particles;
+	typedef Eigen::Block<const Particles> Const_block;
+	typedef Eigen::Array<Float, Eigen::Dynamic, 1> Weights;
+	typedef Eigen::Matrix<Float, Eigen::Dynamic, 1> Vec;
+
+	Block_likelihood_observe_model (std::size_t z_size) : z(z_size)
+	{}
+
+	virtual void L (Const_block P, Weights& l) const = 0;
+	// Likelihood L(z | x) of each particle (column) of P, l has the size of P
+
+	virtual void Lz (const Vec& zz)
+	// Set the observation zz about which to evaluate the Likelihood function
+	{
+		z = zz;
+	}
+protected:
+	Vec z;			// z set by Lz
+};
+
+class Linear_uncorrelated_block_observe_model : public Block_likelihood_observe_model
+/*
+ * Gaussian likelihood of a linear observation, uncorrelated additive observation noise
+ *  z(k) = Hx(k) * x(k|k-1) + v(k)
+ *  Zv(k) observe noise variance vector
+ * The likelihood is not normalised, as resampling only depends on relative weights
+ */
+{
+public:
+	typedef Eigen::Matrix<Float, Eigen::Dynamic, Eigen::Dynamic> Matrix;
+
+	Linear_uncorrelated_block_observe_model (std::size_t x_size, std::size_t z_size);
+
+	void L (Const_block P, Weights& l) const;
+
+	Matrix Hx;		// Model
+	Vec Zv;			// Noise variance
+};
+
+
+class Parallel_SIR_scheme : public Bayes_base
+/*
+ * Data parallel Sampling Importance Resampling Filter Scheme.
+ *  Same operation of SIR_scheme: importance resampling is delayed until an update is required,
+ *  the resampler is the systematic one, roughening uses the max-min of each state.
+ *  Kalman statistics (mean and covariance of the particles) are computed on request.
+ */
+{
+public:
+	typedef Block_predict_model::Particles Particles;
+	typedef Block_likelihood_observe_model::Weights Weights;
+	typedef Eigen::Matrix<Float, Eigen::Dynamic, 1> Vec;
+	typedef Eigen::Matrix<Float, Eigen::Dynamic, Eigen::Dynamic> SymMatrix;
+
+	Particles S;		// state sampling (x_size,s_size), one particle per column
+	std::size_t stochastic_samples;	// Number of stochastic samples in S
+
+	Vec x;				// Mean of the particles, from update_statistics
+	SymMatrix X;		// Covariance of the particles, from update_statistics
+
+	Float rougheningK;	// Current roughening value (0 implies no roughening)
+
+	Parallel_SIR_scheme (std::size_t x_size, std::size_t s_size, unsigned long seed = 0, std::size_t block_size = 1024);
+	/* Initialise filter and set constant sizes for
+	    x_size of the state vector
+	    s_size sample size
+	    block_size number of particles processed together by a thread, with its own random stream
+	 */
+
+	void seed (unsigned long seed);
+	// Restart the random streams of all the blocks
+
+	void init_S ();
+	// Initialise from current sampling
+
+	void init_sample (const Particles& initS);
+	// Initialise from a sampling
+
+	void predict (const Block_predict_model& f);
+	// Predict samples with noise model
+
+	void observe (Block_likelihood_observe_model& h, const Vec& z);
+	// Weight particles using likelihood model h and z
+
+	void observe_likelihood (const Weights& lw);
+	// Observation fusion directly from likelihood weights
+
+	Float update_resample ();
+	/* Update: resample particles using weights and then roughen
+	 *  Return: lcond
+	 */
+
+	void update_statistics ();
+	// Update x,X: mean and (biased) covariance of the particles
+
+	virtual void roughen ()
+	// Generalised roughening:  Default to roughen_minmax
+	{
+		if (rougheningK != 0)
+			roughen_minmax (S, rougheningK);
+	}
+
+protected:
+	struct Random_stream
+	// Random numbers of a block of particles
+	{
+		std::mt19937_64 rng;
+		std::uniform_real_distribution<Float> uniform_01;	// [0..1)
+	};
+
+	void normal (Particles& n, std::size_t b);
+	// Fill n with independent zero mean normal draws from the stream of block b
+
+	std::size_t blocks () const
+	{	return streams.size();
+	}
+	std::size_t block_begin (std::size_t b) const
+	{	return b * block_size;
+	}
+	std::size_t block_end (std::size_t b) const
+	{	return std::min((b+1) * block_size, std::size_t(S.cols()));
+	}
+
+	Float systematic_resample ();
+	// Resample S based on wir, return lcond
+
+	void roughen_minmax (Particles& P, Float K);	// roughening using minmax of P distribution
+
+	Weights wir;				// resamping weights
+	bool wir_update;			// weights have been updated requring a resampling on update
+
+private:
+	static const Float rougheningKinit;
+	std::size_t x_size;
+	std::size_t block_size;
+	std::vector<Random_stream> streams;	// one random stream per block
+	Particles S_resampled;		// resampling buffer, swapped with S
+	Weights wcum;				// cumulative weights within each block
+};
+
+
+}//namespace
+#endif
@@ -0,0 +1,344 @@
+/*
+ * Bayes++ the Bayesian Filtering Library
+ * Copyright (c) 2002 Michael Stevens
+ * See accompanying Bayes++.htm for terms and conditions of use.
+ *
+ * $Id$
+ */
+
+/*
+ * Data parallel Sampling Importance Resampling Filter.
+ *
+ * Bootstrap filter (Sequential Importance Resampling) on blocks of particles.
+ */
+#include "parSIRFlt.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+
+/* Filter namespace */
+namespace Bayesian_filter
+{
+
+Block_predict_model::Block_predict_model (std::size_t x_size, std::size_t q_size) :
+	G(Matrix::Zero(x_size, q_size)), q(Vec::Zero(q_size))
+{}
+
+Linear_block_predict_model::Linear_block_predict_model (std::size_t x_size, std::size_t q_size) :
+	Block_predict_model(x_size, q_size), Fx(Matrix::Identity(x_size, x_size))
+{}
+
+Linear_uncorrelated_block_observe_model::Linear_uncorrelated_block_observe_model (std::size_t x_size, std::size_t z_size) :
+	Block_likelihood_observe_model(z_size),
+	Hx(Matrix::Zero(z_size, x_size)), Zv(Vec::Zero(z_size))
+{}
+
+void Linear_uncorrelated_block_observe_model::L (Const_block P, Weights& l) const
+/* Gaussian likelihood of the particles
+ *  l = exp(-0.5 * sum((z - Hx*P)^2 / Zv))
+ *  Evaluated one observation element at a time over all the particles of P
+ */
+{
+	const Particles zp = (Hx * P.matrix()).array();
+	l.setZero();
+	for (Eigen::Index i = 0; i < zp.rows(); ++i) {
+		l += (zp.row(i).transpose() - z[i]).square() / Zv[i];
+	}
+	l = (Float(-0.5) * l).exp();
+}
+
+
+/*
+ * Parallel SIR filter implementation
+ */
+const Parallel_SIR_scheme::Float Parallel_SIR_scheme::rougheningKinit = 1;
+		// use 1 std.dev. per sample as default roughening
+
+Parallel_SIR_scheme::Parallel_SIR_scheme (std::size_t x_size, std::size_t s_size, unsigned long seed, std::size_t block_size) :
+	S(Particles::Zero(x_size, s_size)),
+	stochastic_samples(s_size),
+	x(Vec::Zero(x_size)), X(SymMatrix::Zero(x_size, x_size)),
+	rougheningK(rougheningKinit),
+	wir(Weights::Ones(s_size)), wir_update(false),
+	x_size(x_size), block_size(block_size),
+	S_resampled(x_size, s_size), wcum(s_size)
+/* Initialise filter and set the size of things we know about
+ */
+{
+	if (s_size < 1)
+		error (Logic_exception("Zero sample size"));
+	if (block_size < 1)
+		error (Logic_exception("Zero block size"));
+	streams.resize((s_size + block_size - 1) / block_size);
+	Parallel_SIR_scheme::seed (seed);
+}
+
+void Parallel_SIR_scheme::seed (unsigned long seed)
+/* Seed the stream of each block from the filter seed and the block index
+ */
+{
+	for (std::size_t b = 0; b < streams.size(); ++b) {
+		std::seed_seq seq {static_cast<unsigned long>(seed), static_cast<unsigned long>(b)};
+		streams[b].rng.seed (seq);
+		streams[b].uniform_01.reset ();
+	}
+}
+
+void Parallel_SIR_scheme::normal (Particles& n, std::size_t b)
+/* Normal draws with the Box-Muller transform
+ *  Uniform draws are made one at a time from the stream, the transform is vectorised over all of n
+ */
+{
+	typedef Eigen::Array<Float, Eigen::Dynamic, 1> Array;
+	const Eigen::Index size = n.size(), half = (size + 1) / 2;
+	const Float scale = std::ldexp(Float(1), -53);	// 53 random bits of each draw
+	const Float two_pi = Float(2) * Float(3.14159265358979323846);
+
+	Random_stream& stream = streams[b];
+	Array u1(half), u2(half);
+	for (Eigen::Index i = 0; i < half; ++i) {
+		u1[i] = Float((stream.rng() >> 11) + 1) * scale;	// (0..1] for the log
+		u2[i] = Float(stream.rng() >> 11) * scale;
+	}
+	const Array r = (Float(-2) * u1.log()).sqrt();
+	const Array theta = two_pi * u2;
+
+	Eigen::Map<Array> draws(n.data(), size);
+	draws.head(half) = r * theta.cos();
+	draws.tail(size - half) = (r * theta.sin()).head(size - half);
+}
+
+void Parallel_SIR_scheme::init_S ()
+/* Initialise sampling
+ *  Pre: S
+ *  Post: stochastic_samples := samples in S
+ */
+{
+	stochastic_samples = S.cols();
+	wir.setOnes();			// Initial uniform weights
+	wir_update = false;
+}
+
+void Parallel_SIR_scheme::init_sample (const Particles& initS)
+/* Initialise from a sampling
+ *  Precond: initS has the size of S
+ */
+{
+	if (initS.rows() != S.rows() || initS.cols() != S.cols())
+		error (Logic_exception("init_sample size does not conform"));
+	S = initS;
+	init_S ();
+}
+
+void Parallel_SIR_scheme::predict (const Block_predict_model& f)
+/* Predict state posterior with sampled noise model
+ *  Pre : S represent the prior distribution
+ *  Post: S represent the predicted distribution, stochastic_samples := samples in S
+ */
+{
+	if ((f.q.array() < 0).any())
+		error (Numeric_exception("Negative q in predict"));
+	const Vec rootq = f.q.cwiseSqrt();
+
+						// Predict each block of particles S using supplied predict model
+	const long nBlocks = long(blocks());
+#pragma omp parallel for schedule(static)
+	for (long b = 0; b < nBlocks; ++b) {
+		const std::size_t begin = block_begin(b), n = block_end(b) - begin;
+		Block_predict_model::Block Sb = S.middleCols(begin, n);
+		f.f (Sb);
+							// Additive random noise: correlated by G, std dev rootq
+		Particles noise(rootq.size(), n);
+		normal (noise, b);
+		Sb.matrix().noalias() += f.G * (rootq.asDiagonal() * noise.matrix());
+	}
+	stochastic_samples = S.cols();
+}
+
+void Parallel_SIR_scheme::observe (Block_likelihood_observe_model& h, const Vec& z)
+/* Observation fusion using Likelihood at z
+ * Pre : wir previous particle likelihood weights
+ * Post: wir fused (multiplicative) particle likelihood weights
+ */
+{
+	h.Lz (z);			// Observe likelihood at z
+						// Weight Particles. Fused with previous weight
+	const Particles& Sc = S;
+	const long nBlocks = long(blocks());
+#pragma omp parallel for schedule(static)
+	for (long b = 0; b < nBlocks; ++b) {
+		const std::size_t begin = block_begin(b), n = block_end(b) - begin;
+		Weights l(n);
+		h.L (Sc.middleCols(begin, n), l);
+		wir.segment(begin, n) *= l;
+	}
+	wir_update = true;
+}
+
+void Parallel_SIR_scheme::observe_likelihood (const Weights& lw)
+/* Observation fusion directly from likelihood weights
+ * lw may be smaller then the number of particles. Weights for additional particles are assumed to be 1
+ * Pre : wir previous particle likelihood weights
+ * Post: wir fused (multiplicative) particle likelihood weights
+ */
+{
+	wir.head(lw.size()) *= lw;
+	wir_update = true;
+}
+
+Parallel_SIR_scheme::Float Parallel_SIR_scheme::update_resample ()
+/* Resample particles using weights and roughen
+ * Pre : S represent the predicted distribution
+ * Post: S represent the fused distribution
+ * Exceptions:
+ *  Bayes_filter_exception from resampling
+ *    unchanged: S, stochastic_samples
+ * Return
+ *  lcond, Smallest normalised weight, represents conditioning of resampling solution
+ *  lcond == 1 if no resampling performed
+ */
+{
+	Float lcond = 1;
+	if (wir_update)		// Resampling only required if weights have been updated
+	{
+		lcond = systematic_resample ();
+		roughen ();			// Roughen samples
+		wir.setOnes();		// Resampling results in uniform weights
+		wir_update = false;
+	}
+	return lcond;
+}
+
+Parallel_SIR_scheme::Float Parallel_SIR_scheme::systematic_resample ()
+/* Systematic resample algorithm from [2], parallel form
+ * Algorithm:
+ *	A particle is chosen once for each time its cumulative weight interval intersects with an equidistant grid
+ *	(u + k) * wstep, k = 0..n-1. A uniform random draw u positions the grid within the cumulative weights.
+ *	1. Each block computes the cumulative sum (Kahan algorithm) of its weights
+ *	2. The block sums are scanned to obtain the offset of each block
+ *	3. Each particle counts the grid points below its cumulative weight: the counts of a particle and of its
+ *	   predecessor give the range of S_resampled it is copied to
+ *	Complexity O(n), parallel except for the scan of the block sums
+ * Post:
+ *  S resampled, stochastic_samples := number of unique resamples
+ * Sideeffects:
+ *  A single draw is made from the stream of the first block
+ */
+{
+	const std::size_t nSamples = S.cols();
+	const long nBlocks = long(blocks());
+	std::vector<Float> block_sum(nBlocks), block_min(nBlocks), block_offset(nBlocks);
+
+						// Cumulative sum of likelihood weights in each block, and smallest weight
+#pragma omp parallel for schedule(static)
+	for (long b = 0; b < nBlocks; ++b) {
+		Float wmin = std::numeric_limits<Float>::max();
+		Float sum = 0, c = 0, y, t;
+		for (std::size_t i = block_begin(b); i != block_end(b); ++i) {
+			if (wir[i] < wmin)
+				wmin = wir[i];
+			y = wir[i] - c;
+			t = sum + y;
+			c = t - sum - y;
+			wcum[i] = sum = t;
+		}
+		block_sum[b] = sum;
+		block_min[b] = wmin;
+	}
+						// Offset of each block in the cumulative sum
+	Float wmin = std::numeric_limits<Float>::max();
+	Float wtotal = 0;
+	for (long b = 0; b < nBlocks; ++b) {
+		block_offset[b] = wtotal;
+		wtotal += block_sum[b];
+		wmin = std::min(wmin, block_min[b]);
+	}
+	if (wmin < 0)		// bad weights
+		error (Numeric_exception("negative weight"));
+	if (wtotal <= 0)	// bad cumulative weights (previous check should actually prevent -ve
+		error (Numeric_exception("total likelihood zero"));
+						// Any numerical failure should cascade into cumulative sum
+	if (!(wtotal <= std::numeric_limits<Float>::max()))	// NaN or infinity
+		error (Numeric_exception("total likelihood numerical error"));
+
+						// Stratified step and random grid position
+	const Float wstep = wtotal / Float(nSamples);
+	const Float u = streams[0].uniform_01(streams[0].rng);
+	assert (u >= 0 && u < 1);		// very bad if random is incorrect
+
+						// Resamples based on cumulative weights
+	std::vector<std::size_t> block_unique(nBlocks, 0);
+#pragma omp parallel for schedule(static)
+	for (long b = 0; b < nBlocks; ++b) {
+		// Number of grid points below the cumulative weight w
+		auto grid_count = [&](Float w) -> std::size_t {
+			const Float g = std::ceil(w / wstep - u);
+			return g <= 0 ? 0 : std::min(nSamples, std::size_t(g));
+		};
+		std::size_t si = grid_count(block_offset[b]);
+		for (std::size_t i = block_begin(b); i != block_end(b); ++i) {
+			// The last particle closes the grid whatever the rounding of the cumulative sum
+			const std::size_t send = (i + 1 == nSamples) ? nSamples : grid_count(block_offset[b] + wcum[i]);
+			if (send > si) {
+				++block_unique[b];
+				for (Eigen::Index r = 0; r < S.rows(); ++r) {
+					S_resampled.row(r).segment(si, send - si).setConstant(S(r, i));
+				}
+				si = send;
+			}
+		}
+	}
+	S.swap (S_resampled);
+
+	stochastic_samples = 0;
+	for (long b = 0; b < nBlocks; ++b)
+		stochastic_samples += block_unique[b];
+	return wmin / wtotal;
+}
+
+void Parallel_SIR_scheme::update_statistics ()
+/* Update kalman statistics without resampling
+ * Sample Covariance := Sum_i [transpose(S[i]-mean)*(S[i]-mean)] / (s_size)
+ *  The definition is the Maximum Likelihood (biased) estimate of covariance given samples with unknown (estimated) mean
+ */
+{
+	x = S.matrix().rowwise().mean();
+	const Block_predict_model::Matrix centered = S.matrix().colwise() - x;
+	X.noalias() = centered * centered.transpose() / Float(S.cols());
+}
+
+void Parallel_SIR_scheme::roughen_minmax (Particles& P, Float K)
+/* Roughening
+ *  Uses algorithm from Ref[1] using max-min in each state of P
+ *  K is scaling factor for roughening noise
+ *  unique_samples is unchanged as roughening is used to postprocess observe resamples
+ * Numerical collapse of P
+ *  P with very small or zero range result in minimal roughening
+ */
+{
+						// Scale Sigma by constant and state dimensions
+	const Float SigmaScale = K * std::pow (Float(P.cols()), -1/Float(x_size));
+						// Find min and max states in all P, precond P not empty
+	const long nBlocks = long(blocks());
+	Particles block_min(x_size, nBlocks), block_max(x_size, nBlocks);
+#pragma omp parallel for schedule(static)
+	for (long b = 0; b < nBlocks; ++b) {
+		const std::size_t begin = block_begin(b), n = block_end(b) - begin;
+		block_min.col(b) = P.middleCols(begin, n).rowwise().minCoeff();
+		block_max.col(b) = P.middleCols(begin, n).rowwise().maxCoeff();
+	}
+						// Roughening st.dev max-min
+	const Weights rootq = (block_max.rowwise().maxCoeff() - block_min.rowwise().minCoeff()) * SigmaScale;
+						// Apply roughening predict based on scaled variance
+#pragma omp parallel for schedule(static)
+	for (long b = 0; b < nBlocks; ++b) {
+		const std::size_t begin = block_begin(b), n = block_end(b) - begin;
+		Particles noise(x_size, n);
+		normal (noise, b);			// independent zero mean normal
+		P.middleCols(begin, n) += noise.colwise() * rootq;
+	}
+}
+
+}//namespace
@@ -0,0 +1,168 @@
+#ifndef _OPEN_PTRACK__POSE_GALLERY_INDEX_H
+#define _OPEN_PTRACK__POSE_GALLERY_INDEX_H
+
+#include <array>
+#include <map>
+#include <vector>
+#include <eigen3/Eigen/Eigen>
+#include <body_pose_estimation/skeleton_base.h>
+
+namespace open_ptrack
+{
+namespace bpr
+{
+
+/**
+ * \brief Contiguous index of the gallery poses used for pose recognition.
+ *
+ * The limbs (elbow + wrist, knee + ankle) of all the frames of all the gallery
+ * poses are stored in a single matrix, one column per frame and frames of the
+ * same pose in consecutive columns. Scores of many skeletons are computed at
+ * once with one matrix product per limb. For every pose the limb centroids and
+ * radii are stored too: by the triangle inequality they give a lower bound of
+ * the pose score, used to skip poses which cannot beat the best one.
+ * Limbs with missing (NaN) joints are ignored in the scores.
+ */
+class PoseGalleryIndex
+{
+public:
+  typedef Eigen::Matrix<double, 3,
+  open_ptrack::bpe::SkeletonJoints::SIZE> SkeletonMatrix;
+
+  enum Limb
+  {
+    RIGHT_ARM = 0,
+    LEFT_ARM,
+    RIGHT_LEG,
+    LEFT_LEG,
+    LIMBS_NUMBER
+  };
+
+  // rows of a limb in the limb vectors (two 3D joints)
+  static const int LIMB_SIZE = 6;
+
+  PoseGalleryIndex(const std::array<bool, LIMBS_NUMBER>& enabled_limbs,
+                   uint per_skeleton_score_fusion_policy,
+                   uint per_gallery_frame_pose_score_fusion_policy);
+
+  // build the index from the gallery frames of every pose
+  void
+  build(const std::map<size_t, std::vector<SkeletonMatrix> >& gallery_poses);
+
+  // number of rows of a limb vector (LIMB_SIZE for every enabled limb)
+  int
+  getLimbVectorSize() const { return m_enabled_limbs.size() * LIMB_SIZE; }
+
+  size_t
+  getPosesNumber() const { return m_pose_ids.size(); }
+
+  // gallery pose id of the pose at the given index
+  size_t
+  getPoseId(size_t pose_index) const { return m_pose_ids[pose_index]; }
+
+  // fill a column of a limb matrix with the enabled limbs of a skeleton
+  template <typename JointVector>
+  void
+  toLimbVector(const JointVector& joints,
+               Eigen::Ref<Eigen::VectorXd> limb_vector) const
+  {
+    for(size_t l = 0; l < m_enabled_limbs.size(); ++l)
+    {
+      const std::pair<int, int>& j = LIMB_JOINTS[m_enabled_limbs[l]];
+      limb_vector.segment<LIMB_SIZE>(l * LIMB_SIZE) <<
+          joints[j.first].x, joints[j.first].y, joints[j.first].z,
+          joints[j.second].x, joints[j.second].y, joints[j.second].z;
+    }
+  }
+
+  /**
+   * \brief Score all the gallery poses for all the skeletons.
+   *
+   * \param[in] queries Limb vectors of the skeletons, one column per skeleton.
+   * \param[out] scores Pose scores, one row per pose and one column per skeleton.
+   */
+  void
+  score(const Eigen::MatrixXd& queries, Eigen::MatrixXd& scores) const;
+
+  /**
+   * \brief Find the best gallery pose of a skeleton, skipping the poses whose
+   * lower bound is above the best score found so far (or above max_score).
+   *
+   * \param[in] query Limb vector of the skeleton.
+   * \param[in] max_score Scores above this value are not of interest.
+   * \param[out] scores Score of every pose (NaN for the skipped poses).
+   * \param[in] candidates Pose indices scored first (e.g. the best poses of
+   * the previous frame), so that most of the other poses can be skipped.
+   *
+   * \return the index of the best pose, -1 if no pose scored below max_score.
+   */
+  int
+  findBest(const Eigen::VectorXd& query, double max_score,
+           Eigen::VectorXd& scores,
+           const std::vector<int>& candidates = std::vector<int>()) const;
+
+  /**
+   * \brief Refresh the scores of a skeleton which moved since it was scored:
+   * the candidates are scored again, then every pose whose lower bound can
+   * beat one of them. The other poses keep their previous score.
+   *
+   * \param[in] query Limb vector of the skeleton.
+   * \param[in] max_score Scores above this value are not of interest.
+   * \param[in,out] scores Previous score of every pose (NaN scores are
+   * always refreshed).
+   * \param[in] candidates Pose indices scored first (e.g. the best poses of
+   * the previous scoring).
+   *
+   * \return the index of the best refreshed pose, -1 if no pose scored below
+   * max_score.
+   */
+  int
+  refine(const Eigen::VectorXd& query, double max_score,
+         Eigen::VectorXd& scores, const std::vector<int>& candidates) const;
+
+  // indices of the k poses with the lowest scores (NaN scores are ignored)
+  static std::vector<int>
+  getBestPoses(const Eigen::VectorXd& scores, size_t k);
+
+private:
+  static const std::array<std::pair<int, int>, LIMBS_NUMBER> LIMB_JOINTS;
+
+  std::vector<int> m_enabled_limbs;
+  uint m_per_skeleton_score_fusion_policy;
+  uint m_per_gallery_frame_pose_score_fusion_policy;
+
+  // all the gallery frames, one column per frame
+  Eigen::MatrixXd m_gallery;
+  // squared norm of every limb of every frame (one row per limb)
+  Eigen::MatrixXd m_gallery_squared_norms;
+  // 1 for the limbs of a frame with all the joints, 0 otherwise (limb x frame)
+  Eigen::MatrixXd m_gallery_limb_weights;
+  // first column of every pose in m_gallery (plus the end of the last one)
+  std::vector<int> m_pose_begin;
+  std::vector<size_t> m_pose_ids;
+  // limb centroids of every pose (one column per pose)
+  Eigen::MatrixXd m_pose_centroids;
+  // distance of the farthest frame from the limb centroid (limb x pose)
+  Eigen::MatrixXd m_pose_radii;
+
+  // fuse limb distances (one row per limb, NaN if missing) into per-frame scores
+  Eigen::RowVectorXd
+  fuseLimbs(const Eigen::MatrixXd& limb_distances) const;
+
+  // fuse the frame scores of a pose into the pose score
+  double
+  fuseFrames(Eigen::VectorXd frame_scores) const;
+
+  // exact score of a single pose
+  double
+  scorePose(const Eigen::VectorXd& query, int pose_index) const;
+
+  // lower bound of the score of every pose
+  Eigen::RowVectorXd
+  lowerBounds(const Eigen::VectorXd& query) const;
+};
+
+} // bpr
+} // open_ptrack
+
+#endif
@@ -6,8 +6,11 @@
 #include <ros/package.h>
 #include <opt_msgs/SkeletonTrackArray.h>
 #include <body_pose_recognition/standardpose.h>
+#include <body_pose_recognition/pose_gallery_index.h>
 #include <visualization_msgs/MarkerArray.h>
 #include <boost/filesystem.hpp>
+#include <deque>
+#include <memory>
 #include <numeric>
 #include <opt_msgs/PoseRecognitionArray.h>
 #include <message_filters/time_synchronizer.h>
@@ -81,8 +84,32 @@ private:
   opt_msgs::SkeletonTrackArray> m_sync;
   std::map<size_t, std::vector<SkeletonMatrix>> m_gallery_poses;
   std::map<size_t, std::string> m_gallery_poses_names;
-  std::map<size_t, std::vector<double>> m_per_frame_scores;
-  std::map<size_t, double> m_final_scores;
+  // contiguous gallery used for scoring
+  std::unique_ptr<PoseGalleryIndex> m_gallery_index;
+  // if true, poses which cannot beat the best one are not scored
+  bool m_early_exit;
+
+  // recognition results of a track, reused while the track barely moves
+  struct TrackCache
+  {
+    // limb vector and pose scores of the last scoring
+    Eigen::VectorXd query;
+    Eigen::VectorXd scores;
+    int best_pose;
+    // best poses of the last scoring, checked first at the next one
+    std::vector<int> best_poses;
+    // last results (best pose and score) for the temporal vote
+    std::deque<std::pair<int, double> > votes;
+    ros::Time last_seen;
+  };
+  std::map<int, TrackCache> m_track_cache;
+  bool m_cache_enabled;
+  // maximum joint displacement (meters) for reusing the last scores
+  double m_cache_displacement_threshold;
+  int m_cache_top_k;
+  size_t m_cache_vote_window;
+  // time (seconds) after which a track not seen is removed from the cache
+  double m_cache_max_age;
   bool m_use_right_leg, m_use_right_arm, m_use_left_leg, m_use_left_arm;
   // how to fuse scores from the different body parts in a unique one
   uint m_per_skeleton_score_fusion_policy;
@@ -99,6 +126,11 @@ private:
       const opt_msgs::StandardSkeletonTrackArrayConstPtr &standard_data,
       const opt_msgs::SkeletonTrackArrayConstPtr &data);
   void readMatricesForSinglePose(const uint pose_id);
+  static double
+  maxJointDisplacement(const Eigen::VectorXd& a, const Eigen::VectorXd& b);
+  static void
+  voteBestPose(const std::deque<std::pair<int, double> >& votes,
+               int& best_pose, double& best_score);
 };
 
 } // bpr
@@ -0,0 +1,357 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <body_pose_recognition/pose_gallery_index.h>
+
+namespace open_ptrack
+{
+namespace bpr
+{
+
+typedef bpe::SkeletonJoints SkeletonJoints;
+
+const std::array<std::pair<int, int>, PoseGalleryIndex::LIMBS_NUMBER>
+PoseGalleryIndex::LIMB_JOINTS = {{
+  std::make_pair(SkeletonJoints::RELBOW, SkeletonJoints::RWRIST),
+  std::make_pair(SkeletonJoints::LELBOW, SkeletonJoints::LWRIST),
+  std::make_pair(SkeletonJoints::RKNEE, SkeletonJoints::RANKLE),
+  std::make_pair(SkeletonJoints::LKNEE, SkeletonJoints::LANKLE)
+}};
+
+PoseGalleryIndex::PoseGalleryIndex(
+    const std::array<bool, LIMBS_NUMBER>& enabled_limbs,
+    uint per_skeleton_score_fusion_policy,
+    uint per_gallery_frame_pose_score_fusion_policy):
+  m_per_skeleton_score_fusion_policy(per_skeleton_score_fusion_policy),
+  m_per_gallery_frame_pose_score_fusion_policy(
+    per_gallery_frame_pose_score_fusion_policy)
+{
+  for(int l = 0; l < LIMBS_NUMBER; ++l)
+    if(enabled_limbs[l])
+      m_enabled_limbs.push_back(l);
+}
+
+void
+PoseGalleryIndex::build(
+    const std::map<size_t, std::vector<SkeletonMatrix> >& gallery_poses)
+{
+  const int limbs = m_enabled_limbs.size();
+  int n_frames = 0;
+  for(auto it = gallery_poses.begin(); it != gallery_poses.end(); ++it)
+    n_frames += it->second.size();
+
+  m_gallery.resize(getLimbVectorSize(), n_frames);
+  m_pose_begin.clear();
+  m_pose_ids.clear();
+  int frame = 0;
+  for(auto it = gallery_poses.begin(); it != gallery_poses.end(); ++it)
+  {
+    if(it->second.empty()) continue;
+    m_pose_begin.push_back(frame);
+    m_pose_ids.push_back(it->first);
+    for(size_t f = 0; f < it->second.size(); ++f, ++frame)
+    {
+      const SkeletonMatrix& m = it->second[f];
+      for(int l = 0; l < limbs; ++l)
+      {
+        const std::pair<int, int>& j = LIMB_JOINTS[m_enabled_limbs[l]];
+        m_gallery.block<3, 1>(l * LIMB_SIZE, frame) = m.col(j.first);
+        m_gallery.block<3, 1>(l * LIMB_SIZE + 3, frame) = m.col(j.second);
+      }
+    }
+  }
+  m_pose_begin.push_back(frame);
+
+  // limbs with missing (NaN) joints get a zero weight, and zeros in m_gallery
+  // so that they do not propagate through the matrix products
+  m_gallery_limb_weights.resize(limbs, n_frames);
+  for(int f = 0; f < n_frames; ++f)
+    for(int l = 0; l < limbs; ++l)
+    {
+      auto limb = m_gallery.block<LIMB_SIZE, 1>(l * LIMB_SIZE, f);
+      m_gallery_limb_weights(l, f) = limb.allFinite() ? 1.0 : 0.0;
+      if(m_gallery_limb_weights(l, f) == 0.0) limb.setZero();
+    }
+
+  m_gallery_squared_norms.resize(limbs, n_frames);
+  for(int l = 0; l < limbs; ++l)
+    m_gallery_squared_norms.row(l) =
+        m_gallery.middleRows(l * LIMB_SIZE, LIMB_SIZE).colwise().squaredNorm();
+
+  // limb centroids and radii of every pose, for the score lower bounds
+  const size_t n_poses = m_pose_ids.size();
+  m_pose_centroids.resize(getLimbVectorSize(), n_poses);
+  m_pose_radii.resize(limbs, n_poses);
+  for(size_t p = 0; p < n_poses; ++p)
+  {
+    const int begin = m_pose_begin[p], n = m_pose_begin[p + 1] - begin;
+    m_pose_centroids.col(p) = m_gallery.middleCols(begin, n).rowwise().mean();
+    for(int l = 0; l < limbs; ++l)
+    {
+      // a limb missing in some frame gives no bound
+      if(m_gallery_limb_weights.block(l, begin, 1, n).minCoeff() == 0.0)
+      {
+        m_pose_radii(l, p) = std::numeric_limits<double>::infinity();
+        continue;
+      }
+      m_pose_radii(l, p) = (m_gallery.block(l * LIMB_SIZE, begin, LIMB_SIZE, n)
+                            .colwise()
+                            - m_pose_centroids.block<LIMB_SIZE, 1>(l * LIMB_SIZE, p))
+          .colwise().norm().maxCoeff();
+    }
+  }
+}
+
+Eigen::RowVectorXd
+PoseGalleryIndex::fuseLimbs(const Eigen::MatrixXd& limb_distances) const
+{
+  // NaN distances (missing limbs) are ignored, NaN if all the limbs are missing
+  Eigen::RowVectorXd fused(limb_distances.cols());
+  for(int c = 0; c < limb_distances.cols(); ++c)
+  {
+    double sum = 0.0, worst = 0.0;
+    int n = 0;
+    for(int l = 0; l < limb_distances.rows(); ++l)
+    {
+      const double v = limb_distances(l, c);
+      if(std::isnan(v)) continue;
+      sum += v;
+      worst = std::max(worst, v);
+      ++n;
+    }
+    if(n == 0)
+      fused(c) = std::numeric_limits<double>::quiet_NaN();
+    else if(m_per_skeleton_score_fusion_policy == 1) // worst score policy
+      fused(c) = worst;
+    else // average score policy
+      fused(c) = sum / n;
+  }
+  return fused;
+}
+
+double
+PoseGalleryIndex::fuseFrames(Eigen::VectorXd frame_scores) const
+{
+  switch(m_per_gallery_frame_pose_score_fusion_policy)
+  {
+  case 0: // best match
+    return frame_scores.minCoeff();
+  case 2: // median match
+  {
+    const int median_id = frame_scores.size() / 2;
+    std::nth_element(frame_scores.data(), frame_scores.data() + median_id,
+                     frame_scores.data() + frame_scores.size());
+    return frame_scores(median_id);
+  }
+  case 3: // worst match
+    return frame_scores.maxCoeff();
+  default: // average match
+    return frame_scores.mean();
+  }
+}
+
+void
+PoseGalleryIndex::score(const Eigen::MatrixXd& queries,
+                        Eigen::MatrixXd& scores) const
+{
+  const int limbs = m_enabled_limbs.size();
+  const int n_frames = m_gallery.cols(), n_queries = queries.cols();
+
+  // limb distances of all frames from all queries, one matrix product per limb:
+  // |g - q|^2 = |g|^2 + |q|^2 - 2 g'q
+  // missing limbs (NaN joints) are zeroed and weighted 0, as the limbs ignored
+  // by fuseLimbs
+  Eigen::MatrixXd frame_scores = Eigen::MatrixXd::Zero(n_frames, n_queries);
+  Eigen::MatrixXd frame_weights = Eigen::MatrixXd::Zero(n_frames, n_queries);
+  Eigen::MatrixXd d(n_frames, n_queries), w(n_frames, n_queries);
+  Eigen::MatrixXd query_limb(LIMB_SIZE, n_queries);
+  Eigen::RowVectorXd query_weights(n_queries);
+  for(int l = 0; l < limbs; ++l)
+  {
+    const auto gallery_limb = m_gallery.middleRows(l * LIMB_SIZE, LIMB_SIZE);
+    query_limb = queries.middleRows(l * LIMB_SIZE, LIMB_SIZE);
+    for(int q = 0; q < n_queries; ++q)
+    {
+      query_weights(q) = query_limb.col(q).allFinite() ? 1.0 : 0.0;
+      if(query_weights(q) == 0.0) query_limb.col(q).setZero();
+    }
+    d.noalias() = -2.0 * gallery_limb.transpose() * query_limb;
+    d.colwise() += m_gallery_squared_norms.row(l).transpose();
+    d.rowwise() += query_limb.colwise().squaredNorm();
+    w.noalias() = m_gallery_limb_weights.row(l).transpose() * query_weights;
+    d = d.cwiseMax(0.0).cwiseSqrt().cwiseProduct(w);
+    if(m_per_skeleton_score_fusion_policy == 1)
+      frame_scores = frame_scores.cwiseMax(d);
+    else
+      frame_scores += d;
+    frame_weights += w;
+  }
+  if(m_per_skeleton_score_fusion_policy == 1)
+    frame_scores = (frame_weights.array() > 0.0).select(
+          frame_scores, std::numeric_limits<double>::quiet_NaN());
+  else
+    frame_scores = frame_scores.cwiseQuotient(frame_weights);
+
+  scores.resize(m_pose_ids.size(), n_queries);
+  for(size_t p = 0; p < m_pose_ids.size(); ++p)
+  {
+    const int begin = m_pose_begin[p], n = m_pose_begin[p + 1] - begin;
+    for(int q = 0; q < n_queries; ++q)
+      scores(p, q) = fuseFrames(frame_scores.block(begin, q, n, 1));
+  }
+}
+
+double
+PoseGalleryIndex::scorePose(const Eigen::VectorXd& query, int pose_index) const
+{
+  const int limbs = m_enabled_limbs.size();
+  const int begin = m_pose_begin[pose_index];
+  const int n = m_pose_begin[pose_index + 1] - begin;
+  Eigen::MatrixXd limb_distances(limbs, n);
+  for(int l = 0; l < limbs; ++l)
+  {
+    const auto query_limb = query.segment<LIMB_SIZE>(l * LIMB_SIZE);
+    if(not query_limb.allFinite())
+    {
+      limb_distances.row(l).setConstant(std::numeric_limits<double>::quiet_NaN());
+      continue;
+    }
+    limb_distances.row(l) =
+        (m_gallery_limb_weights.block(l, begin, 1, n).array() > 0.0).select(
+          (m_gallery.block(l * LIMB_SIZE, begin, LIMB_SIZE, n).colwise()
+           - query_limb).colwise().norm(),
+          std::numeric_limits<double>::quiet_NaN());
+  }
+  return fuseFrames(fuseLimbs(limb_distances).transpose());
+}
+
+Eigen::RowVectorXd
+PoseGalleryIndex::lowerBounds(const Eigen::VectorXd& query) const
+{
+  const int limbs = m_enabled_limbs.size();
+  const size_t n_poses = m_pose_ids.size();
+
+  // |q - g| >= |q - c| - r for every frame g of a pose
+  Eigen::MatrixXd limb_bounds(limbs, n_poses);
+  for(int l = 0; l < limbs; ++l)
+  {
+    if(not query.segment<LIMB_SIZE>(l * LIMB_SIZE).allFinite())
+    {
+      limb_bounds.row(l).setConstant(std::numeric_limits<double>::quiet_NaN());
+      continue;
+    }
+    limb_bounds.row(l) =
+        ((m_pose_centroids.middleRows(l * LIMB_SIZE, LIMB_SIZE).colwise()
+          - query.segment<LIMB_SIZE>(l * LIMB_SIZE)).colwise().norm()
+         - m_pose_radii.row(l)).cwiseMax(0.0);
+  }
+  return fuseLimbs(limb_bounds);
+}
+
+int
+PoseGalleryIndex::findBest(const Eigen::VectorXd& query, double max_score,
+                           Eigen::VectorXd& scores,
+                           const std::vector<int>& candidates) const
+{
+  const size_t n_poses = m_pose_ids.size();
+  scores.setConstant(n_poses, std::numeric_limits<double>::quiet_NaN());
+  int best = -1;
+  double best_score = max_score;
+
+  // candidates first: a good initial best score makes the bounds effective
+  for(size_t i = 0; i < candidates.size(); ++i)
+  {
+    const int p = candidates[i];
+    if(p < 0 or p >= int(n_poses) or not std::isnan(scores(p))) continue;
+    scores(p) = scorePose(query, p);
+    if(scores(p) < best_score)
+    {
+      best_score = scores(p);
+      best = p;
+    }
+  }
+
+  Eigen::RowVectorXd bounds = lowerBounds(query);
+
+  std::vector<int> order(n_poses);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+            [&bounds](int a, int b){ return bounds(a) < bounds(b); });
+
+  for(size_t i = 0; i < n_poses; ++i)
+  {
+    const int p = order[i];
+    // no remaining pose can beat the best one
+    if(not (bounds(p) < best_score)) break;
+    if(not std::isnan(scores(p))) continue;
+
+    scores(p) = scorePose(query, p);
+    if(scores(p) < best_score)
+    {
+      best_score = scores(p);
+      best = p;
+    }
+  }
+  return best;
+}
+
+int
+PoseGalleryIndex::refine(const Eigen::VectorXd& query, double max_score,
+                         Eigen::VectorXd& scores,
+                         const std::vector<int>& candidates) const
+{
+  const size_t n_poses = m_pose_ids.size();
+  std::vector<bool> refreshed(n_poses, false);
+  int best = -1;
+  double best_score = max_score;
+
+  // the worst refreshed candidate is the score a pose has to beat
+  double worst_candidate = candidates.empty() ?
+        std::numeric_limits<double>::infinity() :
+        -std::numeric_limits<double>::infinity();
+  for(size_t i = 0; i < candidates.size(); ++i)
+  {
+    const int p = candidates[i];
+    if(p < 0 or p >= int(n_poses) or refreshed[p]) continue;
+    scores(p) = scorePose(query, p);
+    refreshed[p] = true;
+    if(not (scores(p) <= worst_candidate))
+      worst_candidate = scores(p);
+  }
+
+  Eigen::RowVectorXd bounds = lowerBounds(query);
+  for(size_t p = 0; p < n_poses; ++p)
+  {
+    if(not refreshed[p]
+       and (not (bounds(p) >= worst_candidate) or std::isnan(scores(p))))
+    {
+      scores(p) = scorePose(query, p);
+      refreshed[p] = true;
+    }
+    // stale scores cannot be the best: their bound is above a candidate
+    if(refreshed[p] and scores(p) < best_score)
+    {
+      best_score = scores(p);
+      best = p;
+    }
+  }
+  return best;
+}
+
+std::vector<int>
+PoseGalleryIndex::getBestPoses(const Eigen::VectorXd& scores, size_t k)
+{
+  std::vector<int> poses;
+  for(int p = 0; p < scores.size(); ++p)
+    if(not std::isnan(scores(p)))
+      poses.push_back(p);
+  k = std::min(k, poses.size());
+  std::partial_sort(poses.begin(), poses.begin() + k, poses.end(),
+                    [&scores](int a, int b){ return scores(a) < scores(b); });
+  poses.resize(k);
+  return poses;
+}
+
+} // bpr
+} // open_ptrack
@@ -9,21 +9,6 @@ namespace bpr
 typedef bpe::SkeletonJoints SkeletonJoints;
 typedef bpe::SkeletonLinks SkeletonLinks;
 
-template<typename A, typename B>
-std::pair<B,A> flip_pair(const std::pair<A,B> &p)
-{
-  return std::pair<B,A>(p.second, p.first);
-}
-
-template<typename A, typename B>
-std::map<B,A> flip_map(const std::map<A,B> &src)
-{
-  std::map<B,A> dst;
-  std::transform(src.begin(), src.end(), std::inserter(dst, dst.begin()),
-                 flip_pair<A,B>);
-  return dst;
-}
-
 std::istream& operator>>(std::istream& str, FileRow& data)
 {
   data.readNextRow(str);
@@ -48,9 +33,24 @@ PoseRecognition::PoseRecognition():
       m_private_nh.param("per_skeleton_score_fusion_policy", 0);
   m_per_gallery_frame_pose_score_fusion_policy =
       m_private_nh.param("per_gallery_frame_pose_score_fusion_policy", 0);
+  m_early_exit = m_private_nh.param("early_exit", false);
+  m_cache_enabled = m_private_nh.param("cache/enabled", false);
+  m_cache_displacement_threshold =
+      m_private_nh.param("cache/displacement_threshold", 0.02);
+  m_cache_top_k = m_private_nh.param("cache/top_k", 3);
+  m_cache_vote_window = m_private_nh.param("cache/vote_window", 5);
+  m_cache_max_age = m_private_nh.param("cache/max_age", 2.0);
   m_publisher = m_nh.advertise<opt_msgs::PoseRecognitionArray>
       ("/recognizer/poses", 1);
   readGalleryPoses();
+  std::array<bool, PoseGalleryIndex::LIMBS_NUMBER> enabled_limbs = {{
+    m_use_right_arm, m_use_left_arm, m_use_right_leg, m_use_left_leg
+  }};
+  m_gallery_index.reset(new PoseGalleryIndex(
+                          enabled_limbs,
+                          m_per_skeleton_score_fusion_policy,
+                          m_per_gallery_frame_pose_score_fusion_policy));
+  m_gallery_index->build(m_gallery_poses);
   m_rviz_publisher = m_nh.advertise<visualization_msgs::MarkerArray>
       ("/recognizer/markers_debug", 1);
   m_rviz_debug_publisher = m_nh.advertise<visualization_msgs::MarkerArray>
@@ -69,167 +69,125 @@ PoseRecognition::skeletonCallback
   visualization_msgs::MarkerArray predicted_pose_marker, marker_array;
 
   if(data->tracks.size() != standard_data->tracks.size()) return;
+  const size_t n_poses = m_gallery_index->getPosesNumber();
+  if(n_poses == 0) return;
+
+  // sk already in standard pose: limb vectors of all the skeletons
+  Eigen::MatrixXd queries(m_gallery_index->getLimbVectorSize(),
+                          standard_data->tracks.size());
   for (size_t skel_id = 0, skel_size = standard_data->tracks.size();
        skel_id != skel_size; ++skel_id)
   {
-    const opt_msgs::StandardSkeletonTrack& observed_st_sk =
-        standard_data->tracks[skel_id];
+    m_gallery_index->toLimbVector(standard_data->tracks[skel_id].joints,
+                                  queries.col(skel_id));
+  }
+  // skeletons whose track is cached are reused or refined, the others are
+  // scored from scratch
+  const size_t skel_size = standard_data->tracks.size();
+  std::vector<Eigen::VectorXd> pose_scores(skel_size);
+  std::vector<int> best_poses(skel_size, -1);
+  std::vector<bool> rescored(skel_size, true);
+  std::vector<int> to_score;
+  for (size_t skel_id = 0; skel_id != skel_size; ++skel_id)
+  {
+    auto cache_it = m_cache_enabled ?
+          m_track_cache.find(standard_data->tracks[skel_id].id) :
+          m_track_cache.end();
+    if(cache_it != m_track_cache.end()
+       and maxJointDisplacement(queries.col(skel_id), cache_it->second.query)
+       < m_cache_displacement_threshold)
+    {
+      // the skeleton barely moved since it was scored
+      pose_scores[skel_id] = cache_it->second.scores;
+      best_poses[skel_id] = cache_it->second.best_pose;
+      rescored[skel_id] = false;
+    }
+    else if(m_early_exit)
+    {
+      // poses which cannot beat the best one are not scored (NaN), the best
+      // poses of the last scoring of the track are checked first
+      best_poses[skel_id] = m_gallery_index->findBest(
+            queries.col(skel_id), m_threshold, pose_scores[skel_id],
+            cache_it != m_track_cache.end() ?
+              cache_it->second.best_poses : std::vector<int>());
+    }
+    else if(cache_it != m_track_cache.end())
+    {
+      // only the best poses of the last scoring of the track and the poses
+      // which can beat them are scored again, the others keep their score
+      pose_scores[skel_id] = cache_it->second.scores;
+      best_poses[skel_id] = m_gallery_index->refine(
+            queries.col(skel_id), m_threshold, pose_scores[skel_id],
+            cache_it->second.best_poses);
+    }
+    else
+    {
+      to_score.push_back(skel_id);
+    }
+  }
+
+  // score all the gallery poses for the remaining skeletons at once
+  if(not to_score.empty())
+  {
+    Eigen::MatrixXd to_score_queries(queries.rows(), to_score.size());
+    for(size_t i = 0; i < to_score.size(); ++i)
+      to_score_queries.col(i) = queries.col(to_score[i]);
+    Eigen::MatrixXd scores;
+    m_gallery_index->score(to_score_queries, scores);
+    for(size_t i = 0; i < to_score.size(); ++i)
+    {
+      const int skel_id = to_score[i];
+      pose_scores[skel_id] = scores.col(i);
+      for(size_t pose_id = 0; pose_id < n_poses; ++pose_id)
+      {
+        if(scores(pose_id, i) < m_threshold
+           and (best_poses[skel_id] < 0
+                or scores(pose_id, i) < scores(best_poses[skel_id], i)))
+          best_poses[skel_id] = pose_id;
+      }
+    }
+  }
+
+  for (size_t skel_id = 0; skel_id != skel_size; ++skel_id)
+  {
     const opt_msgs::SkeletonTrack& sk2 = data->tracks[skel_id];
 //    if(sk2.visibility == opt_msgs::StandardSkeletonTrack::OCCLUDED
 //       or
 //       sk2.visibility == opt_msgs::StandardSkeletonTrack::NOT_VISIBLE)
 //      return;
 
-    // sk already in standard pose
-    Eigen::Matrix<double, 6, 1> r_arm;
-    Eigen::Matrix<double, 6, 1> l_arm;
-    Eigen::Matrix<double, 6, 1> r_leg;
-    Eigen::Matrix<double, 6, 1> l_leg;
-    r_arm << observed_st_sk.joints[SkeletonJoints::RELBOW].x,
-        observed_st_sk.joints[SkeletonJoints::RELBOW].y,
-        observed_st_sk.joints[SkeletonJoints::RELBOW].z,
-        observed_st_sk.joints[SkeletonJoints::RWRIST].x,
-        observed_st_sk.joints[SkeletonJoints::RWRIST].y,
-        observed_st_sk.joints[SkeletonJoints::RWRIST].z;
-    l_arm << observed_st_sk.joints[SkeletonJoints::LELBOW].x,
-        observed_st_sk.joints[SkeletonJoints::LELBOW].y,
-        observed_st_sk.joints[SkeletonJoints::LELBOW].z,
-        observed_st_sk.joints[SkeletonJoints::LWRIST].x,
-        observed_st_sk.joints[SkeletonJoints::LWRIST].y,
-        observed_st_sk.joints[SkeletonJoints::LWRIST].z;
-    r_leg << observed_st_sk.joints[SkeletonJoints::RKNEE].x,
-        observed_st_sk.joints[SkeletonJoints::RKNEE].y,
-        observed_st_sk.joints[SkeletonJoints::RKNEE].z,
-        observed_st_sk.joints[SkeletonJoints::RANKLE].x,
-        observed_st_sk.joints[SkeletonJoints::RANKLE].y,
-        observed_st_sk.joints[SkeletonJoints::RANKLE].z;
-    l_leg << observed_st_sk.joints[SkeletonJoints::LKNEE].x,
-        observed_st_sk.joints[SkeletonJoints::LKNEE].y,
-        observed_st_sk.joints[SkeletonJoints::LKNEE].z,
-        observed_st_sk.joints[SkeletonJoints::LANKLE].x,
-        observed_st_sk.joints[SkeletonJoints::LANKLE].y,
-        observed_st_sk.joints[SkeletonJoints::LANKLE].z;
-    for(uint pose_id = 0, end_id = m_gallery_poses.size(); pose_id != end_id;
-        ++pose_id)
+    int best_pose = best_poses[skel_id];
+    double best_score = best_pose >= 0 ?
+          pose_scores[skel_id](best_pose) : -1;
+    if(m_cache_enabled)
     {
-      std::array<double, 4> scores ={
-        std::numeric_limits<double>::quiet_NaN(),
-        std::numeric_limits<double>::quiet_NaN(),
-        std::numeric_limits<double>::quiet_NaN(),
-        std::numeric_limits<double>::quiet_NaN()
-      };
-      for(uint frame_id = 0, n_frames = m_gallery_poses[pose_id].size();
-          frame_id != n_frames; ++frame_id)
+      TrackCache& cache = m_track_cache[standard_data->tracks[skel_id].id];
+      if(rescored[skel_id])
       {
-        if(m_use_right_arm)
-        {
-          Eigen::Matrix<double, 6, 1> gallery_frame;
-          gallery_frame
-              << m_gallery_poses[pose_id][frame_id].col(SkeletonJoints::RELBOW),
-              m_gallery_poses[pose_id][frame_id].col(SkeletonJoints::RWRIST);
-          scores[0] = (r_arm - gallery_frame).norm();
-        }
-        if(m_use_left_arm)
-        {
-          Eigen::Matrix<double, 6, 1> gallery_frame;
-          gallery_frame
-              << m_gallery_poses[pose_id][frame_id].col(SkeletonJoints::LELBOW),
-              m_gallery_poses[pose_id][frame_id].col(SkeletonJoints::LWRIST);
-          scores[1] = (l_arm - gallery_frame).norm();
-        }
-        if(m_use_right_leg)
-        {
-          Eigen::Matrix<double, 6, 1> gallery_frame;
-          gallery_frame
-              << m_gallery_poses[pose_id][frame_id].col(SkeletonJoints::RKNEE),
-              m_gallery_poses[pose_id][frame_id].col(SkeletonJoints::RANKLE);
-          scores[2] = (r_leg - gallery_frame).norm();
-        }
-        if(m_use_left_leg)
-        {
-          Eigen::Matrix<double, 6, 1> gallery_frame;
-          gallery_frame
-              << m_gallery_poses[pose_id][frame_id].col(SkeletonJoints::LKNEE),
-              m_gallery_poses[pose_id][frame_id].col(SkeletonJoints::LANKLE);
-          scores[3] = (l_leg - gallery_frame).norm();
-        }
-        switch(m_per_skeleton_score_fusion_policy)
-        {
-        case 0: // average score policy
-        {
-          auto acc_lambda = [](const double to_add, double result)
-          {
-            return std::isnan(to_add)?result:result+to_add;
-          };
-          m_per_frame_scores[pose_id][frame_id] = std::accumulate(
-                scores.begin(), scores.end(), 0.0, acc_lambda)
-              / std::count_if(scores.begin(), scores.end(),
-                              [](const double v){return not std::isnan(v);});
-          break;
-        }
-        case 1: // worst score policy
-        {
-          auto max_lambda = [](double a, double b)
-          {
-            return a < b? true: std::isnan(a);
-          };
-          m_per_frame_scores[pose_id][frame_id] = *std::max_element(
-                scores.begin(), scores.end(), max_lambda);
-          break;
-        }
-        } // switch
-      } // for frame_id
-      // score fusion per pose
-      switch(m_per_gallery_frame_pose_score_fusion_policy)
-      {
-      case 0: // best match
-      {
-        m_final_scores[pose_id] =
-            *std::min(m_per_frame_scores[pose_id].begin(),
-                      m_per_frame_scores[pose_id].end());
-        break;
-      }
-      case 1: // average match
-      {
-        m_final_scores[pose_id] =
-            std::accumulate(m_per_frame_scores[pose_id].begin(),
-                            m_per_frame_scores[pose_id].end(), 0.0)
-            / m_per_frame_scores[pose_id].size();
-        break;
-      }
-      case 2: // median match
-      {
-        uint median_id = m_per_frame_scores[pose_id].size() / 2;
-        std::nth_element(
-              m_per_frame_scores[pose_id].begin(),
-              m_per_frame_scores[pose_id].begin() + median_id,
-              m_per_frame_scores[pose_id].end());
-        m_final_scores[pose_id] = m_per_frame_scores[pose_id][median_id];
-        break;
-      }
-      case 3: //worst match
-      {
-        m_final_scores[pose_id] =
-            *std::max(m_per_frame_scores[pose_id].begin(),
-                      m_per_frame_scores[pose_id].end());
+        cache.query = queries.col(skel_id);
+        cache.scores = pose_scores[skel_id];
+        cache.best_pose = best_pose;
+        cache.best_poses = PoseGalleryIndex::getBestPoses(
+              pose_scores[skel_id], m_cache_top_k);
       }
-      } // switch
-    } // for pose_id
+      cache.last_seen = data->header.stamp;
+      // temporal vote between the last results of the track
+      cache.votes.push_back(std::make_pair(best_pose, best_score));
+      while(cache.votes.size() > m_cache_vote_window)
+        cache.votes.pop_front();
+      voteBestPose(cache.votes, best_pose, best_score);
+    }
+    const Eigen::VectorXd& skel_pose_scores = pose_scores[skel_id];
+
     // result
     opt_msgs::PoseRecognition recognition_msg;
-    recognition_msg.gallery_poses.resize(m_final_scores.size());
-    // sort m_final_scores based on the second field
-    std::map<double, size_t> dst = flip_map(m_final_scores);
-    // theoretically flip_map should return a multimap,
-    // but the probability that two scores are the same is really low
-    // When it happens the values are overwritten and I will loose
-    // a couple of recognition ids => no problem
+    recognition_msg.gallery_poses.resize(n_poses);
     opt_msgs::PosePredictionResult max_pr;
-    if ((dst.begin())->first < m_threshold)
+    if (best_pose >= 0)
     {
-      max_pr.pose_id = dst.begin()->second;
-      max_pr.pose_name = m_gallery_poses_names[dst.begin()->second];
-      max_pr.score = dst.begin()->first;
+      max_pr.pose_id = m_gallery_index->getPoseId(best_pose);
+      max_pr.pose_name = m_gallery_poses_names[max_pr.pose_id];
+      max_pr.score = best_score;
     }
     else
     {
@@ -238,14 +196,14 @@ PoseRecognition::skeletonCallback
       max_pr.score = -1;
     }
     recognition_msg.best_prediction_result = max_pr;
-    for(auto it = dst.begin(), end = dst.end();
-        it != end; ++it)
+    for(size_t pose_id = 0; pose_id < n_poses; ++pose_id)
     {
       opt_msgs::PosePredictionResult pr;
-      pr.pose_id = it->second;
-      pr.pose_name = m_gallery_poses_names[it->second];
-      pr.score = it->first;
-      recognition_msg.gallery_poses[it->second] = pr;
+      pr.pose_id = m_gallery_index->getPoseId(pose_id);
+      pr.pose_name = m_gallery_poses_names[pr.pose_id];
+      pr.score = std::isnan(skel_pose_scores(pose_id)) ? -1 :
+                                                     skel_pose_scores(pose_id);
+      recognition_msg.gallery_poses[pose_id] = pr;
     }
     recognition_array_msg.poses.push_back(recognition_msg);
     // visualization marker output
@@ -332,7 +290,7 @@ PoseRecognition::skeletonCallback
       text_pose_score.scale.y = 0.34;
       text_pose_score.scale.z = 0.34;
       text_pose_score.color = sk2.color;
-      if (ppr.score < m_threshold)
+      if (ppr.score >= 0 and ppr.score < m_threshold)
       {
         text_pose_score.color.r = 0.0;
         text_pose_score.color.g = 1.0;
@@ -349,6 +307,14 @@ PoseRecognition::skeletonCallback
     m_rviz_publisher.publish(marker_array);
     m_rviz_debug_publisher.publish(predicted_pose_marker);
   } // standard tracks (skel_id)
+  // forget tracks not seen for a while
+  for(auto it = m_track_cache.begin(); it != m_track_cache.end();)
+  {
+    if((data->header.stamp - it->second.last_seen).toSec() > m_cache_max_age)
+      it = m_track_cache.erase(it);
+    else
+      ++it;
+  }
   // publish the result
   recognition_array_msg.header.frame_id = data->header.frame_id;
   recognition_array_msg.header.stamp = data->header.stamp;
@@ -356,6 +322,37 @@ PoseRecognition::skeletonCallback
   // Visualization message
 }
 
+double
+PoseRecognition::maxJointDisplacement(const Eigen::VectorXd& a,
+                                      const Eigen::VectorXd& b)
+{
+  // limb vectors are sequences of 3D joints
+  const int n_joints = a.size() / 3;
+  return (Eigen::Map<const Eigen::Matrix3Xd>(a.data(), 3, n_joints)
+          - Eigen::Map<const Eigen::Matrix3Xd>(b.data(), 3, n_joints))
+      .colwise().norm().maxCoeff();
+}
+
+void
+PoseRecognition::voteBestPose(const std::deque<std::pair<int, double> >& votes,
+                              int& best_pose, double& best_score)
+{
+  // most voted pose, ties broken in favour of the most recent result
+  std::map<int, int> counts;
+  int max_count = 0;
+  for(auto it = votes.begin(); it != votes.end(); ++it)
+    max_count = std::max(max_count, ++counts[it->first]);
+  for(auto it = votes.rbegin(); it != votes.rend(); ++it)
+  {
+    if(counts[it->first] == max_count)
+    {
+      best_pose = it->first;
+      best_score = it->second;
+      return;
+    }
+  }
+}
+
 void
 PoseRecognition::readGalleryPoses()
 {
@@ -395,7 +392,6 @@ PoseRecognition::readGalleryPoses()
     m_gallery_poses[pose_id] =
         std::vector<SkeletonMatrix>(are_there_any_frames / 2);
     m_gallery_poses_names[pose_id] = pose_name;
-    m_per_frame_scores[pose_id] = std::vector<double>(are_there_any_frames / 2);
     readMatricesForSinglePose(pose_id);
 
   }
@@ -45,6 +45,7 @@ void configCb(detection::multiple_objects_detectionConfig &config, uint32_t leve
     Object_Detector::AREA_TOLERANCE=config.AREA_TOLERANCE;
     Object_Detector::QUALITY_TOLERANCE=config.QUALITY_TOLERANCE;
     Object_Detector::DENSITY_TOLORENCE=config.DENSITY_TOLORENCE;
+    Object_Detector::OVERLAP_TOLERANCE=config.OVERLAP_TOLERANCE;
 }
 
 
@@ -82,6 +83,7 @@ int main(int argc, char** argv){
     nh.param("AREA_TOLERANCE",Object_Detector::AREA_TOLERANCE,20);
     nh.param("QUALITY_TOLERANCE",Object_Detector::QUALITY_TOLERANCE,20000);
     nh.param("DENSITY_TOLORENCE",Object_Detector::DENSITY_TOLORENCE,4.0);
+    nh.param("OVERLAP_TOLERANCE",Object_Detector::OVERLAP_TOLERANCE,0.5);
 
     nh.param("Backprojection_Mode",Object_Detector::Backprojection_Mode,std::string("HSD"));
 
@@ -99,6 +101,7 @@ int main(int argc, char** argv){
               <<"AREA_TOLERANCE: "<<Object_Detector::AREA_TOLERANCE<< std::endl
              <<"QUALITY_TOLERANCE: "<<Object_Detector::QUALITY_TOLERANCE<< std::endl
             <<"DENSITY_TOLORENCEE: "<<Object_Detector::DENSITY_TOLORENCE<< std::endl
+            <<"OVERLAP_TOLERANCE: "<<Object_Detector::OVERLAP_TOLERANCE<< std::endl
            << std::endl;
 
     std::cout << "Backprojection_Mode: "<<Object_Detector::Backprojection_Mode<< std::endl;
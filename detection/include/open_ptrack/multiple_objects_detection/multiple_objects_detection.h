@@ -61,6 +61,7 @@
 
 #include "open_ptrack/multiple_objects_detection/object_detector.h"
 #include "open_ptrack/multiple_objects_detection/roi_zz.h"
+#include <open_ptrack/opt_utils/depth_statistics.h>
 
 //publish the detections
 #include <opt_msgs/Detection.h>
@@ -172,7 +173,9 @@ private:
   ///////////For main detection///////////
   std::vector<Object_Detector> Object_Detectors;
   std::vector<Rect> current_detected_boxes;
-  cv::Mat main_color,main_color_origin,main_hsv,hsv_mask,main_depth_16,main_depth_8;
+  Object_Detector::Frame detection_frame;//input of all the detectors
+  cv::Mat main_color,main_color_origin,main_hsv,hsv_mask,main_depth_16;
+  open_ptrack::opt_utils::DepthStatistics depth_statistics;//median depth of the detected boxes
   ///////////For main detection///////////
 
 
@@ -221,8 +224,7 @@ public:
         updateImage = false;
         lock.unlock();
 
-        //                main_color.copyTo(main_color_origin);
-        Object_Detector::setMainColorOrigin(main_color);
+        main_color.copyTo(main_color_origin);//main_color is drawn on, the detectors use this copy
 
         if(use_background_removal)
         {
@@ -355,7 +357,6 @@ private:
       tracks_2D.push_back(tracks_2D_);
       bool occlude_=true;
       occludes.push_back(occlude_);
-      Object_Detector::current_detected_boxes=current_detected_boxes;
     }
     objects_selected=true;
     finished_select_rois_from_file=false;
@@ -410,7 +411,6 @@ private:
             tracks_2D.push_back(tracks_2D_);
             bool occlude_=true;
             occludes.push_back(occlude_);
-            Object_Detector::current_detected_boxes=current_detected_boxes;
         }
         objects_selected=true;
         finished_select_rois_from_file=false;
@@ -437,13 +437,39 @@ private:
       tracks_2D.push_back(tracks_2D_);
       bool occlude_=false;
       occludes.push_back(occlude_);
-      Object_Detector::current_detected_boxes=current_detected_boxes;
     }
     objects_selected=true;
     std::cout<<rois_from_gui.size()<<" objects are selected from gui"<<std::endl;
     rois_from_gui.clear();
   }
 
+  //the objects are detected at the same time, every one blocking the others where they were in the previous frame,
+  //so two objects can move to the same place: when two detections overlap more than OVERLAP_TOLERANCE, keep the one
+  //that stays closer to its previous box and set the other occluded, it will be searched again in the next frame
+  void resolve_conflicts(std::vector<RotatedRect>& current_trackBoxes)
+  {
+    std::vector<Rect> boxes(current_trackBoxes.size());
+    for(size_t i=0; i<current_trackBoxes.size(); i++)
+      boxes[i]=current_trackBoxes[i].boundingRect();
+
+    for(size_t i=0; i<Object_Detectors.size(); i++)
+    {
+      for(size_t j=i+1; j<Object_Detectors.size() && !Object_Detectors[i].occluded; j++)
+      {
+        if(Object_Detectors[j].occluded)
+          continue;
+        double overlap=(boxes[i]&boxes[j]).area();
+        if(overlap<=Object_Detector::OVERLAP_TOLERANCE*std::max(1,std::min(boxes[i].area(),boxes[j].area())))
+          continue;
+
+        //the object that moved away from its previous box is the one that jumped on the other object
+        size_t lost=(boxes[j]&current_detected_boxes[j]).area()>(boxes[i]&current_detected_boxes[i]).area() ? i : j;
+        Object_Detectors[lost].dropDetection();
+        current_trackBoxes[lost]=RotatedRect();
+      }
+    }
+  }
+
   void multiple_objects_detection_main()    //main_detection
   {
     if( main_color.empty()||Object_Detectors.empty())
@@ -451,29 +477,26 @@ private:
 
     //        ////////////////////////////////////////set the input(color+depth) of every detector////////////////////////////////////////
 
-    cv::cvtColor(main_color, main_hsv, CV_BGR2HSV);
-    Object_Detector::setMainColor(main_hsv);// set all the detectors' "main_hsv"
-
-    //calculate the hsv_mask by the range
-    cv::inRange(main_hsv, cv::Scalar(Object_Detector::HMin, Object_Detector::SMin, MIN(Object_Detector::VMin,Object_Detector::VMax)), cv::Scalar(Object_Detector::HMax, Object_Detector::SMax, MAX(Object_Detector::VMin, Object_Detector::VMax)), hsv_mask);
-    Object_Detector::setHsvMask(hsv_mask);// set all the detectors' "main_hsv"
+    detection_frame.color_origin=main_color_origin;
+    detection_frame.depth=main_depth_16;
 
-
-    if(Object_Detector::Backprojection_Mode=="HSD")// if use HSD, convert the depth from 16bit into 8bit
+    if(Object_Detector::Backprojection_Mode=="HSD")// HSD detectors read bgr and 16 bit depth directly, just in their search windows
     {
-      //devide (1000mm~9000mm) into 255 parts
-      ushort Max=9000,Min=1000;
-      main_depth_16.convertTo(main_depth_8, CV_8U,255.0/(Max-Min),-255.0*Min/(Max-Min));
-      Object_Detector::setMainDepth(main_depth_8);
+      detection_frame.color.release();
+      detection_frame.hsv_mask.release();
     }
     else
     {
-      Object_Detector::setMainDepth(main_depth_16);
+      cv::cvtColor(main_color, main_hsv, CV_BGR2HSV);
+      detection_frame.color=main_hsv;// set all the detectors' "main_hsv"
+
+      //calculate the hsv_mask by the range
+      cv::inRange(main_hsv, cv::Scalar(Object_Detector::HMin, Object_Detector::SMin, MIN(Object_Detector::VMin,Object_Detector::VMax)), cv::Scalar(Object_Detector::HMax, Object_Detector::SMax, MAX(Object_Detector::VMin, Object_Detector::VMax)), hsv_mask);
+      detection_frame.hsv_mask=hsv_mask;// set all the detectors' "hsv_mask"
     }
+    detection_frame.detected_boxes=current_detected_boxes;//every detector blocks the other objects where they were in the previous frame
     ////////////////////////////////////////set the input(color+depth) of every detector////////////////////////////////////////
 
-    //        Object_Detector::setMainColorOrigin(main_color_origin);
-
 
 
     //!!!!!!!!!!!!!!!!!!!!!!!create detection_array_msg!!!!!!!!!!!!!!!!!!!!!!!
@@ -492,13 +515,21 @@ private:
     detection_array_msg->image_type = std::string("rgb");
     //!!!!!!!!!!!!!!!!!!!!!!!detection_array_msg msg!!!!!!!!!!!!!!!!!!!!!!!
 
-    //detect objects one by one
+    ////////////main detection, return a detection with a RotatedRect for every object
+    //the detectors are independent, so all the objects are detected at the same time
+    std::vector<RotatedRect> current_trackBoxes(Object_Detectors.size());
+#pragma omp parallel for schedule(dynamic)
+    for(int i=0; i<(int)Object_Detectors.size(); i++)
+    {
+      current_trackBoxes[i]=Object_Detectors[i].detectCurrentRect(i,detection_frame);
+    }
+    resolve_conflicts(current_trackBoxes);
+    /////////////main detection, return a detection with a RotatedRect for every object
+
     for(size_t i=0; i<Object_Detectors.size(); i++)
     {
-      ////////////main detection, return a detection with a RotatedRect
-      RotatedRect current_trackBox=Object_Detectors[i].detectCurrentRect(i);
+      RotatedRect current_trackBox=current_trackBoxes[i];
       string object_name=Object_Detectors[i].object_name;
-      /////////////main detection, return a detection with a RotatedRect
 
 
       occludes[i]=Object_Detectors[i].occluded;//update the occlusion flag
@@ -515,13 +546,18 @@ private:
         ////////////////////for display the detection ellipse and track points////////////////////
 
 
-        Object_Detector::current_detected_boxes=current_detected_boxes;// update the detected_boxes, it is used to generate the other objects mask for the following detection , in the following detection ,this Rect will be blocked in the image
 
 
         //////////////////////// genearate detection msg!!!!!!!!!!!!!!!!!!!!!!!!!!
         Detection detection_msg;
         Point2d current_center2D_d(cvFloor(current_trackBox.center.x),cvFloor(current_trackBox.center.y));//center point in image2D coordinate
-        double current_center_depth=main_depth_16.at<ushort>(current_center2D_d.y,current_center2D_d.x)/1000.0;//meter ,not mm
+        //median depth of the central half of the box, the corners of the bounding box of the ellipse are background
+        Rect center_box(current_center2D_d.x-current_detected_boxes[i].width/4,current_center2D_d.y-current_detected_boxes[i].height/4,
+                        current_detected_boxes[i].width/2+1,current_detected_boxes[i].height/2+1);
+        open_ptrack::opt_utils::DepthStatistics::Result depth_stats;
+        double current_center_depth=0;
+        if(depth_statistics.compute(main_depth_16,center_box,0.001f,depth_stats))
+          current_center_depth=depth_stats.median;//meter ,not mm
 
         tf::Vector3 camera_3D;//center point in camera3D coordinate
         camera_3D.setX((current_center2D_d.x-cx)*fx*current_center_depth);
@@ -577,7 +613,6 @@ private:
       else{//if occluded ,use a empty_rect because of the tracker will use this to generate the other_objects_mask
         Rect empty_rect(0,0,1,1);
         current_detected_boxes[i]=empty_rect;
-        Object_Detector::current_detected_boxes=current_detected_boxes;
       }
     }
 
@@ -31,6 +31,8 @@ public:
 
     static int h_bins,s_bins;//for the hue backrojection hist ,divide (HMin,HMax) to h_bins parts
     static int d_bins;// depth bins,
+    static const ushort DEPTH_MIN=1000,DEPTH_MAX=9000;//HSD mode devides (1000mm~9000mm) into 255 parts
+    static const uchar OUT_OF_RANGE=255;//bin of the values out of the range of the hist
     //////////////////////////For camshift//////////////////////////
 
 
@@ -49,6 +51,8 @@ public:
     static int AREA_TOLERANCE;//AREA_TOLERANCE is also used to create the position_maks
     static int QUALITY_TOLERANCE;
     static double DENSITY_TOLORENCE;
+    // OVERLAP_TOLERANCE here means the TOLERANCE of the part of the smaller box covered by another box ,when two detections overlap more than this, they are in conflict and just one object keep its detection
+    static double OVERLAP_TOLERANCE;
 
     bool occluded;
     bool half_occluded;
@@ -56,19 +60,20 @@ public:
 
     ///////////For camshift recover from occlusion///////////
 
-    static std::vector<Rect> current_detected_boxes;//this one come from class:multiple_objects_detection, every time of every object's detection ,multiple_objects_detection will update this varable ,we use it to generate the other_object_mask
+    //input of the detectors for one frame, shared (read only) by all the detectors, so that they can detect in parallel
+    struct Frame
+    {
+        cv::Mat color;//hsv image (H and HS mode)
+        cv::Mat depth;//16 bit depth (HSD mode)
+        cv::Mat color_origin;//bgr image, used to calculate the histograms at the first run, and by the HSD backprojection
+        cv::Mat hsv_mask;//H and HS mode, HSD mode calculates it in the search window
+        std::vector<Rect> detected_boxes;//the boxes of the previous frame ,we use them to block the other objects
+    };
+
     cv::Mat roi_from_file;// the roi come from file which is set when "select_rois_from_file"
     std::string object_name;
 
 private:
-    static cv::Mat mainColor;
-    static cv::Mat mainDepth;
-    cv::Mat Color,Depth;//copied from mainColor,mainDepth
-
-    static cv::Mat mainColorOrigin;
-    static cv::Mat hsvMask;
-    cv::Mat ColorOrigin,hsv_mask;//copied from mainColorOrigin,hsv_mask
-
 
     bool firstRun;
     cv::Rect currentRect;// just used in the  initilization(no important)
@@ -79,18 +84,31 @@ private:
 
 
     //////////main variable for calculate the histogram ///////////
-    cv::Mat hue,backproj;
+    cv::Mat backproj;//full frame, but just the search_window is computed, the rest is always 0
+    cv::Rect search_window;//detectWindow increased by AREA_TOLERANCE (the whole image when occluded)
     cv::Mat h_hist;//H mode
     cv::Mat hs_hist_for_HS;//HS mode
-    cv::Mat hs_hist_for_HSD,//just used under occlusion,because ,when oclluded ,can't use depth infomation to detect the objects
-    hs_hist_pdf,//use hs_hist_for_HSD to get pdf ,use it as the permnet part
-    tmp_depth_hist_pdf,//use every depth frame to get this ,use it as the tmp part
-    hsd_hist;//combine hs_hist_pdf(perment) and  tmp_depth_hist_pdf(tmp,every frame) to get this
+    cv::Mat hs_hist_for_HSD;//the permenet part of the hsd hist, used alone under occlusion,because ,when oclluded ,can't use depth infomation to detect the objects
+    std::vector<float> d_weight;//the tmp part of the hsd hist: the depth pdf of every frame divided by its max, hsd hist = hs_hist_for_HSD*d_weight
+    uchar h_lut[256],s_lut[256],d_lut[256];//bin of every hue, saturation and 8 bit depth value, compiled at the first run with the hs hist
     ///////////main variable for calculate the histogram ///////////
 
 
-    Mat other_object_mask,position_mask,depth_mask;//some mask that used for get the good back projection image
+    Mat depth_mask;//mask of the detected box in the detectWindow, used for the depth hist of HSD mode
 
+    cv::Mat beginBackprojection(const Frame& frame);//set the search_window, return the backproj of the search_window
+    void detectedBoxMask();//calculate depth_mask
+
+    void compileHSDModel(const cv::Mat& roi_hsv, const cv::Mat& roi_hsv_mask);//hs hist and lookup tables of HSD mode
+    void updateDepthWeight(const Frame& frame, const cv::Rect& window, const cv::Mat& mask);//depth hist of the pixels of window in mask and in the hsv range
+    static bool inHsvRange(int h, int s, int v)//the same test of cv::inRange for the hsv_mask
+    {
+        return h>=HMin && h<=HMax && s>=SMin && s<=SMax && v>=MIN(VMin,VMax) && v<=MAX(VMin,VMax);
+    }
+    static uchar depth8(ushort depth)//16 bit depth (mm) to 8 bit depth of HSD mode
+    {
+        return saturate_cast<uchar>(depth*(255.f/(DEPTH_MAX-DEPTH_MIN))-255.f*DEPTH_MIN/(DEPTH_MAX-DEPTH_MIN));
+    }
 
 
 public:
@@ -98,34 +116,20 @@ public:
         :firstRun(true),occluded(false),half_occluded(false),half_occluded_frames(10)
     {}
 
-    static void setMainColor(const cv::Mat _mainColor);
-    static cv::Mat getMainColor();
-
-    static void setMainDepth(const cv::Mat _mainDepth);
-    static cv::Mat getMainDepth();
-
-    static void setMainColorOrigin(const cv::Mat _mainColorOrigin);
-    static cv::Mat getMainColorOrigin();
-
-    static void setHsvMask(const cv::Mat _hsvMask);
-    static cv::Mat getHsvMask();
-
     void setCurrentRect(const cv::Rect _currentRect);
     cv::Rect getCurrentRect();
 
     void setObjectName(const std::string object_name);
     std::string getObjectName();
 
-    void setcurrent_detected_boxes(std::vector<Rect> _current_detected_boxes);
-    std::vector<Rect>  getcurrent_detected_boxes();
 
-
-    void H_backprojection();
-    void HS_backprojection();
-    void HSD_backprojection();
+    void H_backprojection(const Frame& frame);
+    void HS_backprojection(const Frame& frame);
+    void HSD_backprojection(const Frame& frame);
 
     cv::RotatedRect object_shift(InputArray _probColor,Rect& window, TermCriteria criteria);//camshift + occlusion handle
-    cv::RotatedRect detectCurrentRect(int id);//main detection function
+    cv::RotatedRect detectCurrentRect(int id, const Frame& frame);//main detection function, it just changes this detector, so different detectors can run at the same time
+    void dropDetection();//the detection is in conflict with another object ,set occluded so that the object is searched again in the next frame
 };
 
 //stastic varable defination
@@ -143,8 +147,7 @@ int Object_Detector::d_bins;
 int Object_Detector::AREA_TOLERANCE;
 int Object_Detector::QUALITY_TOLERANCE;
 double Object_Detector::DENSITY_TOLORENCE;
-
-std::vector<Rect> Object_Detector::current_detected_boxes;
+double Object_Detector::OVERLAP_TOLERANCE;
 
 std::string Object_Detector::Backprojection_Mode;
 #endif // Object_Detector_H
@@ -1,54 +1,6 @@
 #include "open_ptrack/multiple_objects_detection/object_detector.h"
 #include <iostream>
-// Static member definition ...
-cv::Mat Object_Detector::mainColor;
-cv::Mat Object_Detector::mainDepth;
-cv::Mat Object_Detector::mainColorOrigin;
-cv::Mat Object_Detector::hsvMask;
-
-void Object_Detector::setMainColor(const cv::Mat _mainColor)
-{
-    _mainColor.copyTo(mainColor);
-}
-
-cv::Mat Object_Detector::getMainColor()
-{
-    return mainColor;
-}
-
-void Object_Detector::setMainDepth(const cv::Mat _mainDepth)
-{
-    _mainDepth.copyTo(mainDepth);
-}
-
-cv::Mat Object_Detector::getMainDepth()
-{
-    return mainDepth;
-}
-
-
-void Object_Detector::setMainColorOrigin(const cv::Mat _mainColorOrigin)
-{
-    _mainColorOrigin.copyTo(mainColorOrigin);
-}
-
-cv::Mat Object_Detector::getMainColorOrigin()
-{
-    return mainColorOrigin;
-}
-
-
-void Object_Detector::setHsvMask(const cv::Mat _hsvMask)
-{
-    _hsvMask.copyTo(hsvMask);
-}
-
-cv::Mat Object_Detector::getHsvMask()
-{
-    return hsvMask;
-}
-
-
+#include <algorithm>
 
 void Object_Detector::setCurrentRect(const cv::Rect _currentRect)
 {
@@ -72,34 +24,66 @@ std::string Object_Detector::getObjectName()
 }
 
 
-void Object_Detector::setcurrent_detected_boxes(std::vector<Rect> _current_detected_boxes)
+cv::Mat Object_Detector::beginBackprojection(const Frame& frame)
 {
-    current_detected_boxes=_current_detected_boxes;
+    Rect image(0,0,frame.color_origin.cols,frame.color_origin.rows);
+
+    //backproj is kept between frames, just the last search_window has to be cleared
+    if(backproj.size()!=frame.color_origin.size())
+    {
+        backproj=Mat::zeros(frame.color_origin.size(),CV_8UC1);
+        search_window=Rect();
+    }
+    backproj(search_window)=0;
+
+    //the object can move in the window which is AREA_TOLERANCE size bigger than the last detected window
+    detectWindow=detectWindow&image;
+    if(occluded==false&&detectWindow.area()>1)
+    {
+        search_window=Rect(detectWindow.x-AREA_TOLERANCE,detectWindow.y-AREA_TOLERANCE,
+                           detectWindow.width+2*AREA_TOLERANCE,detectWindow.height+2*AREA_TOLERANCE)&image;
+    }
+    else
+    {
+        search_window=image;
+    }
+    return backproj(search_window);
 }
 
-std::vector<Rect> Object_Detector::getcurrent_detected_boxes()
+void Object_Detector::detectedBoxMask()
 {
-    return current_detected_boxes;
+    //calculate the the current_trackBox(rotatedrect) mask in the detectWindow,named depth_mask(in this mask ,just the the value in the area :current_detectBox(rotatedrect) is 255)
+    Point2f vertices[4];
+    current_detectedBox.points(vertices);
+    std::vector< std::vector<Point> >  co_ordinates;
+    co_ordinates.push_back(std::vector<Point>());
+    co_ordinates[0].push_back(vertices[0]);
+    co_ordinates[0].push_back(vertices[1]);
+    co_ordinates[0].push_back(vertices[2]);
+    co_ordinates[0].push_back(vertices[3]);
+
+    depth_mask=Mat::zeros(detectWindow.size(),CV_8UC1);
+    if(depth_mask.empty())
+        return;
+    drawContours( depth_mask,co_ordinates,0, Scalar(255),CV_FILLED, 8, noArray(), INT_MAX, -detectWindow.tl() );
 }
 
-void Object_Detector::H_backprojection()
+void Object_Detector::H_backprojection(const Frame& frame)
 {
     float h_ranges[] = {0,(float)HMax};
     const float* ph_ranges = h_ranges;
     int h_channels[] = {0, 0};
-    hue.create(Color.size(), Color.depth());
-    cv::mixChannels(&Color, 1, &hue, 1, h_channels, 1);
 
     if( firstRun )
     {
         if(!occluded)
         {
         Mat _hsv, _hue,_hsv_mask;
-        cv::cvtColor(ColorOrigin, _hsv, CV_BGR2HSV);
+        cv::cvtColor(frame.color_origin(selection), _hsv, CV_BGR2HSV);
         cv::inRange(_hsv, cv::Scalar(HMin, SMin, MIN(VMin,VMax)), cv::Scalar(HMax, SMax, MAX(VMin, VMax)), _hsv_mask);
+        _hue.create(_hsv.size(), _hsv.depth());
         cv::mixChannels(&_hsv, 1, &_hue, 1, h_channels, 1);
-        cv::Mat roi(_hue, selection), maskroi(_hsv_mask, selection);
-        cv::calcHist(&roi, 1, 0, maskroi, h_hist, 1, &h_bins, &ph_ranges);
+        cv::calcHist(&_hue, 1, 0, _hsv_mask, h_hist, 1, &h_bins, &ph_ranges);
         cv::normalize(h_hist, h_hist, 0, 255, CV_MINMAX);
         detectWindow = selection;
         firstRun = false;
@@ -118,10 +102,12 @@ void Object_Detector::H_backprojection()
         }
 
     }
-    cv::calcBackProject(&hue, 1, 0, h_hist, backproj, &ph_ranges,1,true);
+    Mat window_backproj = beginBackprojection(frame);
+    Mat window_color(frame.color, search_window);
+    cv::calcBackProject(&window_color, 1, h_channels, h_hist, window_backproj, &ph_ranges,1,true);
 }
 
-void Object_Detector::HS_backprojection()
+void Object_Detector::HS_backprojection(const Frame& frame)
 {
     int hs_size[] = { h_bins, s_bins };
     float h_range[] = {(float)HMin,(float)HMax};
@@ -134,11 +120,10 @@ void Object_Detector::HS_backprojection()
         if(!occluded)
         {
             Mat _hsv,_hsv_mask;
-            cv::cvtColor(ColorOrigin, _hsv, CV_BGR2HSV);
+            cv::cvtColor(frame.color_origin(selection), _hsv, CV_BGR2HSV);
             cv::inRange(_hsv, cv::Scalar(HMin, SMin, MIN(VMin,VMax)), cv::Scalar(HMax, SMax, MAX(VMin, VMax)), _hsv_mask);
-            cv::Mat roi(_hsv, selection), maskroi(_hsv_mask, selection);
             // imshow("hsv_mask",hsv_mask);
-            cv::calcHist(&roi, 1, hs_channels, maskroi, hs_hist_for_HS, 2, hs_size, phs_ranges, true, false);
+            cv::calcHist(&_hsv, 1, hs_channels, _hsv_mask, hs_hist_for_HS, 2, hs_size, phs_ranges, true, false);
             cv::normalize(hs_hist_for_HS, hs_hist_for_HS, 0, 255, CV_MINMAX);
             detectWindow = selection;
             firstRun = false;
@@ -156,79 +141,118 @@ void Object_Detector::HS_backprojection()
             firstRun = false;
         }
     }
-    cv::calcBackProject( &Color, 1, hs_channels, hs_hist_for_HS, backproj, phs_ranges, 1, true );
+    Mat window_backproj = beginBackprojection(frame);
+    Mat window_color(frame.color, search_window);
+    cv::calcBackProject( &window_color, 1, hs_channels, hs_hist_for_HS, window_backproj, phs_ranges, 1, true );
 //    imshow("backproj",backproj);
 }
 
-void Object_Detector::HSD_backprojection()
+//divisions of cv::cvtColor(CV_BGR2HSV) for 8 bit images, initialized once before the detectors run
+static const int hsv_shift = 12;
+static struct HSV_Div_Tables
 {
+    int sdiv[256], hdiv[256];
+    HSV_Div_Tables()
+    {
+        sdiv[0] = hdiv[0] = 0;
+        for(int i = 1; i < 256; i++)
+        {
+            sdiv[i] = saturate_cast<int>((255 << hsv_shift)/(1.*i));
+            hdiv[i] = saturate_cast<int>((180 << hsv_shift)/(6.*i));
+        }
+    }
+} hsv_div_tables;
 
-    const int hsd_size[] = { h_bins, s_bins ,d_bins};
-    const int hs_size[] =  { h_bins, s_bins };
+//bgr-->hsv of one pixel, the same integer arithmetic of cv::cvtColor(CV_BGR2HSV) for 8 bit images
+static inline void bgr2hsv(const uchar* bgr, int& h, int& s, int& v)
+{
+    int b = bgr[0], g = bgr[1], r = bgr[2];
+    int vmin = std::min(std::min(b, g), r);
+    v = std::max(std::max(b, g), r);
+    int diff = v - vmin;
+    int vr = v == r ? -1 : 0;
+    int vg = v == g ? -1 : 0;
+
+    s = (diff * hsv_div_tables.sdiv[v] + (1 << (hsv_shift-1))) >> hsv_shift;
+    h = (vr & (g - b)) + (~vr & ((vg & (b - r + 2 * diff)) + ((~vg) & (r - g + 4 * diff))));
+    h = (h * hsv_div_tables.hdiv[diff] + (1 << (hsv_shift-1))) >> hsv_shift;
+    h += h < 0 ? 180 : 0;
+}
 
+//bin of every 8 bit value for a uniform histogram of the range (min,max), the same of cv::calcHist and cv::calcBackProject
+static void binLookupTable(uchar lut[256], int bins, float min, float max)
+{
+    double a = bins/(max - min), b = -a*min;
+    for(int j = 0; j < 256; j++)
+    {
+        lut[j] = Object_Detector::OUT_OF_RANGE;
+        if(j >= min && j < max)
+            lut[j] = (uchar)std::max(std::min(cvFloor(j*a + b), bins - 1), 0);
+    }
+}
+
+void Object_Detector::compileHSDModel(const cv::Mat& roi_hsv, const cv::Mat& roi_hsv_mask)
+{
+    const int hs_size[] =  { h_bins, s_bins };
     float h_range[] = { (float)HMin, (float)HMax };
     float s_range[] = { (float)SMin, (float)SMax };
-    float d_range[] = { 0, 255 };
-
-    const float* pd_ranges= d_range;
     const float* phs_ranges[] = { h_range, s_range };
-    const float* phsd_ranges[] = {h_range, s_range ,d_range };
-
     int hs_channels[] = { 0, 1 };
-    int hsd_channels[] = {0,1,2};
-    int hsd_channels_formix[] = {0, 2};
 
-    cv::mixChannels(&Depth, 1, &Color, 3, hsd_channels_formix, 1);//hsv-->hsd
+    cv::calcHist(&roi_hsv, 1, hs_channels, roi_hsv_mask, hs_hist_for_HSD, 2, hs_size, phs_ranges, true, false);
+    cv::normalize(hs_hist_for_HSD , hs_hist_for_HSD , 0, 255, CV_MINMAX);
+
+    //the hsd hist is 255*hs_pdf*depth_pdf normalized to 255, that is hs_hist_for_HSD*depth_pdf/max(depth_pdf),
+    //so we just keep the hs hist and the depth weights instead of the 3D hist
+    binLookupTable(h_lut, h_bins, h_range[0], h_range[1]);
+    binLookupTable(s_lut, s_bins, s_range[0], s_range[1]);
+    binLookupTable(d_lut, d_bins, 0, 255);
+    d_weight.assign(d_bins, 1.f);
+}
 
+void Object_Detector::updateDepthWeight(const Frame& frame, const cv::Rect& window, const cv::Mat& mask)
+{
+    std::vector<int> depth_hist(d_bins, 0);
+    for(int y = 0; y < window.height; y++)
+    {
+        const uchar* bgr = frame.color_origin.ptr<uchar>(window.y + y) + 3*window.x;
+        const ushort* depth = frame.depth.ptr<ushort>(window.y + y) + window.x;
+        const uchar* m = mask.empty() ? 0 : mask.ptr<uchar>(y);
+        for(int x = 0; x < window.width; x++)
+        {
+            if(m)
+            {
+                int h, s, v;
+                bgr2hsv(bgr + 3*x, h, s, v);
+                if(!m[x] || !inHsvRange(h, s, v))
+                    continue;
+            }
+            uchar d_bin = d_lut[depth8(depth[x])];
+            if(d_bin != OUT_OF_RANGE)
+                depth_hist[d_bin]++;
+        }
+    }
+
+    int max_count = *std::max_element(depth_hist.begin(), depth_hist.end());
+    if(max_count == 0)//no depth in the box, keep the last depth pdf
+        return;
+    for(int k = 0; k < d_bins; k++)
+        d_weight[k] = depth_hist[k]/(float)max_count;
+}
+
+void Object_Detector::HSD_backprojection(const Frame& frame)
+{
     if( firstRun )
     {
         if(!occluded)//if the roi is from the file, the first frame will be set to occluded, in this situation,we just calculate the hs pdf and use it to search the object
         {
-            Mat _hsv;
-            cv::cvtColor(ColorOrigin, _hsv, CV_BGR2HSV);
-            cv::Mat roi(_hsv, selection), maskroi(hsv_mask, selection);
-            cv::calcHist(&roi, 1, hs_channels, maskroi, hs_hist_for_HSD, 2, hs_size, phs_ranges, true, false);
-            cv::normalize(hs_hist_for_HSD , hs_hist_for_HSD , 0, 255, CV_MINMAX);
-
-            double sum_hs_hist=sum(hs_hist_for_HSD)[0];
-            hs_hist_pdf=hs_hist_for_HSD/sum_hs_hist;
-
-            //used to generate the initial hsd_hist(use this just for the right data format )
-            cv::calcHist(&roi, 1, hsd_channels, maskroi, hsd_hist, 3, hsd_size, phsd_ranges, true, false);
-
-            cv::Mat roi_depth(Depth, selection);
-
-            //calculate the the current_trackBox(rotatedrect) mask,named depth_mask(in this mask ,just the the value in the area :current_detectBox(rotatedrect) is 255)
-            Point2f vertices[4];
-            current_detectedBox.points(vertices);
-            std::vector< std::vector<Point> >  co_ordinates;
-            co_ordinates.push_back(std::vector<Point>());
-            co_ordinates[0].push_back(vertices[0]);
-            co_ordinates[0].push_back(vertices[1]);
-            co_ordinates[0].push_back(vertices[2]);
-            co_ordinates[0].push_back(vertices[3]);
-            depth_mask=Mat::zeros(Color.size(),CV_8UC1);
-            drawContours( depth_mask,co_ordinates,0, Scalar(255),CV_FILLED, 8 );
-            depth_mask&=hsv_mask;
-            cv::Mat  depth_mask_roi(depth_mask, detectWindow);
-            cv::calcHist(&roi_depth, 1, 0, depth_mask_roi, tmp_depth_hist_pdf, 1, &d_bins, &pd_ranges);
-            double sum_tmp_depth_hist_pdf=sum(tmp_depth_hist_pdf)[0];
-            tmp_depth_hist_pdf=tmp_depth_hist_pdf/sum_tmp_depth_hist_pdf;
-
-
-            //combine the hs and depth
-            for (int i=0; i<hsd_size[0]; i++) {
-                for (int j=0; j<hsd_size[1]; j++) {
-                    for (int k=0; k<hsd_size[2]; k++) {
-                        hsd_hist.at<float>(i,j,k)=255*hs_hist_pdf.at<float>(i,j)*tmp_depth_hist_pdf.at<float>(k);
-                    }
-                }
-            }
+            Mat roi_hsv, roi_hsv_mask;
+            cv::cvtColor(frame.color_origin(selection), roi_hsv, CV_BGR2HSV);
+            cv::inRange(roi_hsv, cv::Scalar(HMin, SMin, MIN(VMin,VMax)), cv::Scalar(HMax, SMax, MAX(VMin, VMax)), roi_hsv_mask);
+            compileHSDModel(roi_hsv, roi_hsv_mask);
 
-            //normalize hsd_hist
-            double hMin,hMax;
-            minMaxIdx(hsd_hist, &hMin, &hMax);
-            hsd_hist = 255 * hsd_hist / hMax;
+            //the detected box is still empty, so the depth pdf is calculated on the pixels of the selection in the hsv range
+            updateDepthWeight(frame, selection, roi_hsv_mask);
 
             detectWindow = selection;
             firstRun = false;
@@ -242,15 +266,7 @@ void Object_Detector::HSD_backprojection()
                         cv::Scalar(HMax, SMax, MAX(VMin, VMax)), roi_hsv_mask);
             //            imshow("roi_hsv_mask",roi_hsv_mask);
             //            cv::waitKey(10);
-
-            cv::calcHist(&roi_hsv, 1, hs_channels, roi_hsv_mask, hs_hist_for_HSD, 2, hs_size, phs_ranges, true, false);
-            cv::normalize(hs_hist_for_HSD , hs_hist_for_HSD , 0, 255, CV_MINMAX);
-
-            double sum_hs_hist=sum(hs_hist_for_HSD)[0];
-            hs_hist_pdf=hs_hist_for_HSD/sum_hs_hist;
-
-            //used to generate the initial hsd_hist(use this just for the right data format )
-            cv::calcHist(&roi_hsv, 1, hsd_channels, roi_hsv_mask, hsd_hist, 3, hsd_size, phsd_ranges, true, false);
+            compileHSDModel(roi_hsv, roi_hsv_mask);
 
             detectWindow = selection;
             firstRun = false;
@@ -261,54 +277,39 @@ void Object_Detector::HSD_backprojection()
     {
         if(!occluded&&!half_occluded)
         {
-            cv::Mat roi_depth(Depth, detectWindow);
-
-            //calculate the the current_trackBox(rotatedrect) mask,named depth_mask(in this mask ,just the the value in the area :current_detectBox(rotatedrect) is 255)
-            Point2f vertices[4];
-            current_detectedBox.points(vertices);
-            std::vector< std::vector<Point> >  co_ordinates;
-            co_ordinates.push_back(std::vector<Point>());
-            co_ordinates[0].push_back(vertices[0]);
-            co_ordinates[0].push_back(vertices[1]);
-            co_ordinates[0].push_back(vertices[2]);
-            co_ordinates[0].push_back(vertices[3]);
-
-            depth_mask=Mat::zeros(Color.size(),CV_8UC1);
-            drawContours( depth_mask,co_ordinates,0, Scalar(255),CV_FILLED, 8 );
-            depth_mask&=hsv_mask;
-
-            cv::Mat  depth_mask_roi(depth_mask, detectWindow);
-
-            cv::calcHist(&roi_depth, 1, 0, depth_mask_roi, tmp_depth_hist_pdf, 1, &d_bins, &pd_ranges);
-            double sum_tmp_depth_hist_pdf=sum(tmp_depth_hist_pdf)[0];
-            tmp_depth_hist_pdf=tmp_depth_hist_pdf/sum_tmp_depth_hist_pdf;
-
-            //////////////////////cost a lot of time  //////////////////////
-            for (int i=0; i<hsd_size[0]; i++) {
-                for (int j=0; j<hsd_size[1]; j++) {
-                    for (int k=0; k<hsd_size[2]; k++) {
-                        hsd_hist.at<float>(i,j,k)=255*hs_hist_pdf.at<float>(i,j)*tmp_depth_hist_pdf.at<float>(k);
-                    }
-                }
-            }
-            //////////////////////rcost a lot of time  //////////////////////
-
-            double hMin,hMax;
-            minMaxIdx(hsd_hist, &hMin, &hMax);
-            hsd_hist = 255 * hsd_hist / hMax;
+            detectedBoxMask();
+            if(!depth_mask.empty())
+                updateDepthWeight(frame, detectWindow, depth_mask);
         }
     }
 
-
-    if(!occluded&&!half_occluded)//if not occluded, use hsd pdf
-    {
-        cv::calcBackProject( &Color, 1, hsd_channels, hsd_hist, backproj, phsd_ranges, 1, true );
-    }
-    else//if occluded, use hs pdf
+    //one pass on the bgr and depth pixels of the search_window: hsv, hsv mask, bins and hsd pdf(if occluded, just the hs pdf)
+    Mat window_backproj = beginBackprojection(frame);
+    const bool use_depth = !occluded&&!half_occluded;
+    for(int y = 0; y < search_window.height; y++)
     {
-        cv::calcBackProject( &Color, 1, hs_channels, hs_hist_for_HSD, backproj, phs_ranges, 1, true );
+        const uchar* bgr = frame.color_origin.ptr<uchar>(search_window.y + y) + 3*search_window.x;
+        const ushort* depth = frame.depth.ptr<ushort>(search_window.y + y) + search_window.x;
+        uchar* prob = window_backproj.ptr<uchar>(y);
+        for(int x = 0; x < search_window.width; x++)
+        {
+            int h, s, v;
+            bgr2hsv(bgr + 3*x, h, s, v);
+            uchar h_bin = h_lut[h], s_bin = s_lut[s];
+            if(!inHsvRange(h, s, v) || h_bin == OUT_OF_RANGE || s_bin == OUT_OF_RANGE)
+            {
+                prob[x] = 0;
+                continue;
+            }
+            float p = hs_hist_for_HSD.at<float>(h_bin, s_bin);
+            if(use_depth)
+            {
+                uchar d_bin = d_lut[depth8(depth[x])];
+                p = d_bin == OUT_OF_RANGE ? 0 : p*d_weight[d_bin];
+            }
+            prob[x] = saturate_cast<uchar>(p);
+        }
     }
-
 }
 
 //camshift + occlusion handle
@@ -448,61 +449,39 @@ cv::RotatedRect Object_Detector::object_shift(InputArray _probColor,Rect& window
     return box;
 }
 
-cv::RotatedRect Object_Detector::detectCurrentRect(int id)
+cv::RotatedRect Object_Detector::detectCurrentRect(int id, const Frame& frame)
 {
-
-    mainColor.copyTo(Color);
-    mainDepth.copyTo(Depth);
-    mainColorOrigin.copyTo(ColorOrigin);
-    hsvMask.copyTo(hsv_mask);
-
+    //the backprojection and the masks are calculated just in the search_window, so the cost of every detector depends on the size of its window, not of the frame
     if(Backprojection_Mode=="H")
     {
-        H_backprojection();
+        H_backprojection(frame);
     }
     else if(Backprojection_Mode=="HS")
     {
-        HS_backprojection();
+        HS_backprojection(frame);
     }
     else
     {
-        HSD_backprojection();
+        HSD_backprojection(frame);
     }
 //    imshow("backproj first",backproj);
 
+    Mat window_backproj(backproj, search_window);
+    if(!frame.hsv_mask.empty())//HSD mode applies the hsv mask in the backprojection
+        window_backproj &= frame.hsv_mask(search_window);
 
-    // calculate the other_object_mask with the current_detected_boxes
-    other_object_mask=Mat::ones(Color.size(), CV_8U)*255;
-    for (int i=0; i<current_detected_boxes.size(); i++)
+    // block the other objects with the detected_boxes of the previous frame
+    for (int i=0; i<frame.detected_boxes.size(); i++)
     {
         if(i!=id)
         {
             uchar tmp =0;
-            Rect current_tracked_box =current_detected_boxes[i];
-            current_tracked_box=current_tracked_box&Rect(0,0,Color.size().width,Color.size().height);
-            other_object_mask(current_tracked_box)=tmp;
+            Rect current_tracked_box =frame.detected_boxes[i]&search_window;
+            if(current_tracked_box.area()>0)
+                backproj(current_tracked_box)=tmp;
         }
     }
 
-
-    detectWindow=detectWindow&Rect(0,0,Color.size().width,Color.size().height);
-    if(occluded==false&&detectWindow.area()>1)
-    {
-        //use x y to generate position_mask,the object can move in the window which is AREA_TOLERANCE size bigger than the last detected window
-        position_mask=Mat::zeros(Color.size(),CV_8UC1);
-        int detectWindow_XL=detectWindow.x-AREA_TOLERANCE,detectWindow_XR=detectWindow.x+detectWindow.width+AREA_TOLERANCE;
-        int detectWindow_YT=detectWindow.y-AREA_TOLERANCE,detectWindow_YB=detectWindow.y+detectWindow.height+AREA_TOLERANCE;
-        Rect search_window=Rect(detectWindow_XL,detectWindow_YT,detectWindow_XR-detectWindow_XL,detectWindow_YB-detectWindow_YT)&Rect(0,0,Color.size().width,Color.size().height);
-        position_mask(search_window)=255;
-        position_mask &= hsv_mask;
-        backproj &= position_mask;
-        backproj &= other_object_mask;
-    }
-    else{
-        backproj &= hsv_mask;
-        backproj &= other_object_mask;
-    }
-
     if(detectWindow.area()>1)
         current_detectedBox = object_shift(backproj, detectWindow,
                                            cv::TermCriteria( CV_TERMCRIT_EPS | CV_TERMCRIT_ITER, 10, 1 ));
@@ -514,3 +493,8 @@ cv::RotatedRect Object_Detector::detectCurrentRect(int id)
 
 }
 
+void Object_Detector::dropDetection()
+{
+    occluded=true;
+    current_detectedBox=RotatedRect();
+}
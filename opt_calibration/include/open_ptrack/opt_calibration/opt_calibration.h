@@ -35,6 +35,7 @@
 #define OPEN_PTRACK_OPT_CALIBRATION_OPT_CALIBRATION_H_
 
 #include <sstream>
+#include <deque>
 
 #include <ros/ros.h>
 #include <ros/package.h>
@@ -58,6 +59,11 @@
 #include <open_ptrack/opt_calibration/opt_checkerboard_extraction.h>
 
 
+namespace ceres
+{
+class Problem;
+}
+
 namespace open_ptrack
 {
 namespace opt_calibration
@@ -209,6 +215,8 @@ public:
     view_map_vec_.push_back(ViewMap());
   }
 
+  // analyzeData only reads the calibration, it can run concurrently for different sensors.
+  // addData modifies the current acquisition and must be serialized.
   bool analyzeData(const cb::PinholeSensor::Ptr & color_sensor,
                    const cb::DepthSensor::Ptr & depth_sensor,
                    const cv::Mat & image,
@@ -256,6 +264,7 @@ private:
 
   bool estimateFloor();
   void convertToWorldFrame();
+  void addResiduals(size_t view);
 
 
   ros::NodeHandle node_handle_;
@@ -283,6 +292,18 @@ private:
   bool floor_estimated_;
   cb::Plane floor_;
 
+  // Bundle adjustment kept between optimizations: the residual blocks of the new views are added
+  // to problem_ and the parameter blocks keep the last solution (warm start).
+  typedef Eigen::Matrix<cb::Scalar, 6, 1, Eigen::DontAlign> PoseData;     // angle-axis, translation
+  boost::shared_ptr<ceres::Problem> problem_;
+  std::vector<PoseData> sensor_data_;
+  std::deque<PoseData> cb_data_;                      // deque: parameter blocks must not move
+  Eigen::Matrix<cb::Scalar, 3, 1, Eigen::DontAlign> floor_data_;
+  size_t optimized_views_;                            // view maps with residual blocks in problem_
+  bool problem_floor_;                                // floor_estimated_ when problem_ was built
+  int max_free_views_;                                // older checkerboards are held constant, 0 = all free
+  size_t frozen_views_;
+
 };
 
 } /* namespace opt_calibration */
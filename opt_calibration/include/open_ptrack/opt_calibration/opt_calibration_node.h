@@ -36,6 +36,7 @@
 
 #include <ros/ros.h>
 #include <ros/package.h>
+#include <ros/callback_queue.h>
 
 #include <image_transport/image_transport.h>
 #include <cv_bridge/cv_bridge.h>
@@ -99,6 +100,39 @@ private:
     UPDATE
   };
 
+  /**
+   * @brief Checkerboard analysis of the last messages of a device.
+   */
+  struct DeviceDetection
+  {
+    bool detected;
+    std::string frame_id;
+    Sensor::Ptr sensors[2];
+    OPTCalibration::CheckerboardView::Ptr cb_views[2];
+    int num_views;
+    std::string error;                                      ///< @brief Message of the exception thrown by the analysis, if any.
+  };
+
+  /**
+   * @brief Number of devices with new messages.
+   */
+  int newMessagesCount() const;
+
+  /**
+   * @brief Wait for the messages of the next acquisition: until all the devices have new messages
+   * or acquisition_window_ seconds after the first new message (or without any message).
+   * Acquisitions are at least min_acquisition_period_ seconds apart.
+   */
+  void waitForMessages();
+
+  /**
+   * @brief Analyse the new messages of a device, the devices are indexed pinhole, kinect and swiss ranger
+   * in this order. Devices are independent, so they can be analysed concurrently.
+   * @param[in] i Index of the device.
+   * @param[out] detection Result of the analysis.
+   */
+  void analyzeDevice(size_t i, DeviceDetection & detection);
+
   ros::NodeHandle node_handle_;                             ///< @brief Handle to the ROS node.
   image_transport::ImageTransport image_transport_;         ///< @brief Handle to ImageTransport, which advertise and subscribe to image topics.
 
@@ -120,6 +154,9 @@ private:
   std::vector<Sensor::Ptr> sensor_vec_;
 
   int num_sensors_;                                         ///< @brief Number of sensors connected to the network.
+  double acquisition_window_;                               ///< @brief Maximum time (s) to wait for the messages of all the devices.
+  double min_acquisition_period_;                           ///< @brief Minimum time (s) between two acquisitions, 0 = camera rate.
+  ros::WallTime last_acquisition_;                          ///< @brief End of the last acquisition wait.
 
   OPTCalibration::Ptr calibration_;                         ///< @brief Calibration object.
 
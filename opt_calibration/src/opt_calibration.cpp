@@ -32,6 +32,7 @@
  */
 
 #include <fstream>
+#include <thread>
 
 #include <tf_conversions/tf_eigen.h>
 #include <tf/transform_listener.h>
@@ -59,8 +60,13 @@ OPTCalibration::OPTCalibration(const ros::NodeHandle & node_handle)
     initialization_(true),
     last_optimization_(OPTIMIZATION_COUNT),
     floor_acquisition_(false),
-    floor_estimated_(false)
+    floor_estimated_(false),
+    optimized_views_(0),
+    problem_floor_(false),
+    max_free_views_(0),
+    frozen_views_(0)
 {
+  node_handle_.param("max_free_views", max_free_views_, 0);
   marker_pub_ = node_handle_.advertise<visualization_msgs::Marker>("markers", 0);
 }
 
@@ -108,13 +114,13 @@ bool OPTCalibration::analyzeData(const cb::PinholeSensor::Ptr & color_sensor,
   {
     visualization_msgs::Marker checkerboard_marker;
     checkerboard_marker.ns = "checkerboard";
-    checkerboard_marker.id = node_map_[color_sensor]->id();
+    checkerboard_marker.id = node_map_.at(color_sensor)->id();
     extracted_checkerboard->toMarker(checkerboard_marker);
     marker_pub_.publish(checkerboard_marker);
 
     visualization_msgs::Marker plane_marker;
     plane_marker.ns = "plane";
-    plane_marker.id = node_map_[color_sensor]->id();
+    plane_marker.id = node_map_.at(color_sensor)->id();
     extracted_plane->toMarker(plane_marker);
     marker_pub_.publish(plane_marker);
 
@@ -157,7 +163,7 @@ bool OPTCalibration::analyzeData(const cb::PinholeSensor::Ptr & color_sensor,
   {
     visualization_msgs::Marker checkerboard_marker;
     checkerboard_marker.ns = "checkerboard";
-    checkerboard_marker.id = node_map_[color_sensor]->id();
+    checkerboard_marker.id = node_map_.at(color_sensor)->id();
     extracted_checkerboard->toMarker(checkerboard_marker);
     marker_pub_.publish(checkerboard_marker);
 
@@ -697,37 +703,90 @@ private:
 
 };
 
-void OPTCalibration::optimize()
+void OPTCalibration::addResiduals(size_t i)
 {
-  convertToWorldFrame();
+  ViewMap & view_map = view_map_vec_[i];
+  if (view_map.size() == 1) // Nothing to optimize
+    return;
 
-  ROS_INFO("Optimizing...");
+  for (ViewMap::iterator it = view_map.begin(); it != view_map.end(); ++it)
+  {
+    CheckerboardView::Ptr cb_view = it->second;
+    const TreeNode::Ptr & tree_node = it->first;
 
-  Eigen::Matrix<cb::Scalar, Eigen::Dynamic, 6, Eigen::DontAlign | Eigen::RowMajor> cb_data(view_map_vec_.size(), 6);
-  Eigen::Matrix<cb::Scalar, Eigen::Dynamic, 6, Eigen::DontAlign | Eigen::RowMajor> sensor_data(node_vec_.size(), 6);
-  Eigen::Matrix<cb::Scalar, 3, 1, Eigen::DontAlign> floor_data;
+    if (tree_node->type() == TreeNode::INTENSITY)
+    {
+      cb::PinholeSensor::Ptr sensor = boost::static_pointer_cast<cb::PinholeSensor>(tree_node->sensor());
+      cb::PinholeView<cb::Checkerboard>::Ptr view = boost::static_pointer_cast<cb::PinholeView<cb::Checkerboard> >(cb_view->view);
+      if (tree_node->level() > 0 and not cb_view->is_floor)
+      {
+        PinholeError * error = new PinholeError(sensor->cameraModel(), checkerboard_, view->points());
+        typedef ceres::AutoDiffCostFunction<PinholeError, ceres::DYNAMIC, 6, 6> PinholeErrorFunction;
 
-  for (size_t i = 0; i < node_vec_.size(); ++i)
-  {
-    const TreeNode & sensor_node = *node_vec_[i];
-    cb::AngleAxis rotation = cb::AngleAxis(sensor_node.sensor()->pose().linear());
-    sensor_data.row(i).head<3>() = rotation.angle() * rotation.axis();
-    sensor_data.row(i).tail<3>() = sensor_node.sensor()->pose().translation();
-  }
+        ceres::CostFunction * cost_function = new PinholeErrorFunction(error, checkerboard_->size());
+        problem_->AddResidualBlock(cost_function, new ceres::CauchyLoss(0.5), sensor_data_[tree_node->id()].data(), cb_data_[i].data());
+      }
+      else if (tree_node->level() > 0 and cb_view->is_floor)
+      {
+        PinholeFloorError * error = new PinholeFloorError(sensor->cameraModel(), checkerboard_, view->points());
+        typedef ceres::AutoDiffCostFunction<PinholeFloorError, ceres::DYNAMIC, 6, 3, 3> PinholeFloorErrorFunction;
 
-  for (size_t i = 0; i < checkerboard_vec_.size(); ++i)
-  {
-    const cb::Checkerboard & checkerboard = *checkerboard_vec_[i];
-    cb::AngleAxis rotation = cb::AngleAxis(checkerboard.pose().linear());
-    cb_data.row(i).head<3>() = rotation.angle() * rotation.axis();
-    cb_data.row(i).tail<3>() = checkerboard.pose().translation();
+        ceres::CostFunction * cost_function = new PinholeFloorErrorFunction(error, checkerboard_->size());
+        problem_->AddResidualBlock(cost_function, new ceres::CauchyLoss(0.5), sensor_data_[tree_node->id()].data(), cb_data_[i].data(), floor_data_.data());
+      }
+      else if (not cb_view->is_floor)
+      {
+        RootPinholeError * error = new RootPinholeError(sensor->cameraModel(), checkerboard_, view->points());
+        typedef ceres::AutoDiffCostFunction<RootPinholeError, ceres::DYNAMIC, 6> RootPinholeErrorFunction;
 
+        ceres::CostFunction * cost_function = new RootPinholeErrorFunction(error, checkerboard_->size());
+        problem_->AddResidualBlock(cost_function, new ceres::CauchyLoss(0.5), cb_data_[i].data());
+      }
+      else // (cb_view->is_floor)
+      {
+        RootPinholeFloorError * error = new RootPinholeFloorError(sensor->cameraModel(), checkerboard_, view->points());
+        typedef ceres::AutoDiffCostFunction<RootPinholeFloorError, ceres::DYNAMIC, 3, 3> RootPinholeFloorErrorFunction;
+
+        ceres::CostFunction * cost_function = new RootPinholeFloorErrorFunction(error, checkerboard_->size());
+        problem_->AddResidualBlock(cost_function, new ceres::CauchyLoss(0.5), cb_data_[i].data(), floor_data_.data());
+      }
+    }
+    else //(tree_node->type() == TreeNode::DEPTH)
+    {
+      cb::DepthSensor::Ptr sensor = boost::static_pointer_cast<cb::DepthSensor>(tree_node->sensor());
+      cb::DepthViewPCL<cb::PlanarObject>::Ptr view = boost::static_pointer_cast<cb::DepthViewPCL<cb::PlanarObject> >(cb_view->view);
+      if (tree_node->level() > 0)
+      {
+        DepthError * error = new DepthError(checkerboard_,
+                                            cb_view->object->plane(),
+                                            cb::PCLConversion<cb::Scalar>::toPointMatrix(*view->data(), view->points()),
+                                            sensor->depthErrorFunction());
+
+        typedef ceres::AutoDiffCostFunction<DepthError, ceres::DYNAMIC, 6, 6> DepthErrorFunction;
+
+        ceres::CostFunction * cost_function = new DepthErrorFunction(error, checkerboard_->size());
+        //ceres::CostFunction * cost_function = new DepthErrorFunction(error, view->points().size());
+        problem_->AddResidualBlock(cost_function, new ceres::CauchyLoss(0.5), sensor_data_[tree_node->id()].data(), cb_data_[i].data());
+
+      }
+      else
+      {
+        //ROS_FATAL("FATAL");
+      }
+    }
   }
+}
+
+void OPTCalibration::optimize()
+{
+  convertToWorldFrame();
+
+  ROS_INFO("Optimizing...");
 
 //  ROS_INFO("Before optimization:");
 //  for (size_t i = 0; i < sensor_vec_.size(); ++i)
 //    ROS_INFO_STREAM("(" << node_vec_[i]->sensor()->parent()->frameId() << ") "
-//                        << node_vec_[i]->sensor()->frameId() << ": " << sensor_data.row(i));
+//                        << node_vec_[i]->sensor()->frameId() << ": " << sensor_data_[i].transpose());
 
   if (not floor_estimated_)
   {
@@ -748,15 +807,43 @@ void OPTCalibration::optimize()
     floor_pose.linear().col(0) = floor_x;
     floor_pose.linear().col(1) = floor_pose.linear().col(2).cross(floor_pose.linear().col(0));
     floor_pose.translation() = floor_origin;
+  }
+
+  // The problem is built again while the sensor tree can still change and when the floor is estimated,
+  // since the floor checkerboards change parametrization. Otherwise only the new views are added.
+  bool rebuild = not problem_ or initialization_ or problem_floor_ != floor_estimated_;
+  if (rebuild)
+  {
+    problem_ = boost::make_shared<ceres::Problem>();
+    problem_floor_ = floor_estimated_;
+    optimized_views_ = 0;
+    frozen_views_ = 0;
+    cb_data_.clear();
+
+    sensor_data_.resize(node_vec_.size());
+    for (size_t i = 0; i < node_vec_.size(); ++i)
+    {
+      const TreeNode & sensor_node = *node_vec_[i];
+      cb::AngleAxis rotation = cb::AngleAxis(sensor_node.sensor()->pose().linear());
+      sensor_data_[i].head<3>() = rotation.angle() * rotation.axis();
+      sensor_data_[i].tail<3>() = sensor_node.sensor()->pose().translation();
+    }
 
-    floor_data = floor_origin;
+    if (floor_estimated_)
+      floor_data_ = floor_origin;
   }
 
-  for (size_t i = 0; i < checkerboard_vec_.size(); ++i)
+  // New checkerboards start from their pose, the others from the last solution
+  for (size_t i = cb_data_.size(); i < checkerboard_vec_.size(); ++i)
   {
+    const cb::Checkerboard & checkerboard = *checkerboard_vec_[i];
+    cb::AngleAxis rotation = cb::AngleAxis(checkerboard.pose().linear());
+    PoseData cb_data;
+    cb_data.head<3>() = rotation.angle() * rotation.axis();
+    cb_data.tail<3>() = checkerboard.pose().translation();
+
     if (floor_estimated_ and is_floor_vec_[i])
     {
-      const cb::Checkerboard & checkerboard = *checkerboard_vec_[i];
       cb::Vector3 origin = floor_.projection(checkerboard[0]); // TODO use line-of-sight projection
       cb::Vector3 x = (floor_.projection(checkerboard(checkerboard.cols() - 1, 0)) - origin).normalized(); // TODO use line-of-sight projection
       cb::Scalar theta = std::atan2((x - floor_x * floor_x.dot(x)).norm(), floor_x.dot(x));
@@ -765,124 +852,62 @@ void OPTCalibration::optimize()
       cb::Vector3 origin_floor = floor_pose.inverse() * origin;
 //      ROS_INFO_STREAM("O 2D  " << origin_floor.transpose());
 
-      cb_data.row(i).head<2>() = origin_floor.head<2>();
-      cb_data.row(i)[2] = theta;
+      cb_data.head<2>() = origin_floor.head<2>();
+      cb_data[2] = theta;
     }
+    cb_data_.push_back(cb_data);
   }
 
-  ceres::Problem problem;
+  for (size_t i = optimized_views_; i < view_map_vec_.size(); ++i)
+    addResiduals(i);
+  optimized_views_ = view_map_vec_.size();
 
-  for (size_t i = 0; i < view_map_vec_.size(); ++i)
+  // Sliding window: the oldest checkerboards are held constant, they still constrain the sensors
+  for (; max_free_views_ > 0 and frozen_views_ + static_cast<size_t>(max_free_views_) < cb_data_.size(); ++frozen_views_)
   {
-    ViewMap & view_map = view_map_vec_[i];
-    if (view_map.size() == 1) // Nothing to optimize
-      continue;
-
-    for (ViewMap::iterator it = view_map.begin(); it != view_map.end(); ++it)
-    {
-      CheckerboardView::Ptr cb_view = it->second;
-      const TreeNode::Ptr & tree_node = it->first;
-
-      if (tree_node->type() == TreeNode::INTENSITY)
-      {
-        cb::PinholeSensor::Ptr sensor = boost::static_pointer_cast<cb::PinholeSensor>(tree_node->sensor());
-        cb::PinholeView<cb::Checkerboard>::Ptr view = boost::static_pointer_cast<cb::PinholeView<cb::Checkerboard> >(cb_view->view);
-        if (tree_node->level() > 0 and not cb_view->is_floor)
-        {
-          PinholeError * error = new PinholeError(sensor->cameraModel(), checkerboard_, view->points());
-          typedef ceres::AutoDiffCostFunction<PinholeError, ceres::DYNAMIC, 6, 6> PinholeErrorFunction;
-
-          ceres::CostFunction * cost_function = new PinholeErrorFunction(error, checkerboard_->size());
-          problem.AddResidualBlock(cost_function, new ceres::CauchyLoss(0.5), sensor_data.row(tree_node->id()).data(), cb_data.row(i).data());
-        }
-        else if (tree_node->level() > 0 and cb_view->is_floor)
-        {
-          PinholeFloorError * error = new PinholeFloorError(sensor->cameraModel(), checkerboard_, view->points());
-          typedef ceres::AutoDiffCostFunction<PinholeFloorError, ceres::DYNAMIC, 6, 3, 3> PinholeFloorErrorFunction;
-
-          ceres::CostFunction * cost_function = new PinholeFloorErrorFunction(error, checkerboard_->size());
-          problem.AddResidualBlock(cost_function, new ceres::CauchyLoss(0.5), sensor_data.row(tree_node->id()).data(), cb_data.row(i).data(), floor_data.data());
-        }
-        else if (not cb_view->is_floor)
-        {
-          RootPinholeError * error = new RootPinholeError(sensor->cameraModel(), checkerboard_, view->points());
-          typedef ceres::AutoDiffCostFunction<RootPinholeError, ceres::DYNAMIC, 6> RootPinholeErrorFunction;
-
-          ceres::CostFunction * cost_function = new RootPinholeErrorFunction(error, checkerboard_->size());
-          problem.AddResidualBlock(cost_function, new ceres::CauchyLoss(0.5), cb_data.row(i).data());
-        }
-        else // (cb_view->is_floor)
-        {
-          RootPinholeFloorError * error = new RootPinholeFloorError(sensor->cameraModel(), checkerboard_, view->points());
-          typedef ceres::AutoDiffCostFunction<RootPinholeFloorError, ceres::DYNAMIC, 3, 3> RootPinholeFloorErrorFunction;
-
-          ceres::CostFunction * cost_function = new RootPinholeFloorErrorFunction(error, checkerboard_->size());
-          problem.AddResidualBlock(cost_function, new ceres::CauchyLoss(0.5), cb_data.row(i).data(), floor_data.data());
-        }
-      }
-      else //(tree_node->type() == TreeNode::DEPTH)
-      {
-        cb::DepthSensor::Ptr sensor = boost::static_pointer_cast<cb::DepthSensor>(tree_node->sensor());
-        cb::DepthViewPCL<cb::PlanarObject>::Ptr view = boost::static_pointer_cast<cb::DepthViewPCL<cb::PlanarObject> >(cb_view->view);
-        if (tree_node->level() > 0)
-        {
-          DepthError * error = new DepthError(checkerboard_,
-                                              cb_view->object->plane(),
-                                              cb::PCLConversion<cb::Scalar>::toPointMatrix(*view->data(), view->points()),
-                                              sensor->depthErrorFunction());
-
-          typedef ceres::AutoDiffCostFunction<DepthError, ceres::DYNAMIC, 6, 6> DepthErrorFunction;
-
-          ceres::CostFunction * cost_function = new DepthErrorFunction(error, checkerboard_->size());
-          //ceres::CostFunction * cost_function = new DepthErrorFunction(error, view->points().size());
-          problem.AddResidualBlock(cost_function, new ceres::CauchyLoss(0.5), sensor_data.row(tree_node->id()).data(), cb_data.row(i).data());
-
-        }
-        else
-        {
-          //ROS_FATAL("FATAL");
-        }
-      }
-    }
+    if (problem_->HasParameterBlock(cb_data_[frozen_views_].data()))
+      problem_->SetParameterBlockConstant(cb_data_[frozen_views_].data());
   }
 
   ceres::Solver::Options options;
   options.linear_solver_type = ceres::SPARSE_SCHUR;
-  options.max_num_iterations = 200;
+  options.max_num_iterations = rebuild ? 200 : 50;    // warm started, close to the solution
 //  options.minimizer_progress_to_stdout = true;
-  options.num_threads = 8;
+  options.num_threads = std::max(1u, std::thread::hardware_concurrency());
 
   ceres::Solver::Summary summary;
-  ceres::Solve(options, &problem, &summary);
+  ceres::Solve(options, problem_.get(), &summary);
+  ROS_INFO_STREAM("Optimization: " << summary.num_residual_blocks << " residual blocks, "
+                  << summary.iterations.size() << " iterations, " << summary.total_time_in_seconds << " s");
 
 //  ROS_INFO("After optimization:");
   for (size_t i = 0; i < node_vec_.size(); ++i)
   {
 //    ROS_INFO_STREAM("(" << node_vec_[i]->sensor()->parent()->frameId() << ") "
-//                        << node_vec_[i]->sensor()->frameId() << ": " << sensor_data.row(i));
+//                        << node_vec_[i]->sensor()->frameId() << ": " << sensor_data_[i].transpose());
     TreeNode::Ptr & sensor_node = node_vec_[i];
-    if (sensor_data.row(i).head<3>().norm() != 0)
+    if (sensor_data_[i].head<3>().norm() != 0)
     {
-      cb::AngleAxis rotation(sensor_data.row(i).head<3>().norm(), sensor_data.row(i).head<3>().normalized());
-      cb::Translation3 translation(sensor_data.row(i).tail<3>());
+      cb::AngleAxis rotation(sensor_data_[i].head<3>().norm(), sensor_data_[i].head<3>().normalized());
+      cb::Translation3 translation(sensor_data_[i].tail<3>());
       sensor_node->sensor()->setPose(translation * rotation);
     }
     else
     {
-      cb::Translation3 translation(sensor_data.row(i).tail<3>());
+      cb::Translation3 translation(sensor_data_[i].tail<3>());
       sensor_node->sensor()->setPose(cb::Pose::Identity() * translation);
     }
   }
 
 //  if (floor_estimated_)
-//    ROS_INFO_STREAM("F* " << -floor_data.normalized().transpose() << " " << floor_data.norm());
+//    ROS_INFO_STREAM("F* " << -floor_data_.normalized().transpose() << " " << floor_data_.norm());
 
-  cb::Plane plane(-floor_data.normalized(), floor_data.norm());
+  cb::Plane plane(-floor_data_.normalized(), floor_data_.norm());
   cb::Transform plane_pose;
   plane_pose.linear().col(2) = plane.normal();
-  plane_pose.linear().col(0) = (plane.projection(floor_data + cb::Vector3::UnitX()) - floor_data).normalized();
+  plane_pose.linear().col(0) = (plane.projection(floor_data_ + cb::Vector3::UnitX()) - floor_data_).normalized();
   plane_pose.linear().col(1) = plane_pose.linear().col(2).cross(plane_pose.linear().col(0));
-  plane_pose.translation() = floor_data;
+  plane_pose.translation() = floor_data_;
 
   for (size_t i = 0; i < checkerboard_vec_.size(); ++i)
   {
@@ -890,8 +915,8 @@ void OPTCalibration::optimize()
 
     if (floor_estimated_ and is_floor_vec_[i])
     {
-      cb::Translation2 checkerboard_t_2d(cb_data.row(i).head<2>());
-      cb::Rotation2 checkerboard_r_2d(cb_data.row(i)[2]);
+      cb::Translation2 checkerboard_t_2d(cb_data_[i].head<2>());
+      cb::Rotation2 checkerboard_r_2d(cb_data_[i][2]);
       cb::Transform2 checkerboard_pose_2d = checkerboard_t_2d * checkerboard_r_2d;
       cb::Transform checkerboard_pose = cb::Transform::Identity();
 
@@ -904,15 +929,15 @@ void OPTCalibration::optimize()
     }
     else
     {
-      if (cb_data.row(i).head<3>().norm() > 0.001)
+      if (cb_data_[i].head<3>().norm() > 0.001)
       {
-        cb::AngleAxis rotation(cb_data.row(i).head<3>().norm(), cb_data.row(i).head<3>().normalized());
-        cb::Translation3 translation(cb_data.row(i).tail<3>());
+        cb::AngleAxis rotation(cb_data_[i].head<3>().norm(), cb_data_[i].head<3>().normalized());
+        cb::Translation3 translation(cb_data_[i].tail<3>());
         checkerboard->transform(translation * rotation * checkerboard->pose().inverse());
       }
       else
       {
-        cb::Translation3 translation(cb_data.row(i).tail<3>());
+        cb::Translation3 translation(cb_data_[i].tail<3>());
         checkerboard->transform(cb::Pose::Identity() * translation * checkerboard->pose().inverse());
       }
     }
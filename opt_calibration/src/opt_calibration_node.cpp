@@ -62,6 +62,8 @@ OPTCalibrationNode::OPTCalibrationNode(const ros::NodeHandle & node_handle)
 {
   action_sub_ = node_handle_.subscribe("action", 1, &OPTCalibrationNode::actionCallback, this);
   status_pub_ = node_handle_.advertise<opt_msgs::CalibrationStatus>("status", 1);
+  node_handle_.param("acquisition_window", acquisition_window_, 0.2);
+  node_handle_.param("min_acquisition_period", min_acquisition_period_, 0.2);
 
   std::string world_computation_s;
   node_handle_.param("world_computation", world_computation_s, std::string("first_sensor"));
@@ -297,95 +299,163 @@ void OPTCalibrationNode::actionCallback(const std_msgs::String::ConstPtr & msg)
   }
 }
 
+int OPTCalibrationNode::newMessagesCount() const
+{
+  int count = 0;
+  for (size_t i = 0; i < pinhole_vec_.size(); ++i)
+    count += pinhole_vec_[i]->hasNewMessages();
+  for (size_t i = 0; i < kinect_vec_.size(); ++i)
+    count += kinect_vec_[i]->hasNewMessages();
+  for (size_t i = 0; i < swiss_ranger_vec_.size(); ++i)
+    count += swiss_ranger_vec_[i]->hasNewMessages();
+  return count;
+}
+
+void OPTCalibrationNode::waitForMessages()
+{
+  const int num_devices = pinhole_vec_.size() + kinect_vec_.size() + swiss_ranger_vec_.size();
+  const ros::WallTime earliest = last_acquisition_ + ros::WallDuration(min_acquisition_period_);
+  ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(acquisition_window_);
+  bool first_message = true;
+
+  while (ros::ok())
+  {
+    // Wake up at every message
+    ros::getGlobalCallbackQueue()->callAvailable(ros::WallDuration(0.01));
+
+    ros::WallTime now = ros::WallTime::now();
+    int new_messages = newMessagesCount();
+    if (new_messages > 0 and first_message)
+    {
+      deadline = now + ros::WallDuration(acquisition_window_);
+      first_message = false;
+    }
+
+    // Without devices only the deadline ends the wait
+    if (now >= earliest and ((num_devices > 0 and new_messages == num_devices) or now >= deadline))
+      break;
+  }
+  last_acquisition_ = ros::WallTime::now();
+}
+
+void OPTCalibrationNode::analyzeDevice(size_t i, DeviceDetection & detection)
+{
+  detection.detected = false;
+  detection.num_views = 0;
+
+  if (i < pinhole_vec_.size())
+  {
+    const PinholeRGBDevice::Ptr & device = pinhole_vec_[i];
+    if (device->hasNewMessages())
+    {
+      device->convertLastMessages();
+      PinholeRGBDevice::Data::Ptr data = device->lastData();
+      ROS_DEBUG_STREAM("[" << device->frameId() << "] analysing image generated at: " << device->lastMessages().image_msg->header.stamp);
+      if (calibration_->analyzeData(device->sensor(), data->image, detection.cb_views[0]))
+      {
+        detection.sensors[0] = device->sensor();
+        detection.num_views = 1;
+        detection.frame_id = device->frameId();
+        detection.detected = true;
+      }
+    }
+    return;
+  }
+  i -= pinhole_vec_.size();
+
+  if (i < kinect_vec_.size())
+  {
+    const KinectDevice::Ptr & device = kinect_vec_[i];
+    if (device->hasNewMessages())
+    {
+      device->convertLastMessages();
+      KinectDevice::Data::Ptr data = device->lastData();
+      ROS_DEBUG_STREAM("[" << device->colorFrameId() << "] analysing image generated at: " << device->lastMessages().image_msg->header.stamp);
+      ROS_DEBUG_STREAM("[" << device->depthFrameId() << "] analysing cloud generated at: " << device->lastMessages().cloud_msg->header.stamp);
+      if (calibration_->analyzeData(device->colorSensor(), device->depthSensor(),
+                                    data->image, data->cloud,
+                                    detection.cb_views[0], detection.cb_views[1]))
+      {
+        detection.sensors[0] = device->colorSensor();
+        detection.sensors[1] = device->depthSensor();
+        detection.num_views = 2;
+        detection.frame_id = device->colorFrameId();
+        detection.detected = true;
+      }
+    }
+    return;
+  }
+  i -= kinect_vec_.size();
+
+  const SwissRangerDevice::Ptr & device = swiss_ranger_vec_[i];
+  if (device->hasNewMessages())
+  {
+    device->convertLastMessages();
+    SwissRangerDevice::Data::Ptr data = device->lastData();
+    ROS_DEBUG_STREAM("[" << device->frameId() << "] analysing image generated at: " << device->lastMessages().intensity_msg->header.stamp);
+    ROS_DEBUG_STREAM("[" << device->frameId() << "] analysing cloud generated at: " << device->lastMessages().cloud_msg->header.stamp);
+    if (calibration_->analyzeData(device->intensitySensor(), device->depthSensor(),
+                                  data->intensity_image, data->cloud,
+                                  detection.cb_views[0], detection.cb_views[1]))
+    {
+      detection.sensors[0] = device->intensitySensor();
+      detection.sensors[1] = device->depthSensor();
+      detection.num_views = 2;
+      detection.frame_id = device->frameId();
+      detection.detected = true;
+    }
+  }
+}
+
 void OPTCalibrationNode::spin()
 {
-  ros::Rate rate(5.0);
+  const size_t num_devices = pinhole_vec_.size() + kinect_vec_.size() + swiss_ranger_vec_.size();
+  std::vector<DeviceDetection> detections(num_devices);
 
   while (ros::ok())
   {
-    ros::spinOnce();
+    waitForMessages();
     calibration_->nextAcquisition();
 
-    int count = 0;
-
-    try
+    // Checkerboard extraction of all the devices in parallel, each one writes only its own detection
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < int(num_devices); ++i)
     {
-#pragma omp parallel for
-      for (size_t i = 0; i < pinhole_vec_.size(); ++i)
+      detections[i].error.clear();
+      try
       {
-        const PinholeRGBDevice::Ptr & device = pinhole_vec_[i];
-        if (device->hasNewMessages())
-        {
-          device->convertLastMessages();
-          PinholeRGBDevice::Data::Ptr data = device->lastData();
-          OPTCalibration::CheckerboardView::Ptr cb_view;
-          ROS_DEBUG_STREAM("[" << device->frameId() << "] analysing image generated at: " << device->lastMessages().image_msg->header.stamp);
-#pragma omp critical
-          if (calibration_->analyzeData(device->sensor(), data->image, cb_view))
-          {
-            calibration_->addData(device->sensor(), cb_view);
-            images_acquired_map_[device->frameId()]++;
-            ROS_INFO_STREAM("[" << device->frameId() << "] checkerboard detected");
-            ++count;
-          }
-        }
+        analyzeDevice(i, detections[i]);
       }
-      for (size_t i = 0; i < kinect_vec_.size(); ++i)
+      catch (cv_bridge::Exception & ex)
       {
-        const KinectDevice::Ptr & device = kinect_vec_[i];
-        if (device->hasNewMessages())
-        {
-          device->convertLastMessages();
-          KinectDevice::Data::Ptr data = device->lastData();
-          OPTCalibration::CheckerboardView::Ptr color_cb_view;
-          OPTCalibration::CheckerboardView::Ptr depth_cb_view;
-          ROS_DEBUG_STREAM("[" << device->colorFrameId() << "] analysing image generated at: " << device->lastMessages().image_msg->header.stamp);
-          ROS_DEBUG_STREAM("[" << device->depthFrameId() << "] analysing cloud generated at: " << device->lastMessages().cloud_msg->header.stamp);
-          if (calibration_->analyzeData(device->colorSensor(), device->depthSensor(),
-                                        data->image, data->cloud,
-                                        color_cb_view, depth_cb_view))
-          {
-            calibration_->addData(device->colorSensor(), color_cb_view);
-            calibration_->addData(device->depthSensor(), depth_cb_view);
-            images_acquired_map_[device->colorFrameId()]++;
-            ROS_INFO_STREAM("[" << device->colorFrameId() << "] checkerboard detected");
-            ++count;
-          }
-        }
+        detections[i].detected = false;
+        detections[i].error = std::string("cv_bridge exception: ") + ex.what();
       }
-      for (size_t i = 0; i < swiss_ranger_vec_.size(); ++i)
+      catch (std::runtime_error & ex)
       {
-        const SwissRangerDevice::Ptr & device = swiss_ranger_vec_[i];
-        if (device->hasNewMessages())
-        {
-          device->convertLastMessages();
-          SwissRangerDevice::Data::Ptr data = device->lastData();
-          OPTCalibration::CheckerboardView::Ptr color_cb_view;
-          OPTCalibration::CheckerboardView::Ptr depth_cb_view;
-          ROS_DEBUG_STREAM("[" << device->frameId() << "] analysing image generated at: " << device->lastMessages().intensity_msg->header.stamp);
-          ROS_DEBUG_STREAM("[" << device->frameId() << "] analysing cloud generated at: " << device->lastMessages().cloud_msg->header.stamp);
-          if (calibration_->analyzeData(device->intensitySensor(), device->depthSensor(),
-                                        data->intensity_image, data->cloud,
-                                        color_cb_view, depth_cb_view))
-          {
-            calibration_->addData(device->intensitySensor(), color_cb_view);
-            calibration_->addData(device->depthSensor(), depth_cb_view);
-            images_acquired_map_[device->frameId()]++;
-            ROS_INFO_STREAM("[" << device->frameId() << "] checkerboard detected");
-            ++count;
-          }
-        }
+        detections[i].detected = false;
+        detections[i].error = std::string("exception: ") + ex.what();
       }
     }
-    catch (cv_bridge::Exception & ex)
-    {
-      ROS_ERROR_STREAM("cv_bridge exception: " << ex.what());
-      return;
-    }
-    catch (std::runtime_error & ex)
+
+    // Serialized insertion of the detections in the calibration graph, in device order
+    int count = 0;
+    for (size_t i = 0; i < num_devices; ++i)
     {
-      ROS_ERROR_STREAM("exception: " << ex.what());
-      return;
+      const DeviceDetection & detection = detections[i];
+      if (not detection.error.empty())
+      {
+        ROS_ERROR_STREAM(detection.error);
+        return;
+      }
+      if (not detection.detected)
+        continue;
+
+      for (int v = 0; v < detection.num_views; ++v)
+        calibration_->addData(detection.sensors[v], detection.cb_views[v]);
+      images_acquired_map_[detection.frame_id]++;
+      ROS_INFO_STREAM("[" << detection.frame_id << "] checkerboard detected");
+      ++count;
     }
 
     status_msg_.header.stamp = ros::Time::now();
@@ -401,8 +471,6 @@ void OPTCalibrationNode::spin()
 
     if (count > 0)
       ROS_INFO("-----------------------------------------------");
-
-    rate.sleep();
   }
 }
 
@@ -38,6 +38,7 @@
 
 #include <ros/ros.h>
 #include <opt_msgs/TrackArray.h>
+#include <opt_msgs/TrackDeltaArray.h>
 #include <opt_msgs/IDArray.h>
 #include <opt_msgs/NameArray.h>
 #include <opt_msgs/SkeletonTrackArray.h>
@@ -133,6 +134,74 @@ trackingCallback(const opt_msgs::TrackArray::ConstPtr& tracking_msg)
 }
 
 
+void
+trackingDeltaCallback(const opt_msgs::TrackDeltaArray::ConstPtr& delta_msg)
+{
+  /// Create JSON-formatted message:
+  Jzon::Object root, header, stamp;
+
+  /// Add header:
+  header.Add("seq", int(delta_msg->header.seq));
+  stamp.Add("sec", int(delta_msg->header.stamp.sec));
+  stamp.Add("nsec", int(delta_msg->header.stamp.nsec));
+  header.Add("stamp", stamp);
+  std::string camera_name = delta_msg->header.frame_id;
+    if (strcmp(camera_name.substr(0,1).c_str(), "/") == 0)  // Remove bar at the beginning
+    {
+      camera_name = camera_name.substr(1, camera_name.size() - 1);
+    }
+  header.Add("frame_id", camera_name);
+  root.Add("header", header);
+  root.Add("keyframe", bool(delta_msg->keyframe));
+
+  /// Add changed tracks:
+  Jzon::Array tracks;
+  for (unsigned int i = 0; i < delta_msg->tracks.size(); i++)
+  {
+    Jzon::Object current_track;
+    current_track.Add("id", delta_msg->tracks[i].id);
+    current_track.Add("x", delta_msg->tracks[i].x);
+    current_track.Add("y", delta_msg->tracks[i].y);
+    current_track.Add("height", delta_msg->tracks[i].height);
+    current_track.Add("age", delta_msg->tracks[i].age);
+    current_track.Add("confidence", delta_msg->tracks[i].confidence);
+
+    tracks.Add(current_track);
+  }
+  root.Add("people_tracks", tracks);
+
+  /// Add removed tracks:
+  Jzon::Array removed_ids;
+  for (unsigned int i = 0; i < delta_msg->removed_ids.size(); i++)
+  {
+    removed_ids.Add(delta_msg->removed_ids[i]);
+  }
+  root.Add("removed_ids", removed_ids);
+
+  /// Convert JSON object to string:
+  Jzon::Format message_format = Jzon::StandardFormat;
+  message_format.indentSize = json_indent_size;
+  message_format.newline = json_newline;
+  message_format.spacing = json_spacing;
+  message_format.useTabs = json_use_tabs;
+  Jzon::Writer writer(root, message_format);
+  writer.Write();
+  std::string json_string = writer.GetResult();
+
+  /// Copy string to message buffer:
+  udp_data.si_num_byte_ = json_string.length()+1;
+  char buf[udp_data.si_num_byte_];
+  for (unsigned int i = 0; i < udp_data.si_num_byte_; i++)
+  {
+    buf[i] = 0;
+  }
+  sprintf(buf, "%s", json_string.c_str());
+  udp_data.pc_pck_ = buf;         // buffer where the message is written
+
+  /// Send message:
+  udp_messaging.sendFromSocketUDP(&udp_data);
+}
+
 void peopleTracksCallback(const opt_msgs::TrackArray::ConstPtr& association_message)
 {
   Jzon::Array tracks;
@@ -315,9 +384,11 @@ main(int argc, char **argv)
 
   facetracksflag = 0;
 
-  // ROS subscriber:
+  // ROS subscribers (nh is private: the topics are ~input_topic, ~delta_topic, ... and are remapped in the launch file):
   ros::Subscriber tracking_sub = nh.subscribe<opt_msgs::TrackArray>
       ("input_topic", 1, trackingCallback);
+  ros::Subscriber tracking_delta_sub = nh.subscribe<opt_msgs::TrackDeltaArray>
+      ("delta_topic", 1, trackingDeltaCallback);
   ros::Subscriber alive_ids_sub = nh.subscribe<opt_msgs::IDArray>
       ("alive_ids_topic", 1, aliveIDsCallback);
   ros::Subscriber people_tracks_sub = nh.subscribe<opt_msgs::TrackArray>("people_tracks_topic", 1, peopleTracksCallback);
@@ -0,0 +1,115 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2013-, Open Perception, Inc.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ * with the distribution.
+ * * Neither the name of the copyright holder(s) nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef OPEN_PTRACK_OPT_UTILS_DEPTH_STATISTICS_H_
+#define OPEN_PTRACK_OPT_UTILS_DEPTH_STATISTICS_H_
+
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+namespace open_ptrack
+{
+  namespace opt_utils
+  {
+    /**
+     * \brief DepthStatistics computes a robust depth of an image box.
+     *
+     * The box is sampled on a regular grid of at most max_samples points and the valid depths
+     * (in [min_depth, max_depth)) are counted in a histogram with bins of resolution meters.
+     * Median and trimmed mean are read from the histogram, so their error is below resolution.
+     * The histogram is allocated once, so boxes are processed without allocations.
+     * An object is not thread safe: use one per thread.
+     */
+    class DepthStatistics
+    {
+      public:
+
+        /** \brief Depth statistics of a box. */
+        struct Result
+        {
+          float median;         // median of the valid depths (meters)
+          float trimmed_mean;   // mean of the valid depths between the trim and 1 - trim quantiles (meters)
+          float valid_ratio;    // valid samples / samples
+          int samples;          // samples taken in the box
+        };
+
+        /**
+         * \brief Constructor.
+         *
+         * \param[in] min_depth Minimum valid depth (meters), smaller depths (e.g. 0, no measure) are ignored.
+         * \param[in] max_depth Maximum valid depth (meters).
+         * \param[in] resolution Width of the histogram bins (meters).
+         * \param[in] max_samples Maximum number of samples per box, 0 to use all the pixels.
+         * \param[in] trim Fraction of the samples discarded at each end by the trimmed mean.
+         */
+        DepthStatistics(float min_depth = 0.2f, float max_depth = 10.0f, float resolution = 0.01f,
+                        int max_samples = 1024, float trim = 0.2f);
+
+        /**
+         * \brief Compute the depth statistics of a box.
+         *
+         * \param[in] depth Depth image, CV_16UC1 or CV_32FC1.
+         * \param[in] box Box in the image, clipped to the image.
+         * \param[in] depth_scale Meters per unit of depth (e.g. 0.001 for millimeters).
+         * \param[out] result Statistics of the box.
+         *
+         * \return false if the box has no valid depth.
+         */
+        bool
+        compute(const cv::Mat& depth, const cv::Rect& box, float depth_scale, Result& result);
+
+      private:
+
+        template <typename T> void
+        accumulate(const cv::Mat& depth, const cv::Rect& box, int step, float depth_scale, int& samples, int& valid);
+
+        /** \brief Depth of the sample of rank r in the histogram. */
+        float
+        quantile(float r) const;
+
+        float min_depth_;
+        float max_depth_;
+        float resolution_;
+        int max_samples_;
+        float trim_;
+
+        std::vector<int> histogram_;
+        int first_bin_;   // range of the non empty bins
+        int last_bin_;
+    };
+  } /* namespace opt_utils */
+} /* namespace open_ptrack */
+#endif /* OPEN_PTRACK_OPT_UTILS_DEPTH_STATISTICS_H_ */
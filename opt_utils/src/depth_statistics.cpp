@@ -0,0 +1,138 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2013-, Open Perception, Inc.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ * with the distribution.
+ * * Neither the name of the copyright holder(s) nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <open_ptrack/opt_utils/depth_statistics.h>
+#include <algorithm>
+#include <cmath>
+
+namespace open_ptrack
+{
+  namespace opt_utils
+  {
+    DepthStatistics::DepthStatistics(float min_depth, float max_depth, float resolution,
+                                     int max_samples, float trim) :
+      min_depth_(min_depth), max_depth_(max_depth), resolution_(resolution),
+      max_samples_(max_samples), trim_(std::min(std::max(trim, 0.0f), 0.49f))
+    {
+      histogram_.assign(std::ceil((max_depth_ - min_depth_) / resolution_) + 1, 0);
+      first_bin_ = histogram_.size();
+      last_bin_ = -1;
+    }
+
+    template <typename T> void
+    DepthStatistics::accumulate(const cv::Mat& depth, const cv::Rect& box, int step, float depth_scale, int& samples, int& valid)
+    {
+      const int last = histogram_.size() - 1;
+      for (int y = box.y + step / 2; y < box.y + box.height; y += step)
+      {
+        const T* row = depth.ptr<T>(y);
+        for (int x = box.x + step / 2; x < box.x + box.width; x += step)
+        {
+          float d = row[x] * depth_scale;
+          samples++;
+          if (!(d >= min_depth_ && d < max_depth_))   // also NaN
+            continue;
+
+          int bin = std::min(int((d - min_depth_) / resolution_), last);
+          histogram_[bin]++;
+          first_bin_ = std::min(first_bin_, bin);
+          last_bin_ = std::max(last_bin_, bin);
+          valid++;
+        }
+      }
+    }
+
+    float
+    DepthStatistics::quantile(float r) const
+    {
+      int count = 0;
+      for (int bin = first_bin_; bin <= last_bin_; bin++)
+      {
+        int h = histogram_[bin];
+        if (count + h > r)   // linear inside the bin
+          return min_depth_ + (bin + (r - count) / h) * resolution_;
+        count += h;
+      }
+      return min_depth_ + (last_bin_ + 1) * resolution_;
+    }
+
+    bool
+    DepthStatistics::compute(const cv::Mat& depth, const cv::Rect& box, float depth_scale, Result& result)
+    {
+      cv::Rect roi = box & cv::Rect(0, 0, depth.cols, depth.rows);
+      result.samples = 0;
+      result.valid_ratio = 0;
+      if (roi.area() == 0)
+        return false;
+
+      // grid step giving at most max_samples_ samples
+      int step = 1;
+      if (max_samples_ > 0 && roi.area() > max_samples_)
+        step = std::ceil(std::sqrt(roi.area() / float(max_samples_)));
+
+      int valid = 0;
+      if (depth.type() == CV_16UC1)
+        accumulate<unsigned short>(depth, roi, step, depth_scale, result.samples, valid);
+      else if (depth.type() == CV_32FC1)
+        accumulate<float>(depth, roi, step, depth_scale, result.samples, valid);
+      result.valid_ratio = result.samples > 0 ? valid / float(result.samples) : 0;
+      if (valid == 0)
+        return false;
+
+      result.median = quantile(0.5f * valid);
+
+      // mean of the part of every bin between the ranks lo and hi, at the bin center
+      float lo = trim_ * valid;
+      float hi = valid - lo;
+      double sum = 0;
+      int count = 0;
+      for (int bin = first_bin_; bin <= last_bin_; bin++)
+      {
+        int h = histogram_[bin];
+        float inside = std::min<float>(count + h, hi) - std::max<float>(count, lo);
+        if (inside > 0)
+          sum += inside * (bin + 0.5f);
+        count += h;
+      }
+      result.trimmed_mean = min_depth_ + sum / (hi - lo) * resolution_;
+
+      std::fill(histogram_.begin() + first_bin_, histogram_.begin() + last_bin_ + 1, 0);
+      first_bin_ = histogram_.size();
+      last_bin_ = -1;
+      return true;
+    }
+  } /* namespace opt_utils */
+} /* namespace open_ptrack */
@@ -26,6 +26,7 @@
 #include <recognition/OPTSaveRegisteredFaces.h>
 #include <recognition/OPTLoadRegisteredFaces.h>
 
+#include <open_ptrack/recognition/face_registry.hpp>
 #include <open_ptrack/recognition/face_recognizer.hpp>
 #include <open_ptrack/recognition/nn/face_recognizer_nn.hpp>
 #include <open_ptrack/recognition/bayes/face_recognizer_bayes.hpp>
@@ -63,6 +64,22 @@ public:
     seq.registerCallback(boost::bind(&FaceRecognitionNode::face_sequenced_callback, this, _1));
 
     names_seq_num = 0;
+
+    // the registry is restored at startup and then saved periodically
+    ros::NodeHandle private_nh("~");
+    double checkpoint_interval;
+    private_nh.param<std::string>("registry_path", registry_path, "");
+    private_nh.param("registry_checkpoint_interval", checkpoint_interval, 60.0);
+    if(!registry_path.empty()) {
+      std::vector<RegisteredFace::Ptr> faces;
+      if(FaceRegistry::isRegistryFile(registry_path) && checkpoint_registry.load(registry_path, faces)) {
+        std::cout << "loaded " << faces.size() << " faces from " << registry_path << std::endl;
+        recognizer->registerFaces(faces);
+      }
+      if(checkpoint_interval > 0.0) {
+        checkpoint_timer = nh.createTimer(ros::Duration(checkpoint_interval), &FaceRecognitionNode::checkpoint, this);
+      }
+    }
   }
 
 private:
@@ -227,43 +244,67 @@ if (count > 0) { //jb
     return true;
   }
 
+  /**
+   * @brief saves the registered faces to the registry file
+   *        this method is called by a timer function, and only the faces modified since the last save are appended
+   * @param e  time callback argument
+   */
+  void checkpoint(const ros::TimerEvent& e) {
+    std::lock_guard<std::mutex> lock(recognizer_mutex);
+    auto faces = recognizer->getRegisteredFaces();
+    if(!faces.empty()) {
+      checkpoint_registry.save(registry_path, faces);
+    }
+  }
+
+  /**
+   * @brief saves the registered faces to a binary registry file
+   * @param req  the file path
+   * @param res  the status
+   * @return true
+   */
   bool save_registered_faces(recognition::OPTSaveRegisteredFaces::Request& req, recognition::OPTSaveRegisteredFaces::Response& res) {
     std::lock_guard<std::mutex> lock(recognizer_mutex);
     std::cout << "--- save_regitered_faces ---" << std::endl;
 
     auto faces = recognizer->getRegisteredFaces();
+    res.status = registry.save(req.path, faces) ? res.STATUS_OK : res.STATUS_ERROR;
+    return true;
+  }
 
-    std::ofstream ofs(req.path);
-    if(!ofs) {
-      std::cerr << "error : failed to open the file!!" << std::endl;
-      std::cerr << "      : " << req.path << std::endl;
+  /**
+   * @brief loads registered faces from a binary registry file or from a text file of the former format
+   * @param req  the file path
+   * @param res  the status
+   * @return true
+   */
+  bool load_registered_faces(recognition::OPTLoadRegisteredFaces::Request& req, recognition::OPTLoadRegisteredFaces::Response& res) {
+    std::cout << "--- load_regitered_faces ---" << std::endl;
+    std::vector<RegisteredFace::Ptr> faces;
+    bool loaded = FaceRegistry::isRegistryFile(req.path) ? registry.load(req.path, faces) : load_text_registered_faces(req.path, faces);
+    if(!loaded || faces.empty()) {
       res.status = res.STATUS_ERROR;
       return true;
     }
 
-    ofs << "num_faces " << faces.size() << std::endl;
-    ofs << "face_id num_features" << std::endl;
-    for(const auto& face : faces) {
-      ofs << face->getFaceId() << " " << face->getFaces().size() << std::endl;
-    }
-    ofs << "features" << std::endl;
-    for(const auto& face : faces) {
-      for(const auto& feature : face->getFaces()) {
-        ofs << feature.transpose() << std::endl;
-      }
-    }
-
+    std::lock_guard<std::mutex> lock(recognizer_mutex);
+    recognizer->registerFaces(faces);
+    res.status = res.STATUS_OK;
     return true;
   }
 
-  bool load_registered_faces(recognition::OPTLoadRegisteredFaces::Request& req, recognition::OPTLoadRegisteredFaces::Response& res) {
-    std::cout << "--- load_regitered_faces ---" << std::endl;
-    std::ifstream ifs(req.path);
+  /**
+   * @brief loads registered faces from a text file
+   * @param path   the file path
+   * @param faces  [out] loaded faces
+   * @return true if succeeded
+   */
+  bool load_text_registered_faces(const std::string& path, std::vector<RegisteredFace::Ptr>& faces) {
+    std::ifstream ifs(path);
     if(!ifs) {
       std::cerr << "error : failed to open the file!!" << std::endl;
-      std::cerr << "      : " << req.path << std::endl;
-      res.status = res.STATUS_ERROR;
-      return true;
+      std::cerr << "      : " << path << std::endl;
+      return false;
     }
 
     std::string token;
@@ -275,32 +316,29 @@ if (count > 0) { //jb
 
     if(num_faces == 0) {
       std::cerr << "empty!!" << std::endl;
-      res.status = res.STATUS_ERROR;
-      return true;
+      return false;
     }
 
-    std::vector<RegisteredFace::Ptr> faces(num_faces);
-    for(auto& face : faces) {
-      int face_id, num_features;
-      ifs >> face_id >> num_features;
-      std::cout << face_id << " " << num_features << std::endl;
+    faces.resize(num_faces);
+    std::vector<int> num_features(num_faces);
+    for(int i=0; i<num_faces; i++) {
+      int face_id;
+      ifs >> face_id >> num_features[i];
+      std::cout << face_id << " " << num_features[i] << std::endl;
 
-      face.reset(new RegisteredFace(face_id));
-      face->getFaces().resize(num_features);
+      faces[i].reset(new RegisteredFace(face_id));
     }
 
     ifs >> token;   // ignore "features"
-    for(auto& face : faces) {
-      for(auto& feature : face->getFaces()) {
-        feature.resize(128);
-        for(int i=0; i<feature.size(); i++) {
-          ifs >> feature[i];
+    Eigen::VectorXf feature(128);
+    for(int i=0; i<num_faces; i++) {
+      for(int j=0; j<num_features[i]; j++) {
+        for(int k=0; k<feature.size(); k++) {
+          ifs >> feature[k];
         }
+        faces[i]->addFace(feature);
       }
     }
-
-    std::lock_guard<std::mutex> lock(recognizer_mutex);
-    recognizer->registerFaces(faces);
     return true;
   }
 
@@ -309,6 +347,11 @@ private:
   std::mutex recognizer_mutex;
   std::unique_ptr<FaceRecognizer> recognizer;
 
+  // face registries
+  FaceRegistry registry;                // the registry saved and loaded by the services
+  FaceRegistry checkpoint_registry;     // the registry restored at startup and saved periodically
+  std::string registry_path;
+
   // ROS
   ros::ServiceServer set_predefined_faces_service;
   ros::ServiceServer save_registered_faces_service;
@@ -318,6 +361,7 @@ private:
   ros::Publisher track_pub;
   ros::Publisher names_pub;
   ros::Timer names_pub_timer;
+  ros::Timer checkpoint_timer;
 
   ros::Subscriber track_sub;
   ros::Subscriber alive_ids_sub;
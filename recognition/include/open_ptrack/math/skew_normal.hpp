@@ -20,6 +20,23 @@ inline double skew_normal_distribution(double alpha, double zeta, double omega,
   return 2.0 / omega * phi * PHI;
 }
 
+/**
+ * @brief the logarithm of the probability density function of a skew normal distribution
+ *        it does not underflow in the tails as the logarithm of #skew_normal_distribution does
+ * @param alpha  skewness
+ * @param zeta   location (mean)
+ * @param omega  scale (variance)
+ * @param x      variable
+ * @return the log probability density
+ */
+inline double skew_normal_log_distribution(double alpha, double zeta, double omega, double x) {
+  x = (x - zeta) / omega;
+
+  double log_phi = -0.5 * log(2.0 * M_PI) - x*x / 2.0;
+  double PHI = 1.0 / 2.0 * erfc(-alpha * x / M_SQRT2);
+  return log(2.0 / omega) + log_phi + log(PHI);
+}
+
 /**
  * @brief The SkewNormalDistribution class
  */
@@ -39,6 +56,10 @@ public:
     return skew_normal_distribution(alpha, zeta, omega, x);
   }
 
+  double logProb(double x) const {
+    return skew_normal_log_distribution(alpha, zeta, omega, x);
+  }
+
   double operator() (double x) const {
     return prob(x);
   }
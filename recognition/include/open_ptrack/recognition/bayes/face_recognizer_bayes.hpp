@@ -19,9 +19,15 @@ public:
     pos_pdf.reset(new SkewNormalDistribution(2.09329546, 0.51549199, 0.28795632));
     neg_pdf.reset(new SkewNormalDistribution(-3.13951689, 1.54745462, 0.28095953));
 
+    gallery_dirty = true;
+
     count_thresh = 3;
     posterior_thresh = 0.95;
     neg_pdf_scale = 1.0;
+
+    feature_policy = RegisteredFace::DIVERSITY;
+    max_features_per_face = 128;
+    prototype_rate = 0.1;
   }
   ~FaceRecognizerBayes() {}
 
@@ -75,35 +81,30 @@ public:
     std::transform(tracker_status_map.begin(), tracker_status_map.end(), trackers.begin(),
       [=](const std::pair<int, TrackerStatusBayes::Ptr>& p) { return p.second; }
     );
-
-    // create tables of observation counts and probabilities
-    auto tables = createCountProbabilityTables(trackers, unassociated_faces, face_ids);
-    Eigen::MatrixXi& count_table = tables.first;
-    Eigen::MatrixXd& prob_table = tables.second;
-
-    for(const auto& fset: fmap) {
-      int tracker_id = fset.first;
-      auto tracker = std::find_if(trackers.begin(), trackers.end(), [=](const TrackerStatusBayes::Ptr& t) { return t->getTrackerId() == tracker_id; });
-      if(tracker == trackers.end()) {
-        continue;
+    std::sort(trackers.begin(), trackers.end(),
+      [=](const TrackerStatusBayes::Ptr& lhs, const TrackerStatusBayes::Ptr& rhs) {
+        return lhs->getTrackerId() < rhs->getTrackerId();
       }
-
-      int row = std::distance(trackers.begin(), tracker) + 1;
-      for(int i=0; i<unassociated_faces.size(); i++) {
-        std::vector<double> dists = unassociated_faces[i]->calcDistances(fset.second);
-        for(double dist : dists) {
-          Eigen::ArrayXd likelihoods = Eigen::ArrayXd::Ones(unassociated_faces.size() + 1);
-          likelihoods[0] = neg_pdf_scale;
-          likelihoods *= (*neg_pdf)(dist);
-          likelihoods[i+1] = (*pos_pdf)(dist);
-
-          prob_table.row(row).array() *= likelihoods;
-        }
-      }
-      count_table.row(row).array() += fset.second.size();
+    );
+    std::vector<int> tracker_ids(trackers.size());
+    std::transform(trackers.begin(), trackers.end(), tracker_ids.begin(), [=](const TrackerStatusBayes::Ptr& t) { return t->getTrackerId(); });
+
+    // the tables of the last update already hold the priors unless trackers or faces have been added or removed
+    if(tracker_ids != table_tracker_ids || face_ids.size() != table_face_ids.size() || face_ids != table_face_ids) {
+      auto tables = createCountProbabilityTables(trackers, unassociated_faces, face_ids);
+      count_table = tables.first;
+      prob_table = tables.second;
+      table_tracker_ids = tracker_ids;
+      table_face_ids = face_ids;
+      gallery_dirty = true;
+    }
+    if(gallery_dirty) {
+      buildGallery();
     }
 
+    updateLikelihoods(fmap, tracker_ids);
 
+    // the table is warm-started from the previous posteriors, so it converges in a few iterations when only a few rows changed
     shinkhornNormalization(prob_table);
 
     // update the probabilities of the faces and the trackers
@@ -134,11 +135,18 @@ public:
       if(std::get<1>(assoc) == 0) {
         std::cout << "new person!!" << std::endl;
         auto face = RegisteredFaceBayes::Ptr(new RegisteredFaceBayes(face_id_source++, tracker->getTrackerId()));
+        face->setFeaturePolicy(feature_policy, max_features_per_face, prototype_rate);
         associated_faces[tracker->getTrackerId()] = face;
       } else {
         std::cout << "known person!!" << std::endl;
-        associated_faces[tracker->getTrackerId()] = unassociated_faces[std::get<1>(assoc) - 1];
-        unassociated_faces.erase(unassociated_faces.begin() + std::get<1>(assoc) - 1);
+        // look the face up by id since the faces associated before have been erased from the list
+        int face_id = face_ids[std::get<1>(assoc)];
+        auto found_face = std::find_if(unassociated_faces.begin(), unassociated_faces.end(), [=](const RegisteredFaceBayes::Ptr& f) { return f->getFaceId() == face_id; });
+        if(found_face == unassociated_faces.end()) {
+          continue;
+        }
+        associated_faces[tracker->getTrackerId()] = *found_face;
+        unassociated_faces.erase(found_face);
       }
       auto& face = associated_faces[tracker->getTrackerId()];
       for(const auto& feature : tracker->getFeatures()) {
@@ -292,12 +300,14 @@ public:
       if (found_unassocitead != unassociated_faces.end()) {
         std::cerr << "warning : face_id(" << face->getFaceId() << ") is already registered" << std::endl;
         (*found_unassocitead)->addFaces(face);
+        gallery_dirty = true;
         continue;
       }
 
       // the face_id has not been registered
       std::cout << "register face_id(" << face->getFaceId() << ")" << std::endl;
       RegisteredFaceBayes::Ptr new_face(new RegisteredFaceBayes(face->getFaceId()));
+      new_face->setFeaturePolicy(feature_policy, max_features_per_face, prototype_rate);
       new_face->addFaces(face);
       unassociated_faces.push_back(new_face);
 
@@ -326,9 +336,118 @@ public:
     neg_pdf_scale = config.neg_pdf_scale;
     count_thresh = config.num_observations_threshold;
     posterior_thresh = config.posterior_threshold;
+
+    feature_policy = static_cast<RegisteredFace::FeaturePolicy>(config.feature_policy);
+    max_features_per_face = config.max_features_per_face;
+    prototype_rate = config.prototype_rate;
+    for(const auto& face : associated_faces) {
+      face.second->setFeaturePolicy(feature_policy, max_features_per_face, prototype_rate);
+    }
+    for(const auto& face : unassociated_faces) {
+      face->setFeaturePolicy(feature_policy, max_features_per_face, prototype_rate);
+    }
+    gallery_dirty = true;
   }
 
 private:  
+  /**
+   * @brief stacks the features of the unassociated faces into a single matrix
+   */
+  void buildGallery() {
+    int num_features = 0;
+    int dim = 0;
+    gallery_offsets.resize(unassociated_faces.size() + 1);
+    for(int i=0; i<unassociated_faces.size(); i++) {
+      gallery_offsets[i] = num_features;
+      num_features += unassociated_faces[i]->size();
+      if(unassociated_faces[i]->size()) {
+        dim = unassociated_faces[i]->getFaces().rows();
+      }
+    }
+    gallery_offsets.back() = num_features;
+
+    gallery.resize(dim, num_features);
+    for(int i=0; i<unassociated_faces.size(); i++) {
+      gallery.middleCols(gallery_offsets[i], unassociated_faces[i]->size()) = unassociated_faces[i]->getFaces();
+    }
+    gallery_norms = gallery.colwise().squaredNorm().transpose();
+    gallery_dirty = false;
+  }
+
+  /**
+   * @brief multiplies the rows of the trackers which received new features by their likelihoods
+   *        the distances between all the new features and all the gallery features are given by a single matrix product.
+   *        the likelihoods are accumulated as log-likelihood ratios against the negative pdf, which only scales each row by a constant
+   *        that the row normalization removes
+   * @param fmap         tracker ids and new feature vectors
+   * @param tracker_ids  tracker ids of the table rows
+   */
+  void updateLikelihoods(const std::unordered_map<int, std::vector<std::shared_ptr<Eigen::VectorXf>>>& fmap, const std::vector<int>& tracker_ids) {
+    // rows, first columns and numbers of the new features of each tracker in the table
+    std::vector<std::tuple<int, int, int>> segments;
+    int num_features = 0;
+    for(const auto& fset : fmap) {
+      auto tracker = std::lower_bound(tracker_ids.begin(), tracker_ids.end(), fset.first);
+      if(tracker == tracker_ids.end() || *tracker != fset.first || fset.second.empty()) {
+        continue;
+      }
+      segments.push_back(std::make_tuple(std::distance(tracker_ids.begin(), tracker) + 1, num_features, fset.second.size()));
+      num_features += fset.second.size();
+    }
+
+    if(num_features == 0) {
+      return;
+    }
+
+    const int num_faces = unassociated_faces.size();
+    Eigen::MatrixXd log_ratios(num_faces, num_features);
+    if(num_faces) {
+      Eigen::MatrixXf queries(gallery.rows(), num_features);
+      for(const auto& segment : segments) {
+        const auto& features = fmap.at(tracker_ids[std::get<0>(segment) - 1]);
+        for(int i=0; i<features.size(); i++) {
+          if(features[i]->size() != gallery.rows()) {
+            std::cerr << "warning : the feature dimension does not match the registered faces!!" << std::endl;
+            return;
+          }
+          queries.col(std::get<1>(segment) + i) = *features[i];
+        }
+      }
+
+      // |f - q|^2 = |f|^2 - 2 f.q + |q|^2
+      Eigen::MatrixXf dists = -2.0f * (gallery.transpose() * queries);
+      dists.colwise() += gallery_norms;
+      dists.rowwise() += queries.colwise().squaredNorm();
+
+      for(int i=0; i<num_faces; i++) {
+        int face_size = gallery_offsets[i + 1] - gallery_offsets[i];
+        if(face_size == 0) {
+          log_ratios.row(i).setZero();
+          continue;
+        }
+
+        Eigen::VectorXf min_dists = dists.middleRows(gallery_offsets[i], face_size).colwise().minCoeff();
+        for(int j=0; j<num_features; j++) {
+          double dist = std::sqrt(std::max(0.0f, min_dists[j]));
+          log_ratios(i, j) = pos_pdf->logProb(dist) - neg_pdf->logProb(dist);
+        }
+      }
+    }
+
+    for(const auto& segment : segments) {
+      int row = std::get<0>(segment);
+      int n = std::get<2>(segment);
+      if(num_faces) {
+        Eigen::ArrayXd log_likelihoods(num_faces + 1);
+        log_likelihoods[0] = num_faces * n * std::log(neg_pdf_scale);
+        log_likelihoods.tail(num_faces) = log_ratios.middleCols(std::get<1>(segment), n).rowwise().sum();
+
+        prob_table.row(row).array() *= (log_likelihoods - log_likelihoods.maxCoeff()).exp().transpose();
+      }
+      count_table.row(row).array() += n;
+    }
+  }
+
   std::pair<Eigen::MatrixXi, Eigen::MatrixXd> createCountProbabilityTables(const std::vector<TrackerStatusBayes::Ptr>& trackers, const std::vector<RegisteredFaceBayes::Ptr>& faces, const Eigen::VectorXi& face_ids) {
     std::pair<Eigen::MatrixXi, Eigen::MatrixXd> tables;
     Eigen::MatrixXi& count_table = tables.first;
@@ -350,21 +469,18 @@ private:
   }
 
   void shinkhornNormalization(Eigen::MatrixXd& prob_table) const {
+    auto tracker_rows = prob_table.bottomRows(prob_table.rows() - 1);
+    auto face_cols = prob_table.rightCols(prob_table.cols() - 1);
+
     bool converged = false;
     for(int i=0; i<10 && !converged; i++){
-      converged = true;
-      for(int i=1; i<prob_table.rows(); i++) {
-        double sum = prob_table.row(i).sum();
-        prob_table.row(i) /= sum;
+      Eigen::ArrayXd row_sums = tracker_rows.rowwise().sum();
+      tracker_rows.array().colwise() /= row_sums;
 
-        converged = converged & std::abs(1 - sum) < 1e-3;
-      }
-      for(int i=1; i<prob_table.cols(); i++) {
-        double sum = prob_table.col(i).sum();
-        prob_table.col(i) /= sum;
+      Eigen::ArrayXd col_sums = face_cols.colwise().sum().transpose();
+      face_cols.array().rowwise() /= col_sums.transpose();
 
-        converged = converged & std::abs(1 - sum) < 1e-3;
-      }
+      converged = ((1.0 - row_sums).abs() < 1e-3).all() && ((1.0 - col_sums).abs() < 1e-3).all();
     }
     prob_table = prob_table.array().max(1e-3).min(1.0 - 1e-3);
   }
@@ -375,6 +491,16 @@ private:
   std::vector<RegisteredFaceBayes::Ptr> unassociated_faces;
   std::unordered_map<int, RegisteredFaceBayes::Ptr> associated_faces;
 
+  std::vector<int> table_tracker_ids;   // tracker ids of the rows of the tables (the first row is for the faces)
+  Eigen::VectorXi table_face_ids;       // face ids of the columns of the tables (-1 for a new face)
+  Eigen::MatrixXi count_table;          // the numbers of observations of each tracker and face
+  Eigen::MatrixXd prob_table;           // the association probabilities of each tracker and face
+
+  Eigen::MatrixXf gallery;              // features of the unassociated faces (one per column)
+  Eigen::VectorXf gallery_norms;        // squared norms of the gallery features
+  std::vector<int> gallery_offsets;     // the first gallery column of each unassociated face
+  bool gallery_dirty;                   // the gallery must be built again
+
   std::vector<RegisteredFace::Ptr> unassociated_predefined_faces;
   std::unordered_map<int, RegisteredFace::Ptr> associated_predefined_faces;
 
@@ -384,6 +510,10 @@ private:
 
   int count_thresh;           // the minimum number of observations for face_id establishment
   double posterior_thresh;    // the minimum posterior probability for face_id establishment
+
+  RegisteredFace::FeaturePolicy feature_policy;   // the update policy of the full feature lists
+  int max_features_per_face;                      // the maximum number of features kept for each face
+  double prototype_rate;                          // the weight of a new feature with the MOVING_PROTOTYPE policy
 };
 
 #endif // FACE_RECOGNIZER_BAYES_HPP
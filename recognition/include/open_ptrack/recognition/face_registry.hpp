@@ -0,0 +1,391 @@
+#ifndef FACE_REGISTRY_HPP
+#define FACE_REGISTRY_HPP
+
+#include <tuple>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <Eigen/Dense>
+
+#include "open_ptrack/recognition/registered_face.hpp"
+
+/**
+ * @brief binary registry file of registered faces
+ *        the file is a header followed by a sequence of segments, each one appended by a save:
+ *          file header    : magic "OPTFACES", version, feature dimension
+ *          segment header : magic "FSEG", numbers of faces and features, size of the names table, offsets
+ *          face table     : face_id, first feature, number of features and name of each face in the segment
+ *          names table    : the names of the faces (not null-terminated)
+ *          feature block  : contiguous float32 features (one per column), aligned to 16 bytes
+ *        a face in a later segment replaces the same face_id in the earlier ones, so that a save only appends the faces
+ *        modified since the last one (a face is identified by its face_id, and compared by name, number and checksum of features). the file is rewritten from scratch when the replaced features outnumber the valid ones.
+ *        the file is mapped in memory to be loaded, and a truncated last segment (e.g., interrupted save) is ignored.
+ *        a segment whose tables point outside the file is corrupted, and the file is rejected.
+ *        all the values are stored in the native (little-endian) byte order
+ */
+class FaceRegistry {
+public:
+  static const uint32_t VERSION = 1;
+
+  FaceRegistry()
+    : file_size(0),
+      file_dim(0),
+      num_valid_features(0),
+      num_replaced_features(0)
+  {}
+
+  /**
+   * @brief checks if a file is a face registry
+   * @param path  file path
+   * @return true if the file begins with the registry magic
+   */
+  static bool isRegistryFile(const std::string& path) {
+    std::ifstream ifs(path, std::ios::binary);
+    FileHeader header;
+    return ifs.read(reinterpret_cast<char*>(&header), sizeof(header)) && std::memcmp(header.magic, fileMagic(), sizeof(header.magic)) == 0;
+  }
+
+  /**
+   * @brief saves faces to a registry file
+   *        if the file is the one last saved or loaded by this registry, only the faces modified since then are appended
+   * @param path   file path
+   * @param faces  faces to be saved
+   * @return true if succeeded
+   */
+  bool save(const std::string& path, const std::vector<RegisteredFace::Ptr>& faces) {
+    int dim = 0;
+    for(const auto& face : faces) {
+      if(face->size()) {
+        dim = face->getFaces().rows();
+      }
+    }
+
+    std::vector<RegisteredFace::Ptr> modified;
+    int num_modified_features = 0;
+    int num_replaced = 0;
+    for(const auto& face : faces) {
+      auto saved = saved_faces.find(face->getFaceId());
+      if(saved != saved_faces.end() && saved->second.num_features == face->size() && saved->second.name == face->getName() && saved->second.checksum == checksum(*face)) {
+        continue;
+      }
+      modified.push_back(face);
+      num_modified_features += face->size();
+      if(saved != saved_faces.end()) {
+        num_replaced += saved->second.num_features;
+      }
+    }
+
+    bool append = path == file_path && dim == file_dim && fileSize(path) == static_cast<long>(file_size);
+    if(append && modified.empty()) {
+      return true;
+    }
+    if(!append || num_replaced_features + num_replaced > num_valid_features - num_replaced + num_modified_features) {
+      return rewrite(path, faces, dim);
+    }
+
+    std::ofstream ofs(path, std::ios::binary | std::ios::app);
+    if(!ofs || !writeSegment(ofs, modified, dim)) {
+      std::cerr << "error : failed to append to the registry!!" << std::endl;
+      std::cerr << "      : " << path << std::endl;
+      return false;
+    }
+
+    num_valid_features += num_modified_features - num_replaced;
+    num_replaced_features += num_replaced;
+    for(const auto& face : modified) {
+      remember(face);
+    }
+    return true;
+  }
+
+  /**
+   * @brief loads faces from a registry file
+   * @param path   file path
+   * @param faces  [out] loaded faces
+   * @return true if succeeded
+   */
+  bool load(const std::string& path, std::vector<RegisteredFace::Ptr>& faces) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+      std::cerr << "error : failed to open the registry!!" << std::endl;
+      std::cerr << "      : " << path << std::endl;
+      return false;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(FileHeader))) {
+      std::cerr << "error : invalid registry!!" << std::endl;
+      close(fd);
+      return false;
+    }
+
+    size_t size = st.st_size;
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED) {
+      std::cerr << "error : failed to map the registry!!" << std::endl;
+      return false;
+    }
+
+    const char* data = static_cast<const char*>(mapped);
+    const FileHeader* header = reinterpret_cast<const FileHeader*>(data);
+    if(std::memcmp(header->magic, fileMagic(), sizeof(header->magic)) != 0 || header->version != VERSION) {
+      std::cerr << "error : unsupported registry format!!" << std::endl;
+      munmap(mapped, size);
+      return false;
+    }
+
+    // the latest entry, features and names table of each face
+    std::unordered_map<int, std::tuple<const FaceEntry*, const float*, const char*>> latest;
+    std::vector<int> order;
+    size_t offset = sizeof(FileHeader);
+    num_replaced_features = 0;
+    while(offset + sizeof(SegmentHeader) <= size) {
+      const SegmentHeader* segment = reinterpret_cast<const SegmentHeader*>(data + offset);
+      if(std::memcmp(segment->magic, segmentMagic(), sizeof(segment->magic)) != 0 || segment->segment_size < sizeof(SegmentHeader) || segment->segment_size > size - offset) {
+        std::cerr << "warning : ignored a truncated registry segment" << std::endl;
+        break;
+      }
+
+      // the tables and the feature block must lie in the segment, and the entries in the tables
+      size_t segment_end = offset + segment->segment_size;
+      size_t names_offset = offset + sizeof(SegmentHeader) + static_cast<size_t>(segment->num_faces) * sizeof(FaceEntry);
+      size_t feature_size = header->feature_dim * sizeof(float);
+      bool valid = names_offset + segment->names_size <= segment->features_offset && segment->features_offset <= segment_end
+        && segment->features_offset % sizeof(float) == 0
+        && (feature_size == 0 || segment->num_features <= (segment_end - segment->features_offset) / feature_size);
+      const FaceEntry* entries = reinterpret_cast<const FaceEntry*>(data + offset + sizeof(SegmentHeader));
+      for(uint32_t i=0; valid && i<segment->num_faces; i++) {
+        valid = static_cast<uint64_t>(entries[i].first_feature) + entries[i].num_features <= segment->num_features
+          && static_cast<uint64_t>(entries[i].name_offset) + entries[i].name_size <= segment->names_size;
+      }
+      if(!valid) {
+        std::cerr << "error : corrupted registry segment!!" << std::endl;
+        std::cerr << "      : " << path << std::endl;
+        munmap(mapped, size);
+        return false;
+      }
+
+      const char* names = data + names_offset;
+      const float* features = reinterpret_cast<const float*>(data + segment->features_offset);
+      for(uint32_t i=0; i<segment->num_faces; i++) {
+        auto& entry = latest[entries[i].face_id];
+        if(std::get<0>(entry)) {
+          num_replaced_features += std::get<0>(entry)->num_features;
+        } else {
+          order.push_back(entries[i].face_id);
+        }
+        entry = std::make_tuple(&entries[i], features + static_cast<size_t>(entries[i].first_feature) * header->feature_dim, names);
+      }
+      offset += segment->segment_size;
+    }
+
+    saved_faces.clear();
+    faces.clear();
+    faces.reserve(order.size());
+    num_valid_features = 0;
+    for(int face_id : order) {
+      const auto& latest_entry = latest[face_id];
+      const FaceEntry* entry = std::get<0>(latest_entry);
+
+      faces.emplace_back(new RegisteredFace(face_id));
+      faces.back()->setName(std::string(std::get<2>(latest_entry) + entry->name_offset, entry->name_size));
+      // a single copy of the mapped features
+      faces.back()->setFaces(Eigen::Map<const Eigen::MatrixXf>(std::get<1>(latest_entry), header->feature_dim, entry->num_features));
+      num_valid_features += entry->num_features;
+      remember(faces.back());
+    }
+
+    file_path = path;
+    file_size = offset;
+    file_dim = header->feature_dim;
+
+    munmap(mapped, size);
+    return true;
+  }
+
+private:
+  static const char* fileMagic() {
+    return "OPTFACES";
+  }
+
+  static const char* segmentMagic() {
+    return "FSEG";
+  }
+
+  struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t feature_dim;
+    uint32_t reserved[12];
+  };
+
+  struct SegmentHeader {
+    char magic[4];
+    uint32_t num_faces;
+    uint32_t num_features;
+    uint32_t names_size;
+    uint64_t features_offset;   // offset of the feature block from the beginning of the file
+    uint64_t segment_size;      // size of the segment including the header
+  };
+
+  struct FaceEntry {
+    int32_t face_id;
+    uint32_t first_feature;     // index of the first feature in the feature block of the segment
+    uint32_t num_features;
+    uint32_t name_offset;       // offset of the name in the names table of the segment
+    uint32_t name_size;
+  };
+
+  struct SavedFace {
+    int num_features;
+    std::string name;
+    uint64_t checksum;          // checksum of the features
+  };
+
+  static long fileSize(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? st.st_size : -1;
+  }
+
+  /**
+   * @brief FNV-1a hash of the features of a face
+   */
+  static uint64_t checksum(const RegisteredFace& face) {
+    const auto& features = face.getFaces();
+    uint64_t hash = 14695981039346656037ull;
+    for(int i=0; i<features.cols(); i++) {
+      const unsigned char* bytes = reinterpret_cast<const unsigned char*>(features.col(i).data());
+      for(size_t j=0; j<features.rows() * sizeof(float); j++) {
+        hash = (hash ^ bytes[j]) * 1099511628211ull;
+      }
+    }
+    return hash;
+  }
+
+  void remember(const RegisteredFace::Ptr& face) {
+    SavedFace& saved = saved_faces[face->getFaceId()];
+    saved.num_features = face->size();
+    saved.name = face->getName();
+    saved.checksum = checksum(*face);
+  }
+
+  /**
+   * @brief writes all the faces to a new file which then replaces #path
+   */
+  bool rewrite(const std::string& path, const std::vector<RegisteredFace::Ptr>& faces, int dim) {
+    file_path.clear();
+    std::string tmp_path = path + ".tmp";
+    std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+    if(!ofs) {
+      std::cerr << "error : failed to open the file!!" << std::endl;
+      std::cerr << "      : " << tmp_path << std::endl;
+      return false;
+    }
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, fileMagic(), sizeof(header.magic));
+    header.version = VERSION;
+    header.feature_dim = dim;
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    file_size = sizeof(header);
+    if(!writeSegment(ofs, faces, dim)) {
+      std::cerr << "error : failed to write the registry!!" << std::endl;
+      return false;
+    }
+    ofs.close();
+
+    if(std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+      std::cerr << "error : failed to replace the registry!!" << std::endl;
+      std::cerr << "      : " << path << std::endl;
+      return false;
+    }
+
+    file_path = path;
+    file_dim = dim;
+    saved_faces.clear();
+    num_valid_features = 0;
+    num_replaced_features = 0;
+    for(const auto& face : faces) {
+      num_valid_features += face->size();
+      remember(face);
+    }
+    return true;
+  }
+
+  /**
+   * @brief writes a segment at the end of the file (#file_size bytes)
+   */
+  bool writeSegment(std::ofstream& ofs, const std::vector<RegisteredFace::Ptr>& faces, int dim) {
+    std::vector<FaceEntry> entries(faces.size());
+    std::string names;
+    uint32_t num_features = 0;
+    for(int i=0; i<faces.size(); i++) {
+      if(faces[i]->size() && faces[i]->getFaces().rows() != dim) {
+        std::cerr << "error : the faces have different feature dimensions!!" << std::endl;
+        return false;
+      }
+      entries[i].face_id = faces[i]->getFaceId();
+      entries[i].first_feature = num_features;
+      entries[i].num_features = faces[i]->size();
+      entries[i].name_offset = names.size();
+      entries[i].name_size = faces[i]->getName().size();
+      names += faces[i]->getName();
+      num_features += faces[i]->size();
+    }
+
+    SegmentHeader segment;
+    std::memset(&segment, 0, sizeof(segment));
+    std::memcpy(segment.magic, segmentMagic(), sizeof(segment.magic));
+    segment.num_faces = faces.size();
+    segment.num_features = num_features;
+    segment.names_size = names.size();
+
+    size_t tables_end = file_size + sizeof(SegmentHeader) + entries.size() * sizeof(FaceEntry) + names.size();
+    size_t padding = (16 - tables_end % 16) % 16;
+    segment.features_offset = tables_end + padding;
+    segment.segment_size = segment.features_offset + static_cast<size_t>(num_features) * dim * sizeof(float) - file_size;
+
+    const char zeros[16] = {0};
+    ofs.write(reinterpret_cast<const char*>(&segment), sizeof(segment));
+    ofs.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(FaceEntry));
+    ofs.write(names.data(), names.size());
+    ofs.write(zeros, padding);
+    for(const auto& face : faces) {
+      // the features of a face are contiguous columns
+      const auto& features = face->getFaces();
+      ofs.write(reinterpret_cast<const char*>(features.data()), features.size() * sizeof(float));
+    }
+    ofs.flush();
+    if(!ofs) {
+      return false;
+    }
+
+    file_size += segment.segment_size;
+    return true;
+  }
+
+private:
+  std::string file_path;                              // the file last saved or loaded
+  size_t file_size;                                   // the size of the file when it was last saved or loaded
+  int file_dim;                                       // the feature dimension of the file
+  std::unordered_map<int, SavedFace> saved_faces;     // the faces in the file
+  int num_valid_features;                             // the number of the latest features of the faces in the file
+  int num_replaced_features;                          // the number of features replaced by later segments
+};
+
+#endif // FACE_REGISTRY_HPP
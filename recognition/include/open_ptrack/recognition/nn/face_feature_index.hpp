@@ -0,0 +1,387 @@
+#ifndef FACE_FEATURE_INDEX_HPP
+#define FACE_FEATURE_INDEX_HPP
+
+#include <queue>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <Eigen/Dense>
+
+/**
+ * @brief nearest neighbor index of labeled face feature vectors
+ *        the features are stored as the columns of a contiguous matrix.
+ *        small galleries are searched exhaustively with a single matrix-vector product,
+ *        large ones with a hierarchical navigable small world (HNSW) graph built on the same matrix.
+ *        removed features are only marked as removed, and the matrix is compacted when they outnumber the valid ones
+ */
+class FaceFeatureIndex {
+public:
+
+  /**
+   * @brief constructor
+   * @param graph_threshold   the number of features from which the HNSW graph is used
+   * @param num_links         the number of links of a feature in each layer of the graph (twice in the bottom layer)
+   * @param ef_construction   the size of the candidate list used to link a new feature
+   * @param ef_search         the size of the candidate list used to search the graph
+   */
+  FaceFeatureIndex(int graph_threshold = 16384, int num_links = 16, int ef_construction = 100, int ef_search = 64)
+    : graph_threshold(graph_threshold),
+      num_links(num_links),
+      ef_construction(ef_construction),
+      ef_search(ef_search),
+      level_scale(1.0 / std::log(static_cast<double>(std::max(num_links, 2))))
+  {
+    clear();
+  }
+
+  /**
+   * @brief removes all the features
+   */
+  void clear() {
+    features.resize(0, 0);
+    squared_norms.resize(0);
+    labels.clear();
+    label_columns.clear();
+    num_columns = 0;
+    num_removed = 0;
+
+    clearGraph();
+  }
+
+  /**
+   * @brief adds a feature vector
+   * @param label    the label of the feature (e.g., face_id)
+   * @param feature  the feature vector
+   */
+  void insert(int label, const Eigen::VectorXf& feature) {
+    if(num_columns == 0 && features.rows() != feature.size()) {
+      features.resize(feature.size(), 0);
+    }
+    if(feature.size() != features.rows()) {
+      std::cerr << "warning : the feature dimension (" << feature.size() << ") does not match the index (" << features.rows() << ")" << std::endl;
+      return;
+    }
+
+    if(num_columns == features.cols()) {
+      int capacity = std::max<int>(64, features.cols() * 2);
+      features.conservativeResize(Eigen::NoChange, capacity);
+      squared_norms.conservativeResize(capacity);
+    }
+
+    int column = num_columns++;
+    features.col(column) = feature;
+    squared_norms[column] = feature.squaredNorm();
+    labels.push_back(label);
+    label_columns[label].push_back(column);
+
+    if(graph_enabled) {
+      insertNode(column);
+    } else if(size() >= graph_threshold) {
+      buildGraph();
+    }
+  }
+
+  /**
+   * @brief removes all the features with the given label
+   * @param label  the label of the features
+   */
+  void remove(int label) {
+    auto found = label_columns.find(label);
+    if(found == label_columns.end()) {
+      return;
+    }
+
+    for(int column : found->second) {
+      labels[column] = -1;
+      // removed columns never win the exhaustive search
+      squared_norms[column] = std::numeric_limits<float>::infinity();
+    }
+    num_removed += found->second.size();
+    label_columns.erase(found);
+
+    if(num_removed > size()) {
+      compact();
+    }
+  }
+
+  /**
+   * @brief finds the feature closest to the query
+   * @param query  the query feature vector
+   * @return the euclidean distance to the closest feature and its label (-1 if the index is empty)
+   */
+  std::pair<double, int> search(const Eigen::VectorXf& query) const {
+    if(size() == 0 || query.size() != features.rows()) {
+      return std::make_pair(std::numeric_limits<double>::max(), -1);
+    }
+
+    int closest = graph_enabled ? searchGraph(query) : -1;
+    if(closest < 0) {
+      // |f - q|^2 = |f|^2 - 2 f.q + |q|^2, where |q|^2 does not change the order
+      Eigen::VectorXf dists = squared_norms.head(num_columns) - 2.0f * (features.leftCols(num_columns).transpose() * query);
+      dists.minCoeff(&closest);
+    }
+
+    return std::make_pair(static_cast<double>((features.col(closest) - query).norm()), labels[closest]);
+  }
+
+  /**
+   * @brief the number of features in the index
+   * @return the number of features
+   */
+  int size() const {
+    return num_columns - num_removed;
+  }
+
+  /**
+   * @brief whether the HNSW graph is used
+   */
+  bool usesGraph() const {
+    return graph_enabled;
+  }
+
+private:
+  using Candidate = std::pair<float, int>;    // squared distance, column
+
+  float distance(const Eigen::VectorXf& query, int column) const {
+    return (features.col(column) - query).squaredNorm();
+  }
+
+  /**
+   * @brief moves the valid features to the front of the matrix and rebuilds the graph
+   */
+  void compact() {
+    int dst = 0;
+    label_columns.clear();
+    for(int src = 0; src < num_columns; src++) {
+      if(labels[src] < 0) {
+        continue;
+      }
+      features.col(dst) = features.col(src);
+      squared_norms[dst] = squared_norms[src];
+      labels[dst] = labels[src];
+      label_columns[labels[dst]].push_back(dst);
+      dst++;
+    }
+    num_columns = dst;
+    num_removed = 0;
+    labels.resize(dst);
+
+    // hysteresis to avoid building the graph again and again around the threshold
+    bool rebuild = graph_enabled && size() >= graph_threshold / 2;
+    clearGraph();
+    if(rebuild) {
+      buildGraph();
+    }
+  }
+
+  void clearGraph() {
+    graph_enabled = false;
+    levels.clear();
+    links.clear();
+    entry_point = -1;
+    max_level = -1;
+    rng.seed(0);
+  }
+
+  void buildGraph() {
+    clearGraph();
+    graph_enabled = true;
+    for(int column = 0; column < num_columns; column++) {
+      insertNode(column);
+    }
+  }
+
+  int randomLevel() {
+    std::uniform_real_distribution<double> uniform(std::numeric_limits<double>::min(), 1.0);
+    return static_cast<int>(-std::log(uniform(rng)) * level_scale);
+  }
+
+  int maxLinks(int level) const {
+    return level == 0 ? 2 * num_links : num_links;
+  }
+
+  /**
+   * @brief moves greedily to the closest node in the layers above #level
+   */
+  int descend(const Eigen::VectorXf& query, int level) const {
+    int current = entry_point;
+    float current_dist = distance(query, current);
+    for(int l = max_level; l > level; l--) {
+      bool changed = true;
+      while(changed) {
+        changed = false;
+        for(int neighbor : links[current][l]) {
+          float dist = distance(query, neighbor);
+          if(dist < current_dist) {
+            current = neighbor;
+            current_dist = dist;
+            changed = true;
+          }
+        }
+      }
+    }
+    return current;
+  }
+
+  /**
+   * @brief best first search in a layer of the graph
+   * @return at most #ef candidates sorted by distance
+   */
+  std::vector<Candidate> searchLayer(const Eigen::VectorXf& query, int entry, int ef, int level) const {
+    if(visited.size() < static_cast<size_t>(num_columns)) {
+      visited.resize(num_columns, 0);
+    }
+    if(++visit_tag == 0) {
+      std::fill(visited.begin(), visited.end(), 0);
+      visit_tag = 1;
+    }
+
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+    std::priority_queue<Candidate> results;
+
+    Candidate first(distance(query, entry), entry);
+    candidates.push(first);
+    results.push(first);
+    visited[entry] = visit_tag;
+
+    while(!candidates.empty()) {
+      Candidate current = candidates.top();
+      if(current.first > results.top().first) {
+        break;
+      }
+      candidates.pop();
+
+      for(int neighbor : links[current.second][level]) {
+        if(visited[neighbor] == visit_tag) {
+          continue;
+        }
+        visited[neighbor] = visit_tag;
+
+        float dist = distance(query, neighbor);
+        if(results.size() < static_cast<size_t>(ef) || dist < results.top().first) {
+          candidates.push(Candidate(dist, neighbor));
+          results.push(Candidate(dist, neighbor));
+          if(results.size() > static_cast<size_t>(ef)) {
+            results.pop();
+          }
+        }
+      }
+    }
+
+    std::vector<Candidate> sorted(results.size());
+    for(int i = sorted.size() - 1; i >= 0; i--) {
+      sorted[i] = results.top();
+      results.pop();
+    }
+    return sorted;
+  }
+
+  /**
+   * @brief selects the neighbors which are closer to the new node than to the already selected ones
+   *        so that the links spread in different directions, then fills the list with the closest remaining ones
+   * @param candidates  candidates sorted by distance
+   * @param m           the maximum number of neighbors
+   */
+  std::vector<int> selectNeighbors(const std::vector<Candidate>& candidates, int m) const {
+    std::vector<int> selected;
+    std::vector<bool> taken(candidates.size(), false);
+    selected.reserve(m);
+
+    for(size_t i = 0; i < candidates.size() && selected.size() < static_cast<size_t>(m); i++) {
+      bool diverse = std::none_of(selected.begin(), selected.end(), [&](int s) {
+        return (features.col(s) - features.col(candidates[i].second)).squaredNorm() < candidates[i].first;
+      });
+      if(diverse) {
+        selected.push_back(candidates[i].second);
+        taken[i] = true;
+      }
+    }
+    for(size_t i = 0; i < candidates.size() && selected.size() < static_cast<size_t>(m); i++) {
+      if(!taken[i]) {
+        selected.push_back(candidates[i].second);
+      }
+    }
+
+    return selected;
+  }
+
+  void insertNode(int column) {
+    int level = randomLevel();
+    levels.push_back(level);
+    links.emplace_back(level + 1);
+
+    if(entry_point < 0) {
+      entry_point = column;
+      max_level = level;
+      return;
+    }
+
+    Eigen::VectorXf query = features.col(column);
+    int current = descend(query, level);
+    for(int l = std::min(level, max_level); l >= 0; l--) {
+      std::vector<Candidate> candidates = searchLayer(query, current, ef_construction, l);
+      links[column][l] = selectNeighbors(candidates, num_links);
+
+      for(int neighbor : links[column][l]) {
+        std::vector<int>& neighbor_links = links[neighbor][l];
+        neighbor_links.push_back(column);
+        if(neighbor_links.size() > static_cast<size_t>(maxLinks(l))) {
+          std::vector<Candidate> neighbor_candidates(neighbor_links.size());
+          std::transform(neighbor_links.begin(), neighbor_links.end(), neighbor_candidates.begin(), [&](int n) {
+            return Candidate((features.col(n) - features.col(neighbor)).squaredNorm(), n);
+          });
+          std::sort(neighbor_candidates.begin(), neighbor_candidates.end());
+          neighbor_links = selectNeighbors(neighbor_candidates, maxLinks(l));
+        }
+      }
+      current = candidates.front().second;
+    }
+
+    if(level > max_level) {
+      max_level = level;
+      entry_point = column;
+    }
+  }
+
+  /**
+   * @brief searches the graph
+   * @return the column of the closest valid feature found (-1 if all the candidates were removed)
+   */
+  int searchGraph(const Eigen::VectorXf& query) const {
+    // removed features are still used to move in the graph, but cannot be returned
+    std::vector<Candidate> candidates = searchLayer(query, descend(query, 0), ef_search, 0);
+    auto found = std::find_if(candidates.begin(), candidates.end(), [&](const Candidate& c) { return labels[c.second] >= 0; });
+    return found != candidates.end() ? found->second : -1;
+  }
+
+private:
+  int graph_threshold;        // the number of features from which the graph is used
+  int num_links;              // the number of links of a node in the upper layers
+  int ef_construction;        // the size of the candidate list for insertion
+  int ef_search;              // the size of the candidate list for search
+  double level_scale;         // the normalization factor of the level distribution
+
+  Eigen::MatrixXf features;                                 // feature vectors (one per column)
+  Eigen::VectorXf squared_norms;                            // squared norms of the features (infinity if removed)
+  std::vector<int> labels;                                  // labels of the features (-1 if removed)
+  std::unordered_map<int, std::vector<int>> label_columns;  // columns of each label
+  int num_columns;                                          // the number of used columns
+  int num_removed;                                          // the number of removed features
+
+  bool graph_enabled;
+  std::vector<int> levels;                                  // the top layer of each node
+  std::vector<std::vector<std::vector<int>>> links;         // links of each node in each layer
+  int entry_point;
+  int max_level;
+  std::minstd_rand rng;
+
+  mutable std::vector<unsigned int> visited;                // visit marks for the graph search
+  mutable unsigned int visit_tag = 0;
+};
+
+#endif // FACE_FEATURE_INDEX_HPP
@@ -1,6 +1,7 @@
 #ifndef FACE_RECOGNIZER_NN_HPP
 #define FACE_RECOGNIZER_NN_HPP
 
+#include <limits>
 #include <memory>
 #include <iostream>
 #include <unordered_map>
@@ -10,6 +11,7 @@
 #include "open_ptrack/recognition/face_recognizer.hpp"
 #include "open_ptrack/recognition/registered_face.hpp"
 #include "open_ptrack/recognition/nn/tracker_status_nn.hpp"
+#include "open_ptrack/recognition/nn/face_feature_index.hpp"
 
 /**
  * @brief face recognition based on k-nearest neighbor matching
@@ -21,13 +23,20 @@ public:
    * @brief constructor
    * @param fp_threshold    the threshold for false positive detection
    * @param num_neighbors   the number of neighbor points used for kNN
+   * @param max_features_per_face   the maximum number of features kept for each face (0 means unlimited)
+   * @param index_graph_threshold   the number of indexed features from which the approximate graph search is used
    */
-  FaceRecognizerNN(double fp_threshold = 0.8, int num_neighbors = 5) {
+  FaceRecognizerNN(double fp_threshold = 0.8, int num_neighbors = 5, int max_features_per_face = 128, int index_graph_threshold = 16384)
+    : unassociated_index(index_graph_threshold)
+  {
     min_voting_faces = 5;
     min_support_faces = 3;
 
     this->fp_threshold = 2.75;     //
     this->num_neighbors = 5;   //
+    this->max_features_per_face = max_features_per_face;
+    this->feature_policy = RegisteredFace::DIVERSITY;
+    this->prototype_rate = 0.1;
 
     face_id_source = 0;
   }
@@ -119,6 +128,7 @@ public:
         std::cout << "ERASE!!" << std::endl;
         face->second->setTrackerId(-1);
         unassociated_faces.push_back(face->second);
+        indexFace(face->second);
         associated_faces.erase(face);
         return collectGarbage(trackers);
       }
@@ -163,20 +173,19 @@ public:
       }
 
       // check if the face_id exists in unassociated_faces
-      auto found_unassocitead = std::find_if(unassociated_faces.begin(), unassociated_faces.end(),
-        [=](const RegisteredFace::Ptr& p) {
-          return p->getFaceId() == face->getFaceId();
-        }
-      );
-      if (found_unassocitead != unassociated_faces.end()) {
+      auto found_unassocitead = unassociated_face_ids.find(face->getFaceId());
+      if (found_unassocitead != unassociated_face_ids.end()) {
         std::cerr << "warning : face_id(" << face->getFaceId() << ") is already registered" << std::endl;
-        (*found_unassocitead)->addFaces(face);
+        found_unassocitead->second->addFaces(face);
+        indexFace(found_unassocitead->second);
         continue;
       }
 
       // the face_id has not been registered
       std::cout << "register face_id(" << face->getFaceId() << ")" << std::endl;
+      face->setFeaturePolicy(feature_policy, max_features_per_face, prototype_rate);
       unassociated_faces.push_back(face);
+      indexFace(face);
     }
   }
 
@@ -204,6 +213,17 @@ public:
     fp_threshold = config.fp_threshold;
     num_neighbors = config.num_neighbors;
     */
+    feature_policy = static_cast<RegisteredFace::FeaturePolicy>(config.feature_policy);
+    max_features_per_face = config.max_features_per_face;
+    prototype_rate = config.prototype_rate;
+
+    for(const auto& face : associated_faces) {
+      face.second->setFeaturePolicy(feature_policy, max_features_per_face, prototype_rate);
+    }
+    for(const auto& face : unassociated_faces) {
+      face->setFeaturePolicy(feature_policy, max_features_per_face, prototype_rate);
+      indexFace(face);
+    }
   }
 private:
   /**
@@ -244,17 +264,30 @@ private:
    * @return the distance between #feature and the closest face, and the closest face
    */
   std::pair<double, RegisteredFace::Ptr> findClosest(const Eigen::VectorXf& feature) const {
-    double closest_dist = std::numeric_limits<double>::max();
-    RegisteredFace::Ptr closest_face;
-    for(const auto& face : unassociated_faces) {
-      double dist = face->calcDistance(feature);
-      if(dist < closest_dist) {
-        closest_dist = dist;
-        closest_face = face;
-      }
+    auto closest = unassociated_index.search(feature);
+    if(closest.second < 0) {
+      return std::make_pair(closest.first, RegisteredFace::Ptr());
+    }
+
+    auto found = unassociated_face_ids.find(closest.second);
+    if(found == unassociated_face_ids.end()) {
+      std::cerr << "warning : face_id (" << closest.second << ") is indexed but not unassociated" << std::endl;
+      return std::make_pair(std::numeric_limits<double>::max(), RegisteredFace::Ptr());
     }
+    return std::make_pair(closest.first, found->second);
+  }
 
-    return std::make_pair(closest_dist, closest_face);
+  /**
+   * @brief replaces the features of #face in the index of the unassociated faces
+   * @param face  unassociated face
+   */
+  void indexFace(const RegisteredFace::Ptr& face) {
+    unassociated_face_ids[face->getFaceId()] = face;
+    unassociated_index.remove(face->getFaceId());
+    const auto& features = face->getFaces();
+    for(int i=0; i<features.cols(); i++) {
+      unassociated_index.insert(face->getFaceId(), features.col(i));
+    }
   }
 
   /**
@@ -296,16 +329,21 @@ private:
     if(max_elem->first < 0) {
       std::cout << "new person!!" << std::endl;
       auto face = RegisteredFace::Ptr(new RegisteredFace(face_id_source++, status->getTrackerId()));
+      face->setFeaturePolicy(feature_policy, max_features_per_face, prototype_rate);
       associated_faces[status->getTrackerId()] = face;
     } else {
       std::cout << "known person!!" << std::endl;
-      auto found = std::find_if(unassociated_faces.begin(), unassociated_faces.end(),  [&](const RegisteredFace::Ptr& p) {return p->getFaceId() == max_elem->first;});
-      if (found == unassociated_faces.end()) {
+      auto found = unassociated_face_ids.find(max_elem->first);
+      if (found == unassociated_face_ids.end()) {
         std::cerr << "error : illegal condition!!" << std::endl;
+        return;
       }
 
-      associated_faces[status->getTrackerId()] = *found;
-      unassociated_faces.erase(found);
+      const RegisteredFace::Ptr known_face = found->second;
+      associated_faces[status->getTrackerId()] = known_face;
+      unassociated_index.remove(known_face->getFaceId());
+      unassociated_face_ids.erase(found);
+      unassociated_faces.erase(std::find(unassociated_faces.begin(), unassociated_faces.end(), known_face));
     }
 
     auto& face = associated_faces[status->getTrackerId()];
@@ -322,7 +360,9 @@ private:
   std::unordered_map<int, TrackerStatusNN::Ptr> tracker_status_map;   //
 
   std::vector<RegisteredFace::Ptr> unassociated_faces;
+  std::unordered_map<int, RegisteredFace::Ptr> unassociated_face_ids;    // unassociated faces indexed by their face ids
   std::unordered_map<int, RegisteredFace::Ptr> associated_faces;
+  FaceFeatureIndex unassociated_index;    // features of the unassociated faces labeled with their face ids
 
   std::vector<RegisteredFace::Ptr> unassociated_predefined_faces;
   std::unordered_map<int, RegisteredFace::Ptr> associated_predefined_faces;
@@ -332,6 +372,9 @@ private:
 
   int num_neighbors;                      // the number of neighbor points used for classification
   double fp_threshold;                    // the threshold for false positive detection
+  RegisteredFace::FeaturePolicy feature_policy;   // the update policy of the full feature lists
+  int max_features_per_face;              // the maximum number of features kept for each face
+  double prototype_rate;                  // the weight of a new feature with the MOVING_PROTOTYPE policy
 };
 
 #endif // FACE_RECOGNIZER_HPP
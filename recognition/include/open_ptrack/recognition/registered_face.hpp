@@ -1,18 +1,33 @@
 #ifndef REGISTERED_FACE_HPP
 #define REGISTERED_FACE_HPP
 
+#include <cmath>
+#include <limits>
 #include <memory>
 #include <vector>
+#include <numeric>
+#include <iostream>
+#include <algorithm>
 #include <Eigen/Dense>
 
 /**
  * @brief face registered to the recognition system
  *        this class consists of a set of face features ,face_id, tracker_id, name of the registered face
+ *        the features are stored as the columns of a matrix, and their number can be bounded with a feature policy
  */
 class RegisteredFace {
 public:
   using Ptr = std::shared_ptr<RegisteredFace>;
 
+  /**
+   * @brief how the feature list is updated once it is full
+   */
+  enum FeaturePolicy {
+    DIVERSITY = 0,          // the new feature replaces the most redundant one if it is more distinct
+    KMEANS = 1,             // the features are online k-means centroids, the new feature moves the closest one
+    MOVING_PROTOTYPE = 2    // the new feature moves the closest feature with an exponential moving average
+  };
+
   /**
    * @brief constructor
    * @param face_id      id of the face
@@ -20,9 +35,12 @@ public:
    */
   RegisteredFace(int face_id, int tracker_id = -1)
     : face_id (face_id),
-      tracker_id (tracker_id)
+      tracker_id (tracker_id),
+      num_faces (0),
+      max_faces (0),
+      policy (DIVERSITY),
+      prototype_rate (0.1)
   {
-    faces.reserve(32);
   }
 
   /**
@@ -32,19 +50,93 @@ public:
   RegisteredFace(const std::string& name)
     : face_id(-1),
       tracker_id(-1),
-      name(name)
+      name(name),
+      num_faces(0),
+      max_faces(0),
+      policy(DIVERSITY),
+      prototype_rate(0.1)
   {
-    faces.reserve(32);
   }
 
   virtual ~RegisteredFace() {}
 
+  /**
+   * @brief sets how the feature list is bounded
+   *        if the list exceeds the new maximum, the most redundant features are removed
+   * @param policy          the update policy of the full list
+   * @param max_faces       the maximum number of features in the list (0 means unlimited)
+   * @param prototype_rate  the weight of a new feature with the MOVING_PROTOTYPE policy
+   */
+  void setFeaturePolicy(FeaturePolicy policy, int max_faces, double prototype_rate = 0.1) {
+    this->policy = policy;
+    this->max_faces = max_faces;
+    this->prototype_rate = prototype_rate;
+
+    if(max_faces > 0 && num_faces > max_faces) {
+      updateNeighbors();
+      while(num_faces > max_faces) {
+        removeFace(std::min_element(neighbor_dists.begin(), neighbor_dists.begin() + num_faces) - neighbor_dists.begin());
+      }
+    }
+
+    counts.assign(num_faces, 1);
+    if(max_faces > 0 && policy == DIVERSITY) {
+      updateNeighbors();
+    }
+  }
+
   /**
    * @brief adds a face feature to the feature list
    * @param face  feature vector to be added
    */
   void addFace(const Eigen::VectorXf& face) {
-    faces.push_back(face);
+    if(num_faces == 0 && faces.rows() != face.size()) {
+      faces.resize(face.size(), 0);
+    }
+    if(face.size() != faces.rows()) {
+      std::cout << "row/col comparison failed" << std::endl;
+      return;
+    }
+
+    Eigen::VectorXf dists = calcSquaredDistances(face);
+    if(max_faces <= 0 || num_faces < max_faces) {
+      appendFace(face, dists);
+      return;
+    }
+
+    int closest;
+    float closest_dist = dists.minCoeff(&closest);
+    switch(policy) {
+    case DIVERSITY: {
+      // keep the features spread: the feature closest to another one is the most redundant
+      int redundant = std::min_element(neighbor_dists.begin(), neighbor_dists.begin() + num_faces) - neighbor_dists.begin();
+      if(closest_dist > neighbor_dists[redundant]) {
+        replaceFace(redundant, face, dists);
+      }
+      break;
+    }
+    case KMEANS:
+      counts[closest]++;
+      setFace(closest, faces.col(closest) + (face - faces.col(closest)) / counts[closest]);
+      break;
+    case MOVING_PROTOTYPE:
+      setFace(closest, (1.0 - prototype_rate) * faces.col(closest) + prototype_rate * face);
+      break;
+    }
+  }
+
+  /**
+   * @brief replaces the feature list
+   *        the list is bounded by the current feature policy
+   * @param new_faces  features (one per column)
+   */
+  void setFaces(const Eigen::Ref<const Eigen::MatrixXf>& new_faces) {
+    faces = new_faces;
+    squared_norms = faces.colwise().squaredNorm().transpose();
+    num_faces = faces.cols();
+    neighbor_dists.resize(num_faces);
+    neighbors.resize(num_faces);
+    setFeaturePolicy(policy, max_faces, prototype_rate);
   }
 
   /**
@@ -52,8 +144,8 @@ public:
    * @param faces  features to be added
    */
   void addFaces(const RegisteredFace::Ptr& faces) {
-    for(const auto& face : faces->faces) {
-      addFace(face);
+    for(int i=0; i<faces->size(); i++) {
+      addFace(faces->faces.col(i));
     }
   }
 
@@ -63,17 +155,15 @@ public:
    * @return the distance between #face and the closest face
    */
   double calcDistance(const Eigen::VectorXf& face) const {
-    double dist = std::numeric_limits<double>::max();
-    for(const auto& f : faces) {
-      if(f.rows() == face.rows() && f.cols() == face.cols()){
-        dist = std::min<double>( dist, (f - face).squaredNorm() );
-      }
-      else{
-        std::cout << "row/col comparison failed" << std::endl;
-        return 0;
-      }
+    if(num_faces == 0) {
+      return std::sqrt(std::numeric_limits<double>::max());
+    }
+    if(face.size() != faces.rows()) {
+      std::cout << "row/col comparison failed" << std::endl;
+      return 0;
     }
-    return std::sqrt(dist);
+
+    return std::sqrt(calcSquaredDistances(face).minCoeff());
   }
 
   /**
@@ -82,13 +172,9 @@ public:
    * @return the distance between #face and the closest face
    */
   double calcDistance(const Eigen::VectorXf& face, int n) const {
-    std::vector<double> dists(faces.size());
-    std::transform(faces.begin(), faces.end(), dists.begin(), [&](const Eigen::VectorXf& f) { return (f - face).norm(); });
-    std::sort(dists.begin(), dists.end());
-
-    n = std::min<int>(n, dists.size());
-    double accum = std::accumulate(dists.begin(), dists.begin() + n, 0.0);
-    return accum / n;
+    Eigen::VectorXf squared_dists = calcSquaredDistances(face);
+    std::vector<double> dists(squared_dists.data(), squared_dists.data() + squared_dists.size());
+    return averageSmallest(dists, n);
   }
 
   /**
@@ -98,12 +184,26 @@ public:
    */
   std::vector<double> calcDistances(const std::vector<std::shared_ptr<Eigen::VectorXf>>& features) const {
     std::vector<double> dists(features.size());
-    std::transform(features.begin(), features.end(), dists.begin(),
-      [&](const std::shared_ptr<Eigen::VectorXf>& f) {
-        return calcDistance(*f);
+    if(features.empty() || num_faces == 0) {
+      std::transform(features.begin(), features.end(), dists.begin(),
+        [&](const std::shared_ptr<Eigen::VectorXf>& f) { return calcDistance(*f); }
+      );
+      return dists;
+    }
+
+    Eigen::MatrixXf queries(faces.rows(), features.size());
+    for(int i=0; i<features.size(); i++) {
+      if(features[i]->size() != faces.rows()) {
+        std::cout << "row/col comparison failed" << std::endl;
+        return std::vector<double>(features.size(), 0.0);
       }
-    );
+      queries.col(i) = *features[i];
+    }
 
+    Eigen::VectorXf min_dists = calcSquaredDistances(queries).colwise().minCoeff();
+    for(int i=0; i<dists.size(); i++) {
+      dists[i] = std::sqrt(min_dists[i]);
+    }
     return dists;
   }
 
@@ -130,14 +230,14 @@ public:
    * @return the distance
    */
   double calcDistance(const RegisteredFace& rhs, int n) const {
-    std::vector<double> dists(rhs.size());
-    std::transform(rhs.faces.begin(), rhs.faces.end(), dists.begin(), [&](const Eigen::VectorXf& v){ return calcDistance(v);});
-
-    std::sort(dists.begin(), dists.end());
+    if(num_faces == 0) {
+      return std::sqrt(std::numeric_limits<double>::max());
+    }
 
-    n = std::min<int>(n, dists.size());
-    double accum = std::accumulate(dists.begin(), dists.begin() + n, 0.0);
-    return accum / n;
+    // squared distances of each feature of #rhs to the closest feature in the list
+    Eigen::VectorXf min_dists = calcSquaredDistances(rhs.getFaces()).colwise().minCoeff();
+    std::vector<double> dists(min_dists.data(), min_dists.data() + min_dists.size());
+    return averageSmallest(dists, n);
   }
 
   /**
@@ -145,7 +245,7 @@ public:
    * @return
    */
   int size() const {
-    return faces.size();
+    return num_faces;
   }
 
   int getFaceId() const {
@@ -164,12 +264,154 @@ public:
     return name;
   }
 
-  std::vector<Eigen::VectorXf>& getFaces() {
-    return faces;
+  void setName(const std::string& name) {
+    this->name = name;
+  }
+
+  /**
+   * @brief the face features
+   * @return a matrix with one feature per column
+   */
+  Eigen::Ref<const Eigen::MatrixXf> getFaces() const {
+    return faces.leftCols(num_faces);
+  }
+
+private:
+  /**
+   * @brief squared distances between the features in the list (rows) and #queries (columns)
+   *        |f - q|^2 = |f|^2 - 2 f.q + |q|^2, so that all the distances are given by a single matrix product
+   */
+  Eigen::MatrixXf calcSquaredDistances(const Eigen::Ref<const Eigen::MatrixXf>& queries) const {
+    Eigen::MatrixXf dists = -2.0f * (faces.leftCols(num_faces).transpose() * queries);
+    dists.colwise() += squared_norms.head(num_faces);
+    dists.rowwise() += queries.colwise().squaredNorm();
+    return dists.cwiseMax(0.0f);
+  }
+
+  /**
+   * @brief the average of the square roots of the #n smallest squared distances
+   */
+  static double averageSmallest(std::vector<double>& squared_dists, int n) {
+    n = std::min<int>(n, squared_dists.size());
+    std::partial_sort(squared_dists.begin(), squared_dists.begin() + n, squared_dists.end());
+    double accum = std::accumulate(squared_dists.begin(), squared_dists.begin() + n, 0.0, [](double sum, double d) { return sum + std::sqrt(d); });
+    return accum / n;
   }
 
-  const std::vector<Eigen::VectorXf>& getFaces() const {
-    return faces;
+  /**
+   * @brief appends a feature
+   * @param dists  squared distances between #face and the features in the list
+   */
+  void appendFace(const Eigen::VectorXf& face, const Eigen::VectorXf& dists) {
+    if(num_faces == faces.cols()) {
+      int capacity = std::max<int>(32, faces.cols() * 2);
+      if(max_faces > 0) {
+        capacity = std::min(capacity, max_faces);
+      }
+      faces.conservativeResize(Eigen::NoChange, capacity);
+      squared_norms.conservativeResize(capacity);
+      neighbor_dists.resize(capacity);
+      neighbors.resize(capacity);
+    }
+
+    int i = num_faces++;
+    faces.col(i) = face;
+    squared_norms[i] = face.squaredNorm();
+    counts.push_back(1);
+    neighbor_dists[i] = std::numeric_limits<float>::max();
+    neighbors[i] = -1;
+    if(max_faces > 0 && policy == DIVERSITY) {
+      updateNeighbors(i, dists);
+    }
+  }
+
+  /**
+   * @brief replaces a feature keeping the nearest neighbors of the list up to date
+   * @param dists  squared distances between #face and the features in the list
+   */
+  void replaceFace(int i, const Eigen::VectorXf& face, const Eigen::VectorXf& dists) {
+    faces.col(i) = face;
+    squared_norms[i] = face.squaredNorm();
+    neighbor_dists[i] = std::numeric_limits<float>::max();
+    neighbors[i] = -1;
+
+    for(int j=0; j<num_faces; j++) {
+      if(j != i && neighbors[j] == i) {
+        updateNeighbor(j);
+      }
+    }
+    Eigen::VectorXf new_dists = dists;
+    new_dists[i] = std::numeric_limits<float>::max();
+    updateNeighbors(i, new_dists);
+  }
+
+  void setFace(int i, const Eigen::VectorXf& face) {
+    faces.col(i) = face;
+    squared_norms[i] = face.squaredNorm();
+  }
+
+  /**
+   * @brief removes a feature moving the last one in its place, keeping the nearest neighbors of the list up to date
+   */
+  void removeFace(int i) {
+    int last = num_faces - 1;
+    std::vector<int> orphans;
+    for(int j=0; j<num_faces; j++) {
+      if(j != i && neighbors[j] == i) {
+        orphans.push_back(j == last ? i : j);
+      } else if(neighbors[j] == last) {
+        neighbors[j] = i;
+      }
+    }
+
+    faces.col(i) = faces.col(last);
+    squared_norms[i] = squared_norms[last];
+    neighbor_dists[i] = neighbor_dists[last];
+    neighbors[i] = neighbors[last];
+    num_faces--;
+
+    for(int j : orphans) {
+      updateNeighbor(j);
+    }
+  }
+
+  /**
+   * @brief updates the nearest neighbors with a new feature #i
+   */
+  void updateNeighbors(int i, const Eigen::VectorXf& dists) {
+    for(int j=0; j<num_faces; j++) {
+      if(j == i) {
+        continue;
+      }
+      if(dists[j] < neighbor_dists[i]) {
+        neighbor_dists[i] = dists[j];
+        neighbors[i] = j;
+      }
+      if(dists[j] < neighbor_dists[j]) {
+        neighbor_dists[j] = dists[j];
+        neighbors[j] = i;
+      }
+    }
+  }
+
+  /**
+   * @brief finds the nearest neighbor of the feature #i
+   */
+  void updateNeighbor(int i) {
+    Eigen::VectorXf dists = calcSquaredDistances(faces.col(i));
+    dists[i] = std::numeric_limits<float>::max();
+    neighbor_dists[i] = dists.minCoeff(&neighbors[i]);
+  }
+
+  /**
+   * @brief finds the nearest neighbors of all the features
+   */
+  void updateNeighbors() {
+    neighbor_dists.resize(faces.cols());
+    neighbors.resize(faces.cols());
+    for(int i=0; i<num_faces; i++) {
+      updateNeighbor(i);
+    }
   }
 
 private:
@@ -177,7 +419,16 @@ private:
   int tracker_id;     // ID of the tracker associated with the face (-1 means no tracker is associated)
   std::string name;   // name of the person
 
-  std::vector<Eigen::VectorXf> faces;   // face feature list
+  Eigen::MatrixXf faces;            // face feature list (one feature per column)
+  Eigen::VectorXf squared_norms;    // squared norms of the features
+  int num_faces;                    // the number of features in the list
+
+  int max_faces;                    // the maximum number of features in the list (0 means unlimited)
+  FeaturePolicy policy;             // the update policy of the full list
+  double prototype_rate;            // the weight of a new feature with the MOVING_PROTOTYPE policy
+  std::vector<int> counts;          // the number of features merged into each feature (KMEANS)
+  std::vector<float> neighbor_dists;  // squared distance of each feature to its nearest neighbor (DIVERSITY)
+  std::vector<int> neighbors;         // nearest neighbor of each feature (DIVERSITY)
 };
 
 
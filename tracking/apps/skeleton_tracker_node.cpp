@@ -936,6 +936,7 @@ configCb(Config &config, uint32_t level)
   tracker->setDetectorLikelihood (config.detector_likelihood);
   tracker->setLikelihoodWeights
       (config.detector_weight*chi_map[0.999]/18.467, config.motion_weight);
+  tracker->setJointWeight (config.joint_weight);
 
   if (config.acceleration_variance != acceleration_variance)
   {
@@ -1025,6 +1026,9 @@ main(int argc, char** argv)
   double motion_weight;
   nh.param("motion_weight", motion_weight, 0.5);
 
+  double joint_weight;
+  nh.param("joint_weight", joint_weight, 0.25);
+
   double sec_before_old;
   nh.param("sec_before_old", sec_before_old, 3.6);
 
@@ -1145,6 +1149,7 @@ main(int argc, char** argv)
         world_frame_id,
         debug_mode,
         vertical);
+  tracker->setJointWeight (joint_weight);
 
   starting_index = 0;
 
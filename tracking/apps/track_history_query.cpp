@@ -0,0 +1,108 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2013-, Open Perception, Inc.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ * with the distribution.
+ * * Neither the name of the copyright holder(s) nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include <cstdlib>
+#include <cstring>
+
+#include <open_ptrack/tracking/track_history.h>
+
+void
+printUsage (const char* program)
+{
+  std::cout << "Usage: " << program << " <directory> [--from <time>] [--to <time>] [--id <track id>] [--summary]" << std::endl
+            << "  Prints the recorded track states as CSV. Times are in seconds since epoch." << std::endl;
+}
+
+int
+main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    printUsage (argv[0]);
+    return 1;
+  }
+
+  std::string directory = argv[1];
+  double start_time = -std::numeric_limits<double>::max();
+  double end_time = std::numeric_limits<double>::max();
+  int id = -1;
+  bool summary = false;
+
+  for (int i = 2; i < argc; i++)
+  {
+    if (!std::strcmp(argv[i], "--from") && i + 1 < argc)
+      start_time = std::atof(argv[++i]);
+    else if (!std::strcmp(argv[i], "--to") && i + 1 < argc)
+      end_time = std::atof(argv[++i]);
+    else if (!std::strcmp(argv[i], "--id") && i + 1 < argc)
+      id = std::atoi(argv[++i]);
+    else if (!std::strcmp(argv[i], "--summary"))
+      summary = true;
+    else
+    {
+      printUsage (argv[0]);
+      return 1;
+    }
+  }
+
+  open_ptrack::tracking::TrackHistoryReader reader(directory);
+  if (summary)
+  {
+    std::cout << "Segments: " << reader.getSegmentsNumber() << std::endl;
+    std::cout << "Records: " << reader.getRecordsNumber() << std::endl;
+    return 0;
+  }
+
+  std::vector<open_ptrack::tracking::TrackHistoryRecord> records;
+  reader.query(start_time, end_time, id, records);
+
+  std::cout << "time,id,x,y,z,height,vx,vy,var_x,var_y,var_vx,var_vy,visibility,source" << std::endl;
+  std::cout << std::fixed;
+  for (unsigned int i = 0; i < records.size(); i++)
+  {
+    const open_ptrack::tracking::TrackHistoryRecord& r = records[i];
+    std::cout << std::setprecision(6) << r.time << "," << r.id << ","
+              << std::setprecision(3) << r.x << "," << r.y << "," << r.z << "," << r.height << ","
+              << r.vx << "," << r.vy << ","
+              << std::setprecision(5) << r.var_x << "," << r.var_y << "," << r.var_vx << "," << r.var_vy << ","
+              << int(r.visibility) << "," << reader.getSourceName(r.source) << std::endl;
+  }
+
+  return 0;
+}
@@ -53,16 +53,18 @@
 #include <fstream>
 #include <string.h>
 
-#include <message_filters/subscriber.h>
-#include <message_filters/time_sequencer.h>
 #include <open_ptrack/opt_utils/conversions.h>
 #include <open_ptrack/detection/detection.h>
 #include <open_ptrack/detection/detection_source.h>
 #include <open_ptrack/tracking/tracker.h>
+#include <open_ptrack/tracking/output_scheduler.h>
+#include <open_ptrack/tracking/track_history.h>
+#include <open_ptrack/tracking/reorder_buffer.h>
 #include <opt_msgs/Association.h>
 #include <opt_msgs/Detection.h>
 #include <opt_msgs/DetectionArray.h>
 #include <opt_msgs/TrackArray.h>
+#include <opt_msgs/TrackDeltaArray.h>
 #include <opt_msgs/IDArray.h>
 //#include <open_ptrack/opt_utils/ImageConverter.h>
 
@@ -95,6 +97,7 @@ ros::Publisher detection_marker_pub;
 ros::Publisher detection_trajectory_pub;
 ros::Publisher alive_ids_pub;
 ros::Publisher association_result_pub;
+ros::Publisher delta_pub;
 size_t starting_index;
 size_t detection_insert_index;
 tf::Transform camera_frame_to_world_transform;
@@ -102,6 +105,14 @@ tf::Transform world_to_camera_frame_transform;
 bool extrinsic_calibration;
 double period;
 open_ptrack::tracking::Tracker* tracker;
+open_ptrack::tracking::OutputScheduler* output_scheduler;
+double output_rate;             // rate of tracking results publication (0 means publish at every detection message)
+bool output_on_change;          // if true, tracking results are published only when tracks changed significantly
+bool output_delta;              // enables/disables the publishing of delta messages
+open_ptrack::tracking::TrackHistoryWriter* history_writer = NULL;   // track history recorder (NULL if disabled)
+open_ptrack::tracking::ReorderBuffer* reorder_buffer;               // sorts detection messages of all cameras by timestamp
+double detection_rate;          // expected rate of detection messages from all cameras
+ros::Rate* loop_rate = NULL;    // rate of the main loop (rebuilt when output_rate changes)
 pcl::PointCloud<pcl::PointXYZRGB>::Ptr history_pointcloud(new pcl::PointCloud<pcl::PointXYZRGB>);
 pcl::PointCloud<pcl::PointXYZRGB>::Ptr detection_history_pointcloud(new pcl::PointCloud<pcl::PointXYZRGB>);
 bool swissranger;
@@ -121,13 +132,10 @@ double gate_distance;
 bool calibration_refinement;
 std::map<std::string, Eigen::Matrix4d> registration_matrices;
 double max_detection_delay;
-ros::Time latest_time;
 
 std::map<std::string, ros::Time> last_received_detection_;
 ros::Duration max_time_between_detections_;
 
-std::map<std::string, std::pair<double, int> > number_messages_delay_map_;
-
 /**
  * \brief Create marker to be visualized in RViz
  *
@@ -204,13 +212,33 @@ readMatrixFromFile (std::string filename)
   return matrix;
 }
 
+/**
+ * \brief Publish tracking results (and the corresponding delta message) if the output scheduler allows it
+ *
+ * \param[in] tracking_results_msg The TrackArray message to publish.
+ * \param[in] now Current time.
+ */
+void
+publishTrackingResults (opt_msgs::TrackArray::Ptr& tracking_results_msg, const ros::Time& now)
+{
+  opt_msgs::TrackDeltaArray::Ptr delta_msg(new opt_msgs::TrackDeltaArray);
+  if (!output_scheduler->schedule(*tracking_results_msg, now, delta_msg))
+    return;
+
+  results_pub.publish(tracking_results_msg);
+  if (output_delta)
+    delta_pub.publish(delta_msg);
+}
+
 /**
  * \brief Read the DetectionArray message and use the detections for creating/updating/deleting tracks
  *
  * \param[in] msg the DetectionArray message.
+ * \param[in] late If true, the message is older than the ones already processed and only updates the tracks
+ *                 it is associated to.
  */
 void
-detection_cb(const opt_msgs::DetectionArray::ConstPtr& msg)
+detection_cb(const opt_msgs::DetectionArray::ConstPtr& msg, bool late = false)
 {
   // Read message header information:
   std::string frame_id = msg->header.frame_id;
@@ -225,18 +253,6 @@ detection_cb(const opt_msgs::DetectionArray::ConstPtr& msg)
   frame_id_tmp.replace(pos, std::string("_depth_optical_frame").size(), "");
   last_received_detection_[frame_id_tmp] = frame_time;
 
-  // Compute delay of detection message, if any:
-  double time_delay = 0.0;
-  if (frame_time > latest_time)
-  {
-    latest_time = frame_time;
-    time_delay = 0.0;
-  }
-  else
-  {
-    time_delay = (latest_time - frame_time).toSec();
-  }
-
   tf::StampedTransform transform;
   tf::StampedTransform inverse_transform;
   //	cv_bridge::CvImage::Ptr cvPtr;
@@ -358,27 +374,35 @@ detection_cb(const opt_msgs::DetectionArray::ConstPtr& msg)
       }
     }
 
+    // Late detections are applied to the tracks from their state at the message time, nothing is published:
+    if (late)
+    {
+      tracker->updateLateTracks(detections_vector);
+      return;
+    }
+
     // If at least one detection has been received:
-    if((detections_vector.size() > 0) && (time_delay < max_detection_delay))
+    if(detections_vector.size() > 0)
     {
       // Perform detection-track association:
 //      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
       tracker->newFrame(detections_vector);
       tracker->updateTracks();
+      if (history_writer)
+        tracker->appendToHistory(history_writer, frame_time);
 //      std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
 //      ROS_WARN_STREAM("Track time: " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
 
       // Create a TrackingResult message with the output of the tracking process
       opt_msgs::TrackArray::Ptr tracking_results_msg(new opt_msgs::TrackArray);
+      tracking_results_msg->header.stamp = ros::Time::now();//frame_time;
+      tracking_results_msg->header.frame_id = world_frame_id;
+      tracker->toMsg(tracking_results_msg);
 
-      if(output_tracking_results)
+      // Publish tracking message (at fixed rate, tracks are published by the main loop):
+      if(output_tracking_results && output_rate <= 0.0)
       {
-        opt_msgs::TrackArray::Ptr tracking_results_msg(new opt_msgs::TrackArray);
-        tracking_results_msg->header.stamp = ros::Time::now();//frame_time;
-        tracking_results_msg->header.frame_id = world_frame_id;
-        tracker->toMsg(tracking_results_msg);
-        // Publish tracking message:
-        results_pub.publish(tracking_results_msg);
+        publishTrackingResults (tracking_results_msg, tracking_results_msg->header.stamp);
       }
 
 //      //Show the tracking process' results as an image
@@ -482,30 +506,15 @@ detection_cb(const opt_msgs::DetectionArray::ConstPtr& msg)
         detection_trajectory_pub.publish(detection_history_pointcloud); // publish trajectory message
       }
     }
-    else // if no detections have been received or detection_delay is above max_detection_delay
+    else // if no detections have been received
     {
-      if(output_tracking_results)
+      if(output_tracking_results && output_rate <= 0.0 && !output_on_change)
       { // Publish an empty tracking message
         opt_msgs::TrackArray::Ptr tracking_results_msg(new opt_msgs::TrackArray);
         tracking_results_msg->header.stamp = frame_time;
         tracking_results_msg->header.frame_id = world_frame_id;
         results_pub.publish(tracking_results_msg);
       }
-      if((detections_vector.size() > 0) && (time_delay >= max_detection_delay))
-      {
-        if (number_messages_delay_map_.find(msg->header.frame_id) == number_messages_delay_map_.end())
-          number_messages_delay_map_[msg->header.frame_id] = std::pair<double, int>(0.0, 0);
-
-        number_messages_delay_map_[msg->header.frame_id].first += time_delay;
-        number_messages_delay_map_[msg->header.frame_id].second++;
-
-        if (number_messages_delay_map_[msg->header.frame_id].second == 100)
-        {
-          double avg = number_messages_delay_map_[msg->header.frame_id].first / number_messages_delay_map_[msg->header.frame_id].second;
-          ROS_WARN_STREAM("[" << msg->header.frame_id << "] received 100 detections with average delay " << avg << " > " << max_detection_delay);
-          number_messages_delay_map_[msg->header.frame_id] = std::pair<double, int>(0.0, 0);
-        }
-      }
     }
   }
   catch(tf::TransformException& ex)
@@ -514,6 +523,49 @@ detection_cb(const opt_msgs::DetectionArray::ConstPtr& msg)
   }
 }
 
+/**
+ * \brief Process detection messages released by the reorder buffer.
+ *
+ * \param[in] now Current time.
+ */
+void
+releaseDetections(const ros::Time& now)
+{
+  std::vector<opt_msgs::DetectionArray::ConstPtr> released_msgs;
+  std::vector<opt_msgs::DetectionArray::ConstPtr> late_msgs;
+  reorder_buffer->pop(now, released_msgs, late_msgs);
+  for (unsigned int i = 0; i < late_msgs.size(); i++)
+    detection_cb(late_msgs[i], true);
+  for (unsigned int i = 0; i < released_msgs.size(); i++)
+    detection_cb(released_msgs[i]);
+}
+
+void
+input_cb(const opt_msgs::DetectionArray::ConstPtr& msg)
+{
+  ros::Time now = ros::Time::now();
+  switch (reorder_buffer->push(msg, now))
+  {
+    case open_ptrack::tracking::ReorderBuffer::LATE:
+      ROS_WARN_STREAM_THROTTLE(1.0, "[" << msg->header.frame_id << "] detection message older than the latest processed one by "
+          << (reorder_buffer->getWatermark() - msg->header.stamp).toSec() << " seconds (reorder_buffer/max_deadline too short?): "
+          << "updating the tracks out of order (" << reorder_buffer->getLateMessagesNumber() << " so far)");
+      break;
+    case open_ptrack::tracking::ReorderBuffer::TOO_LATE:
+      ROS_WARN_STREAM_THROTTLE(1.0, "[" << msg->header.frame_id << "] detection message older than the latest processed one by "
+          << (reorder_buffer->getWatermark() - msg->header.stamp).toSec() << " > " << max_detection_delay << " seconds: dropped ("
+          << reorder_buffer->getDroppedMessagesNumber() << " so far)");
+      break;
+    case open_ptrack::tracking::ReorderBuffer::LATE_QUEUE_FULL:
+      ROS_WARN_STREAM_THROTTLE(1.0, "[" << msg->header.frame_id << "] late detection message dropped because the late queue is full ("
+          << reorder_buffer->getDroppedMessagesNumber() << " so far)");
+      break;
+    default:
+      break;
+  }
+  releaseDetections(now);
+}
+
 void
 generateColors(int colors_number, std::vector<cv::Vec3f>& colors)
 {
@@ -562,6 +614,7 @@ configCb(Config &config, uint32_t level)
 {
   tracker->setMinConfidenceForTrackInitialization (config.min_confidence_initialization);
   max_detection_delay = config.max_detection_delay;
+  reorder_buffer->setMaxLateness(max_detection_delay);
   calibration_refinement = config.calibration_refinement;
   tracker->setSecBeforeOld (config.sec_before_old);
   tracker->setSecBeforeFake (config.sec_before_fake);
@@ -594,6 +647,18 @@ configCb(Config &config, uint32_t level)
 
   gate_distance = chi_map.find(config.gate_distance_probability) != chi_map.end() ? chi_map[config.gate_distance_probability] : chi_map[0.999];
   tracker->setGateDistance (config.gate_distance_probability);
+
+  if (loop_rate && config.output_rate != output_rate)
+  {
+    delete loop_rate;
+    loop_rate = new ros::Rate(std::max(detection_rate, config.output_rate));
+  }
+  output_rate = config.output_rate;
+  output_on_change = config.output_on_change;
+  output_scheduler->setOutputRate (config.output_rate);
+  output_scheduler->setOnChange (config.output_on_change);
+  output_scheduler->setMinPositionChange (config.output_min_position_change);
+  output_scheduler->setKeyframeInterval (config.output_keyframe_interval);
 }
 
 int
@@ -604,10 +669,7 @@ main(int argc, char** argv)
   ros::NodeHandle nh("~");
 
   // Subscribers/Publishers:
-  message_filters::Subscriber<opt_msgs::DetectionArray> input_sub(nh, "input", 5);
-  message_filters::TimeSequencer<opt_msgs::DetectionArray> input_seq(input_sub, ros::Duration(0.5), ros::Duration(0.01), 512);
-  input_seq.registerCallback(boost::function<void(const opt_msgs::DetectionArrayConstPtr&)>(detection_cb));
-  //ros::Subscriber input_sub = nh.subscribe("input", 5, detection_cb);
+  ros::Subscriber input_sub = nh.subscribe("input", 100, input_cb);
   marker_pub_tmp = nh.advertise<visualization_msgs::Marker>("/tracker/markers", 1);
   marker_pub = nh.advertise<visualization_msgs::MarkerArray>("/tracker/markers_array", 1);
   pointcloud_pub = nh.advertise<pcl::PointCloud<pcl::PointXYZRGBA> >("/tracker/history", 1);
@@ -616,6 +678,7 @@ main(int argc, char** argv)
   detection_trajectory_pub = nh.advertise<pcl::PointCloud<pcl::PointXYZRGBA> >("/detector/history", 1);
   alive_ids_pub = nh.advertise<opt_msgs::IDArray>("/tracker/alive_ids", 1);
   association_result_pub = nh.advertise<opt_msgs::Association>("/tracker/association_result", 1);
+  delta_pub = nh.advertise<opt_msgs::TrackDeltaArray>("/tracker/tracks_delta", 100);
 
   // Dynamic reconfigure
   boost::recursive_mutex config_mutex_;
@@ -682,15 +745,40 @@ main(int argc, char** argv)
   nh.param("image_rgb", output_image_rgb, true);
   nh.param("tracking_results", output_tracking_results, true);
 
+  // Output scheduling parameters:
+  double output_min_position_change, output_keyframe_interval;
+  nh.param("output/rate", output_rate, 0.0);
+  nh.param("output/on_change", output_on_change, false);
+  nh.param("output/min_position_change", output_min_position_change, 0.02);
+  nh.param("output/keyframe_interval", output_keyframe_interval, 1.0);
+  nh.param("output/delta", output_delta, false);
+
   nh.param("detection_debug", output_detection_results, true);
   nh.param("detection_history_size", detection_history_size, 1000);
 
   bool debug_mode;
   nh.param("debug_active", debug_mode, false);
 
+  // Track history recorder parameters:
+  bool history_recorder;
+  std::string history_directory;
+  int history_segment_capacity, history_queue_size;
+  nh.param("history_recorder/enabled", history_recorder, false);
+  nh.param("history_recorder/directory", history_directory, std::string("track_history"));
+  nh.param("history_recorder/segment_capacity", history_segment_capacity, 1000000);
+  nh.param("history_recorder/queue_size", history_queue_size, 65536);
+
   nh.param("calibration_refinement", calibration_refinement, false);
   nh.param("max_detection_delay", max_detection_delay, 3.0);
 
+  // Reorder buffer parameters:
+  double reorder_min_deadline, reorder_max_deadline, reorder_camera_timeout;
+  int reorder_queue_size;
+  nh.param("reorder_buffer/min_deadline", reorder_min_deadline, 0.01);
+  nh.param("reorder_buffer/max_deadline", reorder_max_deadline, 0.5);
+  nh.param("reorder_buffer/queue_size", reorder_queue_size, 512);
+  nh.param("reorder_buffer/camera_timeout", reorder_camera_timeout, 1.0);
+
   double max_time_between_detections_d;
   nh.param("max_time_between_detections", max_time_between_detections_d, 10.0);
   max_time_between_detections_ = ros::Duration(max_time_between_detections_d);
@@ -743,7 +831,8 @@ main(int argc, char** argv)
   nan_point.z = std::numeric_limits<float>::quiet_NaN();
   detection_history_pointcloud->points.resize(detection_history_size, nan_point);
 
-  ros::Rate hz(num_cameras*rate);
+  detection_rate = num_cameras*rate;
+  loop_rate = new ros::Rate(std::max(detection_rate, output_rate));
 
 //  cv::namedWindow("TRACKER ", CV_WINDOW_NORMAL);
 
@@ -766,9 +855,42 @@ main(int argc, char** argv)
       debug_mode,
       vertical);
 
+  // Initialize the scheduler of tracking results publication:
+  output_scheduler = new open_ptrack::tracking::OutputScheduler(
+      output_rate,
+      output_on_change,
+      output_min_position_change,
+      output_keyframe_interval);
+
+  // Initialize the track history recorder:
+  if (history_recorder && (history_segment_capacity < 1 || history_queue_size < 1))
+  {
+    ROS_ERROR_STREAM("Invalid history_recorder/segment_capacity (" << history_segment_capacity << ") or history_recorder/queue_size ("
+        << history_queue_size << "): both must be at least 1, track history recording disabled");
+    history_recorder = false;
+  }
+  if (history_recorder)
+  {
+    history_writer = new open_ptrack::tracking::TrackHistoryWriter(history_directory,
+        history_segment_capacity, history_queue_size);
+    ROS_INFO_STREAM("Recording track history to " << history_directory);
+  }
+
+  // Initialize the buffer sorting detection messages of all cameras:
+  reorder_buffer = new open_ptrack::tracking::ReorderBuffer(
+      reorder_min_deadline,
+      reorder_max_deadline,
+      max_detection_delay,
+      reorder_queue_size,
+      reorder_camera_timeout);
+
   starting_index = 0;
 
-  // Set up dynamic reconfiguration
+  // Set up dynamic reconfiguration (the output/* parameters are its initial output_* values)
+  nh.setParam("output_rate", output_rate);
+  nh.setParam("output_on_change", output_on_change);
+  nh.setParam("output_min_position_change", output_min_position_change);
+  nh.setParam("output_keyframe_interval", output_keyframe_interval);
   ReconfigureServer::CallbackType f = boost::bind(&configCb, _1, _2);
   reconfigure_server_.reset(new ReconfigureServer(config_mutex_, nh));
   reconfigure_server_->setCallback(f);
@@ -797,6 +919,20 @@ main(int argc, char** argv)
   {
     ros::spinOnce();
     ros::Time now = ros::Time::now();
+
+    // Process detection messages whose camera deadlines expired:
+    releaseDetections(now);
+
+    // Publish tracking results at fixed rate:
+    if (output_tracking_results && output_rate > 0.0 && output_scheduler->isDue(now))
+    {
+      opt_msgs::TrackArray::Ptr tracking_results_msg(new opt_msgs::TrackArray);
+      tracking_results_msg->header.stamp = now;
+      tracking_results_msg->header.frame_id = world_frame_id;
+      tracker->toMsg(tracking_results_msg);
+      publishTrackingResults (tracking_results_msg, now);
+    }
+
     for (std::map<std::string, ros::Time>::const_iterator it = last_received_detection_.begin(); it != last_received_detection_.end(); ++it)
     {
       ros::Duration duration(now - it->second);
@@ -821,7 +957,14 @@ main(int argc, char** argv)
         last_camera_legend_update = now;
       }
     }
-    hz.sleep();
+    loop_rate->sleep();
+  }
+
+  if (history_writer)
+  {
+    if (history_writer->getDroppedRecords() > 0)
+      ROS_WARN_STREAM("Track history recorder dropped " << history_writer->getDroppedRecords() << " records");
+    delete history_writer;
   }
 
   return 0;
@@ -0,0 +1,551 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2013-, Open Perception, Inc.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ * with the distribution.
+ * * Neither the name of the copyright holder(s) nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Offline replay of recorded detections through the people Tracker.
+ *
+ * Detections are read from a bag file (or from a compact dump written by this tool), sorted by
+ * timestamp and fed to Tracker::newFrame/updateTracks as fast as possible, without ROS master and
+ * without the TimeSequencer delay of the tracker node. Transforms are resolved from the static
+ * calibration file (camera_poses.yaml) and from /tf and /tf_static messages recorded in the bag.
+ *
+ * Tracking results are written as CSV (frame,time,id,x,y,height,visibility) in world coordinates,
+ * ready to be compared with ground truth for MOTA/IDF1 computation.
+ */
+
+#include <ros/ros.h>
+#include <ros/serialization.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <tf/tf.h>
+#include <tf/transform_datatypes.h>
+#include <tf2/buffer_core.h>
+#include <tf2_msgs/TFMessage.h>
+#include <yaml-cpp/yaml.h>
+
+#include <open_ptrack/detection/detection.h>
+#include <open_ptrack/detection/detection_source.h>
+#include <open_ptrack/tracking/tracker.h>
+#include <opt_msgs/DetectionArray.h>
+#include <opt_msgs/TrackArray.h>
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+typedef std::chrono::steady_clock Clock;
+
+/** \brief Magic number at the beginning of a compact detection dump */
+const char DUMP_MAGIC[8] = {'O', 'P', 'T', 'D', 'E', 'T', 'S', '1'};
+
+/** \brief Record types of a compact detection dump */
+enum DumpRecord
+{
+  DUMP_DETECTIONS = 0,
+  DUMP_TRANSFORMS = 1
+};
+
+/** \brief Names of the timed stages */
+enum Stage
+{
+  CONVERSION, NEW_FRAME, DISTANCE_MATRIX, COST_MATRIX, MUNKRES, UPDATE_DETECTED, UNASSOCIATED, NEW_TRACKS, OUTPUT,
+  STAGES_NUMBER
+};
+const char* STAGE_NAMES[STAGES_NUMBER] = {"conversion", "newFrame", "createDistanceMatrix", "createCostMatrix", "munkres",
+                                          "updateDetectedTracks", "fillUnassociatedDetections", "createNewTracks", "output"};
+
+/** \brief Accumulated time (in seconds) of every stage */
+double stage_time[STAGES_NUMBER] = {0};
+
+/** \brief Measure the time spent in a stage */
+class StageTimer
+{
+  const Stage stage_;
+  const Clock::time_point start_;
+public:
+  StageTimer(Stage stage) : stage_(stage), start_(Clock::now()) {}
+  ~StageTimer()
+  {
+    stage_time[stage_] += std::chrono::duration<double>(Clock::now() - start_).count();
+  }
+};
+
+/** \brief Tracker which measures the time spent in every stage of updateTracks() */
+class ReplayTracker : public open_ptrack::tracking::Tracker
+{
+public:
+  ReplayTracker(double gate_distance, bool detector_likelihood, std::vector<double> likelihood_weights, bool velocity_in_motion_term,
+      double min_confidence, double min_confidence_detections, double sec_before_old, double sec_before_fake,
+      double sec_remain_new, int detections_to_validate, double period, double position_variance,
+      double acceleration_variance, std::string world_frame_id, bool debug_mode, bool vertical) :
+    Tracker(gate_distance, detector_likelihood, likelihood_weights, velocity_in_motion_term, min_confidence,
+        min_confidence_detections, sec_before_old, sec_before_fake, sec_remain_new, detections_to_validate, period,
+        position_variance, acceleration_variance, world_frame_id, debug_mode, vertical)
+  {
+
+  }
+
+  virtual void
+  updateTracks()
+  {
+    { StageTimer timer(DISTANCE_MATRIX); createDistanceMatrix(); }
+    { StageTimer timer(COST_MATRIX); createCostMatrix(); }
+    {
+      StageTimer timer(MUNKRES);
+      open_ptrack::tracking::Munkres munkres;
+      cost_matrix_ = munkres.solve(cost_matrix_, false);
+    }
+    { StageTimer timer(UPDATE_DETECTED); updateDetectedTracks(); }
+    { StageTimer timer(UNASSOCIATED); fillUnassociatedDetections(); }
+    updateLostTracks();
+    { StageTimer timer(NEW_TRACKS); createNewTracks(); }
+  }
+};
+
+/** \brief Read a parameter from a YAML node, using '/' to separate nested keys */
+template <typename T> T
+param(const YAML::Node& node, const std::string& name, const T& default_value)
+{
+  if (!node.IsMap())
+    return default_value;
+
+  size_t slash = name.find('/');
+  if (slash == std::string::npos)
+    return node[name] ? node[name].as<T>() : default_value;
+  return param(node[name.substr(0, slash)], name.substr(slash + 1), default_value);
+}
+
+/** \brief Chi square values for the gate distance, as in the tracker node */
+double
+chiSquare(double probability, bool velocity_in_motion_term)
+{
+  std::map<double, double> chi_map;
+  if (velocity_in_motion_term)    // state dimension = 4
+  {
+    chi_map[0.5] = 3.357; chi_map[0.75] = 5.385; chi_map[0.8] = 5.989; chi_map[0.9] = 7.779; chi_map[0.95] = 9.488;
+    chi_map[0.98] = 11.668; chi_map[0.99] = 13.277; chi_map[0.995] = 14.860; chi_map[0.998] = 16.924; chi_map[0.999] = 18.467;
+  }
+  else                            // state dimension = 2
+  {
+    chi_map[0.5] = 1.386; chi_map[0.75] = 2.773; chi_map[0.8] = 3.219; chi_map[0.9] = 4.605; chi_map[0.95] = 5.991;
+    chi_map[0.98] = 7.824; chi_map[0.99] = 9.210; chi_map[0.995] = 10.597; chi_map[0.998] = 12.429; chi_map[0.999] = 13.816;
+  }
+  return chi_map.find(probability) != chi_map.end() ? chi_map[probability] : chi_map[0.999];
+}
+
+/** \brief Add the transforms contained in a TFMessage to the buffer */
+void
+addTransforms(tf2::BufferCore& buffer, const tf2_msgs::TFMessage& msg, bool is_static)
+{
+  for (unsigned int i = 0; i < msg.transforms.size(); i++)
+  {
+    try
+    {
+      buffer.setTransform(msg.transforms[i], "replay", is_static);
+    }
+    catch (tf2::TransformException& ex)
+    {
+      ROS_WARN_STREAM("Cannot add transform: " << ex.what());
+    }
+  }
+}
+
+/** \brief Load world -> sensor poses of the static calibration file as static transforms */
+tf2_msgs::TFMessage
+loadCalibration(const std::string& filename, const std::string& world_frame_id)
+{
+  tf2_msgs::TFMessage msg;
+  YAML::Node poses = YAML::LoadFile(filename)["poses"];
+  for (YAML::const_iterator it = poses.begin(); it != poses.end(); ++it)
+  {
+    geometry_msgs::TransformStamped transform;
+    transform.header.frame_id = world_frame_id;
+    transform.child_frame_id = it->first.as<std::string>();
+    transform.transform.translation.x = it->second["translation"]["x"].as<double>();
+    transform.transform.translation.y = it->second["translation"]["y"].as<double>();
+    transform.transform.translation.z = it->second["translation"]["z"].as<double>();
+    transform.transform.rotation.x = it->second["rotation"]["x"].as<double>();
+    transform.transform.rotation.y = it->second["rotation"]["y"].as<double>();
+    transform.transform.rotation.z = it->second["rotation"]["z"].as<double>();
+    transform.transform.rotation.w = it->second["rotation"]["w"].as<double>();
+    msg.transforms.push_back(transform);
+  }
+  return msg;
+}
+
+/** \brief Remove the leading slash from a frame id (tf2 does not accept it) */
+std::string
+stripSlash(const std::string& frame_id)
+{
+  return (!frame_id.empty() && frame_id[0] == '/') ? frame_id.substr(1) : frame_id;
+}
+
+/** \brief Write a ROS message to a compact dump */
+template <typename M> void
+writeDumpRecord(std::ofstream& out, DumpRecord type, const M& msg)
+{
+  uint32_t size = ros::serialization::serializationLength(msg);
+  std::vector<uint8_t> buffer(size);
+  ros::serialization::OStream stream(buffer.data(), size);
+  ros::serialization::serialize(stream, msg);
+
+  uint8_t record_type = type;
+  out.write(reinterpret_cast<const char*>(&record_type), sizeof(record_type));
+  out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+  out.write(reinterpret_cast<const char*>(buffer.data()), size);
+}
+
+/** \brief Read detections and transforms from a bag file */
+bool
+readBag(const std::string& filename, const std::string& topic, tf2::BufferCore& buffer,
+    std::vector<opt_msgs::DetectionArray::ConstPtr>& detection_msgs, std::vector<tf2_msgs::TFMessage>& static_msgs)
+{
+  rosbag::Bag bag;
+  try
+  {
+    bag.open(filename, rosbag::bagmode::Read);
+  }
+  catch (rosbag::BagException& ex)
+  {
+    ROS_ERROR_STREAM("Cannot open " << filename << ": " << ex.what());
+    return false;
+  }
+
+  std::vector<std::string> topics;
+  topics.push_back(topic);
+  topics.push_back("/tf");
+  topics.push_back("/tf_static");
+  rosbag::View view(bag, rosbag::TopicQuery(topics));
+  for (rosbag::View::iterator it = view.begin(); it != view.end(); ++it)
+  {
+    if (it->getTopic() == topic)
+    {
+      opt_msgs::DetectionArray::ConstPtr msg = it->instantiate<opt_msgs::DetectionArray>();
+      if (msg)
+        detection_msgs.push_back(msg);
+    }
+    else
+    {
+      tf2_msgs::TFMessage::ConstPtr msg = it->instantiate<tf2_msgs::TFMessage>();
+      if (msg)
+      {
+        // Dynamic transforms are kept with their stamp, so the latest one is used for every camera:
+        bool is_static = it->getTopic() == "/tf_static";
+        addTransforms(buffer, *msg, is_static);
+        if (is_static)
+          static_msgs.push_back(*msg);
+      }
+    }
+  }
+  bag.close();
+  return true;
+}
+
+/** \brief Read detections and transforms from a compact dump */
+bool
+readDump(const std::string& filename, tf2::BufferCore& buffer,
+    std::vector<opt_msgs::DetectionArray::ConstPtr>& detection_msgs, std::vector<tf2_msgs::TFMessage>& static_msgs)
+{
+  std::ifstream in(filename.c_str(), std::ios::binary);
+  char magic[sizeof(DUMP_MAGIC)];
+  if (!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), DUMP_MAGIC))
+  {
+    ROS_ERROR_STREAM(filename << " is not a detection dump");
+    return false;
+  }
+
+  std::vector<uint8_t> data;
+  uint8_t record_type;
+  uint32_t size;
+  while (in.read(reinterpret_cast<char*>(&record_type), sizeof(record_type)) &&
+         in.read(reinterpret_cast<char*>(&size), sizeof(size)))
+  {
+    data.resize(size);
+    if (!in.read(reinterpret_cast<char*>(data.data()), size))
+      break;
+    ros::serialization::IStream stream(data.data(), size);
+
+    if (record_type == DUMP_DETECTIONS)
+    {
+      opt_msgs::DetectionArray::Ptr msg(new opt_msgs::DetectionArray);
+      ros::serialization::deserialize(stream, *msg);
+      detection_msgs.push_back(msg);
+    }
+    else if (record_type == DUMP_TRANSFORMS)
+    {
+      tf2_msgs::TFMessage msg;
+      ros::serialization::deserialize(stream, msg);
+      addTransforms(buffer, msg, true);
+      static_msgs.push_back(msg);
+    }
+  }
+  return true;
+}
+
+bool
+compareStamps(const opt_msgs::DetectionArray::ConstPtr& a, const opt_msgs::DetectionArray::ConstPtr& b)
+{
+  return a->header.stamp < b->header.stamp;
+}
+
+void
+printUsage(const char* program)
+{
+  std::cout << "Usage: " << program << " --input <file.bag|file.dets> [options]" << std::endl
+            << "  --topic <topic>          detection topic in the bag (default /detector/detections)" << std::endl
+            << "  --calibration <file>     camera poses file (default none)" << std::endl
+            << "  --params <file>          tracker parameters file (e.g. conf/tracker_multicamera.yaml)" << std::endl
+            << "  --output <file>          write tracking results as CSV" << std::endl
+            << "  --dump <file>            write detections and static transforms to a compact dump and exit" << std::endl;
+}
+
+int
+main(int argc, char** argv)
+{
+  std::string input_filename, topic = "/detector/detections", calibration_filename, params_filename,
+      output_filename, dump_filename;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if (i + 1 >= argc)
+    {
+      printUsage(argv[0]);
+      return 1;
+    }
+    if (arg == "--input") input_filename = argv[++i];
+    else if (arg == "--topic") topic = argv[++i];
+    else if (arg == "--calibration") calibration_filename = argv[++i];
+    else if (arg == "--params") params_filename = argv[++i];
+    else if (arg == "--output") output_filename = argv[++i];
+    else if (arg == "--dump") dump_filename = argv[++i];
+    else
+    {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (input_filename.empty())
+  {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  ros::Time::init();
+  if (ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME, ros::console::levels::Warn))
+    ros::console::notifyLoggerLevelsChanged();
+
+  // Read tracking parameters (same names and defaults of the tracker node):
+  YAML::Node params = params_filename.empty() ? YAML::Node() : YAML::LoadFile(params_filename);
+  std::string world_frame_id = stripSlash(param<std::string>(params, "world_frame_id", "/odom"));
+  bool vertical = param<bool>(params, "orientation/vertical", false);
+  bool extrinsic_calibration = param<bool>(params, "extrinsic_calibration", false);
+  double voxel_size = param<double>(params, "voxel_size", 0.06);
+  double rate = param<double>(params, "rate", 30.0);
+  double min_confidence = param<double>(params, "min_confidence_initialization", -2.5);
+  double chi_value = param<double>(params, "gate_distance_probability", 0.9);
+  double acceleration_variance = param<double>(params, "acceleration_variance", 1.0);
+  double position_variance_weight = param<double>(params, "position_variance_weight", 1.0);
+  bool detector_likelihood = param<bool>(params, "detector_likelihood", false);
+  bool velocity_in_motion_term = param<bool>(params, "velocity_in_motion_term", false);
+  double detector_weight = param<double>(params, "detector_weight", -1.0);
+  double motion_weight = param<double>(params, "motion_weight", 0.5);
+  double sec_before_old = param<double>(params, "sec_before_old", 3.6);
+  double sec_before_fake = param<double>(params, "sec_before_fake", 2.4);
+  double sec_remain_new = param<double>(params, "sec_remain_new", 1.2);
+  int detections_to_validate = param<int>(params, "detections_to_validate", 5);
+  double min_confidence_detections = param<double>(params, "haar_disp_ada_min_confidence", -2.5);
+
+  // Read detections and transforms:
+  tf2::BufferCore tf_buffer(ros::Duration(1e6));
+  std::vector<opt_msgs::DetectionArray::ConstPtr> detection_msgs;
+  std::vector<tf2_msgs::TFMessage> static_msgs;
+  if (!calibration_filename.empty())
+  {
+    static_msgs.push_back(loadCalibration(calibration_filename, world_frame_id));
+    addTransforms(tf_buffer, static_msgs.back(), true);
+  }
+
+  Clock::time_point load_start = Clock::now();
+  bool is_dump = input_filename.size() > 5 && input_filename.substr(input_filename.size() - 5) == ".dets";
+  if (!(is_dump ? readDump(input_filename, tf_buffer, detection_msgs, static_msgs) :
+        readBag(input_filename, topic, tf_buffer, detection_msgs, static_msgs)))
+    return 1;
+  std::stable_sort(detection_msgs.begin(), detection_msgs.end(), compareStamps);
+  double load_time = std::chrono::duration<double>(Clock::now() - load_start).count();
+  std::cout << "Loaded " << detection_msgs.size() << " detection messages in " << load_time << " s" << std::endl;
+
+  // Convert to a compact dump:
+  if (!dump_filename.empty())
+  {
+    std::ofstream out(dump_filename.c_str(), std::ios::binary);
+    out.write(DUMP_MAGIC, sizeof(DUMP_MAGIC));
+    for (unsigned int i = 0; i < static_msgs.size(); i++)
+      writeDumpRecord(out, DUMP_TRANSFORMS, static_msgs[i]);
+    for (unsigned int i = 0; i < detection_msgs.size(); i++)
+      writeDumpRecord(out, DUMP_DETECTIONS, *detection_msgs[i]);
+    std::cout << "Dump written to " << dump_filename << std::endl;
+    return 0;
+  }
+
+  // Initialize the tracker:
+  double gate_distance = chiSquare(chi_value, velocity_in_motion_term);
+  double position_variance = position_variance_weight*std::pow(2 * voxel_size, 2) / 12.0;
+  std::vector<double> likelihood_weights;
+  likelihood_weights.push_back(detector_weight*chiSquare(0.999, velocity_in_motion_term)/18.467);
+  likelihood_weights.push_back(motion_weight);
+  ReplayTracker tracker(gate_distance, detector_likelihood, likelihood_weights, velocity_in_motion_term,
+      min_confidence, min_confidence_detections, sec_before_old, sec_before_fake, sec_remain_new,
+      detections_to_validate, 1.0 / rate, position_variance, acceleration_variance, world_frame_id, false, vertical);
+
+  // Fixed transformation used when extrinsic calibration is not available (as in the tracker node):
+  tf::Transform world_to_camera_frame_transform(tf::Quaternion(-0.5, 0.5, -0.5, -0.5), tf::Vector3(0, 0, 0));
+
+  std::ofstream output;
+  if (!output_filename.empty())
+  {
+    output.open(output_filename.c_str());
+    output << "frame,time,id,x,y,height,visibility" << std::endl;
+    output << std::fixed;
+  }
+
+  // Replay:
+  std::map<std::string, open_ptrack::detection::DetectionSource*> detection_sources_map;
+  unsigned int frames = 0, skipped_frames = 0, detections_number = 0;
+  Clock::time_point replay_start = Clock::now();
+  for (unsigned int m = 0; m < detection_msgs.size(); m++)
+  {
+    const opt_msgs::DetectionArray& msg = *detection_msgs[m];
+    const std::string& frame_id = msg.header.frame_id;
+    std::vector<open_ptrack::detection::Detection> detections_vector;
+    {
+      StageTimer timer(CONVERSION);
+
+      tf::StampedTransform transform, inverse_transform;
+      if (extrinsic_calibration)
+      {
+        try
+        {
+          geometry_msgs::TransformStamped t = tf_buffer.lookupTransform(world_frame_id, stripSlash(frame_id), ros::Time(0));
+          tf::transformStampedMsgToTF(t, transform);
+          inverse_transform.setData(transform.inverse());
+        }
+        catch (tf2::TransformException& ex)
+        {
+          ROS_WARN_STREAM_THROTTLE(1.0, "Skipping detections of " << frame_id << ": " << ex.what());
+          skipped_frames++;
+          continue;
+        }
+      }
+      else
+      {
+        transform.setData(world_to_camera_frame_transform.inverse());
+        inverse_transform.setData(world_to_camera_frame_transform);
+      }
+
+      Eigen::Matrix3d intrinsic_matrix;
+      for(int i = 0; i < 3; i++)
+        for(int j = 0; j < 3; j++)
+          intrinsic_matrix(i, j) = msg.intrinsic_matrix.size() == 9 ? msg.intrinsic_matrix[i * 3 + j] : 0.0;
+
+      if(detection_sources_map.find(frame_id) == detection_sources_map.end())
+      {
+        detection_sources_map[frame_id] = new open_ptrack::detection::DetectionSource(cv::Mat(0, 0, CV_8UC3),
+            transform, inverse_transform, intrinsic_matrix, msg.header.stamp, frame_id);
+      }
+      else
+      {
+        detection_sources_map[frame_id]->update(cv::Mat(0, 0, CV_8UC3), transform, inverse_transform,
+            intrinsic_matrix, msg.header.stamp, frame_id);
+      }
+      open_ptrack::detection::DetectionSource* source = detection_sources_map[frame_id];
+
+      for(unsigned int i = 0; i < msg.detections.size(); i++)
+      {
+        detections_vector.push_back(open_ptrack::detection::Detection(msg.detections[i], source));
+
+        // Convert HOG+SVM confidences to HAAR+ADABOOST-like people detection confidences:
+        if (msg.confidence_type == "hog+svm")
+          detections_vector.back().setConfidence((detections_vector.back().getConfidence() - (-3)) / 3 * 4 + 2);
+      }
+    }
+
+    if (detections_vector.empty())
+      continue;
+
+    { StageTimer timer(NEW_FRAME); tracker.newFrame(detections_vector); }
+    tracker.updateTracks();
+    frames++;
+    detections_number += detections_vector.size();
+
+    {
+      StageTimer timer(OUTPUT);
+      opt_msgs::TrackArray::Ptr tracking_results_msg(new opt_msgs::TrackArray);
+      tracker.toMsg(tracking_results_msg);
+      if (output.is_open())
+      {
+        for (unsigned int i = 0; i < tracking_results_msg->tracks.size(); i++)
+        {
+          const opt_msgs::Track& track = tracking_results_msg->tracks[i];
+          output << frames << "," << std::setprecision(6) << msg.header.stamp.toSec() << "," << track.id << ","
+                 << std::setprecision(4) << track.x << "," << track.y << "," << track.height << ","
+                 << int(track.visibility) << std::endl;
+        }
+      }
+    }
+  }
+  double replay_time = std::chrono::duration<double>(Clock::now() - replay_start).count();
+
+  // Report:
+  double recorded_time = detection_msgs.size() > 1 ?
+      (detection_msgs.back()->header.stamp - detection_msgs.front()->header.stamp).toSec() : 0.0;
+  std::cout << "Processed " << frames << " frames (" << detections_number << " detections, "
+            << skipped_frames << " skipped for missing transforms) in " << replay_time << " s" << std::endl;
+  std::cout << "Frames/s: " << (replay_time > 0 ? frames / replay_time : 0.0)
+            << " (" << (replay_time > 0 ? recorded_time / replay_time : 0.0) << "x real time)" << std::endl;
+  std::cout << std::left << std::setw(30) << "Stage" << std::setw(14) << "total [ms]" << "per frame [us]" << std::endl;
+  for (int s = 0; s < STAGES_NUMBER; s++)
+  {
+    std::cout << std::left << std::setw(30) << STAGE_NAMES[s] << std::setw(14) << stage_time[s] * 1e3
+              << (frames > 0 ? stage_time[s] * 1e6 / frames : 0.0) << std::endl;
+  }
+
+  for (std::map<std::string, open_ptrack::detection::DetectionSource*>::iterator it = detection_sources_map.begin();
+       it != detection_sources_map.end(); it++)
+    delete it->second;
+
+  return 0;
+}
@@ -0,0 +1,321 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2013-, Open Perception, Inc.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ * with the distribution.
+ * * Neither the name of the copyright holder(s) nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef OPEN_PTRACK_TRACKING_BENCHMARK_SYNTHETIC_CROWD_H_
+#define OPEN_PTRACK_TRACKING_BENCHMARK_SYNTHETIC_CROWD_H_
+
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <vector>
+#include <Eigen/Eigen>
+#include <tf/tf.h>
+#include <open_ptrack/detection/detection.h>
+#include <open_ptrack/detection/detection_source.h>
+#include <open_ptrack/detection/skeleton_detection.h>
+#include <body_pose_estimation/skeleton_base.h>
+
+namespace open_ptrack
+{
+  namespace tracking
+  {
+    /** \brief Parameters of a synthetic crowd */
+    struct SyntheticCrowdParameters
+    {
+      SyntheticCrowdParameters() :
+        people(10), cameras(4), venue_width(20.0), venue_length(20.0), rate(30.0), max_speed(1.5),
+        detection_noise(0.05), occlusion_probability(0.1), false_positive_rate(0.05), max_range(10.0),
+        fov(70.0 * M_PI / 180.0), seed(0)
+      {
+
+      }
+
+      /** \brief Number of people in the venue */
+      int people;
+
+      /** \brief Number of cameras, placed along the venue border and looking at its center */
+      int cameras;
+
+      /** \brief Venue size (in meters) */
+      double venue_width, venue_length;
+
+      /** \brief Frame rate of every camera */
+      double rate;
+
+      /** \brief Maximum walking speed (in m/s) */
+      double max_speed;
+
+      /** \brief Standard deviation of the detection position noise (in meters) */
+      double detection_noise;
+
+      /** \brief Probability that a person in the field of view is not detected */
+      double occlusion_probability;
+
+      /** \brief Expected number of false positives per camera frame */
+      double false_positive_rate;
+
+      /** \brief Maximum detection distance (in meters) */
+      double max_range;
+
+      /** \brief Horizontal field of view of the cameras (in radians) */
+      double fov;
+
+      /** \brief Random generator seed */
+      unsigned int seed;
+    };
+
+    /** \brief SyntheticCrowd simulates people walking in a venue observed by a network of cameras.
+     *
+     *  Every call to step() advances the simulation by one camera message (cameras publish in turn)
+     *  and produces the detections of that camera, expressed in the camera optical frame exactly as
+     *  the detectors do, so that Detection objects perform the same camera-to-world transforms.
+     */
+    class SyntheticCrowd
+    {
+      protected:
+        const SyntheticCrowdParameters parameters_;
+
+        std::mt19937 generator_;
+
+        /** \brief People positions and velocities (world frame, z = centroid height) */
+        std::vector<Eigen::Vector3d> positions_;
+        std::vector<Eigen::Vector2d> velocities_;
+
+        /** \brief One detection source per camera */
+        std::vector<open_ptrack::detection::DetectionSource*> sources_;
+
+        /** \brief Camera positions and viewing directions (world frame) */
+        std::vector<Eigen::Vector3d> camera_positions_;
+        std::vector<Eigen::Vector2d> camera_directions_;
+
+        /** \brief Camera to world and world to camera transforms */
+        std::vector<tf::StampedTransform> transforms_, inverse_transforms_;
+
+        /** \brief Camera intrinsic matrix */
+        Eigen::Matrix3d intrinsic_matrix_;
+
+        /** \brief Simulation time */
+        ros::Time time_;
+
+        /** \brief Number of camera messages generated */
+        unsigned int frames_;
+
+        /** \brief Camera of the last message */
+        int camera_;
+
+        /** \brief World positions observed by the camera of the last message (detections and false positives) */
+        std::vector<Eigen::Vector3d> observations_;
+
+        /** \brief Return true if a world point is in the field of view of a camera */
+        bool
+        isVisible(int camera, const Eigen::Vector3d& p) const
+        {
+          Eigen::Vector2d d = p.head<2>() - camera_positions_[camera].head<2>();
+          double distance = d.norm();
+          return distance > 0.5 && distance < parameters_.max_range &&
+              std::acos(d.dot(camera_directions_[camera]) / distance) < parameters_.fov / 2;
+        }
+
+        /** \brief Fill a detection message from a world centroid */
+        opt_msgs::Detection
+        toDetectionMsg(const Eigen::Vector3d& centroid, double height, open_ptrack::detection::DetectionSource* source)
+        {
+          std::normal_distribution<double> confidence(5.0, 1.0);
+          Eigen::Vector3d c = source->inverseTransform(centroid);
+          Eigen::Vector3d top = source->inverseTransform(centroid + Eigen::Vector3d(0, 0, height / 2));
+          Eigen::Vector3d bottom = source->inverseTransform(centroid - Eigen::Vector3d(0, 0, height / 2));
+
+          opt_msgs::Detection msg;
+          msg.centroid.x = c(0); msg.centroid.y = c(1); msg.centroid.z = c(2);
+          msg.top.x = top(0); msg.top.y = top(1); msg.top.z = top(2);
+          msg.bottom.x = bottom(0); msg.bottom.y = bottom(1); msg.bottom.z = bottom(2);
+          msg.height = height;
+          msg.confidence = confidence(generator_);
+          msg.distance = c.norm();
+          msg.occluded = false;
+          return msg;
+        }
+
+      public:
+        SyntheticCrowd(const SyntheticCrowdParameters& parameters) :
+          parameters_(parameters), generator_(parameters.seed), time_(1000.0), frames_(0), camera_(0)
+        {
+          std::uniform_real_distribution<double> x(0.0, parameters_.venue_width);
+          std::uniform_real_distribution<double> y(0.0, parameters_.venue_length);
+          std::uniform_real_distribution<double> angle(-M_PI, M_PI);
+          std::uniform_real_distribution<double> speed(0.0, parameters_.max_speed);
+          for (int i = 0; i < parameters_.people; i++)
+          {
+            positions_.push_back(Eigen::Vector3d(x(generator_), y(generator_), 0.85));
+            double a = angle(generator_), s = speed(generator_);
+            velocities_.push_back(Eigen::Vector2d(s * std::cos(a), s * std::sin(a)));
+          }
+
+          // Cameras along the venue border, 2.5 m high, looking at the venue center:
+          Eigen::Vector2d center(parameters_.venue_width / 2, parameters_.venue_length / 2);
+          intrinsic_matrix_ << 525, 0, 319.5, 0, 525, 239.5, 0, 0, 1;
+          for (int c = 0; c < parameters_.cameras; c++)
+          {
+            double a = 2 * M_PI * c / parameters_.cameras;
+            Eigen::Vector3d position(center(0) + center(0) * std::cos(a), center(1) + center(1) * std::sin(a), 2.5);
+            Eigen::Vector2d direction = (center - position.head<2>()).normalized();
+            camera_positions_.push_back(position);
+            camera_directions_.push_back(direction);
+
+            // Optical frame axes in world coordinates (z forward, x right, y down):
+            tf::Vector3 z_axis(direction(0), direction(1), 0);
+            tf::Vector3 x_axis = z_axis.cross(tf::Vector3(0, 0, 1));
+            tf::Vector3 y_axis = z_axis.cross(x_axis);
+            tf::Matrix3x3 rotation(x_axis.x(), y_axis.x(), z_axis.x(),
+                                   x_axis.y(), y_axis.y(), z_axis.y(),
+                                   x_axis.z(), y_axis.z(), z_axis.z());
+            tf::Transform camera_to_world(rotation, tf::Vector3(position(0), position(1), position(2)));
+
+            std::stringstream frame_id;
+            frame_id << "/camera" << c << "_rgb_optical_frame";
+            tf::StampedTransform transform(camera_to_world, time_, "/world", frame_id.str());
+            tf::StampedTransform inverse_transform(camera_to_world.inverse(), time_, frame_id.str(), "/world");
+            transforms_.push_back(transform);
+            inverse_transforms_.push_back(inverse_transform);
+            sources_.push_back(new open_ptrack::detection::DetectionSource(cv::Mat(0, 0, CV_8UC3),
+                transform, inverse_transform, intrinsic_matrix_, time_, frame_id.str()));
+          }
+        }
+
+        virtual ~SyntheticCrowd()
+        {
+          for (unsigned int c = 0; c < sources_.size(); c++)
+            delete sources_[c];
+        }
+
+        /** \brief Advance the simulation by one camera message */
+        void
+        step()
+        {
+          double dt = 1.0 / (parameters_.rate * parameters_.cameras);
+          time_ += ros::Duration(dt);
+          camera_ = frames_++ % parameters_.cameras;
+
+          // Random walk bouncing on the venue walls:
+          std::normal_distribution<double> turn(0.0, 0.5 * dt);
+          for (unsigned int i = 0; i < positions_.size(); i++)
+          {
+            Eigen::Rotation2Dd rotation(turn(generator_));
+            velocities_[i] = rotation * velocities_[i];
+            positions_[i].head<2>() += velocities_[i] * dt;
+            if (positions_[i](0) < 0 || positions_[i](0) > parameters_.venue_width)
+              velocities_[i](0) = -velocities_[i](0);
+            if (positions_[i](1) < 0 || positions_[i](1) > parameters_.venue_length)
+              velocities_[i](1) = -velocities_[i](1);
+          }
+
+          open_ptrack::detection::DetectionSource* source = sources_[camera_];
+          source->update(cv::Mat(0, 0, CV_8UC3), transforms_[camera_], inverse_transforms_[camera_], intrinsic_matrix_,
+              time_, source->getFrameId());
+
+          // Observations of the current camera:
+          std::uniform_real_distribution<double> uniform(0.0, 1.0);
+          std::normal_distribution<double> noise(0.0, parameters_.detection_noise);
+          observations_.clear();
+          for (unsigned int i = 0; i < positions_.size(); i++)
+          {
+            if (isVisible(camera_, positions_[i]) && uniform(generator_) >= parameters_.occlusion_probability)
+              observations_.push_back(positions_[i] + Eigen::Vector3d(noise(generator_), noise(generator_), 0));
+          }
+          std::poisson_distribution<int> false_positives(parameters_.false_positive_rate);
+          std::uniform_real_distribution<double> range(1.0, parameters_.max_range);
+          std::uniform_real_distribution<double> bearing(-parameters_.fov / 2, parameters_.fov / 2);
+          for (int i = false_positives(generator_); i > 0; i--)
+          {
+            Eigen::Vector2d d = Eigen::Rotation2Dd(bearing(generator_)) * camera_directions_[camera_] * range(generator_);
+            observations_.push_back(Eigen::Vector3d(camera_positions_[camera_](0) + d(0), camera_positions_[camera_](1) + d(1), 0.85));
+          }
+        }
+
+        /** \brief Get the people detections of the last camera message */
+        void
+        getDetections(std::vector<open_ptrack::detection::Detection>& detections)
+        {
+          detections.clear();
+          open_ptrack::detection::DetectionSource* source = sources_[camera_];
+          for (unsigned int i = 0; i < observations_.size(); i++)
+            detections.push_back(open_ptrack::detection::Detection(toDetectionMsg(observations_[i], 1.7, source), source));
+        }
+
+        /** \brief Get the skeleton detections of the last camera message */
+        void
+        getSkeletonDetections(std::vector<open_ptrack::detection::SkeletonDetection>& detections)
+        {
+          // Joint offsets from the body centroid (world frame, person facing x):
+          static const double joint_offsets[open_ptrack::bpe::SkeletonJoints::SIZE][3] = {
+            {0, 0, 0.75}, {0, 0, 0.55}, {0, -0.2, 0.5}, {0, -0.25, 0.2}, {0, -0.25, -0.05},
+            {0, 0.2, 0.5}, {0, 0.25, 0.2}, {0, 0.25, -0.05}, {0, -0.12, -0.05}, {0, -0.12, -0.45},
+            {0, -0.12, -0.8}, {0, 0.12, -0.05}, {0, 0.12, -0.45}, {0, 0.12, -0.8}, {0, 0, 0.3}};
+
+          detections.clear();
+          open_ptrack::detection::DetectionSource* source = sources_[camera_];
+          std::normal_distribution<double> confidence(5.0, 1.0);
+          for (unsigned int i = 0; i < observations_.size(); i++)
+          {
+            rtpose_wrapper::SkeletonMsg msg;
+            msg.joints.resize(open_ptrack::bpe::SkeletonJoints::SIZE);
+            for (int j = 0; j < open_ptrack::bpe::SkeletonJoints::SIZE; j++)
+            {
+              Eigen::Vector3d joint = source->inverseTransform(observations_[i] +
+                  Eigen::Vector3d(joint_offsets[j][0], joint_offsets[j][1], joint_offsets[j][2]));
+              msg.joints[j].x = joint(0);
+              msg.joints[j].y = joint(1);
+              msg.joints[j].z = joint(2);
+            }
+            msg.confidence = confidence(generator_);
+            msg.distance = source->inverseTransform(observations_[i]).norm();
+            msg.occluded = false;
+            detections.push_back(open_ptrack::detection::SkeletonDetection(msg, source));
+          }
+        }
+
+        /** \brief Get the simulation time */
+        ros::Time
+        getTime()
+        {
+          return time_;
+        }
+    };
+
+  } /* namespace tracking */
+} /* namespace open_ptrack */
+
+#endif /* OPEN_PTRACK_TRACKING_BENCHMARK_SYNTHETIC_CROWD_H_ */
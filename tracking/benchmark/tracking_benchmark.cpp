@@ -0,0 +1,258 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2013-, Open Perception, Inc.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ * with the distribution.
+ * * Neither the name of the copyright holder(s) nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <chrono>
+#include <new>
+#include <benchmark/benchmark.h>
+#include <ros/ros.h>
+#include <open_ptrack/tracking/tracker.h>
+#include <open_ptrack/tracking/tracker3d.h>
+#include <open_ptrack/tracking/tracker_object.h>
+#include <open_ptrack/tracking/skeleton_tracker.h>
+#include "synthetic_crowd.h"
+
+// Heap allocations counter (only the tracker calls are accounted):
+static std::atomic<size_t> allocations(0);
+
+void*
+operator new(std::size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void* p = std::malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void
+operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void
+operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+namespace
+{
+  // Names of the tracking stages timed by StageTimedTracker:
+  enum Stage
+  {
+    NEW_FRAME, DISTANCE_MATRIX, COST_MATRIX, MUNKRES, UPDATE_DETECTED_TRACKS, UNASSOCIATED_DETECTIONS,
+    UPDATE_LOST_TRACKS, CREATE_NEW_TRACKS, STAGES_NUMBER
+  };
+  const char* STAGE_NAMES[STAGES_NUMBER] = {"newFrame", "createDistanceMatrix", "createCostMatrix", "munkres",
+      "updateDetectedTracks", "fillUnassociatedDetections", "updateLostTracks", "createNewTracks"};
+
+  /** \brief Tracker wrapper timing every stage of the association pipeline.
+   *
+   *  All the trackers share the same updateTracks() structure, so the wrapper can re-implement it
+   *  by calling the (protected) stages of the wrapped tracker.
+   */
+  template <typename TrackerT>
+  class StageTimedTracker : public TrackerT
+  {
+    protected:
+      typedef std::chrono::steady_clock Clock;
+
+      void
+      accumulate(Stage stage, Clock::time_point& start)
+      {
+        Clock::time_point end = Clock::now();
+        stage_seconds_[stage] += std::chrono::duration<double>(end - start).count();
+        start = end;
+      }
+
+    public:
+      /** \brief Seconds spent in every stage */
+      double stage_seconds_[STAGES_NUMBER];
+
+      StageTimedTracker(double gate_distance, std::vector<double> likelihood_weights, double position_variance,
+          double period) :
+        TrackerT(gate_distance, false, likelihood_weights, false, 4.0, -2.5, 8.0, 2.4, 1.2, 3, period,
+            position_variance, 100.0, "/world", false, false)
+      {
+        std::fill(stage_seconds_, stage_seconds_ + STAGES_NUMBER, 0.0);
+      }
+
+      template <typename DetectionVector>
+      void
+      process(const DetectionVector& detections)
+      {
+        Clock::time_point start = Clock::now();
+        TrackerT::newFrame(detections);
+        accumulate(NEW_FRAME, start);
+        updateTracks();
+      }
+
+      void
+      updateTracks()
+      {
+        Clock::time_point start = Clock::now();
+        this->createDistanceMatrix();
+        accumulate(DISTANCE_MATRIX, start);
+        this->createCostMatrix();
+        accumulate(COST_MATRIX, start);
+
+        // Solve Global Nearest Neighbor problem:
+        open_ptrack::tracking::Munkres munkres;
+        this->cost_matrix_ = munkres.solve(this->cost_matrix_, false);
+        accumulate(MUNKRES, start);
+
+        this->updateDetectedTracks();
+        accumulate(UPDATE_DETECTED_TRACKS, start);
+        this->fillUnassociatedDetections();
+        accumulate(UNASSOCIATED_DETECTIONS, start);
+        this->updateLostTracks();
+        accumulate(UPDATE_LOST_TRACKS, start);
+        this->createNewTracks();
+        accumulate(CREATE_NEW_TRACKS, start);
+      }
+  };
+
+  // Detection types produced by the synthetic crowd for every tracker:
+  template <typename TrackerT>
+  struct DetectionTraits
+  {
+    typedef open_ptrack::detection::Detection DetectionT;
+
+    static void
+    generate(open_ptrack::tracking::SyntheticCrowd& crowd, std::vector<DetectionT>& detections)
+    {
+      crowd.getDetections(detections);
+    }
+  };
+
+  template <>
+  struct DetectionTraits<open_ptrack::tracking::SkeletonTracker>
+  {
+    typedef open_ptrack::detection::SkeletonDetection DetectionT;
+
+    static void
+    generate(open_ptrack::tracking::SyntheticCrowd& crowd, std::vector<DetectionT>& detections)
+    {
+      crowd.getSkeletonDetections(detections);
+    }
+  };
+
+  /** \brief Benchmark one tracker on a crowd of state.range(0) people */
+  template <typename TrackerT>
+  void
+  BM_Tracking(benchmark::State& state)
+  {
+    typedef typename DetectionTraits<TrackerT>::DetectionT DetectionT;
+
+    open_ptrack::tracking::SyntheticCrowdParameters parameters;
+    parameters.people = state.range(0);
+    // Keep crowd density roughly constant (about one person every 4 square meters):
+    parameters.venue_width = parameters.venue_length = std::max(10.0, std::sqrt(4.0 * parameters.people));
+    parameters.max_range = parameters.venue_width;
+    open_ptrack::tracking::SyntheticCrowd crowd(parameters);
+
+    // Same parameters as the default people tracking configuration:
+    double voxel_size = 0.06;
+    std::vector<double> likelihood_weights;
+    likelihood_weights.push_back(-0.25 * 13.816 / 18.467);
+    likelihood_weights.push_back(0.5);
+    StageTimedTracker<TrackerT> tracker(4.605, likelihood_weights, std::pow(2 * voxel_size, 2) / 12.0,
+        1.0 / (parameters.rate * parameters.cameras));
+
+    // Warm-up, so that tracks are created and validated before measuring:
+    std::vector<DetectionT> detections;
+    for (int i = 0; i < 2 * parameters.rate * parameters.cameras; i++)
+    {
+      crowd.step();
+      DetectionTraits<TrackerT>::generate(crowd, detections);
+      if (detections.size() > 0)
+        tracker.process(detections);
+    }
+    std::fill(tracker.stage_seconds_, tracker.stage_seconds_ + STAGES_NUMBER, 0.0);
+
+    size_t allocations_number = 0;
+    size_t detections_number = 0;
+    for (auto _ : state)
+    {
+      state.PauseTiming();
+      crowd.step();
+      DetectionTraits<TrackerT>::generate(crowd, detections);
+      detections_number += detections.size();
+      size_t allocations_before = allocations.load(std::memory_order_relaxed);
+      state.ResumeTiming();
+
+      if (detections.size() > 0)
+        tracker.process(detections);
+
+      allocations_number += allocations.load(std::memory_order_relaxed) - allocations_before;
+    }
+
+    for (int i = 0; i < STAGES_NUMBER; i++)
+      state.counters[std::string(STAGE_NAMES[i]) + "_us"] =
+          benchmark::Counter(1e6 * tracker.stage_seconds_[i], benchmark::Counter::kAvgIterations);
+    state.counters["allocations"] = benchmark::Counter(allocations_number, benchmark::Counter::kAvgIterations);
+    state.counters["detections"] = benchmark::Counter(detections_number, benchmark::Counter::kAvgIterations);
+    state.counters["frames"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+  }
+}
+
+#define TRACKING_BENCHMARK(TrackerT) \
+  BENCHMARK_TEMPLATE(BM_Tracking, TrackerT)->Arg(1)->Arg(10)->Arg(50)->Arg(100)->Arg(200)->Arg(500)-> \
+      Unit(benchmark::kMicrosecond)
+
+TRACKING_BENCHMARK(open_ptrack::tracking::Tracker);
+TRACKING_BENCHMARK(open_ptrack::tracking::Tracker3D);
+TRACKING_BENCHMARK(open_ptrack::tracking::TrackerObject);
+TRACKING_BENCHMARK(open_ptrack::tracking::SkeletonTracker);
+
+int
+main(int argc, char** argv)
+{
+  // No ROS master is needed: only the time and the console are initialized.
+  ros::Time::init();
+  if (ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME, ros::console::levels::Warn))
+    ros::console::notifyLoggerLevelsChanged();
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
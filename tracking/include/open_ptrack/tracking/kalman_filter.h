@@ -44,18 +44,18 @@
 #include <opencv2/opencv.hpp>
 #include <Eigen/Eigen>
 #include <visualization_msgs/MarkerArray.h>
-#include <open_ptrack/bayes/allFilters.hpp>
+#include <open_ptrack/bayes/fixedFlt.hpp>
 
 namespace open_ptrack
 {
 namespace tracking
 {
 /** \brief PredictModel Prediction model (linear state predict model) */
-class PredictModel : public Bayesian_filter::Linear_predict_model
+class PredictModel : public Bayesian_filter::Fixed_linear_predict_model<4, 2>
 {
 protected:
   /* \brief time step */
-  const double dt_;
+  double dt_;
 
 public:
   /** \brief Constructor. */
@@ -65,8 +65,12 @@ public:
   virtual ~PredictModel();
 };
 
-/** \brief ObserveModel Observation model (linear observation is additive uncorrelated model) */
-class ObserveModel : public Bayesian_filter::Linear_uncorrelated_observe_model
+/** \brief ObserveModel Observation model (linear observation is additive uncorrelated model)
+ *
+ *  The output is the position (OutputDimension = 2) or the position and the velocity (OutputDimension = 4).
+ */
+template <int OutputDimension>
+class ObserveModel : public Bayesian_filter::Fixed_linear_uncorrelated_observe_model<4, OutputDimension>
 {
 protected:
   /** \brief Position variance. */
@@ -74,7 +78,7 @@ protected:
 
 public:
   /** \brief Constructor. */
-  ObserveModel(double position_variance, int ouput_dimension);
+  ObserveModel(double position_variance);
 
   /** \brief Destructor. */
   virtual ~ObserveModel();
@@ -85,13 +89,13 @@ class MahalanobisParameters2d
 {
 public:
 
-  MahalanobisParameters2d() : SI(Bayesian_filter_matrix::Empty), x(0), y(0)
+  MahalanobisParameters2d() : x(0), y(0)
   {
-    SI.resize(2, 2, false);
+    SI.setZero();
   }
 
   /** \brief Innovation covariance matrix. */
-  Bayesian_filter::FM::SymMatrix SI;
+  Eigen::Matrix<double, 2, 2, Eigen::DontAlign> SI;
 
   /** \brief Position x component. */
   double x;
@@ -105,13 +109,13 @@ class MahalanobisParameters4d
 {
 public:
 
-  MahalanobisParameters4d() : SI(Bayesian_filter_matrix::Empty), x(0), y(0), vx(0), vy(0)
+  MahalanobisParameters4d() : x(0), y(0), vx(0), vy(0)
   {
-    SI.resize(4, 4, false);
+    SI.setZero();
   }
 
   /** \brief Innovation covariance matrix. */
-  Bayesian_filter::FM::SymMatrix SI;
+  Eigen::Matrix<double, 4, 4, Eigen::DontAlign> SI;
 
   /** \brief Position x component. */
   double x;
@@ -129,6 +133,11 @@ public:
 /** \brief KalmanFilter provides methods for bayesian estimation with Kalman Filter. */
 class KalmanFilter
 {
+public:
+
+  /** \brief Unscented filter with fixed size state and observations (no heap allocations). */
+  typedef Bayesian_filter::Fixed_unscented_scheme<4> Filter;
+
 protected:
 
   /** \brief Time interval.*/
@@ -146,16 +155,21 @@ protected:
   /** \brief State/output dimension.*/
   int output_dimension_;
 
-  Bayesian_filter::Unscented_scheme* filter_;
+  Filter filter_;
 
   /** \brief Prediction model. */
-  PredictModel* predict_model_;
+  PredictModel predict_model_;
+
+  /** \brief Observation model of the position. */
+  ObserveModel<2> position_observe_model_;
 
-  /** \brief Observation model. */
-  ObserveModel* observe_model_;
+  /** \brief Observation model of the position and the velocity. */
+  ObserveModel<4> velocity_observe_model_;
 
 public:
 
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
   /** \brief Constructor. */
   KalmanFilter(double dt, double position_variance, double acceleration_variance, int output_dimension);
 
@@ -244,6 +258,17 @@ public:
   virtual void
   getState(double& x, double& y);
 
+  /**
+         * \brief Get the diagonal of the filter state covariance.
+         *
+         * \param[out] var_x Position x variance.
+         * \param[out] var_y Position y variance.
+         * \param[out] var_vx Velocity x variance.
+         * \param[out] var_vy Velocity y variance.
+         */
+  virtual void
+  getStateCovariance(double& var_x, double& var_y, double& var_vx, double& var_vy);
+
   /**
          * \brief Obtain variables for bayesian estimation with output dimension = 2.
          *
@@ -291,7 +316,7 @@ public:
          *
          * \return innovation covariance matrix.
          */
-  virtual Bayesian_filter::FM::SymMatrix
+  virtual Filter::SymMatrix_z
   getInnovationCovariance();
 
   /**
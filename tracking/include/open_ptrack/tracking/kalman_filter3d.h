@@ -44,18 +44,18 @@
 #include <opencv2/opencv.hpp>
 #include <Eigen/Eigen>
 #include <visualization_msgs/MarkerArray.h>
-#include <open_ptrack/bayes/allFilters.hpp>
+#include <open_ptrack/bayes/fixedFlt.hpp>
 
 namespace open_ptrack
 {
   namespace tracking
   {
     /** \brief PredictModel Prediction model (linear state predict model) */
-    class PredictModel3D : public Bayesian_filter::Linear_predict_model
+    class PredictModel3D : public Bayesian_filter::Fixed_linear_predict_model<6, 3>
     {
       protected:
         /* \brief time step */
-        const double dt_;
+        double dt_;
 
       public:
         /** \brief Constructor. */
@@ -65,8 +65,12 @@ namespace open_ptrack
         virtual ~PredictModel3D();
     };
 
-    /** \brief ObserveModel Observation model (linear observation is additive uncorrelated model) */
-    class ObserveModel3D : public Bayesian_filter::Linear_uncorrelated_observe_model
+    /** \brief ObserveModel Observation model (linear observation is additive uncorrelated model)
+     *
+     *  The output is the position (OutputDimension = 3) or the position and the velocity (OutputDimension = 6).
+     */
+    template <int OutputDimension>
+    class ObserveModel3D : public Bayesian_filter::Fixed_linear_uncorrelated_observe_model<6, OutputDimension>
     {
       protected:
         /** \brief Position variance. */
@@ -74,7 +78,7 @@ namespace open_ptrack
 
       public:
         /** \brief Constructor. */
-        ObserveModel3D(double position_variance, int ouput_dimension);
+        ObserveModel3D(double position_variance);
 
         /** \brief Destructor. */
         virtual ~ObserveModel3D();
@@ -85,13 +89,13 @@ namespace open_ptrack
     {
       public:
 
-        MahalanobisParameters3d() : SI(Bayesian_filter_matrix::Empty), x(0), y(0), z(0)
+        MahalanobisParameters3d() : x(0), y(0), z(0)
       {
-          SI.resize(3, 3, false);
+          SI.setZero();
       }
 
         /** \brief Innovation covariance matrix. */
-        Bayesian_filter::FM::SymMatrix SI;
+        Eigen::Matrix<double, 3, 3, Eigen::DontAlign> SI;
 
         /** \brief Position x component. */
         double x;
@@ -108,13 +112,13 @@ namespace open_ptrack
     {
       public:
 
-        MahalanobisParameters6d() : SI(Bayesian_filter_matrix::Empty), x(0), y(0), z(0), vx(0), vy(0), vz(0)
+        MahalanobisParameters6d() : x(0), y(0), z(0), vx(0), vy(0), vz(0)
       {
-          SI.resize(6, 6, false);
+          SI.setZero();
       }
 
         /** \brief Innovation covariance matrix. */
-        Bayesian_filter::FM::SymMatrix SI;
+        Eigen::Matrix<double, 6, 6, Eigen::DontAlign> SI;
 
         /** \brief Position x component. */
         double x;
@@ -138,6 +142,11 @@ namespace open_ptrack
     /** \brief KalmanFilter provides methods for bayesian estimation with Kalman Filter. */
     class KalmanFilter3D
     {
+      public:
+
+        /** \brief Unscented filter with fixed size state and observations (no heap allocations). */
+        typedef Bayesian_filter::Fixed_unscented_scheme<6> Filter;
+
       protected:
 
         /** \brief Time interval.*/
@@ -155,16 +164,21 @@ namespace open_ptrack
         /** \brief State/output dimension.*/
         int output_dimension_;
 
-        Bayesian_filter::Unscented_scheme* filter_;
+        Filter filter_;
 
         /** \brief Prediction model. */
-        PredictModel3D* predict_model_;
+        PredictModel3D predict_model_;
+
+        /** \brief Observation model of the position. */
+        ObserveModel3D<3> position_observe_model_;
 
-        /** \brief Observation model. */
-        ObserveModel3D* observe_model_;
+        /** \brief Observation model of the position and the velocity. */
+        ObserveModel3D<6> velocity_observe_model_;
 
       public:
 
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
         /** \brief Constructor. */
         KalmanFilter3D(double dt, double position_variance, double acceleration_variance, int output_dimension);
 
@@ -300,7 +314,7 @@ namespace open_ptrack
          *
          * \return innovation covariance matrix.
          */
-        virtual Bayesian_filter::FM::SymMatrix
+        virtual Filter::SymMatrix_z
         getInnovationCovariance();
 
         /**
@@ -0,0 +1,154 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2013-, Open Perception, Inc.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ * with the distribution.
+ * * Neither the name of the copyright holder(s) nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef OPEN_PTRACK_TRACKING_OUTPUT_SCHEDULER_H_
+#define OPEN_PTRACK_TRACKING_OUTPUT_SCHEDULER_H_
+
+#include <map>
+#include <ros/ros.h>
+#include <opt_msgs/TrackArray.h>
+#include <opt_msgs/TrackDeltaArray.h>
+
+namespace open_ptrack
+{
+  namespace tracking
+  {
+    /** \brief OutputScheduler decides when tracking results have to be published and which tracks changed
+     *  since the last publication.
+     *
+     *  Tracks are compared against the last published state, so small movements accumulate until they
+     *  exceed the position threshold. A full snapshot (keyframe) is emitted every keyframe_interval seconds.
+     */
+    class OutputScheduler
+    {
+      protected:
+        /** \brief Minimum time between two publications (0 means no rate limit) */
+        double min_period_;
+
+        /** \brief If true, nothing is published when no track changed significantly */
+        bool on_change_;
+
+        /** \brief Minimum position change (in meters) for a track to be considered changed */
+        double min_position_change_;
+
+        /** \brief Maximum time between two keyframes */
+        double keyframe_interval_;
+
+        /** \brief Time of the last publication */
+        ros::Time last_output_time_;
+
+        /** \brief Time of the last keyframe */
+        ros::Time last_keyframe_time_;
+
+        /** \brief Last published state of every track, indexed by track ID */
+        std::map<int, opt_msgs::Track> published_tracks_;
+
+        /** \brief Return true if track differs significantly from the published one */
+        bool
+        hasChanged(const opt_msgs::Track& published, const opt_msgs::Track& track) const;
+
+      public:
+        /** \brief Constructor */
+        OutputScheduler(double output_rate, bool on_change, double min_position_change, double keyframe_interval);
+
+        /** \brief Destructor */
+        virtual ~OutputScheduler();
+
+        /**
+         * \brief Check if the rate limit allows a new publication.
+         *
+         * \param[in] now Current time.
+         *
+         * \return true if enough time passed since the last publication.
+         */
+        bool
+        isDue(const ros::Time& now) const;
+
+        /**
+         * \brief Compare the current tracks with the last published ones and fill a delta message.
+         *
+         * \param[in] tracks Current tracking results.
+         * \param[in] now Current time.
+         * \param[out] delta_msg Delta message containing changed and removed tracks (or all tracks if keyframe).
+         *
+         * \return true if tracks have to be published now, false if the output has to be suppressed.
+         */
+        bool
+        schedule(const opt_msgs::TrackArray& tracks, const ros::Time& now, opt_msgs::TrackDeltaArray::Ptr& delta_msg);
+
+        /**
+         * \brief Force the next call to schedule() to produce a keyframe.
+         */
+        void
+        requestKeyframe();
+
+        /**
+         * \brief Set output rate.
+         *
+         * \param[in] output_rate Maximum publication rate (0 means no rate limit).
+         */
+        void
+        setOutputRate (double output_rate);
+
+        /**
+         * \brief Set flag enabling change suppression.
+         *
+         * \param[in] on_change If true, nothing is published when no track changed significantly.
+         */
+        void
+        setOnChange (bool on_change);
+
+        /**
+         * \brief Set minimum position change for a track to be considered changed.
+         *
+         * \param[in] min_position_change Minimum position change (in meters).
+         */
+        void
+        setMinPositionChange (double min_position_change);
+
+        /**
+         * \brief Set maximum time between two keyframes.
+         *
+         * \param[in] keyframe_interval Maximum time between two keyframes (in seconds).
+         */
+        void
+        setKeyframeInterval (double keyframe_interval);
+    };
+
+  } /* namespace tracking */
+} /* namespace open_ptrack */
+
+#endif /* OPEN_PTRACK_TRACKING_OUTPUT_SCHEDULER_H_ */
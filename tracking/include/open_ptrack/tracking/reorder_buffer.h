@@ -0,0 +1,204 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2013-, Open Perception, Inc.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ * with the distribution.
+ * * Neither the name of the copyright holder(s) nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef OPEN_PTRACK_TRACKING_REORDER_BUFFER_H_
+#define OPEN_PTRACK_TRACKING_REORDER_BUFFER_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include <ros/ros.h>
+#include <opt_msgs/DetectionArray.h>
+
+namespace open_ptrack
+{
+  namespace tracking
+  {
+    /** \brief ReorderBuffer sorts detection messages coming from a network of cameras by timestamp.
+     *
+     *  A message is released as soon as every active camera has reported a message past its timestamp
+     *  (watermark), or when the deadline of the cameras still missing expires. Deadlines adapt to the
+     *  observed rate and transport delay of every camera. Messages older than the last released one are
+     *  late: they cannot be sorted anymore and are released apart, in a bounded queue, so that only the tracks
+     *  they affect are updated out of order. Messages later than the maximum lateness are dropped.
+     */
+    class ReorderBuffer
+    {
+      public:
+        /** \brief Outcome of the insertion of a message */
+        enum PushResult
+        {
+          BUFFERED,         // Message sorted with the others
+          LATE,             // Message older than the watermark, queued for the out-of-order update
+          TOO_LATE,         // Message older than the watermark by more than the maximum lateness, dropped
+          LATE_QUEUE_FULL   // Late message dropped because the late queue is full
+        };
+
+      protected:
+        /** \brief Statistics of the messages received from a camera */
+        struct CameraStatistics
+        {
+          /** \brief Timestamp of the last message */
+          ros::Time last_stamp;
+
+          /** \brief Arrival time of the last message */
+          ros::Time last_arrival;
+
+          /** \brief Average period between two messages (seconds) */
+          double period;
+
+          /** \brief Average transport delay and its average deviation (seconds) */
+          double delay;
+          double delay_deviation;
+
+          /** \brief Number of messages received */
+          unsigned int messages;
+        };
+
+        /** \brief Statistics of every camera, indexed by frame_id */
+        std::map<std::string, CameraStatistics> cameras_;
+
+        /** \brief Buffered messages, sorted by timestamp */
+        std::multimap<ros::Time, opt_msgs::DetectionArray::ConstPtr> buffer_;
+
+        /** \brief Late messages waiting to be released */
+        std::vector<opt_msgs::DetectionArray::ConstPtr> late_messages_;
+
+        /** \brief Timestamp of the last released message */
+        ros::Time watermark_;
+
+        /** \brief Minimum and maximum time (seconds) to wait for a camera past a timestamp */
+        double min_deadline_;
+        double max_deadline_;
+
+        /** \brief Maximum time (seconds) a late message can be older than the watermark */
+        double max_lateness_;
+
+        /** \brief Maximum number of buffered messages (the oldest are released when exceeded) and of late messages */
+        unsigned int queue_size_;
+
+        /** \brief Time (seconds) after which a silent camera is no longer waited for */
+        double camera_timeout_;
+
+        /** \brief Number of late messages queued for the out-of-order update */
+        unsigned int late_messages_number_;
+
+        /** \brief Number of late messages dropped */
+        unsigned int dropped_messages_number_;
+
+        /** \brief Return the time to wait for a camera past a timestamp */
+        double
+        getDeadline(const CameraStatistics& camera) const;
+
+        /** \brief Return true if the message with the given timestamp can be released */
+        bool
+        isReady(const ros::Time& stamp, const ros::Time& now) const;
+
+      public:
+        /** \brief Constructor */
+        ReorderBuffer(double min_deadline, double max_deadline, double max_lateness, unsigned int queue_size,
+            double camera_timeout);
+
+        /** \brief Destructor */
+        virtual ~ReorderBuffer();
+
+        /**
+         * \brief Insert a new detection message.
+         *
+         * \param[in] msg Detection message.
+         * \param[in] now Arrival time of the message.
+         *
+         * \return BUFFERED or LATE if the message will be released, the reason of the drop otherwise.
+         */
+        PushResult
+        push(const opt_msgs::DetectionArray::ConstPtr& msg, const ros::Time& now);
+
+        /**
+         * \brief Release the messages which can be processed.
+         *
+         * \param[in] now Current time.
+         * \param[out] messages Released messages, sorted by timestamp.
+         * \param[out] late_messages Released late messages, sorted by timestamp (all older than messages).
+         */
+        void
+        pop(const ros::Time& now, std::vector<opt_msgs::DetectionArray::ConstPtr>& messages,
+            std::vector<opt_msgs::DetectionArray::ConstPtr>& late_messages);
+
+        /**
+         * \brief Set the maximum time a late message can be older than the watermark.
+         *
+         * \param[in] max_lateness Maximum lateness (seconds).
+         */
+        void
+        setMaxLateness(double max_lateness);
+
+        /**
+         * \brief Get the timestamp of the last released message.
+         *
+         * \return the watermark.
+         */
+        ros::Time
+        getWatermark() const;
+
+        /**
+         * \brief Get the number of buffered messages.
+         *
+         * \return the number of buffered messages.
+         */
+        size_t
+        size() const;
+
+        /**
+         * \brief Get the number of late messages queued for the out-of-order update.
+         *
+         * \return the number of late messages.
+         */
+        unsigned int
+        getLateMessagesNumber() const;
+
+        /**
+         * \brief Get the number of late messages dropped.
+         *
+         * \return the number of dropped messages.
+         */
+        unsigned int
+        getDroppedMessagesNumber() const;
+    };
+
+  } /* namespace tracking */
+} /* namespace open_ptrack */
+
+#endif /* OPEN_PTRACK_TRACKING_REORDER_BUFFER_H_ */
@@ -0,0 +1,177 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2013-, Open Perception, Inc.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ * with the distribution.
+ * * Neither the name of the copyright holder(s) nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef OPEN_PTRACK_TRACKING_SKELETON_JOINT_FILTER_H_
+#define OPEN_PTRACK_TRACKING_SKELETON_JOINT_FILTER_H_
+
+#include <vector>
+#include <Eigen/Eigen>
+#include <ros/ros.h>
+#include <geometry_msgs/Point.h>
+#include <rtpose_wrapper/Joint3DMsg.h>
+#include <body_pose_estimation/skeleton_base.h>
+
+namespace open_ptrack
+{
+  namespace tracking
+  {
+    /** \brief SkeletonJointFilter filters the positions of all the joints of a skeleton at once.
+     *
+     *  Every joint follows the same constant velocity model of KalmanFilter3D, with position-only
+     *  observations. Since the model is linear and its axes are independent with equal noise, each
+     *  joint axis is an exact two-state Kalman filter and the three axes share the same covariance.
+     *  States and covariances of all the joints are stored as arrays (one element per joint), so that
+     *  prediction and update are performed for the whole skeleton in a single vectorized pass.
+     *  Joints with non-finite coordinates are masked and keep their previous state.
+     */
+    class SkeletonJointFilter
+    {
+      public:
+        /** \brief One value per skeleton joint */
+        typedef Eigen::Array<double, open_ptrack::bpe::SkeletonJoints::SIZE, 1> JointArray;
+
+        /** \brief One flag per skeleton joint */
+        typedef Eigen::Array<bool, open_ptrack::bpe::SkeletonJoints::SIZE, 1> JointMask;
+
+        /** \brief Joint positions, one column per skeleton joint */
+        typedef Eigen::Matrix<double, 3, open_ptrack::bpe::SkeletonJoints::SIZE> JointMatrix;
+
+      protected:
+        /** \brief Time step of the motion model */
+        double period_;
+
+        /** \brief Observation noise variance */
+        double position_variance_;
+
+        /** \brief Multiplier of the distance dependent observation noise */
+        double depth_multiplier_;
+
+        /** \brief Acceleration noise variance */
+        double acceleration_variance_;
+
+        /** \brief Joint positions and velocities */
+        JointArray x_, y_, z_, vx_, vy_, vz_;
+
+        /** \brief Position/velocity covariance of every joint (the same for the three axes) */
+        JointArray p00_, p01_, p11_;
+
+        /** \brief Time of the last update of every joint (in seconds) */
+        JointArray last_update_;
+
+        /** \brief Read joint coordinates into arrays, returning the mask of finite joints */
+        JointMask
+        readJoints(const std::vector<rtpose_wrapper::Joint3DMsg>& joints, JointArray& x, JointArray& y,
+            JointArray& z) const;
+
+      public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        /** \brief Constructor. */
+        SkeletonJointFilter(double period, double position_variance, double acceleration_variance);
+
+        /** \brief Destructor. */
+        virtual ~SkeletonJointFilter();
+
+        /**
+         * \brief Initialize joint states with zero velocity.
+         *
+         * \param[in] joints Joint positions.
+         * \param[in] time Time of the joint positions.
+         */
+        void
+        init(const std::vector<rtpose_wrapper::Joint3DMsg>& joints, const ros::Time& time);
+
+        /**
+         * \brief Predict joint states up to a new observation and update them with it.
+         *
+         * \param[in] joints Joint positions (joints with non-finite coordinates are not updated).
+         * \param[in] time Time of the joint positions.
+         */
+        void
+        update(const std::vector<rtpose_wrapper::Joint3DMsg>& joints, const ros::Time& time);
+
+        /**
+         * \brief Predict joint positions at a given time, without changing the filter state.
+         *
+         * \param[in] time Prediction time.
+         * \param[out] positions Predicted joint positions.
+         * \param[out] variances Predicted position variance of every joint (the same for the three axes).
+         */
+        void
+        predict(const ros::Time& time, JointMatrix& positions, JointArray& variances) const;
+
+        /**
+         * \brief Get the position of a joint.
+         *
+         * \param[in] joint Joint index.
+         * \param[out] x Joint x.
+         * \param[out] y Joint y.
+         * \param[out] z Joint z.
+         */
+        void
+        getState(int joint, double& x, double& y, double& z) const;
+
+        /**
+         * \brief Get the position of a joint.
+         *
+         * \param[in] joint Joint index.
+         *
+         * \return the joint position.
+         */
+        geometry_msgs::Point
+        getState(int joint) const;
+
+        /**
+         * \brief Set acceleration variance.
+         *
+         * \param[in] acceleration_variance Acceleration noise variance.
+         */
+        void
+        setAccelerationVariance (double acceleration_variance);
+
+        /**
+         * \brief Set position variance.
+         *
+         * \param[in] position_variance Observation noise variance.
+         */
+        void
+        setPositionVariance (double position_variance);
+    };
+
+  } /* namespace tracking */
+} /* namespace open_ptrack */
+
+#endif /* OPEN_PTRACK_TRACKING_SKELETON_JOINT_FILTER_H_ */
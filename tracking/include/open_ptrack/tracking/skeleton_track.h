@@ -47,13 +47,11 @@
 #include <pcl_ros/point_cloud.h>
 #include <pcl/point_types.h>
 #include <open_ptrack/opt_utils/conversions.h>
-#include <open_ptrack/tracking/kalman_filter3d.h>
+#include <open_ptrack/tracking/skeleton_joint_filter.h>
 #include <open_ptrack/bayes/bayesFlt.hpp>
 #include <open_ptrack/detection/detection_source.h>
 #include <open_ptrack/detection/skeleton_detection.h>
 #include <open_ptrack/tracking/track.h>
-#include <open_ptrack/tracking/track3d.h>
-#include <open_ptrack/tracking/tracker3d.h>
 #include <opt_msgs/Track3D.h>
 #include <opt_msgs/SkeletonTrack.h>
 #include <memory>
@@ -72,7 +70,8 @@ private:
   isValid(const rtpose_wrapper::Joint3DMsg& joint);
 protected:
 
-  std::vector<Track3D*> joint_tracks_;
+  /** \brief Filter of all the skeleton joints */
+  SkeletonJointFilter joint_filter_;
   std::vector<rtpose_wrapper::Joint3DMsg> raw_joints_tmp_;
   bool all_joint_tracks_initialized_;
 
@@ -80,6 +79,7 @@ protected:
   int debug_count_;
 
 public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
   /** \brief Constructor. */
   SkeletonTrack(int id,
@@ -138,6 +138,19 @@ public:
   bool
   areJointsInitialized();
 
+  /**
+   * \brief Predict joint positions at a given time.
+   *
+   * \param[in] time Prediction time.
+   * \param[out] positions Predicted joint positions (world frame).
+   * \param[out] variances Predicted position variance of every joint.
+   *
+   * \return false if joint states are not initialized yet.
+   */
+  bool
+  getPredictedJoints(const ros::Time& time, SkeletonJointFilter::JointMatrix& positions,
+                     SkeletonJointFilter::JointArray& variances) const;
+
   friend std::ostream&
   operator<< (std::ostream& ss, const SkeletonTrack& s);
 };
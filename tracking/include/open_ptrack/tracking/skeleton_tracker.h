@@ -82,6 +82,12 @@ protected:
   /** \brief List of current detections not associated to any track */
   std::list<open_ptrack::detection::SkeletonDetection> unassociated_detections_;
 
+  /** \brief Weight of the joint distance in the association cost */
+  double joint_weight_;
+
+  /** \brief Robust mean distance between predicted and detected joints (only for gated pairs) */
+  cv::Mat_<double> joint_distance_matrix_;
+
   void
   createDistanceMatrix();
 
@@ -126,7 +132,8 @@ public:
             min_confidence_detections, sec_before_old, sec_before_fake,
             sec_remain_new, detections_to_validate, period,
             position_variance, acceleration_variance,
-            world_frame_id, debug_mode, vertical)
+            world_frame_id, debug_mode, vertical),
+    joint_weight_(0.25)
   {  }
   /** \brief Destructor */
   virtual ~SkeletonTracker();
@@ -150,6 +157,14 @@ public:
   void
   toSkeletonMarkerArray(visualization_msgs::MarkerArray::Ptr& msg);
 
+  /**
+   * \brief Set the weight of the joint distance in the association cost.
+   *
+   * \param[in] joint_weight Weight of the joint distance (0 means centroid-only association).
+   */
+  void
+  setJointWeight (double joint_weight);
+
 };
 
 } /* namespace tracking */
@@ -43,11 +43,14 @@
 #include <opencv2/opencv.hpp>
 #include <Eigen/Eigen>
 #include <cmath>
+#include <deque>
+#include <boost/shared_ptr.hpp>
 #include <visualization_msgs/MarkerArray.h>
 #include <pcl_ros/point_cloud.h>
 #include <pcl/point_types.h>
 #include <open_ptrack/opt_utils/conversions.h>
 #include <open_ptrack/tracking/kalman_filter.h>
+#include <open_ptrack/tracking/track_history.h>
 #include <open_ptrack/bayes/bayesFlt.hpp>
 #include <open_ptrack/detection/detection_source.h>
 #include <opt_msgs/Track.h>
@@ -78,6 +81,14 @@ namespace open_ptrack
 
       protected:
 
+        /** \brief Measurement applied to the Kalman filter, with the filter state after the update */
+        struct FilterUpdate
+        {
+          ros::Time time;
+          double x, y, vx, vy, distance;
+          boost::shared_ptr<open_ptrack::tracking::KalmanFilter> filter;
+        };
+
         /** \brief Dimension of a circular buffer which keep tracks of filter parameters along time */
         int MAX_SIZE;
 
@@ -159,6 +170,44 @@ namespace open_ptrack
         /** \brief Count the number of consecutive updates with low confidence detections */
         int low_confidence_consecutive_frames_;
 
+        /** \brief Filter updates within the circular buffer horizon, sorted by time (replayed after a late detection) */
+        std::deque<FilterUpdate> filter_updates_;
+
+        /** \brief Get the index in the circular buffer corresponding to a time instant */
+        int
+        getIndex(const ros::Time& time);
+
+        /** \brief Store the Mahalanobis parameters of a filter in the circular buffer */
+        void
+        storeMahalanobisParameters(open_ptrack::tracking::KalmanFilter& filter, int index);
+
+        /**
+         * \brief Compute the velocity measure of a detection from the track position one second before.
+         *
+         * \param[in] x Detection centroid x coordinate.
+         * \param[in] y Detection centroid y coordinate.
+         * \param[in] when Detection time.
+         * \param[in] reference Time instant the velocity is computed with respect to.
+         * \param[out] vx Velocity along x.
+         * \param[out] vy Velocity along y.
+         */
+        void
+        getVelocityMeasure(double x, double y, const ros::Time& when, const ros::Time& reference,
+            double& vx, double& vy);
+
+        /** \brief Bring a filter from a time instant to the time of a measurement and update it */
+        void
+        applyMeasurement(open_ptrack::tracking::KalmanFilter& filter, const ros::Time& from,
+            const FilterUpdate& measure);
+
+        /** \brief Append a filter update to the log and forget the ones out of the circular buffer horizon */
+        void
+        addFilterUpdate(const FilterUpdate& filter_update);
+
+        /** \brief Restart the filter update log from the current filter state */
+        void
+        resetFilterUpdates();
+
       public:
 
         /** \brief Constructor. */
@@ -223,6 +272,44 @@ namespace open_ptrack
             open_ptrack::detection::DetectionSource* detection_source,
             bool first_update = false);
 
+        /**
+         * \brief Check if a detection older than the last one associated to the track can still update it.
+         *
+         * \param[in] time Detection time.
+         *
+         * \return true if the track existed at that time and its filter updates since then are known.
+         */
+        virtual bool
+        canUpdateLate(const ros::Time& time);
+
+        /**
+         * \brief Update track with a detection older than the last one associated to it.
+         *
+         * The filter is rolled back to the last update before the detection, updated with it and then with every
+         * later measurement again. Visibility, age and DetectionSource keep referring to the latest detection.
+         *
+         * \param[in] x Detection centroid x coordinate
+         * \param[in] y Detection centroid y coordinate
+         * \param[in] z Detection centroid z coordinate
+         * \param[in] height Detection height
+         * \param[in] distance Detection distance from the sensor
+         * \param[in] confidence Detection confidence
+         * \param[in] min_confidence Minimum confidence for track initialization
+         * \param[in] min_confidence_detections Minimum confidence for detection
+         * \param[in] detection_source DetectionSource which provided the detection
+         */
+        virtual void
+        updateLate(
+            double x,
+            double y,
+            double z,
+            double height,
+            double distance,
+            double confidence,
+            double min_confidence,
+            double min_confidence_detections,
+            open_ptrack::detection::DetectionSource* detection_source);
+
         /**
          * \brief Compute Mahalanobis distance between detection with position (x,y) and track.
          *
@@ -235,6 +322,19 @@ namespace open_ptrack
         virtual double
         getMahalanobisDistance(double x, double y, const ros::Time& when);
 
+        /**
+         * \brief Compute Mahalanobis distance between a late detection with position (x,y) and the track state
+         * predicted from the last update before the detection.
+         *
+         * \param[in] x Detection centroid x coordinate.
+         * \param[in] y Detection centroid y coordinate.
+         * \param[in] when Detection time (canUpdateLate must be true).
+         *
+         * \return the Mahalanobis distance.
+         */
+        virtual double
+        getLateMahalanobisDistance(double x, double y, const ros::Time& when);
+
         /* Validate a track */
         virtual void
         validate();
@@ -362,6 +462,14 @@ namespace open_ptrack
         virtual void
         toMsg(opt_msgs::Track& track_msg, bool vertical);
 
+        /**
+         * \brief Fill a track history record with the current track state.
+         *
+         * \param[in/out] record Track history record (time and source are not modified).
+         */
+        virtual void
+        toHistoryRecord(TrackHistoryRecord& record);
+
         /**
          * \brief Get the DetectionSource corresponding to the last associated detection.
          *
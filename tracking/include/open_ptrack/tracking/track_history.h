@@ -0,0 +1,328 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2013-, Open Perception, Inc.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ * with the distribution.
+ * * Neither the name of the copyright holder(s) nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef OPEN_PTRACK_TRACKING_TRACK_HISTORY_H_
+#define OPEN_PTRACK_TRACKING_TRACK_HISTORY_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <thread>
+
+namespace open_ptrack
+{
+  namespace tracking
+  {
+    /** \brief TrackHistoryRecord contains the state of a track at a given time */
+    struct TrackHistoryRecord
+    {
+      /** \brief Time of the state (in seconds) */
+      double time;
+
+      /** \brief Track ID */
+      int32_t id;
+
+      /** \brief Track centroid */
+      float x, y, z;
+
+      /** \brief Track height */
+      float height;
+
+      /** \brief Track velocity */
+      float vx, vy;
+
+      /** \brief Diagonal of the state covariance matrix */
+      float var_x, var_y, var_vx, var_vy;
+
+      /** \brief Track visibility (see Track::Visibility) */
+      uint8_t visibility;
+
+      /** \brief Index of the camera which provided the last detection associated to the track */
+      uint16_t source;
+    };
+
+    /** \brief Constants describing the on-disk layout of a track history segment.
+     *
+     *  A segment is a file made of a TrackHistorySegmentHeader followed by one column per
+     *  TrackHistoryRecord field. Every column has room for capacity elements and starts at a
+     *  64-byte aligned offset, so that a query only touches the columns it needs.
+     */
+    namespace track_history
+    {
+      /** \brief Segment file magic number */
+      const char MAGIC[8] = {'O', 'P', 'T', 'T', 'H', 'I', 'S', 'T'};
+
+      /** \brief Segment format version */
+      const uint32_t VERSION = 1;
+
+      /** \brief Segment file extension */
+      const std::string EXTENSION = ".opth";
+
+      /** \brief Maximum number of cameras stored in the sources table */
+      const int MAX_SOURCES = 64;
+
+      /** \brief Maximum length of a camera name (including terminator) */
+      const int SOURCE_NAME_LENGTH = 64;
+
+      /** \brief Columns of a segment */
+      enum Column
+      {
+        TIME, ID, X, Y, Z, HEIGHT, VX, VY, VAR_X, VAR_Y, VAR_VX, VAR_VY, VISIBILITY, SOURCE,
+        COLUMNS_NUMBER
+      };
+
+      /** \brief Size in bytes of an element of each column */
+      size_t
+      columnElementSize (Column column);
+
+      /** \brief Offset in bytes of a column from the beginning of a segment with given capacity */
+      size_t
+      columnOffset (Column column, uint32_t capacity);
+
+      /** \brief Total size in bytes of a segment with given capacity */
+      size_t
+      segmentSize (uint32_t capacity);
+    } /* namespace track_history */
+
+    /** \brief TrackHistorySegmentHeader is the header at the beginning of every segment file */
+    struct TrackHistorySegmentHeader
+    {
+      char magic[8];
+      uint32_t version;
+      uint32_t capacity;
+
+      /** \brief Number of records written to the segment (updated after the columns) */
+      uint64_t count;
+
+      /** \brief Time range and ID range of the records in the segment */
+      double min_time, max_time;
+      int32_t min_id, max_id;
+
+      /** \brief Table of camera names referenced by the source column */
+      uint32_t sources_number;
+      char sources[track_history::MAX_SOURCES][track_history::SOURCE_NAME_LENGTH];
+    };
+
+    /** \brief TrackHistoryWriter appends track states to memory-mapped, columnar segment files.
+     *
+     *  push() is meant to be called by the tracking thread: it only copies the record into a
+     *  single-producer/single-consumer lock-free queue. A background thread moves records from the
+     *  queue to the current segment and opens a new segment when the current one is full.
+     */
+    class TrackHistoryWriter
+    {
+      protected:
+        /** \brief Directory containing the segment files */
+        const std::string directory_;
+
+        /** \brief Number of records per segment */
+        const uint32_t segment_capacity_;
+
+        /** \brief Ring buffer between the tracking thread and the writer thread */
+        std::vector<TrackHistoryRecord> queue_;
+
+        /** \brief Index of the next record to be read by the writer thread */
+        std::atomic<size_t> queue_head_;
+
+        /** \brief Index of the next record to be written by the tracking thread */
+        std::atomic<size_t> queue_tail_;
+
+        /** \brief Number of records dropped because the queue was full */
+        std::atomic<size_t> dropped_records_;
+
+        /** \brief Camera name to source index map (used by the tracking thread only) */
+        std::map<std::string, uint16_t> source_indices_;
+
+        /** \brief Camera names table shared with the writer thread */
+        char source_names_[track_history::MAX_SOURCES][track_history::SOURCE_NAME_LENGTH];
+
+        /** \brief Number of valid entries in source_names_ */
+        std::atomic<uint32_t> sources_number_;
+
+        /** \brief Flag stopping the writer thread */
+        std::atomic<bool> running_;
+
+        /** \brief Writer thread */
+        std::thread thread_;
+
+        /** \brief Counter used to name segment files */
+        int segment_counter_;
+
+        /** \brief File descriptor of the current segment */
+        int segment_fd_;
+
+        /** \brief Memory mapping of the current segment */
+        char* segment_data_;
+
+        /** \brief Header of the current segment */
+        TrackHistorySegmentHeader* header_;
+
+        /** \brief Writer thread main loop */
+        void
+        run();
+
+        /** \brief Create and map a new segment file */
+        bool
+        openSegment();
+
+        /** \brief Flush and unmap the current segment file */
+        void
+        closeSegment();
+
+        /** \brief Write a record at the end of the current segment */
+        void
+        writeRecord(const TrackHistoryRecord& record);
+
+      public:
+        /**
+         * \brief Constructor.
+         *
+         * \param[in] directory Directory where segment files are written.
+         * \param[in] segment_capacity Number of records per segment.
+         * \param[in] queue_size Maximum number of records waiting to be written.
+         */
+        TrackHistoryWriter(const std::string& directory, uint32_t segment_capacity, size_t queue_size);
+
+        /** \brief Destructor. Writes pending records and closes the current segment. */
+        virtual ~TrackHistoryWriter();
+
+        /**
+         * \brief Enqueue a record. Lock-free and allocation-free.
+         *
+         * \param[in] record The record to append.
+         *
+         * \return false if the queue is full and the record has been dropped.
+         */
+        bool
+        push(const TrackHistoryRecord& record);
+
+        /**
+         * \brief Get the index of a camera in the sources table, adding it if needed.
+         * Must be called from the same thread which calls push().
+         *
+         * \param[in] frame_id Camera frame id.
+         *
+         * \return the source index.
+         */
+        uint16_t
+        getSourceIndex(const std::string& frame_id);
+
+        /**
+         * \brief Get the number of records dropped because the queue was full.
+         */
+        size_t
+        getDroppedRecords();
+    };
+
+    /** \brief TrackHistoryReader reads track states written by TrackHistoryWriter */
+    class TrackHistoryReader
+    {
+      protected:
+        /** \brief A memory-mapped segment */
+        struct Segment
+        {
+          std::string filename;
+          size_t size;
+          char* data;
+          const TrackHistorySegmentHeader* header;
+
+          /** \brief Conversion from the source indices of the segment to the reader source indices */
+          std::vector<uint16_t> sources;
+        };
+
+        /** \brief Opened segments, sorted by file name (i.e. by creation time) */
+        std::vector<Segment> segments_;
+
+        /** \brief Camera names of all the segments */
+        std::vector<std::string> sources_;
+
+        /** \brief Map a segment file, returning false if it is not a valid segment */
+        bool
+        openSegment(const std::string& filename, Segment& segment);
+
+        /** \brief Return a pointer to a column of a segment */
+        template <typename T> const T*
+        column(const Segment& segment, track_history::Column column) const;
+
+      public:
+        /**
+         * \brief Constructor. Maps all the segments found in a directory.
+         *
+         * \param[in] directory Directory containing the segment files.
+         */
+        TrackHistoryReader(const std::string& directory);
+
+        /** \brief Destructor. */
+        virtual ~TrackHistoryReader();
+
+        /**
+         * \brief Get the number of segments.
+         */
+        size_t
+        getSegmentsNumber();
+
+        /**
+         * \brief Get the total number of records.
+         */
+        size_t
+        getRecordsNumber();
+
+        /**
+         * \brief Get the name of a camera.
+         *
+         * \param[in] source Source index of a record returned by query().
+         */
+        std::string
+        getSourceName(uint16_t source);
+
+        /**
+         * \brief Read the records within a time range, optionally for a single track.
+         *
+         * \param[in] start_time Beginning of the time range (in seconds).
+         * \param[in] end_time End of the time range (in seconds).
+         * \param[in] id Track ID (a negative value selects all tracks).
+         * \param[out] records Records matching the query, in the order they have been written.
+         */
+        void
+        query(double start_time, double end_time, int id, std::vector<TrackHistoryRecord>& records);
+    };
+
+  } /* namespace tracking */
+} /* namespace open_ptrack */
+
+#endif /* OPEN_PTRACK_TRACKING_TRACK_HISTORY_H_ */
@@ -43,6 +43,7 @@
 #include <open_ptrack/detection/detection.h>
 #include <open_ptrack/tracking/track.h>
 #include <open_ptrack/tracking/munkres.h>
+#include <open_ptrack/tracking/track_history.h>
 #include <opt_msgs/TrackArray.h>
 #include <opt_msgs/IDArray.h>
 #include <visualization_msgs/MarkerArray.h>
@@ -185,6 +186,18 @@ namespace open_ptrack
         virtual void
         updateTracks();
 
+        /**
+         * \brief Update the tracks with a set of detections older than the last processed ones.
+         *
+         * Detections are associated to the tracks existing at their time, using the track states predicted
+         * at that time, and only the associated tracks are updated out of order. Late detections neither
+         * create tracks nor change their visibility.
+         *
+         * \param[in] detections Vector of late detections (with the same time).
+         */
+        virtual void
+        updateLateTracks(const std::vector<open_ptrack::detection::Detection>& detections);
+
 //        /**
 //         * \brief Draw the tracks into the RGB image given by its sensor.
 //         */
@@ -248,6 +261,15 @@ namespace open_ptrack
         appendToPointCloud(pcl::PointCloud<pcl::PointXYZRGB>::Ptr& pointcloud,
             size_t starting_index, size_t max_size);
 
+        /**
+         * \brief Appends the state of each track to a track history.
+         *
+         * \param[in] writer The track history writer.
+         * \param[in] time Time of the tracks state.
+         */
+        virtual void
+        appendToHistory(TrackHistoryWriter* writer, const ros::Time& time);
+
         /**
          * \brief Set minimum confidence for track initialization
          *
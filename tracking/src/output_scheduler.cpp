@@ -0,0 +1,155 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2013-, Open Perception, Inc.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ * with the distribution.
+ * * Neither the name of the copyright holder(s) nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <open_ptrack/tracking/output_scheduler.h>
+
+namespace open_ptrack
+{
+namespace tracking
+{
+
+OutputScheduler::OutputScheduler(double output_rate, bool on_change, double min_position_change, double keyframe_interval) :
+  on_change_(on_change),
+  min_position_change_(min_position_change),
+  keyframe_interval_(keyframe_interval)
+{
+  setOutputRate (output_rate);
+  last_output_time_ = ros::Time(0);
+  last_keyframe_time_ = ros::Time(0);
+}
+
+OutputScheduler::~OutputScheduler()
+{
+
+}
+
+bool
+OutputScheduler::isDue(const ros::Time& now) const
+{
+  return (now - last_output_time_).toSec() >= min_period_;
+}
+
+bool
+OutputScheduler::schedule(const opt_msgs::TrackArray& tracks, const ros::Time& now, opt_msgs::TrackDeltaArray::Ptr& delta_msg)
+{
+  if (!isDue(now))
+    return false;
+
+  delta_msg->header = tracks.header;
+  delta_msg->keyframe = (now - last_keyframe_time_).toSec() >= keyframe_interval_;
+  delta_msg->tracks.clear();
+  delta_msg->removed_ids.clear();
+
+  // Tracks which are new or changed since the last publication:
+  std::map<int, opt_msgs::Track> current_tracks;
+  for (unsigned int i = 0; i < tracks.tracks.size(); i++)
+  {
+    const opt_msgs::Track& track = tracks.tracks[i];
+    std::map<int, opt_msgs::Track>::const_iterator published_it = published_tracks_.find(track.id);
+    bool changed = delta_msg->keyframe || (published_it == published_tracks_.end()) ||
+        hasChanged(published_it->second, track);
+
+    if (changed)
+      delta_msg->tracks.push_back(track);
+
+    // Keep the last published state for unchanged tracks, so that small movements accumulate:
+    current_tracks[track.id] = changed ? track : published_it->second;
+  }
+
+  // Tracks which disappeared since the last publication:
+  for (std::map<int, opt_msgs::Track>::const_iterator it = published_tracks_.begin(); it != published_tracks_.end(); it++)
+  {
+    if (current_tracks.find(it->first) == current_tracks.end())
+      delta_msg->removed_ids.push_back(it->first);
+  }
+
+  if (on_change_ && !delta_msg->keyframe && delta_msg->tracks.empty() && delta_msg->removed_ids.empty())
+    return false;
+
+  published_tracks_.swap(current_tracks);
+  last_output_time_ = now;
+  if (delta_msg->keyframe)
+    last_keyframe_time_ = now;
+
+  return true;
+}
+
+void
+OutputScheduler::requestKeyframe()
+{
+  last_keyframe_time_ = ros::Time(0);
+}
+
+void
+OutputScheduler::setOutputRate (double output_rate)
+{
+  min_period_ = output_rate > 0.0 ? 1.0 / output_rate : 0.0;
+}
+
+void
+OutputScheduler::setOnChange (bool on_change)
+{
+  on_change_ = on_change;
+}
+
+void
+OutputScheduler::setMinPositionChange (double min_position_change)
+{
+  min_position_change_ = min_position_change;
+}
+
+void
+OutputScheduler::setKeyframeInterval (double keyframe_interval)
+{
+  keyframe_interval_ = keyframe_interval;
+}
+
+/************************ protected methods ************************/
+
+bool
+OutputScheduler::hasChanged(const opt_msgs::Track& published, const opt_msgs::Track& track) const
+{
+  if (published.visibility != track.visibility)
+    return true;
+
+  double dx = track.x - published.x;
+  double dy = track.y - published.y;
+  double dh = track.height - published.height;
+  return (dx*dx + dy*dy + dh*dh) > (min_position_change_ * min_position_change_);
+}
+
+} /* namespace tracking */
+} /* namespace open_ptrack */
@@ -0,0 +1,212 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2013-, Open Perception, Inc.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ * with the distribution.
+ * * Neither the name of the copyright holder(s) nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <open_ptrack/tracking/reorder_buffer.h>
+
+namespace open_ptrack
+{
+namespace tracking
+{
+
+// Weight of a new sample in the running averages of camera statistics:
+static const double STATISTICS_UPDATE_WEIGHT = 0.1;
+
+ReorderBuffer::ReorderBuffer(double min_deadline, double max_deadline, double max_lateness, unsigned int queue_size,
+    double camera_timeout) :
+  min_deadline_(min_deadline),
+  max_deadline_(max_deadline),
+  max_lateness_(max_lateness),
+  queue_size_(queue_size),
+  camera_timeout_(camera_timeout),
+  late_messages_number_(0),
+  dropped_messages_number_(0)
+{
+  watermark_ = ros::Time(0);
+}
+
+ReorderBuffer::~ReorderBuffer()
+{
+
+}
+
+double
+ReorderBuffer::getDeadline(const CameraStatistics& camera) const
+{
+  // Until the camera rate is known, wait as long as allowed:
+  if (camera.messages < 2)
+    return max_deadline_;
+
+  // The message covering a timestamp is expected within one period plus the transport delay:
+  double deadline = camera.period + camera.delay + 3 * camera.delay_deviation;
+  return std::min(std::max(deadline, min_deadline_), max_deadline_);
+}
+
+bool
+ReorderBuffer::isReady(const ros::Time& stamp, const ros::Time& now) const
+{
+  for (std::map<std::string, CameraStatistics>::const_iterator it = cameras_.begin(); it != cameras_.end(); it++)
+  {
+    const CameraStatistics& camera = it->second;
+
+    // Cameras which stopped publishing are not waited for:
+    if ((now - camera.last_arrival).toSec() > camera_timeout_)
+      continue;
+
+    if (camera.last_stamp < stamp && (now - stamp).toSec() < getDeadline(camera))
+      return false;
+  }
+  return true;
+}
+
+ReorderBuffer::PushResult
+ReorderBuffer::push(const opt_msgs::DetectionArray::ConstPtr& msg, const ros::Time& now)
+{
+  const ros::Time& stamp = msg->header.stamp;
+
+  // Update camera statistics:
+  std::map<std::string, CameraStatistics>::iterator camera_it = cameras_.find(msg->header.frame_id);
+  if (camera_it == cameras_.end())
+  {
+    CameraStatistics camera;
+    camera.last_stamp = stamp;
+    camera.last_arrival = now;
+    camera.period = 0.0;
+    camera.delay = std::max(0.0, (now - stamp).toSec());
+    camera.delay_deviation = 0.0;
+    camera.messages = 1;
+    cameras_[msg->header.frame_id] = camera;
+  }
+  else
+  {
+    CameraStatistics& camera = camera_it->second;
+    double period = (stamp - camera.last_stamp).toSec();
+    if (period > 0.0)
+    {
+      camera.period = camera.messages < 2 ? period :
+          (1 - STATISTICS_UPDATE_WEIGHT) * camera.period + STATISTICS_UPDATE_WEIGHT * period;
+      camera.last_stamp = stamp;
+    }
+    double delay = std::max(0.0, (now - stamp).toSec());
+    camera.delay_deviation = (1 - STATISTICS_UPDATE_WEIGHT) * camera.delay_deviation +
+        STATISTICS_UPDATE_WEIGHT * std::fabs(delay - camera.delay);
+    camera.delay = (1 - STATISTICS_UPDATE_WEIGHT) * camera.delay + STATISTICS_UPDATE_WEIGHT * delay;
+    camera.last_arrival = now;
+    camera.messages++;
+  }
+
+  // Messages older than the watermark cannot be sorted anymore, and the tracks already moved past them:
+  if (stamp < watermark_)
+  {
+    if ((watermark_ - stamp).toSec() > max_lateness_)
+    {
+      dropped_messages_number_++;
+      return TOO_LATE;
+    }
+    if (late_messages_.size() >= queue_size_)
+    {
+      dropped_messages_number_++;
+      return LATE_QUEUE_FULL;
+    }
+    late_messages_.push_back(msg);
+    late_messages_number_++;
+    return LATE;
+  }
+
+  buffer_.insert(std::make_pair(stamp, msg));
+  return BUFFERED;
+}
+
+static bool
+olderThan(const opt_msgs::DetectionArray::ConstPtr& a, const opt_msgs::DetectionArray::ConstPtr& b)
+{
+  return a->header.stamp < b->header.stamp;
+}
+
+void
+ReorderBuffer::pop(const ros::Time& now, std::vector<opt_msgs::DetectionArray::ConstPtr>& messages,
+    std::vector<opt_msgs::DetectionArray::ConstPtr>& late_messages)
+{
+  // Late messages do not wait for anything and do not move the watermark:
+  std::stable_sort(late_messages_.begin(), late_messages_.end(), olderThan);
+  late_messages.insert(late_messages.end(), late_messages_.begin(), late_messages_.end());
+  late_messages_.clear();
+
+  while (!buffer_.empty())
+  {
+    std::multimap<ros::Time, opt_msgs::DetectionArray::ConstPtr>::iterator oldest = buffer_.begin();
+    if (buffer_.size() <= queue_size_ && !isReady(oldest->first, now))
+      break;
+
+    messages.push_back(oldest->second);
+    watermark_ = std::max(watermark_, oldest->first);
+    buffer_.erase(oldest);
+  }
+}
+
+void
+ReorderBuffer::setMaxLateness(double max_lateness)
+{
+  max_lateness_ = max_lateness;
+}
+
+ros::Time
+ReorderBuffer::getWatermark() const
+{
+  return watermark_;
+}
+
+size_t
+ReorderBuffer::size() const
+{
+  return buffer_.size();
+}
+
+unsigned int
+ReorderBuffer::getLateMessagesNumber() const
+{
+  return late_messages_number_;
+}
+
+unsigned int
+ReorderBuffer::getDroppedMessagesNumber() const
+{
+  return dropped_messages_number_;
+}
+
+} /* namespace tracking */
+} /* namespace open_ptrack */
@@ -0,0 +1,183 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2013-, Open Perception, Inc.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ * with the distribution.
+ * * Neither the name of the copyright holder(s) nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <open_ptrack/tracking/skeleton_joint_filter.h>
+
+namespace open_ptrack
+{
+namespace tracking
+{
+
+SkeletonJointFilter::SkeletonJointFilter(double period, double position_variance, double acceleration_variance) :
+  period_(period),
+  position_variance_(position_variance),
+  depth_multiplier_(std::pow(0.005 / 1.96, 2)),
+  acceleration_variance_(acceleration_variance)
+{
+  x_.setZero(); y_.setZero(); z_.setZero();
+  vx_.setZero(); vy_.setZero(); vz_.setZero();
+  p00_.setZero(); p01_.setZero(); p11_.setZero();
+  last_update_.setZero();
+}
+
+SkeletonJointFilter::~SkeletonJointFilter()
+{
+
+}
+
+SkeletonJointFilter::JointMask
+SkeletonJointFilter::readJoints(const std::vector<rtpose_wrapper::Joint3DMsg>& joints, JointArray& x, JointArray& y,
+    JointArray& z) const
+{
+  JointMask valid;
+  for (int i = 0; i < open_ptrack::bpe::SkeletonJoints::SIZE; i++)
+  {
+    const rtpose_wrapper::Joint3DMsg& joint = joints[i];
+    valid(i) = std::isfinite(joint.x) and std::isfinite(joint.y) and std::isfinite(joint.z);
+    x(i) = valid(i) ? joint.x : 0.0;
+    y(i) = valid(i) ? joint.y : 0.0;
+    z(i) = valid(i) ? joint.z : 0.0;
+  }
+  return valid;
+}
+
+void
+SkeletonJointFilter::init(const std::vector<rtpose_wrapper::Joint3DMsg>& joints, const ros::Time& time)
+{
+  JointArray x, y, z;
+  JointMask valid = readJoints(joints, x, y, z);
+
+  // Same initialization of KalmanFilter3D: known position, uncertain velocity.
+  x_ = valid.select(x, x_);
+  y_ = valid.select(y, y_);
+  z_ = valid.select(z, z_);
+  vx_ = valid.select(JointArray::Zero(), vx_);
+  vy_ = valid.select(JointArray::Zero(), vy_);
+  vz_ = valid.select(JointArray::Zero(), vz_);
+  p00_ = valid.select(JointArray::Zero(), p00_);
+  p01_ = valid.select(JointArray::Zero(), p01_);
+  p11_ = valid.select(JointArray::Constant(100.0), p11_);
+  last_update_ = valid.select(JointArray::Constant(time.toSec()), last_update_);
+}
+
+void
+SkeletonJointFilter::update(const std::vector<rtpose_wrapper::Joint3DMsg>& joints, const ros::Time& time)
+{
+  JointArray x, y, z;
+  JointMask valid = readJoints(joints, x, y, z);
+
+  // Number of prediction steps since the last update of every joint (at least one, as in Track3D):
+  JointArray steps = ((time.toSec() - last_update_) / period_).unaryExpr(
+      [](double d) { return std::max(1.0, std::round(d)); });
+  JointArray dt = steps * period_;
+
+  // Prediction over k steps of the discrete white noise acceleration model:
+  double q = acceleration_variance_;
+  double period2 = period_ * period_;
+  JointArray x_pred = x_ + vx_ * dt;
+  JointArray y_pred = y_ + vy_ * dt;
+  JointArray z_pred = z_ + vz_ * dt;
+  JointArray p00_pred = p00_ + 2 * dt * p01_ + dt * dt * p11_ +
+      q * period2 * period2 * (steps.cube() / 3 - steps / 12);
+  JointArray p01_pred = p01_ + dt * p11_ + q * period2 * period_ * steps.square() / 2;
+  JointArray p11_pred = p11_ + q * period2 * steps;
+
+  // Update with the observed positions (noise grows with the fourth power of the distance):
+  JointArray distance = (x.square() + y.square() + z.square()).sqrt();
+  JointArray r = position_variance_ + distance.square().square() * depth_multiplier_;
+  JointArray k0 = p00_pred / (p00_pred + r);
+  JointArray k1 = p01_pred / (p00_pred + r);
+  JointArray ex = x - x_pred, ey = y - y_pred, ez = z - z_pred;
+
+  x_ = valid.select(x_pred + k0 * ex, x_);
+  y_ = valid.select(y_pred + k0 * ey, y_);
+  z_ = valid.select(z_pred + k0 * ez, z_);
+  vx_ = valid.select(vx_ + k1 * ex, vx_);
+  vy_ = valid.select(vy_ + k1 * ey, vy_);
+  vz_ = valid.select(vz_ + k1 * ez, vz_);
+  p00_ = valid.select((1 - k0) * p00_pred, p00_);
+  p11_ = valid.select(p11_pred - k1 * p01_pred, p11_);
+  p01_ = valid.select((1 - k0) * p01_pred, p01_);
+  last_update_ = valid.select(JointArray::Constant(time.toSec()), last_update_);
+}
+
+void
+SkeletonJointFilter::predict(const ros::Time& time, JointMatrix& positions, JointArray& variances) const
+{
+  JointArray steps = ((time.toSec() - last_update_) / period_).unaryExpr(
+      [](double d) { return std::max(1.0, std::round(d)); });
+  JointArray dt = steps * period_;
+
+  double period2 = period_ * period_;
+  positions.row(0) = (x_ + vx_ * dt).matrix().transpose();
+  positions.row(1) = (y_ + vy_ * dt).matrix().transpose();
+  positions.row(2) = (z_ + vz_ * dt).matrix().transpose();
+  variances = p00_ + 2 * dt * p01_ + dt * dt * p11_ +
+      acceleration_variance_ * period2 * period2 * (steps.cube() / 3 - steps / 12);
+}
+
+void
+SkeletonJointFilter::getState(int joint, double& x, double& y, double& z) const
+{
+  x = x_(joint);
+  y = y_(joint);
+  z = z_(joint);
+}
+
+geometry_msgs::Point
+SkeletonJointFilter::getState(int joint) const
+{
+  geometry_msgs::Point p;
+  getState(joint, p.x, p.y, p.z);
+  return p;
+}
+
+void
+SkeletonJointFilter::setAccelerationVariance (double acceleration_variance)
+{
+  acceleration_variance_ = acceleration_variance;
+}
+
+void
+SkeletonJointFilter::setPositionVariance (double position_variance)
+{
+  position_variance_ = position_variance;
+}
+
+} /* namespace tracking */
+} /* namespace open_ptrack */
@@ -66,20 +66,10 @@ SkeletonTrack::SkeletonTrack(int id,
                              bool velocity_in_motion_term,
                              const std::vector<rtpose_wrapper::Joint3DMsg>& joints):
   Track(id, frame_id, position_variance, acceleration_variance, period,
-        velocity_in_motion_term), all_joint_tracks_initialized_(false)
+        velocity_in_motion_term),
+  joint_filter_(period, position_variance, acceleration_variance),
+  all_joint_tracks_initialized_(false)
 {
-  joint_tracks_.resize(SkeletonJoints::SIZE);
-  for(size_t i = 0; i < SkeletonJoints::SIZE; ++i)
-  {
-    joint_tracks_[i] = new Track3D(
-          id,
-          frame_id,
-          position_variance,
-          acceleration_variance,
-          period,
-          velocity_in_motion_term
-          );
-  }
   debug_count_ = -1;
 }
 
@@ -108,15 +98,8 @@ SkeletonTrack::init(double x, double y, double z, double height, double distance
   bool any_nan = anyNaNs(joints);
   any_nan? all_joint_tracks_initialized_ = false :
       all_joint_tracks_initialized_ = true;
-  for(int i = 0, end = joint_tracks_.size();
-      i != end and not any_nan; ++i)
-  {
-    const rtpose_wrapper::Joint3DMsg& bj = joints[i];
-    joint_tracks_[i] -> init(bj.x, bj.y, bj.z, 10,
-                             Eigen::Vector3d(bj.x, bj.y, bj.z).norm(),
-                             detection_source
-                             );
-  }
+  if(not any_nan)
+    joint_filter_.init(joints, detection_source->getTime());
 //  if(SkeletonTrack::count == 0 && debug_count_ <= 0)
 //    ROS_WARN_STREAM("TODO: SkeletonTrack: Initialize ");
   raw_joints_tmp_ = joints;
@@ -129,6 +112,17 @@ SkeletonTrack::areJointsInitialized()
   return all_joint_tracks_initialized_;
 }
 
+bool
+SkeletonTrack::getPredictedJoints(const ros::Time& time,
+                                  SkeletonJointFilter::JointMatrix& positions,
+                                  SkeletonJointFilter::JointArray& variances) const
+{
+  if(not all_joint_tracks_initialized_)
+    return false;
+  joint_filter_.predict(time, positions, variances);
+  return true;
+}
+
 void
 SkeletonTrack::update(
     double x,
@@ -149,15 +143,8 @@ SkeletonTrack::update(
                 detection_source,first_update);
   if(all_joint_tracks_initialized_)
   {
-    for(int i = 0, end = SkeletonJoints::SIZE; i != end; ++i)
-    {
-      const rtpose_wrapper::Joint3DMsg& bj = joints[i];
-      joint_tracks_[i] -> update(bj.x, bj.y, bj.z, 10,
-                                 Eigen::Vector3d(bj.x, bj.y, bj.z).norm(), bj.confidence,
-                                 bj.confidence - 1, bj.confidence + 1, 0,
-                                 detection_source, first_update
-                                 );
-    }
+    // All joints are predicted and updated at once (joints not detected are masked):
+    joint_filter_.update(joints, detection_source->getTime());
   }
   else
   {
@@ -165,22 +152,7 @@ SkeletonTrack::update(
     if (not any_nan)
     {
       all_joint_tracks_initialized_ = true;
-      for(int i = 0, end = joint_tracks_.size();
-          i != end; ++i)
-      {
-        const rtpose_wrapper::Joint3DMsg& bj = joints[i];
-        joint_tracks_[i] -> init(bj.x, bj.y, bj.z, 10,
-                                 Eigen::Vector3d(bj.x, bj.y, bj.z).norm(),
-                                 detection_source
-                                 );
-        bool first_update = true;
-        joint_tracks_[i] -> update(
-              bj.x, bj.y, bj.z, 10,
-              Eigen::Vector3d(bj.x, bj.y, bj.z).norm(), bj.confidence,
-              bj.confidence - 1, bj.confidence + 1, 0,
-              detection_source, first_update
-              );
-      }
+      joint_filter_.init(joints, detection_source->getTime());
     }
   }
 //  if(SkeletonTrack::count == 0 && debug_count_ <= 0)
@@ -230,13 +202,12 @@ SkeletonTrack::toMsg(opt_msgs::SkeletonTrack& track_msg, bool vertical)
     track_msg.box_2D.x = int(top(0)) - track_msg.box_2D.width;
     track_msg.box_2D.y = int(top(1)) - track_msg.box_2D.width / 4;
   }
-  track_msg.joints.resize(joint_tracks_.size());
+  track_msg.joints.resize(SkeletonJoints::SIZE);
   //  SkeletonTrack::bodyPoseMsgToTrackerMsg(track_msg);
   for(size_t i = 0; i < SkeletonJoints::SIZE; ++i)
   {
-    Track3D* t = joint_tracks_[i];
     double jx, jy, jz;
-    t -> getState(jx, jy, jz);
+    joint_filter_.getState(i, jx, jy, jz);
     opt_msgs::Track3D m;
     m.confidence = 1.0;
     m.x = jx;
@@ -306,7 +277,7 @@ SkeletonTrack::createMarker(visualization_msgs::MarkerArray::Ptr& msg,
       joint_marker.id = i + id_ * SkeletonJoints::SIZE * 2; //for visualizing both detection and tracks
       joint_marker.type = visualization_msgs::Marker::SPHERE;
       joint_marker.action = visualization_msgs::Marker::ADD;
-      joint_marker.pose.position = joint_tracks_[i]->getState();
+      joint_marker.pose.position = joint_filter_.getState(i);
       joint_marker.pose.orientation.x = 0.0;
       joint_marker.pose.orientation.y = 0.0;
       joint_marker.pose.orientation.z = 0.0;
@@ -335,8 +306,8 @@ SkeletonTrack::createMarker(visualization_msgs::MarkerArray::Ptr& msg,
         if(it->first == SkeletonJoints::HEAD
            or it->second == SkeletonJoints::HEAD)
           continue;
-      const geometry_msgs::Point& p1 = joint_tracks_[it->first]->getState();
-      const geometry_msgs::Point& p2 = joint_tracks_[it->second]->getState();
+      const geometry_msgs::Point& p1 = joint_filter_.getState(it->first);
+      const geometry_msgs::Point& p2 = joint_filter_.getState(it->second);
       //      if( isValid(p1)
       //          and
       //          isValid(p2))
@@ -463,10 +434,10 @@ SkeletonTrack::createMarker(visualization_msgs::MarkerArray::Ptr& msg,
 
   // Track ID over head
   std::vector<geometry_msgs::Point> joints_tracks_tmp
-      (joint_tracks_.size());
-  for(uint i = 0; i < joint_tracks_.size(); ++i)
+      (SkeletonJoints::SIZE);
+  for(uint i = 0; i < SkeletonJoints::SIZE; ++i)
   {
-    joints_tracks_tmp[i] = joint_tracks_[i]->getState();
+    joints_tracks_tmp[i] = joint_filter_.getState(i);
   }
   Eigen::Vector3d world_centroid =
       open_ptrack::detection::SkeletonDetection::averageOverValidJoints
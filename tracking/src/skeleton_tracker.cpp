@@ -163,6 +163,8 @@ SkeletonTracker::createCostMatrix()
     {
       if(distance_matrix_(i, j) > gate_distance_)
         cost_matrix_(i, j) = 1000000.0;
+      else
+        cost_matrix_(i, j) += joint_weight_ * joint_distance_matrix_(i, j);
     }
   }
 }
@@ -201,12 +203,41 @@ SkeletonTracker::fillUnassociatedDetections()
 void
 SkeletonTracker::createDistanceMatrix()
 {
+  typedef SkeletonJointFilter::JointMatrix JointMatrix;
+  typedef SkeletonJointFilter::JointArray JointArray;
+
+  // Squared normalized joint distances are truncated at the 0.99 chi square value (3 DOF),
+  // so that a few wrong joints cannot dominate the joint term:
+  const double max_joint_distance = 11.345;
+
   distance_matrix_ = cv::Mat_<double>(tracks_.size(), detections_.size());
+  joint_distance_matrix_ = cv::Mat_<double>::zeros(tracks_.size(), detections_.size());
+
+  // Detected joints (world frame) and their validity, read once per detection:
+  std::vector<JointMatrix, Eigen::aligned_allocator<JointMatrix> > detection_joints(detections_.size());
+  std::vector<JointArray, Eigen::aligned_allocator<JointArray> > detection_valid_joints(detections_.size());
+  if (joint_weight_ > 0)
+  {
+    for(size_t measure = 0; measure < detections_.size(); measure++)
+    {
+      const std::vector<rtpose_wrapper::Joint3DMsg>& joints = detections_[measure].getSkeletonMsg().joints;
+      for(int i = 0; i < open_ptrack::bpe::SkeletonJoints::SIZE; i++)
+      {
+        bool valid = i < int(joints.size()) and detections_[measure].isValidJoint(joints[i]);
+        detection_joints[measure].col(i) = valid ? Eigen::Vector3d(joints[i].x, joints[i].y, joints[i].z) :
+                                                   Eigen::Vector3d::Zero();
+        detection_valid_joints[measure](i) = valid ? 1.0 : 0.0;
+      }
+    }
+  }
+
+  const int joints_number = open_ptrack::bpe::SkeletonJoints::SIZE;
   int track = 0;
   for(std::list<SkeletonTrack*>::const_iterator it = tracks_.begin(),
       end = tracks_.end(); it != end; it++)
   {
     SkeletonTrack* t = *it;
+    std::vector<int> gated_measures;
     int measure = 0;
     for(std::vector<open_ptrack::detection::SkeletonDetection>::iterator
         dit = detections_.begin(), dend = detections_.end(); dit != dend; dit++)
@@ -240,6 +271,43 @@ SkeletonTracker::createDistanceMatrix()
       if (std::isnan(distance_matrix_(track, measure-1))
           or (not std::isfinite(distance_matrix_(track, measure-1))))
         distance_matrix_(track, measure-1) = 2*gate_distance_;
+
+      // Joint term, only for pairs surviving the centroid gate:
+      if (joint_weight_ > 0 and distance_matrix_(track, measure-1) <= gate_distance_)
+        gated_measures.push_back(measure-1);
+    }
+
+    // Joints are predicted once per track, at the time of the current detections, and compared
+    // with the joints of all the gated detections at once:
+    JointMatrix track_joints;
+    JointArray track_variances;
+    if (not gated_measures.empty() and
+        t->getPredictedJoints(detections_[gated_measures[0]].getSource()->getTime(), track_joints, track_variances))
+    {
+      track_variances += position_variance_;
+
+      const int gated_number = gated_measures.size();
+      Eigen::Matrix3Xd gated_joints(3, joints_number * gated_number);
+      Eigen::ArrayXXd gated_valid_joints(joints_number, gated_number);
+      for(int g = 0; g < gated_number; g++)
+      {
+        gated_joints.middleCols<joints_number>(g * joints_number) = detection_joints[gated_measures[g]];
+        gated_valid_joints.col(g) = detection_valid_joints[gated_measures[g]];
+      }
+
+      Eigen::RowVectorXd squared_distances =
+          (gated_joints - track_joints.replicate(1, gated_number)).colwise().squaredNorm();
+      Eigen::ArrayXXd d = Eigen::Map<Eigen::ArrayXXd>(squared_distances.data(), joints_number, gated_number).colwise()
+          / track_variances;
+      Eigen::ArrayXd valid_joints = gated_valid_joints.colwise().sum().transpose();
+      Eigen::ArrayXd joint_distances = (d.min(max_joint_distance) * gated_valid_joints).colwise().sum().transpose()
+          / valid_joints;
+
+      for(int g = 0; g < gated_number; g++)
+      {
+        if (valid_joints(g) > 0)
+          joint_distance_matrix_(track, gated_measures[g]) = joint_distances(g);
+      }
     }
     track++;
   }
@@ -372,6 +440,11 @@ SkeletonTracker::toMarkerArray(visualization_msgs::MarkerArray::Ptr &msg,
   }
 }
 
+void
+SkeletonTracker::setJointWeight (double joint_weight)
+{
+  joint_weight_ = joint_weight;
+}
 
 } /* namespace tracking */
 } /* namespace open_ptrack */
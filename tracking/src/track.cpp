@@ -115,6 +115,8 @@ namespace open_ptrack
       last_time_predicted_index_ = old_track.last_time_predicted_index_;
 
       data_association_score_ = old_track.data_association_score_;
+
+      resetFilterUpdates();
     }
 
     void
@@ -136,7 +138,7 @@ namespace open_ptrack
       last_time_predicted_index_ = 0;
       age_ = 0.0;
 
-
+      resetFilterUpdates();
     }
 
     void
@@ -154,70 +156,23 @@ namespace open_ptrack
         bool first_update)
     {
       //Update Kalman filter
-      int difference;
-      double vx, vy;
+      FilterUpdate measure;
+      measure.time = detection_source->getTime();
+      measure.x = x;
+      measure.y = y;
+      measure.vx = measure.vy = 0.0;
+      measure.distance = distance;
       if (velocity_in_motion_term_)
-      {
-        ros::Duration d(1.0);
-        ros::Duration d2(2.0);
-
-        double t = std::max(first_time_detected_.toSec(), (detection_source->getTime() - d).toSec());
-//        std::cout << "t1: " << t << std::endl;
-        t = std::min(t, last_time_detected_.toSec());
-//        std::cout << "t2: " << t << std::endl;
-        t = std::max(t, (detection_source->getTime() - d2).toSec());
-//        std::cout << "t3: " << t << std::endl;
-        double dt = t - last_time_predicted_.toSec();
-//        std::cout << "dt: " << dt << std::endl;
-        difference = int(round(dt / period_));
-//        std::cout << "period: " << period_ << std::endl;
-//        std::cout << "difference: " << difference << std::endl;
-        int vIndex = (MAX_SIZE + last_time_predicted_index_ + difference) % MAX_SIZE;
-//        std::cout << vIndex << std::endl;
-
-//        difference = int(round(dt / period_));
-//        int vIndex = (MAX_SIZE + last_time_predicted_index_ + difference) % MAX_SIZE;
+        getVelocityMeasure(x, y, measure.time, last_time_predicted_, measure.vx, measure.vy);
 
-        if(difference != 0)
-        {
-          vx = - (x - mahalanobis_map4d_[vIndex].x) / dt;
-          vy = - (y - mahalanobis_map4d_[vIndex].y) / dt;
-        }
-        else
-        {
-          vx = mahalanobis_map4d_[vIndex].x;
-          vy = mahalanobis_map4d_[vIndex].x;
-        }
-//        std::cout << "Mahalanobis: " << mahalanobis_map4d_[vIndex].x << "," << mahalanobis_map4d_[vIndex].y << std::endl;
-      }
-
-      // Update Kalman filter from the last time the track was visible:
-      int framesLost = int(round((detection_source->getTime() - last_time_detected_).toSec() / period_)) - 1;
-
-      for(int i = 0; i < framesLost; i++)
-      {
-        filter_->predict();
-        filter_->update();
-      }
-
-      filter_->predict();
-      if (velocity_in_motion_term_)
-      {
-        filter_->update(x, y, vx, vy, distance);
-      }
-      else
-      {
-        filter_->update(x, y, distance);
-      }
+      applyMeasurement(*filter_, last_time_detected_, measure);
+      measure.filter.reset(new open_ptrack::tracking::KalmanFilter(*filter_));
 
       *tmp_filter_ = *filter_;
-      difference = int(round((detection_source->getTime() - last_time_predicted_).toSec() / period_));
-      last_time_predicted_index_ = (MAX_SIZE + last_time_predicted_index_ + difference) % MAX_SIZE;
-      last_time_predicted_ = last_time_detected_ = detection_source->getTime();
-      if (velocity_in_motion_term_)
-        filter_->getMahalanobisParameters(mahalanobis_map4d_[last_time_predicted_index_]);
-      else
-        filter_->getMahalanobisParameters(mahalanobis_map2d_[last_time_predicted_index_]);
+      last_time_predicted_index_ = getIndex(measure.time);
+      last_time_predicted_ = last_time_detected_ = measure.time;
+      storeMahalanobisParameters(*filter_, last_time_predicted_index_);
+      addFilterUpdate(measure);
 
       // Update z_ and height_ with a weighted combination of current and new values:
       z_ = z_ * 0.9 + z * 0.1;
@@ -249,6 +204,83 @@ namespace open_ptrack
       detection_source_ = detection_source;
     }
 
+    bool
+    Track::canUpdateLate(const ros::Time& time)
+    {
+      if (filter_updates_.empty() || time < filter_updates_.front().time)
+        return false;
+
+      // The circular buffer must still contain the time of the detection:
+      return int(round((last_time_predicted_ - time).toSec() / period_)) < MAX_SIZE;
+    }
+
+    void
+    Track::updateLate(
+        double x,
+        double y,
+        double z,
+        double height,
+        double distance,
+        double confidence,
+        double min_confidence,
+        double min_confidence_detections,
+        open_ptrack::detection::DetectionSource* detection_source)
+    {
+      const ros::Time& time = detection_source->getTime();
+
+      // Nothing to replay if the detection is newer than the ones already associated:
+      if (time >= last_time_detected_)
+      {
+        update(x, y, z, height, distance, data_association_score_, confidence, min_confidence,
+            min_confidence_detections, detection_source);
+        return;
+      }
+
+      FilterUpdate measure;
+      measure.time = time;
+      measure.x = x;
+      measure.y = y;
+      measure.vx = measure.vy = 0.0;
+      measure.distance = distance;
+      if (velocity_in_motion_term_)
+        getVelocityMeasure(x, y, time, time, measure.vx, measure.vy);
+
+      // Roll the filter back to the last update before the detection:
+      std::deque<FilterUpdate>::iterator next = filter_updates_.begin();
+      while (next != filter_updates_.end() && next->time <= time)
+        next++;
+      open_ptrack::tracking::KalmanFilter filter(*(next - 1)->filter);
+      applyMeasurement(filter, (next - 1)->time, measure);
+      measure.filter.reset(new open_ptrack::tracking::KalmanFilter(filter));
+      storeMahalanobisParameters(filter, getIndex(time));
+      next = filter_updates_.insert(next, measure) + 1;
+
+      // Apply again the measurements received after the detection:
+      ros::Time from = time;
+      for (; next != filter_updates_.end(); next++)
+      {
+        applyMeasurement(filter, from, *next);
+        next->filter.reset(new open_ptrack::tracking::KalmanFilter(filter));
+        storeMahalanobisParameters(filter, getIndex(next->time));
+        from = next->time;
+      }
+
+      *filter_ = filter;
+      *tmp_filter_ = filter;
+      last_time_predicted_index_ = getIndex(last_time_detected_);
+      last_time_predicted_ = last_time_detected_;
+
+      // Update z_ and height_ with a weighted combination of current and new values:
+      z_ = z_ * 0.9 + z * 0.1;
+      height_ = height_ * 0.9 + height * 0.1;
+
+      if(confidence > min_confidence)
+      {
+        updates_with_enough_confidence_++;
+        last_time_detected_with_high_confidence_ = std::max(last_time_detected_with_high_confidence_, time);
+      }
+    }
+
     void
     Track::validate()
     {
@@ -386,6 +418,138 @@ namespace open_ptrack
 
     }
 
+    double
+    Track::getLateMahalanobisDistance(double x, double y, const ros::Time& when)
+    {
+      // Predict the filter from the last update before the detection:
+      std::deque<FilterUpdate>::iterator next = filter_updates_.begin();
+      while (next != filter_updates_.end() && next->time <= when)
+        next++;
+      open_ptrack::tracking::KalmanFilter filter(*(next - 1)->filter);
+      int difference = int(round((when - (next - 1)->time).toSec() / period_));
+
+      MahalanobisParameters2d mp2d;
+      MahalanobisParameters4d mp4d;
+      if (difference <= 0)
+      {
+        if (velocity_in_motion_term_)
+          filter.getMahalanobisParameters(mp4d);
+        else
+          filter.getMahalanobisParameters(mp2d);
+      }
+      for(int i = 0; i < difference; i++)
+      {
+        filter.predict();
+        if (velocity_in_motion_term_)
+          filter.getMahalanobisParameters(mp4d);
+        else
+          filter.getMahalanobisParameters(mp2d);
+        filter.update();
+      }
+
+      if (velocity_in_motion_term_)
+      {
+        double vx, vy;
+        getVelocityMeasure(x, y, when, when, vx, vy);
+        return open_ptrack::tracking::KalmanFilter::performMahalanobisDistance(x, y, vx, vy, mp4d);
+      }
+      else
+      {
+        return open_ptrack::tracking::KalmanFilter::performMahalanobisDistance(x, y, mp2d);
+      }
+    }
+
+    int
+    Track::getIndex(const ros::Time& time)
+    {
+      int difference = int(round((time - last_time_predicted_).toSec() / period_));
+      return (MAX_SIZE + last_time_predicted_index_ + difference) % MAX_SIZE;
+    }
+
+    void
+    Track::storeMahalanobisParameters(open_ptrack::tracking::KalmanFilter& filter, int index)
+    {
+      if (velocity_in_motion_term_)
+        filter.getMahalanobisParameters(mahalanobis_map4d_[index]);
+      else
+        filter.getMahalanobisParameters(mahalanobis_map2d_[index]);
+    }
+
+    void
+    Track::getVelocityMeasure(double x, double y, const ros::Time& when, const ros::Time& reference,
+        double& vx, double& vy)
+    {
+      ros::Duration d(1.0);
+      ros::Duration d2(2.0);
+
+      // Track position one second before, not newer than the last detection and still in the circular buffer:
+      double t = std::max(first_time_detected_.toSec(), (when - d).toSec());
+      t = std::min(t, last_time_detected_.toSec());
+      t = std::max(t, (when - d2).toSec());
+      t = std::max(t, last_time_predicted_.toSec() - (MAX_SIZE - 1) * period_);
+      double dt = t - reference.toSec();
+      int vIndex = getIndex(ros::Time(t));
+
+      if(int(round(dt / period_)) != 0)
+      {
+        vx = - (x - mahalanobis_map4d_[vIndex].x) / dt;
+        vy = - (y - mahalanobis_map4d_[vIndex].y) / dt;
+      }
+      else
+      {
+        vx = mahalanobis_map4d_[vIndex].x;
+        vy = mahalanobis_map4d_[vIndex].y;
+      }
+    }
+
+    void
+    Track::applyMeasurement(open_ptrack::tracking::KalmanFilter& filter, const ros::Time& from,
+        const FilterUpdate& measure)
+    {
+      // Update Kalman filter from the last time the track was visible:
+      int framesLost = int(round((measure.time - from).toSec() / period_)) - 1;
+
+      for(int i = 0; i < framesLost; i++)
+      {
+        filter.predict();
+        filter.update();
+      }
+
+      filter.predict();
+      if (velocity_in_motion_term_)
+      {
+        filter.update(measure.x, measure.y, measure.vx, measure.vy, measure.distance);
+      }
+      else
+      {
+        filter.update(measure.x, measure.y, measure.distance);
+      }
+    }
+
+    void
+    Track::addFilterUpdate(const FilterUpdate& filter_update)
+    {
+      filter_updates_.push_back(filter_update);
+
+      // Keep the last update out of the horizon as starting point for the ones within it:
+      ros::Duration horizon((MAX_SIZE - 1) * period_);
+      while (filter_updates_.size() > 1 && filter_updates_[1].time <= last_time_detected_ - horizon)
+        filter_updates_.pop_front();
+    }
+
+    void
+    Track::resetFilterUpdates()
+    {
+      FilterUpdate start;
+      start.time = last_time_detected_;
+      start.x = start.y = start.vx = start.vy = 0.0;
+      start.distance = distance_;
+      start.filter.reset(new open_ptrack::tracking::KalmanFilter(*filter_));
+
+      filter_updates_.clear();
+      filter_updates_.push_back(start);
+    }
+
     void
     Track::draw(bool vertical)
     {
@@ -611,6 +775,28 @@ namespace open_ptrack
       }
     }
 
+    void
+    Track::toHistoryRecord(TrackHistoryRecord& record)
+    {
+      double _x, _y, _vx, _vy;
+      filter_->getState(_x, _y, _vx, _vy);
+      double var_x, var_y, var_vx, var_vy;
+      filter_->getStateCovariance(var_x, var_y, var_vx, var_vy);
+
+      record.id = id_;
+      record.x = _x;
+      record.y = _y;
+      record.z = z_;
+      record.height = height_;
+      record.vx = _vx;
+      record.vy = _vy;
+      record.var_x = var_x;
+      record.var_y = var_y;
+      record.var_vx = var_vx;
+      record.var_vy = var_vy;
+      record.visibility = visibility_;
+    }
+
     open_ptrack::detection::DetectionSource*
     Track::getDetectionSource()
     {
@@ -630,6 +816,7 @@ namespace open_ptrack
       filter_->init(x, y, distance_, velocity_in_motion_term_);
 
       *tmp_filter_ = *filter_;
+      resetFilterUpdates();
     }
 
     void
@@ -637,6 +824,8 @@ namespace open_ptrack
     {
       filter_->setPredictModel (acceleration_variance);
       tmp_filter_->setPredictModel (acceleration_variance);
+      for (std::deque<FilterUpdate>::iterator it = filter_updates_.begin(); it != filter_updates_.end(); it++)
+        it->filter->setPredictModel (acceleration_variance);
     }
 
     void
@@ -644,6 +833,8 @@ namespace open_ptrack
     {
       filter_->setObserveModel (position_variance);
       tmp_filter_->setObserveModel (position_variance);
+      for (std::deque<FilterUpdate>::iterator it = filter_updates_.begin(); it != filter_updates_.end(); it++)
+        it->filter->setObserveModel (position_variance);
     }
   } /* namespace tracking */
 } /* namespace open_ptrack */
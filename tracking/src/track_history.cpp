@@ -0,0 +1,472 @@
+/*
+ * Software License Agreement (BSD License)
+ *
+ * Copyright (c) 2013-, Open Perception, Inc.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following
+ * disclaimer in the documentation and/or other materials provided
+ * with the distribution.
+ * * Neither the name of the copyright holder(s) nor the names of its
+ * contributors may be used to endorse or promote products derived
+ * from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <open_ptrack/tracking/track_history.h>
+
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <limits>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <boost/filesystem.hpp>
+
+namespace open_ptrack
+{
+namespace tracking
+{
+
+namespace track_history
+{
+
+size_t
+columnElementSize (Column column)
+{
+  switch (column)
+  {
+  case TIME:
+    return sizeof(double);
+  case ID:
+    return sizeof(int32_t);
+  case VISIBILITY:
+    return sizeof(uint8_t);
+  case SOURCE:
+    return sizeof(uint16_t);
+  default:
+    return sizeof(float);
+  }
+}
+
+size_t
+columnOffset (Column column, uint32_t capacity)
+{
+  // Columns start at 64-byte aligned offsets after the header:
+  size_t offset = (sizeof(TrackHistorySegmentHeader) + 63) & ~size_t(63);
+  for (int c = 0; c < column; c++)
+    offset += (columnElementSize(Column(c)) * capacity + 63) & ~size_t(63);
+  return offset;
+}
+
+size_t
+segmentSize (uint32_t capacity)
+{
+  return columnOffset(COLUMNS_NUMBER, capacity);
+}
+
+} /* namespace track_history */
+
+/************************ TrackHistoryWriter ************************/
+
+TrackHistoryWriter::TrackHistoryWriter(const std::string& directory, uint32_t segment_capacity, size_t queue_size) :
+  directory_(directory),
+  segment_capacity_(std::max<uint32_t>(segment_capacity, 1)),
+  queue_(std::max<size_t>(queue_size, 1) + 1),
+  queue_head_(0),
+  queue_tail_(0),
+  dropped_records_(0),
+  sources_number_(0),
+  running_(true),
+  segment_counter_(0),
+  segment_fd_(-1),
+  segment_data_(NULL),
+  header_(NULL)
+{
+  if (segment_capacity < 1 || queue_size < 1)
+    std::cerr << "TrackHistoryWriter: segment capacity and queue size must be at least 1, using "
+              << segment_capacity_ << " and " << queue_.size() - 1 << std::endl;
+
+  boost::system::error_code error;
+  boost::filesystem::create_directories(directory_, error);
+  std::memset(source_names_, 0, sizeof(source_names_));
+
+  thread_ = std::thread(&TrackHistoryWriter::run, this);
+}
+
+TrackHistoryWriter::~TrackHistoryWriter()
+{
+  running_ = false;
+  if (thread_.joinable())
+    thread_.join();
+}
+
+bool
+TrackHistoryWriter::push(const TrackHistoryRecord& record)
+{
+  size_t tail = queue_tail_.load(std::memory_order_relaxed);
+  size_t next_tail = (tail + 1) % queue_.size();
+  if (next_tail == queue_head_.load(std::memory_order_acquire))
+  {
+    dropped_records_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  queue_[tail] = record;
+  queue_tail_.store(next_tail, std::memory_order_release);
+  return true;
+}
+
+uint16_t
+TrackHistoryWriter::getSourceIndex(const std::string& frame_id)
+{
+  std::map<std::string, uint16_t>::const_iterator it = source_indices_.find(frame_id);
+  if (it != source_indices_.end())
+    return it->second;
+
+  uint32_t index = sources_number_.load(std::memory_order_relaxed);
+  if (index >= track_history::MAX_SOURCES)
+    return track_history::MAX_SOURCES - 1;   // sources table full, reuse last entry
+
+  // Fill the table entry before making it visible to the writer thread:
+  std::strncpy(source_names_[index], frame_id.c_str(), track_history::SOURCE_NAME_LENGTH - 1);
+  sources_number_.store(index + 1, std::memory_order_release);
+  source_indices_[frame_id] = index;
+  return index;
+}
+
+size_t
+TrackHistoryWriter::getDroppedRecords()
+{
+  return dropped_records_.load(std::memory_order_relaxed);
+}
+
+/************************ protected methods ************************/
+
+void
+TrackHistoryWriter::run()
+{
+  while (true)
+  {
+    // Read running_ before draining, so that records pushed before the destructor are written:
+    bool running = running_.load();
+
+    size_t head = queue_head_.load(std::memory_order_relaxed);
+    size_t tail = queue_tail_.load(std::memory_order_acquire);
+    while (head != tail)
+    {
+      writeRecord(queue_[head]);
+      head = (head + 1) % queue_.size();
+      queue_head_.store(head, std::memory_order_release);
+    }
+
+    if (!running)
+      break;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  closeSegment();
+}
+
+bool
+TrackHistoryWriter::openSegment()
+{
+  char filename[64];
+  std::snprintf(filename, sizeof(filename), "tracks_%010ld_%04d", long(std::time(NULL)), segment_counter_++);
+  std::string path = directory_ + "/" + filename + track_history::EXTENSION;
+
+  segment_fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (segment_fd_ < 0)
+  {
+    std::cerr << "TrackHistoryWriter: cannot create " << path << std::endl;
+    return false;
+  }
+
+  size_t size = track_history::segmentSize(segment_capacity_);
+  if (ftruncate(segment_fd_, size) != 0)
+  {
+    std::cerr << "TrackHistoryWriter: cannot resize " << path << std::endl;
+    close(segment_fd_);
+    segment_fd_ = -1;
+    return false;
+  }
+
+  void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, segment_fd_, 0);
+  if (data == MAP_FAILED)
+  {
+    std::cerr << "TrackHistoryWriter: cannot map " << path << std::endl;
+    close(segment_fd_);
+    segment_fd_ = -1;
+    return false;
+  }
+
+  segment_data_ = static_cast<char*>(data);
+  header_ = reinterpret_cast<TrackHistorySegmentHeader*>(segment_data_);
+  std::memcpy(header_->magic, track_history::MAGIC, sizeof(header_->magic));
+  header_->version = track_history::VERSION;
+  header_->capacity = segment_capacity_;
+  header_->count = 0;
+  header_->min_time = std::numeric_limits<double>::max();
+  header_->max_time = -std::numeric_limits<double>::max();
+  header_->min_id = std::numeric_limits<int32_t>::max();
+  header_->max_id = std::numeric_limits<int32_t>::min();
+  header_->sources_number = 0;
+  return true;
+}
+
+void
+TrackHistoryWriter::closeSegment()
+{
+  if (segment_data_ == NULL)
+    return;
+
+  size_t size = track_history::segmentSize(segment_capacity_);
+  msync(segment_data_, size, MS_SYNC);
+  munmap(segment_data_, size);
+  close(segment_fd_);
+  segment_data_ = NULL;
+  header_ = NULL;
+  segment_fd_ = -1;
+}
+
+void
+TrackHistoryWriter::writeRecord(const TrackHistoryRecord& record)
+{
+  if (header_ != NULL && header_->count >= segment_capacity_)
+    closeSegment();
+  if (header_ == NULL && !openSegment())
+    return;
+
+  // Copy new camera names to the segment sources table:
+  uint32_t sources_number = sources_number_.load(std::memory_order_acquire);
+  for (uint32_t i = header_->sources_number; i < sources_number; i++)
+    std::memcpy(header_->sources[i], source_names_[i], track_history::SOURCE_NAME_LENGTH);
+  header_->sources_number = sources_number;
+
+  uint64_t i = header_->count;
+  uint32_t capacity = segment_capacity_;
+  using namespace track_history;
+  reinterpret_cast<double*>(segment_data_ + columnOffset(TIME, capacity))[i] = record.time;
+  reinterpret_cast<int32_t*>(segment_data_ + columnOffset(ID, capacity))[i] = record.id;
+  reinterpret_cast<float*>(segment_data_ + columnOffset(X, capacity))[i] = record.x;
+  reinterpret_cast<float*>(segment_data_ + columnOffset(Y, capacity))[i] = record.y;
+  reinterpret_cast<float*>(segment_data_ + columnOffset(Z, capacity))[i] = record.z;
+  reinterpret_cast<float*>(segment_data_ + columnOffset(HEIGHT, capacity))[i] = record.height;
+  reinterpret_cast<float*>(segment_data_ + columnOffset(VX, capacity))[i] = record.vx;
+  reinterpret_cast<float*>(segment_data_ + columnOffset(VY, capacity))[i] = record.vy;
+  reinterpret_cast<float*>(segment_data_ + columnOffset(VAR_X, capacity))[i] = record.var_x;
+  reinterpret_cast<float*>(segment_data_ + columnOffset(VAR_Y, capacity))[i] = record.var_y;
+  reinterpret_cast<float*>(segment_data_ + columnOffset(VAR_VX, capacity))[i] = record.var_vx;
+  reinterpret_cast<float*>(segment_data_ + columnOffset(VAR_VY, capacity))[i] = record.var_vy;
+  reinterpret_cast<uint8_t*>(segment_data_ + columnOffset(VISIBILITY, capacity))[i] = record.visibility;
+  reinterpret_cast<uint16_t*>(segment_data_ + columnOffset(SOURCE, capacity))[i] = record.source;
+
+  header_->min_time = std::min(header_->min_time, record.time);
+  header_->max_time = std::max(header_->max_time, record.time);
+  header_->min_id = std::min(header_->min_id, record.id);
+  header_->max_id = std::max(header_->max_id, record.id);
+
+  // Make the record visible to readers only after its columns have been written:
+  __sync_synchronize();
+  header_->count = i + 1;
+}
+
+/************************ TrackHistoryReader ************************/
+
+TrackHistoryReader::TrackHistoryReader(const std::string& directory)
+{
+  std::vector<std::string> filenames;
+  boost::system::error_code error;
+  for (boost::filesystem::directory_iterator it(directory, error), end; !error && it != end; it.increment(error))
+  {
+    if (it->path().extension().string() == track_history::EXTENSION)
+      filenames.push_back(it->path().string());
+  }
+  std::sort(filenames.begin(), filenames.end());
+
+  for (unsigned int i = 0; i < filenames.size(); i++)
+  {
+    Segment segment;
+    if (openSegment(filenames[i], segment))
+      segments_.push_back(segment);
+  }
+}
+
+TrackHistoryReader::~TrackHistoryReader()
+{
+  for (unsigned int i = 0; i < segments_.size(); i++)
+    munmap(segments_[i].data, segments_[i].size);
+}
+
+size_t
+TrackHistoryReader::getSegmentsNumber()
+{
+  return segments_.size();
+}
+
+size_t
+TrackHistoryReader::getRecordsNumber()
+{
+  size_t records_number = 0;
+  for (unsigned int i = 0; i < segments_.size(); i++)
+    records_number += std::min<uint64_t>(segments_[i].header->count, segments_[i].header->capacity);
+  return records_number;
+}
+
+std::string
+TrackHistoryReader::getSourceName(uint16_t source)
+{
+  return source < sources_.size() ? sources_[source] : std::string();
+}
+
+void
+TrackHistoryReader::query(double start_time, double end_time, int id, std::vector<TrackHistoryRecord>& records)
+{
+  using namespace track_history;
+  records.clear();
+
+  for (unsigned int s = 0; s < segments_.size(); s++)
+  {
+    const Segment& segment = segments_[s];
+    const TrackHistorySegmentHeader* header = segment.header;
+    // The segment may still be written, never trust count beyond the capacity checked at open:
+    uint64_t count = std::min<uint64_t>(header->count, header->capacity);
+    __sync_synchronize();
+
+    // Skip segments outside the time or ID range:
+    if (count == 0 || header->max_time < start_time || header->min_time > end_time)
+      continue;
+    if (id >= 0 && (id < header->min_id || id > header->max_id))
+      continue;
+
+    // Scan the selection columns first, then gather the other columns only for matching rows:
+    const double* time = column<double>(segment, TIME);
+    const int32_t* ids = column<int32_t>(segment, ID);
+    std::vector<uint64_t> rows;
+    for (uint64_t i = 0; i < count; i++)
+    {
+      if (time[i] >= start_time && time[i] <= end_time && (id < 0 || ids[i] == id))
+        rows.push_back(i);
+    }
+
+    const float* x = column<float>(segment, X);
+    const float* y = column<float>(segment, Y);
+    const float* z = column<float>(segment, Z);
+    const float* height = column<float>(segment, HEIGHT);
+    const float* vx = column<float>(segment, VX);
+    const float* vy = column<float>(segment, VY);
+    const float* var_x = column<float>(segment, VAR_X);
+    const float* var_y = column<float>(segment, VAR_Y);
+    const float* var_vx = column<float>(segment, VAR_VX);
+    const float* var_vy = column<float>(segment, VAR_VY);
+    const uint8_t* visibility = column<uint8_t>(segment, VISIBILITY);
+    const uint16_t* source = column<uint16_t>(segment, SOURCE);
+
+    size_t first = records.size();
+    records.resize(first + rows.size());
+    for (unsigned int r = 0; r < rows.size(); r++)
+    {
+      uint64_t i = rows[r];
+      TrackHistoryRecord& record = records[first + r];
+      record.time = time[i];
+      record.id = ids[i];
+      record.x = x[i];
+      record.y = y[i];
+      record.z = z[i];
+      record.height = height[i];
+      record.vx = vx[i];
+      record.vy = vy[i];
+      record.var_x = var_x[i];
+      record.var_y = var_y[i];
+      record.var_vx = var_vx[i];
+      record.var_vy = var_vy[i];
+      record.visibility = visibility[i];
+      record.source = source[i] < segment.sources.size() ? segment.sources[source[i]] : source[i];
+    }
+  }
+}
+
+/************************ protected methods ************************/
+
+bool
+TrackHistoryReader::openSegment(const std::string& filename, Segment& segment)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || size_t(file_stat.st_size) < sizeof(TrackHistorySegmentHeader))
+  {
+    close(fd);
+    return false;
+  }
+
+  void* data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return false;
+
+  segment.filename = filename;
+  segment.size = file_stat.st_size;
+  segment.data = static_cast<char*>(data);
+  segment.header = reinterpret_cast<const TrackHistorySegmentHeader*>(segment.data);
+
+  const TrackHistorySegmentHeader* header = segment.header;
+  if (std::memcmp(header->magic, track_history::MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != track_history::VERSION ||
+      track_history::segmentSize(header->capacity) > segment.size ||
+      header->count > header->capacity)
+  {
+    std::cerr << "TrackHistoryReader: " << filename << " is not a valid track history segment" << std::endl;
+    munmap(segment.data, segment.size);
+    return false;
+  }
+
+  // Map segment camera names to reader source indices:
+  for (uint32_t i = 0; i < header->sources_number && i < track_history::MAX_SOURCES; i++)
+  {
+    std::string name(header->sources[i], strnlen(header->sources[i], track_history::SOURCE_NAME_LENGTH));
+    std::vector<std::string>::iterator it = std::find(sources_.begin(), sources_.end(), name);
+    if (it == sources_.end())
+      it = sources_.insert(sources_.end(), name);
+    segment.sources.push_back(uint16_t(it - sources_.begin()));
+  }
+  return true;
+}
+
+template <typename T> const T*
+TrackHistoryReader::column(const Segment& segment, track_history::Column column) const
+{
+  return reinterpret_cast<const T*>(segment.data + track_history::columnOffset(column, segment.header->capacity));
+}
+
+} /* namespace tracking */
+} /* namespace open_ptrack */
@@ -161,6 +161,66 @@ Tracker::updateTracks()
   createNewTracks();
 }
 
+void
+Tracker::updateLateTracks(const std::vector<open_ptrack::detection::Detection>& late_detections)
+{
+  if (late_detections.empty())
+    return;
+  std::vector<open_ptrack::detection::Detection> detections = late_detections;
+  ros::Time detections_time = detections[0].getSource()->getTime();
+
+  // Only the tracks whose state at the time of the detections is known can be updated:
+  std::vector<Track*> tracks;
+  for(std::list<Track*>::const_iterator it = tracks_.begin(); it != tracks_.end(); it++)
+  {
+    if ((*it)->canUpdateLate(detections_time))
+      tracks.push_back(*it);
+  }
+  if (tracks.empty())
+    return;
+
+  cv::Mat_<double> distance_matrix(tracks.size(), detections.size());
+  cv::Mat_<double> cost_matrix(tracks.size(), detections.size());
+  for(size_t track = 0; track < tracks.size(); track++)
+  {
+    for(size_t measure = 0; measure < detections.size(); measure++)
+    {
+      open_ptrack::detection::Detection& d = detections[measure];
+      double detector_likelihood = detector_likelihood_ ? d.getConfidence() : 0;
+      double motion_likelihood = tracks[track]->getLateMahalanobisDistance(
+            d.getWorldCentroid()(0), d.getWorldCentroid()(1), detections_time);
+      double distance = likelihood_weights_[0] * detector_likelihood + likelihood_weights_[1] * motion_likelihood;
+
+      // Remove NaN and inf:
+      if (std::isnan(distance) | (not std::isfinite(distance)))
+        distance = 2*gate_distance_;
+
+      distance_matrix(track, measure) = distance;
+      cost_matrix(track, measure) = distance > gate_distance_ ? 1000000.0 : distance;
+    }
+  }
+
+  // Solve Global Nearest Neighbor problem:
+  Munkres munkres;
+  cost_matrix = munkres.solve(cost_matrix, false);	// rows: targets (tracks), cols: detections
+
+  for(size_t track = 0; track < tracks.size(); track++)
+  {
+    Track* t = tracks[track];
+    for(size_t measure = 0; measure < detections.size(); measure++)
+    {
+      open_ptrack::detection::Detection& d = detections[measure];
+      if(cost_matrix(track, measure) == 0.0 && distance_matrix(track, measure) <= gate_distance_ &&
+          ((t->getLowConfidenceConsecutiveFrames() < 10) || (d.getConfidence() > ((min_confidence_ + min_confidence_detections_)/2))))
+      {
+        t->updateLate(d.getWorldCentroid()(0), d.getWorldCentroid()(1), d.getWorldCentroid()(2), d.getHeight(),
+                      d.getDistance(), d.getConfidence(), min_confidence_, min_confidence_detections_, d.getSource());
+        break;
+      }
+    }
+  }
+}
+
 //    void Tracker::drawRgb()
 //    {
 //      for(std::list<open_ptrack::tracking::Track*>::iterator it = tracks_.begin(); it != tracks_.end(); it++)
@@ -252,6 +312,21 @@ Tracker::appendToPointCloud(pcl::PointCloud<pcl::PointXYZRGB>::Ptr& pointcloud,
   return starting_index;
 }
 
+void
+Tracker::appendToHistory(TrackHistoryWriter* writer, const ros::Time& time)
+{
+  for(std::list<open_ptrack::tracking::Track*>::iterator it = tracks_.begin(); it != tracks_.end(); it++)
+  {
+    open_ptrack::tracking::Track* t = *it;
+
+    TrackHistoryRecord record;
+    t->toHistoryRecord(record);
+    record.time = time.toSec();
+    record.source = writer->getSourceIndex(t->getDetectionSource()->getFrameId());
+    writer->push(record);
+  }
+}
+
 /************************ protected methods ************************/
 
 int
@@ -562,6 +562,196 @@ void validate_detector_recall(char *cfgfile, char *weightfile)
     }
 }
 
+typedef struct{
+    float prob;
+    int image;
+    box b;
+} scored_box;
+
+typedef struct{
+    scored_box *boxes;
+    int n;
+    int size;
+} scored_boxes;
+
+static void add_scored_box(scored_boxes *d, float prob, int image, box b)
+{
+    if(d->n == d->size){
+        d->size = d->size ? 2*d->size : 1024;
+        d->boxes = realloc(d->boxes, d->size*sizeof(scored_box));
+    }
+    scored_box s = {prob, image, b};
+    d->boxes[d->n++] = s;
+}
+
+static int scored_box_comparator(const void *pa, const void *pb)
+{
+    float diff = ((const scored_box *)pb)->prob - ((const scored_box *)pa)->prob;
+    return diff < 0 ? -1 : diff > 0;
+}
+
+/*
+ * VOC average precision (area under the interpolated precision/recall curve) of the
+ * detections of one class, matched to the labels with IOU > .5
+ */
+static float average_precision(scored_boxes d, int class, box_label **truth, int *num_truth, int images)
+{
+    int i, j;
+    int *first = calloc(images + 1, sizeof(int));
+    int positives = 0;
+    for(i = 0; i < images; ++i){
+        first[i+1] = first[i] + num_truth[i];
+        for(j = 0; j < num_truth[i]; ++j) positives += truth[i][j].id == class;
+    }
+    if(!positives){
+        free(first);
+        return -1;
+    }
+    char *used = calloc(first[images], sizeof(char));
+    float *precision = calloc(d.n + 1, sizeof(float));
+    float *recall = calloc(d.n + 1, sizeof(float));
+    qsort(d.boxes, d.n, sizeof(scored_box), scored_box_comparator);
+    int tp = 0;
+    for(i = 0; i < d.n; ++i){
+        scored_box s = d.boxes[i];
+        float best_iou = .5;
+        int best = -1;
+        for(j = 0; j < num_truth[s.image]; ++j){
+            box_label t = truth[s.image][j];
+            if(t.id != class) continue;
+            box b = {t.x, t.y, t.w, t.h};
+            float iou = box_iou(s.b, b);
+            if(iou > best_iou){
+                best_iou = iou;
+                best = j;
+            }
+        }
+        if(best >= 0 && !used[first[s.image] + best]){
+            used[first[s.image] + best] = 1;
+            ++tp;
+        }
+        precision[i+1] = (float)tp/(i+1);
+        recall[i+1] = (float)tp/positives;
+    }
+    float ap = 0;
+    for(i = d.n - 1; i > 0; --i){
+        if(precision[i+1] > precision[i]) precision[i] = precision[i+1];
+    }
+    for(i = 1; i <= d.n; ++i){
+        ap += (recall[i] - recall[i-1])*precision[i];
+    }
+    free(first);
+    free(used);
+    free(precision);
+    free(recall);
+    return ap;
+}
+
+/*
+ * Int8 weights of the CPU detector, see load_quantized_weights.
+ * The largest input of every convolution is measured on the first calib images of "train",
+ * then the mAP@.5 of the float and of the int8 network are compared on the "valid" images.
+ */
+void quantize_detector(char *datacfg, char *cfgfile, char *weightfile, char *outfile, int calib)
+{
+    int i, j, k, c;
+    list *options = read_data_cfg(datacfg);
+    char *train_images = option_find_str(options, "train", "data/train.list");
+    char *valid_images = option_find_str(options, "valid", "data/train.list");
+    if(!outfile) outfile = "int8.weights";
+
+    gpu_index = -1;
+    network *net = load_network(cfgfile, weightfile, 0);
+    set_batch_network(net, 1);
+    fuse_batchnorm(net);
+
+    list *plist = get_paths(train_images);
+    char **paths = (char **)list_to_array(plist);
+    float *input_max = calloc(net->n, sizeof(float));
+    for(i = 0; i < calib && i < plist->size; ++i){
+        image orig = load_image_color(paths[i], 0, 0);
+        image sized = resize_image(orig, net->w, net->h);
+        network_predict(net, sized.data);
+        for(j = 0; j < net->n; ++j){
+            layer l = net->layers[j];
+            if(l.type != CONVOLUTIONAL) continue;
+            float *input = j ? net->layers[j-1].output : sized.data;
+            for(k = 0; k < l.inputs; ++k){
+                float v = input[k] < 0 ? -input[k] : input[k];
+                if(v > input_max[j]) input_max[j] = v;
+            }
+        }
+        free_image(orig);
+        free_image(sized);
+    }
+    fprintf(stderr, "Calibrated on %d images\n", i);
+    quantize_network(net, input_max);
+    save_quantized_weights(net, outfile);
+
+    plist = get_paths(valid_images);
+    paths = (char **)list_to_array(plist);
+    int m = plist->size;
+
+    layer l = net->layers[net->n-1];
+    int classes = l.classes;
+    int total = l.w*l.h*l.n;
+    box *boxes = calloc(total, sizeof(box));
+    float **probs = calloc(total, sizeof(float *));
+    for(j = 0; j < total; ++j) probs[j] = calloc(classes+1, sizeof(float));
+
+    box_label **truth = calloc(m, sizeof(box_label *));
+    int *num_truth = calloc(m, sizeof(int));
+    scored_boxes *dets[2];
+    double seconds[2] = {0, 0};
+    for(k = 0; k < 2; ++k) dets[k] = calloc(classes, sizeof(scored_boxes));
+
+    for(i = 0; i < m; ++i){
+        char *path = paths[i];
+        char labelpath[4096];
+        find_replace(path, "images", "labels", labelpath);
+        find_replace(labelpath, "JPEGImages", "labels", labelpath);
+        find_replace(labelpath, ".jpg", ".txt", labelpath);
+        find_replace(labelpath, ".JPEG", ".txt", labelpath);
+        truth[i] = read_boxes(labelpath, &num_truth[i]);
+
+        image orig = load_image_color(path, 0, 0);
+        image sized = resize_image(orig, net->w, net->h);
+        for(k = 0; k < 2; ++k){
+            set_quantized_network(net, k);
+            double start = what_time_is_it_now();
+            network_predict(net, sized.data);
+            seconds[k] += what_time_is_it_now() - start;
+            get_region_boxes(l, sized.w, sized.h, net->w, net->h, .005, probs, boxes, 0, 0, 0, .5, 1);
+            do_nms_sort(boxes, probs, total, classes, .45);
+            for(j = 0; j < total; ++j){
+                for(c = 0; c < classes; ++c){
+                    if(probs[j][c] > 0) add_scored_box(&dets[k][c], probs[j][c], i, boxes[j]);
+                }
+            }
+        }
+        free_image(orig);
+        free_image(sized);
+    }
+
+    float map[2] = {0, 0};
+    int n = 0;
+    for(c = 0; c < classes; ++c){
+        float ap = average_precision(dets[0][c], c, truth, num_truth, m);
+        if(ap < 0) continue;
+        float ap8 = average_precision(dets[1][c], c, truth, num_truth, m);
+        fprintf(stderr, "class %3d: AP float %.4f int8 %.4f\n", c, ap, ap8);
+        map[0] += ap;
+        map[1] += ap8;
+        ++n;
+    }
+    if(n){
+        map[0] /= n;
+        map[1] /= n;
+    }
+    fprintf(stderr, "mAP@.5 on %d images: float %.4f int8 %.4f, drop %.4f\n", m, map[0], map[1], map[0] - map[1]);
+    fprintf(stderr, "forward: float %.1f ms int8 %.1f ms\n", 1000*seconds[0]/(m ? m : 1), 1000*seconds[1]/(m ? m : 1));
+}
+
 void test_detector(char *datacfg, char *cfgfile, char *weightfile, char *filename, float thresh, float hier_thresh, char *outfile, int fullscreen)
 {
     list *options = read_data_cfg(datacfg);
@@ -645,7 +835,7 @@ void run_detector(int argc, char **argv)
     int frame_skip = find_int_arg(argc, argv, "-s", 0);
     int avg = find_int_arg(argc, argv, "-avg", 3);
     if(argc < 4){
-        fprintf(stderr, "usage: %s %s [train/test/valid] [cfg] [weights (optional)]\n", argv[0], argv[1]);
+        fprintf(stderr, "usage: %s %s [train/test/valid/quantize] [cfg] [weights (optional)]\n", argv[0], argv[1]);
         return;
     }
     char *gpu_list = find_char_arg(argc, argv, "-gpus", 0);
@@ -677,6 +867,7 @@ void run_detector(int argc, char **argv)
     int width = find_int_arg(argc, argv, "-w", 0);
     int height = find_int_arg(argc, argv, "-h", 0);
     int fps = find_int_arg(argc, argv, "-fps", 0);
+    int calib = find_int_arg(argc, argv, "-calib", 100);
 
     char *datacfg = argv[3];
     char *cfg = argv[4];
@@ -687,6 +878,7 @@ void run_detector(int argc, char **argv)
     else if(0==strcmp(argv[2], "valid")) validate_detector(datacfg, cfg, weights, outfile);
     else if(0==strcmp(argv[2], "valid2")) validate_detector_flip(datacfg, cfg, weights, outfile);
     else if(0==strcmp(argv[2], "recall")) validate_detector_recall(cfg, weights);
+    else if(0==strcmp(argv[2], "quantize")) quantize_detector(datacfg, cfg, weights, outfile, calib);
     else if(0==strcmp(argv[2], "demo")) {
         list *options = read_data_cfg(datacfg);
         int classes = option_find_int(options, "classes", 20);
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 #include <pthread.h>
 
 #define SECRET_NUM -1234
@@ -148,6 +149,7 @@ struct layer{
     int index;
     int binary;
     int xnor;
+    int quantized;
     int steps;
     int hidden;
     int truth;
@@ -196,6 +198,7 @@ struct layer{
     float temperature;
     float probability;
     float scale;
+    float input_scale;
 
     char  * cweights;
     int   * indexes;
@@ -226,6 +229,10 @@ struct layer{
     float * weights;
     float * weight_updates;
 
+    int8_t  * weights_int8;         // int8 forward: weights = weights_int8 * weight_scales[filter]
+    float   * weight_scales;
+    int32_t * weights_int8_packed;  // weights_int8 packed for gemm_int8
+
     float * delta;
     float * output;
     float * squared;
@@ -471,6 +478,8 @@ typedef struct network{
     int index;
     float *cost;
 
+    double *layer_times;    // CPU forward time of every layer and number of passes, see set_benchmark_layers
+
 #ifdef GPU
     float *input_gpu;
     float *truth_gpu;
@@ -650,15 +659,23 @@ char *option_find_str(list *l, char *key, char *def);
 int option_find_int(list *l, char *key, int def);
 
 network *parse_network_cfg(char *filename);
+network *parse_network_cfg_batch(char *filename, int batch);
 void save_weights(network *net, char *filename);
 void load_weights(network *net, char *filename);
 void save_weights_upto(network *net, char *filename, int cutoff);
 void load_weights_upto(network *net, char *filename, int start, int cutoff);
+void save_quantized_weights(network *net, char *filename);
+void load_quantized_weights(network *net, char *filename);
 
 void zero_objectness(layer l);
 void get_region_boxes(layer l, int w, int h, int netw, int neth, float thresh, float **probs, box *boxes, float **masks, int only_objectness, int *map, float tree_thresh, int relative);
 void free_network(network *net);
 void set_batch_network(network *net, int b);
+void fuse_batchnorm(network *net);
+void set_benchmark_layers(network *net, int benchmark);
+void print_layer_times(network *net);
+void quantize_network(network *net, float *input_max);
+void set_quantized_network(network *net, int quantized);
 void set_temp_network(network *net, float t);
 image load_image(char *filename, int w, int h, int c);
 image load_image_color(char *filename, int w, int h);
@@ -7,6 +7,7 @@
 #include "gemm.h"
 #include <stdio.h>
 #include <time.h>
+#include <math.h>
 
 #ifdef AI2
 #include "xnor_layer.h"
@@ -462,10 +463,19 @@ void forward_convolutional_layer(convolutional_layer l, network net)
             float *a = l.weights + j*l.nweights/l.groups;
             float *b = net.workspace;
             float *c = l.output + (i*l.groups + j)*n*m;
+            float *im = net.input + (i*l.groups + j)*l.c/l.groups*l.h*l.w;
 
-            im2col_cpu(net.input + (i*l.groups + j)*l.c/l.groups*l.h*l.w,
-                l.c/l.groups, l.h, l.w, l.size, l.stride, l.pad, b);
-            gemm(0,0,m,n,k,1,a,k,b,n,1,c,n);
+            if (l.size == 1 && l.stride == 1 && l.pad == 0) {
+                b = im;   // im2col of a 1x1 convolution is the input itself
+            } else {
+                im2col_cpu(im, l.c/l.groups, l.h, l.w, l.size, l.stride, l.pad, b);
+            }
+            if(l.quantized){
+                gemm_int8(m, n, k, l.weights_int8_packed + j*gemm_int8_packed_size(m, k), l.weight_scales + j*m,
+                        b, n, l.input_scale, c, n);
+            } else {
+                gemm(0,0,m,n,k,1,a,k,b,n,1,c,n);
+            }
         }
     }
 
@@ -479,6 +489,40 @@ void forward_convolutional_layer(convolutional_layer l, network net)
     if(l.binary || l.xnor) swap_binary(&l);
 }
 
+/*
+ * Int8 weights for the CPU forward pass: each filter is scaled so its largest weight is 127,
+ * the input is quantized with the largest value input_max seen in calibration.
+ */
+void quantize_convolutional_layer(convolutional_layer *l, float input_max)
+{
+    int i, j;
+    int size = l->nweights/l->n;
+    if(!l->weights_int8) l->weights_int8 = calloc(l->nweights, sizeof(int8_t));
+    if(!l->weight_scales) l->weight_scales = calloc(l->n, sizeof(float));
+    for(i = 0; i < l->n; ++i){
+        float max = 0;
+        for(j = 0; j < size; ++j) max = fmaxf(max, fabsf(l->weights[i*size + j]));
+        l->weight_scales[i] = max > 0 ? max/127 : 1;
+        for(j = 0; j < size; ++j) l->weights_int8[i*size + j] = lrintf(l->weights[i*size + j]/l->weight_scales[i]);
+    }
+    l->input_scale = input_max > 0 ? input_max/127 : 1;
+    pack_convolutional_weights_int8(l);
+}
+
+void pack_convolutional_weights_int8(convolutional_layer *l)
+{
+    int j;
+    int m = l->n/l->groups;
+    int k = l->size*l->size*l->c/l->groups;
+    size_t size = gemm_int8_packed_size(m, k);
+    free(l->weights_int8_packed);
+    l->weights_int8_packed = calloc(l->groups*size, sizeof(int32_t));
+    for(j = 0; j < l->groups; ++j){
+        gemm_int8_pack_a(m, k, l->weights_int8 + j*l->nweights/l->groups, k, l->weights_int8_packed + j*size);
+    }
+    l->quantized = 1;
+}
+
 void backward_convolutional_layer(convolutional_layer l, network net)
 {
     int i, j;
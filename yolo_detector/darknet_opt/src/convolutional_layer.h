@@ -36,6 +36,9 @@ void binarize_weights2(float *weights, int n, int size, char *binary, float *sca
 
 void backward_convolutional_layer(convolutional_layer layer, network net);
 
+void quantize_convolutional_layer(convolutional_layer *layer, float input_max);
+void pack_convolutional_weights_int8(convolutional_layer *layer);
+
 void add_bias(float *output, float *biases, int batch, int n, int size);
 void backward_bias(float *bias_updates, float *delta, int batch, int n, int size);
 
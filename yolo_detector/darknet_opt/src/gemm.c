@@ -4,6 +4,12 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#ifdef OPENBLAS
+#include <cblas.h>
+#endif
 
 void gemm_bin(int M, int N, int K, float ALPHA, 
         char  *A, int lda, 
@@ -71,7 +77,7 @@ void gemm(int TA, int TB, int M, int N, int K, float ALPHA,
     gemm_cpu( TA,  TB,  M, N, K, ALPHA,A,lda, B, ldb,BETA,C,ldc);
 }
 
-void gemm_nn(int M, int N, int K, float ALPHA, 
+static void gemm_nn_loop(int M, int N, int K, float ALPHA, 
         float *A, int lda, 
         float *B, int ldb,
         float *C, int ldc)
@@ -88,6 +94,371 @@ void gemm_nn(int M, int N, int K, float ALPHA,
     }
 }
 
+#if defined(__AVX2__) && defined(__FMA__)
+/*
+ * Cache blocked gemm_nn for the CPU forward pass.
+ * A is packed in GEMM_MC x GEMM_KC blocks of GEMM_MR rows (scaled by ALPHA), B in
+ * GEMM_KC x GEMM_NC blocks of GEMM_NR columns, so the micro kernel accumulates a
+ * GEMM_MR x GEMM_NR tile of C in registers reading both operands contiguously.
+ */
+#define GEMM_MR 6
+#if defined(__AVX512F__)
+#define GEMM_NR 32
+#else
+#define GEMM_NR 16
+#endif
+#define GEMM_MC (GEMM_MR*24)
+#define GEMM_KC 256
+#define GEMM_NC (GEMM_NR*128)
+#define GEMM_MIN_FLOPS (64*64*64)  // smaller products are faster without packing
+
+static void gemm_pack_a(int mc, int kc, float ALPHA, float *A, int lda, float *pa)
+{
+    int i, ir, p;
+    #pragma omp parallel for private(i, p)
+    for(ir = 0; ir < mc; ir += GEMM_MR){
+        float *panel = pa + ir*kc;
+        int mr = mc - ir < GEMM_MR ? mc - ir : GEMM_MR;
+        for(p = 0; p < kc; ++p){
+            for(i = 0; i < mr; ++i) panel[p*GEMM_MR + i] = ALPHA*A[(ir + i)*lda + p];
+            for(; i < GEMM_MR; ++i) panel[p*GEMM_MR + i] = 0;
+        }
+    }
+}
+
+static void gemm_pack_b(int kc, int nc, float *B, int ldb, float *pb)
+{
+    int j, jr, p;
+    #pragma omp parallel for private(j, p)
+    for(jr = 0; jr < nc; jr += GEMM_NR){
+        float *panel = pb + jr*kc;
+        int nr = nc - jr < GEMM_NR ? nc - jr : GEMM_NR;
+        for(p = 0; p < kc; ++p){
+            for(j = 0; j < nr; ++j) panel[p*GEMM_NR + j] = B[p*ldb + jr + j];
+            for(; j < GEMM_NR; ++j) panel[p*GEMM_NR + j] = 0;
+        }
+    }
+}
+
+static void gemm_micro_kernel(int kc, const float *pa, const float *pb, float *C, int ldc, int mr, int nr)
+{
+    float acc[GEMM_MR][GEMM_NR];
+    int i, j, p;
+#if defined(__AVX512F__)
+    __m512 c00 = _mm512_setzero_ps(), c01 = _mm512_setzero_ps();
+    __m512 c10 = _mm512_setzero_ps(), c11 = _mm512_setzero_ps();
+    __m512 c20 = _mm512_setzero_ps(), c21 = _mm512_setzero_ps();
+    __m512 c30 = _mm512_setzero_ps(), c31 = _mm512_setzero_ps();
+    __m512 c40 = _mm512_setzero_ps(), c41 = _mm512_setzero_ps();
+    __m512 c50 = _mm512_setzero_ps(), c51 = _mm512_setzero_ps();
+    for(p = 0; p < kc; ++p){
+        __m512 b0 = _mm512_load_ps(pb + p*GEMM_NR);
+        __m512 b1 = _mm512_load_ps(pb + p*GEMM_NR + 16);
+        __m512 a;
+        a = _mm512_set1_ps(pa[p*GEMM_MR + 0]); c00 = _mm512_fmadd_ps(a, b0, c00); c01 = _mm512_fmadd_ps(a, b1, c01);
+        a = _mm512_set1_ps(pa[p*GEMM_MR + 1]); c10 = _mm512_fmadd_ps(a, b0, c10); c11 = _mm512_fmadd_ps(a, b1, c11);
+        a = _mm512_set1_ps(pa[p*GEMM_MR + 2]); c20 = _mm512_fmadd_ps(a, b0, c20); c21 = _mm512_fmadd_ps(a, b1, c21);
+        a = _mm512_set1_ps(pa[p*GEMM_MR + 3]); c30 = _mm512_fmadd_ps(a, b0, c30); c31 = _mm512_fmadd_ps(a, b1, c31);
+        a = _mm512_set1_ps(pa[p*GEMM_MR + 4]); c40 = _mm512_fmadd_ps(a, b0, c40); c41 = _mm512_fmadd_ps(a, b1, c41);
+        a = _mm512_set1_ps(pa[p*GEMM_MR + 5]); c50 = _mm512_fmadd_ps(a, b0, c50); c51 = _mm512_fmadd_ps(a, b1, c51);
+    }
+    _mm512_storeu_ps(acc[0], c00); _mm512_storeu_ps(acc[0] + 16, c01);
+    _mm512_storeu_ps(acc[1], c10); _mm512_storeu_ps(acc[1] + 16, c11);
+    _mm512_storeu_ps(acc[2], c20); _mm512_storeu_ps(acc[2] + 16, c21);
+    _mm512_storeu_ps(acc[3], c30); _mm512_storeu_ps(acc[3] + 16, c31);
+    _mm512_storeu_ps(acc[4], c40); _mm512_storeu_ps(acc[4] + 16, c41);
+    _mm512_storeu_ps(acc[5], c50); _mm512_storeu_ps(acc[5] + 16, c51);
+#else
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+    for(p = 0; p < kc; ++p){
+        __m256 b0 = _mm256_load_ps(pb + p*GEMM_NR);
+        __m256 b1 = _mm256_load_ps(pb + p*GEMM_NR + 8);
+        __m256 a;
+        a = _mm256_broadcast_ss(pa + p*GEMM_MR + 0); c00 = _mm256_fmadd_ps(a, b0, c00); c01 = _mm256_fmadd_ps(a, b1, c01);
+        a = _mm256_broadcast_ss(pa + p*GEMM_MR + 1); c10 = _mm256_fmadd_ps(a, b0, c10); c11 = _mm256_fmadd_ps(a, b1, c11);
+        a = _mm256_broadcast_ss(pa + p*GEMM_MR + 2); c20 = _mm256_fmadd_ps(a, b0, c20); c21 = _mm256_fmadd_ps(a, b1, c21);
+        a = _mm256_broadcast_ss(pa + p*GEMM_MR + 3); c30 = _mm256_fmadd_ps(a, b0, c30); c31 = _mm256_fmadd_ps(a, b1, c31);
+        a = _mm256_broadcast_ss(pa + p*GEMM_MR + 4); c40 = _mm256_fmadd_ps(a, b0, c40); c41 = _mm256_fmadd_ps(a, b1, c41);
+        a = _mm256_broadcast_ss(pa + p*GEMM_MR + 5); c50 = _mm256_fmadd_ps(a, b0, c50); c51 = _mm256_fmadd_ps(a, b1, c51);
+    }
+    _mm256_storeu_ps(acc[0], c00); _mm256_storeu_ps(acc[0] + 8, c01);
+    _mm256_storeu_ps(acc[1], c10); _mm256_storeu_ps(acc[1] + 8, c11);
+    _mm256_storeu_ps(acc[2], c20); _mm256_storeu_ps(acc[2] + 8, c21);
+    _mm256_storeu_ps(acc[3], c30); _mm256_storeu_ps(acc[3] + 8, c31);
+    _mm256_storeu_ps(acc[4], c40); _mm256_storeu_ps(acc[4] + 8, c41);
+    _mm256_storeu_ps(acc[5], c50); _mm256_storeu_ps(acc[5] + 8, c51);
+#endif
+    for(i = 0; i < mr; ++i){
+        for(j = 0; j < nr; ++j){
+            C[i*ldc + j] += acc[i][j];
+        }
+    }
+}
+
+void gemm_nn(int M, int N, int K, float ALPHA, 
+        float *A, int lda, 
+        float *B, int ldb,
+        float *C, int ldc)
+{
+    if((double)M*N*K < GEMM_MIN_FLOPS){
+        gemm_nn_loop(M, N, K, ALPHA, A, lda, B, ldb, C, ldc);
+        return;
+    }
+    float *pa = aligned_alloc(64, GEMM_MC*GEMM_KC*sizeof(float));
+    float *pb = aligned_alloc(64, GEMM_KC*GEMM_NC*sizeof(float));
+    int jc, pc, ic, jr, ir;
+    for(jc = 0; jc < N; jc += GEMM_NC){
+        int nc = N - jc < GEMM_NC ? N - jc : GEMM_NC;
+        for(pc = 0; pc < K; pc += GEMM_KC){
+            int kc = K - pc < GEMM_KC ? K - pc : GEMM_KC;
+            gemm_pack_b(kc, nc, B + pc*ldb + jc, ldb, pb);
+            for(ic = 0; ic < M; ic += GEMM_MC){
+                int mc = M - ic < GEMM_MC ? M - ic : GEMM_MC;
+                gemm_pack_a(mc, kc, ALPHA, A + ic*lda + pc, lda, pa);
+                #pragma omp parallel for collapse(2) schedule(static)
+                for(jr = 0; jr < nc; jr += GEMM_NR){
+                    for(ir = 0; ir < mc; ir += GEMM_MR){
+                        int mr = mc - ir < GEMM_MR ? mc - ir : GEMM_MR;
+                        int nr = nc - jr < GEMM_NR ? nc - jr : GEMM_NR;
+                        gemm_micro_kernel(kc, pa + ir*kc, pb + jr*kc, C + (ic + ir)*ldc + jc + jr, ldc, mr, nr);
+                    }
+                }
+            }
+        }
+    }
+    free(pa);
+    free(pb);
+}
+#else
+void gemm_nn(int M, int N, int K, float ALPHA, 
+        float *A, int lda, 
+        float *B, int ldb,
+        float *C, int ldc)
+{
+    gemm_nn_loop(M, N, K, ALPHA, A, lda, B, ldb, C, ldc);
+}
+#endif
+
+/*
+ * Integer gemm_nn of the int8 convolutions, C += (A*B) scaled back to float.
+ * A holds int8 weights with the per row scales a_scales, it is packed once (gemm_int8_pack_a)
+ * in panels of GEMM_INT8_MR rows. B is quantized while packed: round(B/b_scale) clamped to
+ * [-127, 127]. Both operands are stored as pairs of int16 (k even in the low half, k odd in the
+ * high one) in an int32, so pmaddwd (or vpdpwssd with VNNI) multiplies two k and sums them
+ * in int32 without saturation, and C += acc * a_scales[i] * b_scale.
+ */
+#define GEMM_INT8_MR 6
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+#define GEMM_INT8_NR 32
+#elif defined(__AVX2__)
+#define GEMM_INT8_NR 16
+#else
+#define GEMM_INT8_NR 8
+#endif
+#define GEMM_INT8_KC 512
+#define GEMM_INT8_NC (GEMM_INT8_NR*128)
+
+static inline int32_t int16_pair(int lo, int hi)
+{
+    return (int32_t)((uint32_t)(uint16_t)lo | ((uint32_t)(uint16_t)hi << 16));
+}
+
+size_t gemm_int8_packed_size(int M, int K)
+{
+    size_t panels = (M + GEMM_INT8_MR - 1)/GEMM_INT8_MR;
+    return panels*GEMM_INT8_MR*((K + 1)/2);
+}
+
+void gemm_int8_pack_a(int M, int K, int8_t *A, int lda, int32_t *pa)
+{
+    int i, ir, p;
+    int kp = (K + 1)/2;
+    for(ir = 0; ir < M; ir += GEMM_INT8_MR){
+        int32_t *panel = pa + ir*kp;
+        for(p = 0; p < kp; ++p){
+            for(i = 0; i < GEMM_INT8_MR; ++i){
+                int lo = 0, hi = 0;
+                if(ir + i < M){
+                    lo = A[(ir + i)*lda + 2*p];
+                    if(2*p + 1 < K) hi = A[(ir + i)*lda + 2*p + 1];
+                }
+                panel[p*GEMM_INT8_MR + i] = int16_pair(lo, hi);
+            }
+        }
+    }
+}
+
+static inline int quantize_int8(float x, float inv_scale)
+{
+    int q = (int)lrintf(x*inv_scale);
+    return q > 127 ? 127 : (q < -127 ? -127 : q);
+}
+
+static void gemm_int8_pack_b(int kc, int nc, float *B, int ldb, float b_scale, int32_t *pb)
+{
+    int j, jr, p;
+    int kp = (kc + 1)/2;
+    float inv_scale = 1.f/b_scale;
+    #pragma omp parallel for private(j, p)
+    for(jr = 0; jr < nc; jr += GEMM_INT8_NR){
+        int32_t *panel = pb + jr*kp;
+        int nr = nc - jr < GEMM_INT8_NR ? nc - jr : GEMM_INT8_NR;
+        for(p = 0; p < kp; ++p){
+            float *b0 = B + 2*p*ldb + jr;
+            float *b1 = 2*p + 1 < kc ? b0 + ldb : 0;
+            j = 0;
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+            if(b1){
+                __m512 s = _mm512_set1_ps(inv_scale);
+                __m512i lo = _mm512_set1_epi32(-127), hi = _mm512_set1_epi32(127), mask = _mm512_set1_epi32(0xffff);
+                for(; j + 16 <= nr; j += 16){
+                    __m512i q0 = _mm512_cvtps_epi32(_mm512_mul_ps(_mm512_loadu_ps(b0 + j), s));
+                    __m512i q1 = _mm512_cvtps_epi32(_mm512_mul_ps(_mm512_loadu_ps(b1 + j), s));
+                    q0 = _mm512_min_epi32(_mm512_max_epi32(q0, lo), hi);
+                    q1 = _mm512_min_epi32(_mm512_max_epi32(q1, lo), hi);
+                    _mm512_store_si512(panel + p*GEMM_INT8_NR + j, _mm512_or_si512(_mm512_and_si512(q0, mask), _mm512_slli_epi32(q1, 16)));
+                }
+            }
+#elif defined(__AVX2__)
+            if(b1){
+                __m256 s = _mm256_set1_ps(inv_scale);
+                __m256i lo = _mm256_set1_epi32(-127), hi = _mm256_set1_epi32(127), mask = _mm256_set1_epi32(0xffff);
+                for(; j + 8 <= nr; j += 8){
+                    __m256i q0 = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(b0 + j), s));
+                    __m256i q1 = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(b1 + j), s));
+                    q0 = _mm256_min_epi32(_mm256_max_epi32(q0, lo), hi);
+                    q1 = _mm256_min_epi32(_mm256_max_epi32(q1, lo), hi);
+                    _mm256_store_si256((__m256i *)(panel + p*GEMM_INT8_NR + j), _mm256_or_si256(_mm256_and_si256(q0, mask), _mm256_slli_epi32(q1, 16)));
+                }
+            }
+#endif
+            for(; j < nr; ++j){
+                panel[p*GEMM_INT8_NR + j] = int16_pair(quantize_int8(b0[j], inv_scale), b1 ? quantize_int8(b1[j], inv_scale) : 0);
+            }
+            for(; j < GEMM_INT8_NR; ++j) panel[p*GEMM_INT8_NR + j] = 0;
+        }
+    }
+}
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+#if defined(__AVX512VNNI__)
+#define GEMM_INT8_MADD(c, a, b) _mm512_dpwssd_epi32(c, a, b)
+#else
+#define GEMM_INT8_MADD(c, a, b) _mm512_add_epi32(c, _mm512_madd_epi16(a, b))
+#endif
+#elif defined(__AVX2__)
+#define GEMM_INT8_MADD(c, a, b) _mm256_add_epi32(c, _mm256_madd_epi16(a, b))
+#endif
+
+static void gemm_int8_micro_kernel(int kp, const int32_t *pa, const int32_t *pb, float *C, int ldc, const float *scales, int mr, int nr)
+{
+    int32_t acc[GEMM_INT8_MR][GEMM_INT8_NR];
+    int i, j, p;
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+    __m512i c00 = _mm512_setzero_si512(), c01 = _mm512_setzero_si512();
+    __m512i c10 = _mm512_setzero_si512(), c11 = _mm512_setzero_si512();
+    __m512i c20 = _mm512_setzero_si512(), c21 = _mm512_setzero_si512();
+    __m512i c30 = _mm512_setzero_si512(), c31 = _mm512_setzero_si512();
+    __m512i c40 = _mm512_setzero_si512(), c41 = _mm512_setzero_si512();
+    __m512i c50 = _mm512_setzero_si512(), c51 = _mm512_setzero_si512();
+    for(p = 0; p < kp; ++p){
+        __m512i b0 = _mm512_load_si512(pb + p*GEMM_INT8_NR);
+        __m512i b1 = _mm512_load_si512(pb + p*GEMM_INT8_NR + 16);
+        __m512i a;
+        a = _mm512_set1_epi32(pa[p*GEMM_INT8_MR + 0]); c00 = GEMM_INT8_MADD(c00, a, b0); c01 = GEMM_INT8_MADD(c01, a, b1);
+        a = _mm512_set1_epi32(pa[p*GEMM_INT8_MR + 1]); c10 = GEMM_INT8_MADD(c10, a, b0); c11 = GEMM_INT8_MADD(c11, a, b1);
+        a = _mm512_set1_epi32(pa[p*GEMM_INT8_MR + 2]); c20 = GEMM_INT8_MADD(c20, a, b0); c21 = GEMM_INT8_MADD(c21, a, b1);
+        a = _mm512_set1_epi32(pa[p*GEMM_INT8_MR + 3]); c30 = GEMM_INT8_MADD(c30, a, b0); c31 = GEMM_INT8_MADD(c31, a, b1);
+        a = _mm512_set1_epi32(pa[p*GEMM_INT8_MR + 4]); c40 = GEMM_INT8_MADD(c40, a, b0); c41 = GEMM_INT8_MADD(c41, a, b1);
+        a = _mm512_set1_epi32(pa[p*GEMM_INT8_MR + 5]); c50 = GEMM_INT8_MADD(c50, a, b0); c51 = GEMM_INT8_MADD(c51, a, b1);
+    }
+    _mm512_storeu_si512(acc[0], c00); _mm512_storeu_si512(acc[0] + 16, c01);
+    _mm512_storeu_si512(acc[1], c10); _mm512_storeu_si512(acc[1] + 16, c11);
+    _mm512_storeu_si512(acc[2], c20); _mm512_storeu_si512(acc[2] + 16, c21);
+    _mm512_storeu_si512(acc[3], c30); _mm512_storeu_si512(acc[3] + 16, c31);
+    _mm512_storeu_si512(acc[4], c40); _mm512_storeu_si512(acc[4] + 16, c41);
+    _mm512_storeu_si512(acc[5], c50); _mm512_storeu_si512(acc[5] + 16, c51);
+#elif defined(__AVX2__)
+    __m256i c00 = _mm256_setzero_si256(), c01 = _mm256_setzero_si256();
+    __m256i c10 = _mm256_setzero_si256(), c11 = _mm256_setzero_si256();
+    __m256i c20 = _mm256_setzero_si256(), c21 = _mm256_setzero_si256();
+    __m256i c30 = _mm256_setzero_si256(), c31 = _mm256_setzero_si256();
+    __m256i c40 = _mm256_setzero_si256(), c41 = _mm256_setzero_si256();
+    __m256i c50 = _mm256_setzero_si256(), c51 = _mm256_setzero_si256();
+    for(p = 0; p < kp; ++p){
+        __m256i b0 = _mm256_load_si256((const __m256i *)(pb + p*GEMM_INT8_NR));
+        __m256i b1 = _mm256_load_si256((const __m256i *)(pb + p*GEMM_INT8_NR + 8));
+        __m256i a;
+        a = _mm256_set1_epi32(pa[p*GEMM_INT8_MR + 0]); c00 = GEMM_INT8_MADD(c00, a, b0); c01 = GEMM_INT8_MADD(c01, a, b1);
+        a = _mm256_set1_epi32(pa[p*GEMM_INT8_MR + 1]); c10 = GEMM_INT8_MADD(c10, a, b0); c11 = GEMM_INT8_MADD(c11, a, b1);
+        a = _mm256_set1_epi32(pa[p*GEMM_INT8_MR + 2]); c20 = GEMM_INT8_MADD(c20, a, b0); c21 = GEMM_INT8_MADD(c21, a, b1);
+        a = _mm256_set1_epi32(pa[p*GEMM_INT8_MR + 3]); c30 = GEMM_INT8_MADD(c30, a, b0); c31 = GEMM_INT8_MADD(c31, a, b1);
+        a = _mm256_set1_epi32(pa[p*GEMM_INT8_MR + 4]); c40 = GEMM_INT8_MADD(c40, a, b0); c41 = GEMM_INT8_MADD(c41, a, b1);
+        a = _mm256_set1_epi32(pa[p*GEMM_INT8_MR + 5]); c50 = GEMM_INT8_MADD(c50, a, b0); c51 = GEMM_INT8_MADD(c51, a, b1);
+    }
+    _mm256_storeu_si256((__m256i *)acc[0], c00); _mm256_storeu_si256((__m256i *)(acc[0] + 8), c01);
+    _mm256_storeu_si256((__m256i *)acc[1], c10); _mm256_storeu_si256((__m256i *)(acc[1] + 8), c11);
+    _mm256_storeu_si256((__m256i *)acc[2], c20); _mm256_storeu_si256((__m256i *)(acc[2] + 8), c21);
+    _mm256_storeu_si256((__m256i *)acc[3], c30); _mm256_storeu_si256((__m256i *)(acc[3] + 8), c31);
+    _mm256_storeu_si256((__m256i *)acc[4], c40); _mm256_storeu_si256((__m256i *)(acc[4] + 8), c41);
+    _mm256_storeu_si256((__m256i *)acc[5], c50); _mm256_storeu_si256((__m256i *)(acc[5] + 8), c51);
+#else
+    for(i = 0; i < GEMM_INT8_MR; ++i){
+        for(j = 0; j < GEMM_INT8_NR; ++j) acc[i][j] = 0;
+    }
+    for(p = 0; p < kp; ++p){
+        for(i = 0; i < GEMM_INT8_MR; ++i){
+            int32_t a = pa[p*GEMM_INT8_MR + i];
+            for(j = 0; j < GEMM_INT8_NR; ++j){
+                int32_t b = pb[p*GEMM_INT8_NR + j];
+                acc[i][j] += (int16_t)a*(int16_t)b + (int16_t)(a >> 16)*(int16_t)(b >> 16);
+            }
+        }
+    }
+#endif
+    for(i = 0; i < mr; ++i){
+        for(j = 0; j < nr; ++j){
+            C[i*ldc + j] += acc[i][j]*scales[i];
+        }
+    }
+}
+
+void gemm_int8(int M, int N, int K,
+        int32_t *pa, float *a_scales,
+        float *B, int ldb, float b_scale,
+        float *C, int ldc)
+{
+    int kp = (K + 1)/2;
+    int32_t *pb = aligned_alloc(64, GEMM_INT8_KC/2*GEMM_INT8_NC*sizeof(int32_t));
+    float *scales = calloc(M, sizeof(float));
+    int i, jc, pc, jr, ir;
+    for(i = 0; i < M; ++i) scales[i] = a_scales[i]*b_scale;
+    for(jc = 0; jc < N; jc += GEMM_INT8_NC){
+        int nc = N - jc < GEMM_INT8_NC ? N - jc : GEMM_INT8_NC;
+        for(pc = 0; pc < K; pc += GEMM_INT8_KC){
+            int kc = K - pc < GEMM_INT8_KC ? K - pc : GEMM_INT8_KC;
+            int kpc = (kc + 1)/2;
+            gemm_int8_pack_b(kc, nc, B + pc*ldb + jc, ldb, b_scale, pb);
+            #pragma omp parallel for collapse(2) schedule(static)
+            for(jr = 0; jr < nc; jr += GEMM_INT8_NR){
+                for(ir = 0; ir < M; ir += GEMM_INT8_MR){
+                    int mr = M - ir < GEMM_INT8_MR ? M - ir : GEMM_INT8_MR;
+                    int nr = nc - jr < GEMM_INT8_NR ? nc - jr : GEMM_INT8_NR;
+                    gemm_int8_micro_kernel(kpc, pa + ir*kp + pc/2*GEMM_INT8_MR, pb + jr*kpc,
+                            C + ir*ldc + jc + jr, ldc, scales + ir, mr, nr);
+                }
+            }
+        }
+    }
+    free(pb);
+    free(scales);
+}
+
 void gemm_nt(int M, int N, int K, float ALPHA, 
         float *A, int lda, 
         float *B, int ldb,
@@ -149,6 +520,11 @@ void gemm_cpu(int TA, int TB, int M, int N, int K, float ALPHA,
         float *C, int ldc)
 {
     //printf("cpu: %d %d %d %d %d %f %d %d %f %d\n",TA, TB, M, N, K, ALPHA, lda, ldb, BETA, ldc);
+#ifdef OPENBLAS
+    cblas_sgemm(CblasRowMajor, TA ? CblasTrans : CblasNoTrans, TB ? CblasTrans : CblasNoTrans,
+            M, N, K, ALPHA, A, lda, B, ldb, BETA, C, ldc);
+    return;
+#endif
     int i, j;
     for(i = 0; i < M; ++i){
         for(j = 0; j < N; ++j){
@@ -1,5 +1,7 @@
 #ifndef GEMM_H
 #define GEMM_H
+#include <stddef.h>
+#include <stdint.h>
 
 void gemm_bin(int M, int N, int K, float ALPHA, 
         char  *A, int lda, 
@@ -18,6 +20,13 @@ void gemm_cpu(int TA, int TB, int M, int N, int K, float ALPHA,
         float BETA,
         float *C, int ldc);
 
+size_t gemm_int8_packed_size(int M, int K);
+void gemm_int8_pack_a(int M, int K, int8_t *A, int lda, int32_t *pa);
+void gemm_int8(int M, int N, int K,
+        int32_t *pa, float *a_scales,
+        float *B, int ldb, float b_scale,
+        float *C, int ldc);
+
 #ifdef GPU
 void gemm_gpu(int TA, int TB, int M, int N, int K, float ALPHA, 
         float *A_gpu, int lda, 
@@ -32,6 +32,9 @@ void free_layer(layer l)
     if(l.scales)             free(l.scales);
     if(l.scale_updates)      free(l.scale_updates);
     if(l.weights)            free(l.weights);
+    if(l.weights_int8)       free(l.weights_int8);
+    if(l.weight_scales)      free(l.weight_scales);
+    if(l.weights_int8_packed) free(l.weights_int8_packed);
     if(l.weight_updates)     free(l.weight_updates);
     if(l.delta)              free(l.delta);
     if(l.output)             free(l.output);
@@ -197,15 +197,86 @@ void forward_network(network *netp)
         if(l.delta){
             fill_cpu(l.outputs * l.batch, 0, l.delta, 1);
         }
+        double start = net.layer_times ? what_time_is_it_now() : 0;
         l.forward(l, net);
+        if(net.layer_times) net.layer_times[i] += what_time_is_it_now() - start;
         net.input = l.output;
         if(l.truth) {
             net.truth = l.output;
         }
     }
+    if(net.layer_times) net.layer_times[net.n] += 1;   // number of timed forward passes
     calc_network_cost(netp);
 }
 
+void set_benchmark_layers(network *net, int benchmark)
+{
+    free(net->layer_times);
+    net->layer_times = benchmark ? calloc(net->n + 1, sizeof(double)) : 0;
+}
+
+void print_layer_times(network *net)
+{
+    if(!net->layer_times || !net->layer_times[net->n]) return;
+    double runs = net->layer_times[net->n];
+    int i;
+    double total = 0;
+    for(i = 0; i < net->n; ++i) total += net->layer_times[i];
+    fprintf(stderr, "Layer times, average of %.0f forward passes:\n", runs);
+    for(i = 0; i < net->n; ++i){
+        layer l = net->layers[i];
+        fprintf(stderr, "%5d %-12s %4d x%4d x%4d -> %4d x%4d x%4d %9.3f ms %5.1f%%\n", i, get_layer_string(l.type),
+                l.w, l.h, l.c, l.out_w, l.out_h, l.out_c, 1000*net->layer_times[i]/runs, 100*net->layer_times[i]/total);
+    }
+    fprintf(stderr, "Total %9.3f ms\n", 1000*total/runs);
+}
+
+void fuse_batchnorm(network *net)
+{
+    int i, j, k;
+    for(i = 0; i < net->n; ++i){
+        layer *l = net->layers + i;
+        if(l->type != CONVOLUTIONAL || !l->batch_normalize || l->binary || l->xnor) continue;
+        int size = l->nweights/l->n;
+        for(j = 0; j < l->n; ++j){
+            float scale = l->scales[j]/(sqrt(l->rolling_variance[j]) + .000001f);
+            for(k = 0; k < size; ++k){
+                l->weights[j*size + k] *= scale;
+            }
+            l->biases[j] -= l->rolling_mean[j]*scale;
+        }
+        l->batch_normalize = 0;
+#ifdef GPU
+        if(gpu_index >= 0){
+            push_convolutional_layer(*l);
+        }
+#endif
+    }
+}
+
+/*
+ * Int8 convolutions for the CPU forward pass. input_max[i] is the largest absolute input of
+ * layer i over the calibration images; batch normalization must be fused first.
+ */
+void quantize_network(network *net, float *input_max)
+{
+    int i;
+    for(i = 0; i < net->n; ++i){
+        layer *l = net->layers + i;
+        if(l->type != CONVOLUTIONAL || l->binary || l->xnor) continue;
+        quantize_convolutional_layer(l, input_max[i]);
+    }
+}
+
+void set_quantized_network(network *net, int quantized)
+{
+    int i;
+    for(i = 0; i < net->n; ++i){
+        layer *l = net->layers + i;
+        if(l->type == CONVOLUTIONAL && l->weights_int8_packed) l->quantized = quantized;
+    }
+}
+
 void update_network(network *netp)
 {
 #ifdef GPU
@@ -671,6 +742,7 @@ void free_network(network *net)
         free_layer(net->layers[i]);
     }
     free(net->layers);
+    free(net->layer_times);
     if(net->input) free(net->input);
     if(net->truth) free(net->truth);
 #ifdef GPU
@@ -632,6 +632,12 @@ int is_network(section *s)
 }
 
 network *parse_network_cfg(char *filename)
+{
+    return parse_network_cfg_batch(filename, 0);
+}
+
+// batch > 0 replaces the batch of the cfg, the network can then run any batch up to it (set_batch_network)
+network *parse_network_cfg_batch(char *filename, int batch)
 {
     list *sections = read_cfg(filename);
     node *n = sections->front;
@@ -644,6 +650,7 @@ network *parse_network_cfg(char *filename)
     list *options = s->options;
     if(!is_network(s)) error("First section must be [net] or [network]");
     parse_net_options(options, net);
+    if(batch > 0) net->batch = batch;
 
     params.h = net->h;
     params.w = net->w;
@@ -960,6 +967,111 @@ void save_weights(network *net, char *filename)
     save_weights_upto(net, filename, net->n);
 }
 
+/*
+ * Int8 convolutions written by "detector quantize": the version, the number of convolutional layers, then
+ * for every convolutional layer a flag and, for the flagged ones, the numbers of filters and weights,
+ * the input scale, the per filter weight scales and the int8 weights.
+ * They are quantized from the weights with the batch normalization fused.
+ */
+#define QUANTIZED_WEIGHTS_MAJOR 0
+#define QUANTIZED_WEIGHTS_MINOR 2
+#define QUANTIZED_WEIGHTS_REVISION 0
+
+static int count_convolutional_layers(network *net)
+{
+    int i;
+    int count = 0;
+    for(i = 0; i < net->n; ++i){
+        if(net->layers[i].type == CONVOLUTIONAL) ++count;
+    }
+    return count;
+}
+
+static void quantized_weights_error(char *filename, int layer, char *what)
+{
+    if(layer < 0) fprintf(stderr, "\n%s: int8 weights do not match the network (%s)\n", filename, what);
+    else fprintf(stderr, "\n%s: int8 weights do not match the network (layer %d: %s)\n", filename, layer, what);
+    exit(-1);
+}
+
+void save_quantized_weights(network *net, char *filename)
+{
+    fprintf(stderr, "Saving int8 weights to %s\n", filename);
+    FILE *fp = fopen(filename, "wb");
+    if(!fp) file_error(filename);
+
+    int major = QUANTIZED_WEIGHTS_MAJOR;
+    int minor = QUANTIZED_WEIGHTS_MINOR;
+    int revision = QUANTIZED_WEIGHTS_REVISION;
+    int convolutionals = count_convolutional_layers(net);
+    fwrite(&major, sizeof(int), 1, fp);
+    fwrite(&minor, sizeof(int), 1, fp);
+    fwrite(&revision, sizeof(int), 1, fp);
+    fwrite(&convolutionals, sizeof(int), 1, fp);
+
+    int i;
+    for(i = 0; i < net->n; ++i){
+        layer l = net->layers[i];
+        if(l.type != CONVOLUTIONAL) continue;
+        int quantized = l.weights_int8 != 0;
+        fwrite(&quantized, sizeof(int), 1, fp);
+        if(!quantized) continue;
+        fwrite(&l.n, sizeof(int), 1, fp);
+        fwrite(&l.nweights, sizeof(int), 1, fp);
+        fwrite(&l.input_scale, sizeof(float), 1, fp);
+        fwrite(l.weight_scales, sizeof(float), l.n, fp);
+        fwrite(l.weights_int8, sizeof(int8_t), l.nweights, fp);
+    }
+    fclose(fp);
+}
+
+void load_quantized_weights(network *net, char *filename)
+{
+    fprintf(stderr, "Loading int8 weights from %s...", filename);
+    FILE *fp = fopen(filename, "rb");
+    if(!fp) file_error(filename);
+
+    int major;
+    int minor;
+    int revision;
+    int convolutionals;
+    if(fread(&major, sizeof(int), 1, fp) != 1 || fread(&minor, sizeof(int), 1, fp) != 1 || fread(&revision, sizeof(int), 1, fp) != 1){
+        quantized_weights_error(filename, -1, "truncated header");
+    }
+    if(major != QUANTIZED_WEIGHTS_MAJOR || minor != QUANTIZED_WEIGHTS_MINOR || revision != QUANTIZED_WEIGHTS_REVISION){
+        fprintf(stderr, "\n%s: unsupported int8 weights version %d.%d.%d, expected %d.%d.%d\n", filename, major, minor, revision,
+                QUANTIZED_WEIGHTS_MAJOR, QUANTIZED_WEIGHTS_MINOR, QUANTIZED_WEIGHTS_REVISION);
+        exit(-1);
+    }
+    if(fread(&convolutionals, sizeof(int), 1, fp) != 1) quantized_weights_error(filename, -1, "truncated header");
+    if(convolutionals != count_convolutional_layers(net)) quantized_weights_error(filename, -1, "number of convolutional layers");
+
+    fuse_batchnorm(net);
+    int i;
+    for(i = 0; i < net->n; ++i){
+        layer *l = net->layers + i;
+        if(l->type != CONVOLUTIONAL) continue;
+        int quantized = 0;
+        int n = 0;
+        int nweights = 0;
+        if(fread(&quantized, sizeof(int), 1, fp) != 1) quantized_weights_error(filename, i, "truncated file");
+        if(!quantized) continue;
+        if(fread(&n, sizeof(int), 1, fp) != 1 || fread(&nweights, sizeof(int), 1, fp) != 1) quantized_weights_error(filename, i, "truncated file");
+        if(n != l->n || nweights != l->nweights) quantized_weights_error(filename, i, "number of filters or weights");
+        if(!l->weights_int8) l->weights_int8 = calloc(l->nweights, sizeof(int8_t));
+        if(!l->weight_scales) l->weight_scales = calloc(l->n, sizeof(float));
+        if(fread(&l->input_scale, sizeof(float), 1, fp) != 1
+                || fread(l->weight_scales, sizeof(float), l->n, fp) != l->n
+                || fread(l->weights_int8, sizeof(int8_t), l->nweights, fp) != l->nweights){
+            quantized_weights_error(filename, i, "truncated file");
+        }
+        pack_convolutional_weights_int8(l);
+    }
+    if(fgetc(fp) != EOF) quantized_weights_error(filename, -1, "trailing data");
+    fprintf(stderr, "Done!\n");
+    fclose(fp);
+}
+
 void transpose_matrix(float *a, int rows, int cols)
 {
     float *transpose = calloc(rows*cols, sizeof(float));
@@ -175,28 +175,107 @@ void extractObject(int imW, int imH, int num, float thresh, box *boxes, float **
     //free_ptrs((void **)probs, num);
 }
 
-void run_yolo_detection_obj(image im, network *net, box *boxes, float **probs, float thresh, float hier_thresh, char **names, boxInfo *result)
+/*
+ * Network input from a packed BGR8 image in a single pass: the image is letterboxed in boxed
+ * (planar RGB in [0,1], borders at .5) with the bilinear interpolation of resize_image,
+ * without the intermediate float images of ipl_to_image, resize_image and letterbox_image.
+ */
+void letterbox_bgr8_obj(const unsigned char *bgr, int w, int h, int step, image boxed)
 {
-    float nms=.4;
-    layer l = net->layers[net->n-1];
-    //clock_t t;
-    //t = clock();
-    
-    image sized = resize_image(im, net->w, net->h);
+    int new_w = w;
+    int new_h = h;
+    if (((float)boxed.w/w) < ((float)boxed.h/h)) {
+        new_w = boxed.w;
+        new_h = (h * boxed.w)/w;
+    } else {
+        new_h = boxed.h;
+        new_w = (w * boxed.h)/h;
+    }
+    int dx = (boxed.w - new_w)/2;
+    int dy = (boxed.h - new_h)/2;
+    float w_scale = new_w > 1 ? (float)(w - 1) / (new_w - 1) : 0;
+    float h_scale = new_h > 1 ? (float)(h - 1) / (new_h - 1) : 0;
+    int plane = boxed.w*boxed.h;
 
+    // source columns and weights of every output column
+    int x0[new_w];
+    int x1[new_w];
+    float fx[new_w];
+    int c, r;
+    for(c = 0; c < new_w; ++c){
+        float sx = c*w_scale;
+        int ix = (int) sx;
+        if(ix > w-1) ix = w-1;
+        x0[c] = 3*ix;
+        x1[c] = 3*(ix+1 < w ? ix+1 : ix);
+        fx[c] = sx - ix;
+    }
 
-	
+    #pragma omp parallel for private(c)
+    for(r = 0; r < boxed.h; ++r){
+        float *out_r = boxed.data + r*boxed.w;
+        float *out_g = out_r + plane;
+        float *out_b = out_g + plane;
+        int y = r - dy;
+        if(y < 0 || y >= new_h){
+            for(c = 0; c < boxed.w; ++c) out_r[c] = out_g[c] = out_b[c] = .5;
+            continue;
+        }
+        float sy = y*h_scale;
+        int iy = (int) sy;
+        if(iy > h-1) iy = h-1;
+        float fy = sy - iy;
+        const unsigned char *row0 = bgr + iy*step;
+        const unsigned char *row1 = bgr + (iy+1 < h ? iy+1 : iy)*step;
+        for(c = 0; c < dx; ++c) out_r[c] = out_g[c] = out_b[c] = .5;
+        for(c = dx + new_w; c < boxed.w; ++c) out_r[c] = out_g[c] = out_b[c] = .5;
+        out_r += dx;
+        out_g += dx;
+        out_b += dx;
+        for(c = 0; c < new_w; ++c){
+            int i0 = x0[c];
+            int i1 = x1[c];
+            float w00 = (1-fx[c])*(1-fy)*(1/255.f);
+            float w01 = fx[c]*(1-fy)*(1/255.f);
+            float w10 = (1-fx[c])*fy*(1/255.f);
+            float w11 = fx[c]*fy*(1/255.f);
+            out_b[c] = w00*row0[i0]   + w01*row0[i1]   + w10*row1[i0]   + w11*row1[i1];
+            out_g[c] = w00*row0[i0+1] + w01*row0[i1+1] + w10*row1[i0+1] + w11*row1[i1+1];
+            out_r[c] = w00*row0[i0+2] + w01*row0[i1+2] + w10*row1[i0+2] + w11*row1[i1+2];
+        }
+    }
+}
+
+// sized is the letterboxed network input of an imW x imH image, see letterbox_bgr8_obj
+void run_yolo_detection_obj(image sized, int imW, int imH, network *net, box *boxes, float **probs, float thresh, float hier_thresh, char **names, boxInfo *result)
+{
+    //clock_t t;
+    //t = clock();
     
     float *X = sized.data;
     
     
     network_predict(net, X);  // jb darknet update
 
-    
+    //t = clock() - t;
+    //double time_taken = ((double)t)/CLOCKS_PER_SEC; // in seconds
+    //printf("took %f seconds to predict yolo \n", time_taken);
+    get_yolo_detections_obj(net, 0, imW, imH, boxes, probs, thresh, hier_thresh, names, result);
+}
+
+// detections of the image b (imW x imH) of the last batch predicted by net
+void get_yolo_detections_obj(network *net, int b, int imW, int imH, box *boxes, float **probs, float thresh, float hier_thresh, char **names, boxInfo *result)
+{
+    float nms=.4;
+    layer l = net->layers[net->n-1];
+    l.output += b*l.outputs;
+    l.batch = 1;
+
     // revised to new api
 // void get_region_boxes(layer l, int w, int h, int netw, int neth, float thresh, float **probs, box *boxes, float **masks, int only_objectness, int *map, float tree_thresh, int relative);
 
-    get_region_boxes(l, 1, 1, net->w, net->h, thresh, probs, boxes, 0, 0, 0, hier_thresh,0 );
+    // relative boxes in the image, the letterbox is removed by correct_region_boxes
+    get_region_boxes(l, imW, imH, net->w, net->h, thresh, probs, boxes, 0, 0, 0, hier_thresh, 1);
 
     if (l.softmax_tree && nms) 
     {
@@ -207,19 +286,7 @@ void run_yolo_detection_obj(image im, network *net, box *boxes, float **probs, f
     	do_nms_sort(boxes, probs, l.w*l.h*l.n, l.classes, nms);
     }
     
-    
-
-	int imW = im.w;
-	int imH = im.h;
-
-    free_image(im);
-    free_image(sized);
-    
-    //t = clock() - t;
-    //double time_taken = ((double)t)/CLOCKS_PER_SEC; // in seconds
-    //printf("took %f seconds to predict yolo \n", time_taken);
    // free_ptrs((void **)probs, l.w*l.h*l.n);
   // printf( "detect layer (layer %d) w = %d h = %d n = %d\n", net->n, l.w, l.h, l.n);
     extractObject(imW, imH, l.w*l.h*l.n, thresh, boxes, probs, names,  l.classes, result);
 }
-
@@ -31,5 +31,7 @@ float** init_probs_obj(network* net);
 image **load_alphabet_obj_(char* path);
 void extratObject(int imW, int imH, int num, float thresh, box *boxes, float **probs, char **names, int classes, boxInfo *result);
 
-void run_yolo_detection_obj(image im, network *net, box *boxes, float **probs, float thresh, float hier_thresh, char **names, boxInfo *result);
+void letterbox_bgr8_obj(const unsigned char *bgr, int w, int h, int step, image boxed);
+void run_yolo_detection_obj(image sized, int imW, int imH, network *net, box *boxes, float **probs, float thresh, float hier_thresh, char **names, boxInfo *result);
+void get_yolo_detections_obj(network *net, int b, int imW, int imH, box *boxes, float **probs, float thresh, float hier_thresh, char **names, boxInfo *result);
 
@@ -44,6 +44,7 @@ extern  "C"{
 #include <Eigen/Eigen>
 
 #include <open_ptrack/opt_utils/conversions.h>
+#include <open_ptrack/opt_utils/depth_statistics.h>
 
 
 using namespace sensor_msgs;
@@ -59,6 +60,9 @@ char **names;
 image **alphabet;
 box *boxes_y;
 float **probs;
+image net_input;		// letterboxed network input, see letterbox_bgr8_obj
+boxInfo detected;		// detected boxes of the current frame
+const int max_detections = 200;
 
 float thresh;
 float hier_thresh;
@@ -81,6 +85,13 @@ double _constant_y;
 std::string encoding;
 float mm_factor;
 
+// robust depth of the boxes, sampled with a depth histogram
+open_ptrack::opt_utils::DepthStatistics* depth_statistics;
+float min_valid_ratio;	// boxes with less valid depth samples are rejected
+
+int benchmark_layers;	// frames between two reports of the forward time of every layer, 0 = off
+int benchmark_frames = 0;
+
 void camera_info_cb (const CameraInfo::ConstPtr & msg)
 {
 	intrinsics_matrix << msg->K[0], 0, msg->K[2], 0, msg->K[4], msg->K[5], 0, 0, 1;
@@ -105,65 +116,6 @@ void dynamic_callback(yolo_detector::open_ptrack_yoloConfig &config, uint32_t le
 	
 }
 
-image ipl_to_image(IplImage* src)
-{
-    unsigned char *data = (unsigned char *)src->imageData;
-    int h = src->height;
-    int w = src->width;
-    int c = src->nChannels;
-    int step = src->widthStep;
-    image out = make_image(w, h, c);
-    int i, j, k, count=0;;
-
-    for(k= 0; k < c; ++k){
-        for(i = 0; i < h; ++i){
-            for(j = 0; j < w; ++j){
-                out.data[count++] = data[i*step + j*c + k]/255.;
-            }
-        }
-    }
-    return out;
-}
-
-image convert_image(cv_bridge::CvImageConstPtr cv_ptr_rgb, int w, int h)
-{
-	IplImage iplimg = cv_ptr_rgb->image;
-	image out = ipl_to_image(&iplimg);
-    rgbgr_image(out);
-    
-    if((h && w) && (h != out.h || w != out.w))
-    {
-        image resized = resize_image(out, w, h);
-        free_image(out);
-        out = resized;
-    }
-    
-    return out;
-}
-
-float median(const cv::Mat& Input)
-{
-
-  std::vector<float> array;
-
-  if (Input.isContinuous())
-  {
-    array.assign(Input.datastart, Input.dataend);
-
-  } 
-  else 
-  {
-    for (int i = 0; i < Input.rows; ++i) 
-    {
-      array.insert(array.end(), Input.ptr<float>(i), Input.ptr<float>(i)+Input. cols);
-    }
-  }
-
-  std::nth_element(array.begin() , array.begin() + array.size() * 0.5, array.end());
-
-  return array[array.size() * 0.5];
-}
-
 void callback(const Image::ConstPtr& rgb_image,
          const Image::ConstPtr& depth_image)
 {
@@ -174,28 +126,26 @@ void callback(const Image::ConstPtr& rgb_image,
     {
 	//	std::cout<<"Run Yolo"<<std::endl;
 		ros::Time begin = ros::Time::now();
-		image im = convert_image(cv_ptr_rgb,0,0);
-		
-		//std::cout << "START CREATE BOX INFO" << std::endl;
-		boxInfo* boxes = (boxInfo*)calloc(1, sizeof(boxInfo));
-		boxes->num = 200;
-		boxes->boxes = (adjBox*)calloc(200, sizeof(adjBox));
+		const cv::Mat& rgb = cv_ptr_rgb->image;
+		letterbox_bgr8_obj(rgb.data, rgb.cols, rgb.rows, rgb.step, net_input);
 		
-		//std::cout << "ENTER C CODE" << std::endl;
-		run_yolo_detection_obj(im, net, boxes_y, probs, thresh,  hier_thresh, names, boxes);
+		detected.num = max_detections;
+		run_yolo_detection_obj(net_input, rgb.cols, rgb.rows, net, boxes_y, probs, thresh,  hier_thresh, names, &detected);
 		
-		printf( "Yolo object count = %d\n", boxes->num);
+		printf( "Yolo object count = %d\n", detected.num);
 		double duration = ros::Time::now().toSec() - begin.toSec();
 
 		std::cout << "Yolo detection time: " << duration<< std::endl;
+		if(benchmark_layers > 0 && ++benchmark_frames % benchmark_layers == 0)
+			print_layer_times(net);
 		
     	
     	//Get Depth Image
 		cv::Mat _depth_image;
-		cv_bridge::CvImage::Ptr cv_ptr_depth;
+		cv_bridge::CvImageConstPtr cv_ptr_depth;
 		try
 		{
-		    cv_ptr_depth = cv_bridge::toCvCopy(depth_image, encoding); //, sensor_msgs::image_encodings::TYPE_32FC1);
+		    cv_ptr_depth = cv_bridge::toCvShare(depth_image, encoding); //, sensor_msgs::image_encodings::TYPE_32FC1);
 		}
 		catch (cv_bridge::Exception& e)
 		{
@@ -216,47 +166,55 @@ void callback(const Image::ConstPtr& rgb_image,
 			}
 		}
 		
-		cv::Mat image = cv_ptr_rgb->image;
+		// the rgb image is shared with the message, draw on a copy
+		bool publish_image = pub.getNumSubscribers() > 0;
+		cv::Mat image;
+		if(publish_image)
+			image = cv_ptr_rgb->image.clone();
 		
 		detection_array_msg->confidence_type = std::string("yolo");
 		detection_array_msg->image_type = std::string("rgb");
 		
 		int i;
-		for(i = 0; i < boxes->num; i++)
+		for(i = 0; i < detected.num; i++)
 		{
-			int medianX = boxes->boxes[i].x + (boxes->boxes[i].w / 2);
-			int medianY = boxes->boxes[i].y + (boxes->boxes[i].h / 2);
+			int medianX = detected.boxes[i].x + (detected.boxes[i].w / 2);
+			int medianY = detected.boxes[i].y + (detected.boxes[i].h / 2);
 			// If the detect box coordinat is near edge of image, it will return a error 'Out of im.size().'
-			if ( medianX < im.w*0.02 || medianX > im.w*0.98) continue;
-			if ( medianY < im.h*0.02 || medianY > im.h*0.98) continue;
+			if ( medianX < rgb.cols*0.02 || medianX > rgb.cols*0.98) continue;
+			if ( medianY < rgb.rows*0.02 || medianY > rgb.rows*0.98) continue;
 			
-			int newX = medianX - (median_factor * (medianX - boxes->boxes[i].x));
-			int newY = medianY - (median_factor * (medianY - boxes->boxes[i].y));
-			int newWidth = 2 * (median_factor * (medianX - boxes->boxes[i].x));
-			int newHeight = 2 * (median_factor * (medianY - boxes->boxes[i].y));
+			int newX = medianX - (median_factor * (medianX - detected.boxes[i].x));
+			int newY = medianY - (median_factor * (medianY - detected.boxes[i].y));
+			int newWidth = 2 * (median_factor * (medianX - detected.boxes[i].x));
+			int newHeight = 2 * (median_factor * (medianY - detected.boxes[i].y));
 			
 			
 			cv::Rect rect(newX, newY, newWidth, newHeight);
-			float medianDepth = median(_depth_image(rect)) / mm_factor;
-			// If medianDepth <= 0, that means the sensor got a wrong depth distance.
-			if (medianDepth <= 0 || medianDepth > 6.25) {
+			open_ptrack::opt_utils::DepthStatistics::Result depth_stats;
+			// No valid depth in the box, the sensor got a wrong depth distance.
+			if (!depth_statistics->compute(_depth_image, rect, 1.0f / mm_factor, depth_stats) || depth_stats.valid_ratio < min_valid_ratio) {
+				continue;
+			}
+			float medianDepth = depth_stats.median;
+			if (medianDepth > 6.25) {
 				std::cout << "mediandepth " << medianDepth << " rejecting" << std::endl;
 				continue;
 			}			
 //float medianDepth = _depth_image.at<float>(medianY, medianX) / 1000.0f;
 			
-			std::string object_name(names[boxes->boxes[i].classID]);  
+			std::string object_name(names[detected.boxes[i].classID]);  
 				    
 			std::stringstream ss;
 			ss << object_name << ":" << medianDepth; //  << " " << mm_factor;
 			
 			
-			if(pub.getNumSubscribers() > 0)
+			if(publish_image)
 			{
 				cv::rectangle(image, cv::Point( newX, newY ), cv::Point( newX+ newWidth, newY+ newHeight), cv::Scalar( 0, 255, 0 ), 4);
-				cv::rectangle(image, cv::Point( boxes->boxes[i].x, boxes->boxes[i].y ), 
-									 cv::Point( boxes->boxes[i].x+ boxes->boxes[i].w, boxes->boxes[i].y+ boxes->boxes[i].h), cv::Scalar( 255, 0, 255 ), 10);
-				cv::putText(image, ss.str(), cv::Point(boxes->boxes[i].x+10,boxes->boxes[i].y+20), cv::FONT_HERSHEY_COMPLEX_SMALL, 0.6, cv::Scalar(200,200,250), 1, CV_AA);
+				cv::rectangle(image, cv::Point( detected.boxes[i].x, detected.boxes[i].y ), 
+									 cv::Point( detected.boxes[i].x+ detected.boxes[i].w, detected.boxes[i].y+ detected.boxes[i].h), cv::Scalar( 255, 0, 255 ), 10);
+				cv::putText(image, ss.str(), cv::Point(detected.boxes[i].x+10,detected.boxes[i].y+20), cv::FONT_HERSHEY_COMPLEX_SMALL, 0.6, cv::Scalar(200,200,250), 1, CV_AA);
 			}
 			
 			float mx =  (medianX - _cx) * medianDepth * _constant_x;
@@ -309,7 +267,7 @@ void callback(const Image::ConstPtr& rgb_image,
 			}
 		}
 		
-		if(pub.getNumSubscribers() > 0)
+		if(publish_image)
 		{
 			
 			sensor_msgs::ImagePtr msg = cv_bridge::CvImage(std_msgs::Header(), "bgr8", image).toImageMsg();
@@ -318,9 +276,6 @@ void callback(const Image::ConstPtr& rgb_image,
 		
 		//std::cout << "publishing " << detection_array_msg << std::endl; 
 		detection_pub.publish(detection_array_msg);
-		// Free the object when the current loop is finishing, because if you don't free it, it will always occupy the memory until the pc collapses. 
-		free(boxes->boxes);
-		free(boxes);
     }
 }
 
@@ -383,6 +338,16 @@ int main(int argc, char** argv)
 	thresh = (float)thresh_;
 	hier_thresh = (float)hier_thresh_;
 	median_factor = (float)median_factor_;
+
+	// accuracy of the box depth: histogram bin (meters) and samples per box
+	double depth_resolution;
+	int depth_samples;
+	double min_valid_ratio_;
+	nh.param("depth_resolution", depth_resolution, 0.01);
+	nh.param("depth_samples", depth_samples, 1024);
+	nh.param("min_valid_ratio", min_valid_ratio_, 0.1);
+	depth_statistics = new open_ptrack::opt_utils::DepthStatistics(0.2f, 10.0f, depth_resolution, depth_samples);
+	min_valid_ratio = (float)min_valid_ratio_;
 	
 std::string datacfg;
 	nh.param("data_cfg", datacfg, std::string("cfg/coco.data"));// overridden
@@ -408,10 +373,22 @@ std::string datacfg;
     
     
     set_batch_network( net, 1 );
+    // fold the batch normalization in the convolution weights, it is constant at inference
+    fuse_batchnorm( net );
+    // int8 convolutions on the CPU, weights quantized offline by "darknet detector quantize"
+    std::string int8_weight_file;
+    nh.param("int8_weight_file", int8_weight_file, std::string(""));
+    if(!int8_weight_file.empty())
+        load_quantized_weights( net, (char*)int8_weight_file.c_str() );
+    nh.param("benchmark_layers", benchmark_layers, 0);
+    if(benchmark_layers > 0)
+        set_benchmark_layers( net, 1 );
 	srand(2222222);
 	
 	boxes_y = init_boxes_obj(net);
 	probs = init_probs_obj(net);
+	net_input = make_image(net->w, net->h, 3);
+	detected.boxes = (adjBox*)calloc(max_detections, sizeof(adjBox));
 	
 	// jb - there was a problem with parsing this, and we may not need rest of config file, so put here - 
 	// list *options = read_data_cfg((char*)datacfg.c_str() );
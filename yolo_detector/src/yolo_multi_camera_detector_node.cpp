@@ -0,0 +1,425 @@
+#include <ros/ros.h>
+#include <message_filters/subscriber.h>
+#include <message_filters/synchronizer.h>
+#include <message_filters/sync_policies/approximate_time.h>
+
+//Publish Messages
+#include <sensor_msgs/CameraInfo.h>
+#include <opt_msgs/Detection.h>
+#include <opt_msgs/DetectionArray.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/image_encodings.h>
+
+#include <cv_bridge/cv_bridge.h>
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include <dynamic_reconfigure/server.h>
+#include <yolo_detector/open_ptrack_yoloConfig.h>
+
+extern  "C"{
+#include "network.h"
+#include "image.h"
+#include "run_yolo_obj.h"
+#include "parser.h"
+#include "region_layer.h"
+#include "utils.h"
+#include "box.h"
+}
+
+#include <Eigen/Eigen>
+
+#include <open_ptrack/opt_utils/depth_statistics.h>
+
+/*
+ * YOLO object detection of several cameras with a single network.
+ * The frames of the cameras are collected until all the cameras sent one or batch_window
+ * seconds have passed since the first, then they are letterboxed in consecutive slots of the
+ * network input and detected as one batch. The detections of every image are published in its
+ * own DetectionArray, with the intrinsics and the depth image of its camera.
+ */
+
+using namespace sensor_msgs;
+using namespace message_filters;
+using namespace opt_msgs;
+
+typedef sensor_msgs::Image Image;
+typedef sync_policies::ApproximateTime<Image, Image> Sync1Policy;
+
+namespace enc = sensor_msgs::image_encodings;
+
+struct Camera
+{
+	std::string name;
+
+	Eigen::Matrix3f intrinsics_matrix;
+	bool camera_info_available_flag;
+	double _cx;
+	double _cy;
+	double _constant_x;
+	double _constant_y;
+
+	// frame waiting for the next batch
+	Image::ConstPtr rgb_image;
+	Image::ConstPtr depth_image;
+
+	boost::shared_ptr<message_filters::Subscriber<Image> > rgb_image_sub;
+	boost::shared_ptr<message_filters::Subscriber<Image> > depth_image_sub;
+	boost::shared_ptr<Synchronizer<Sync1Policy> > sync;
+	ros::Subscriber camera_info_sub;
+};
+
+std::vector<Camera> cameras;
+
+network* net;
+char **names;
+box *boxes_y;
+float **probs;
+image net_input;		// letterboxed images of the batch, one after the other
+int net_batch = 0;		// batch currently set in the network
+boxInfo detected;		// detected boxes of one image of the batch
+const int max_detections = 200;
+
+float thresh;
+float hier_thresh;
+float median_factor;
+
+ros::Publisher detection_pub;
+
+double batch_window;	// seconds to wait for the frames of the other cameras
+ros::Time batch_start;	// arrival of the first frame of the next batch
+int pending_frames = 0;
+
+std::string encoding;
+float mm_factor;
+
+// robust depth of the boxes, sampled with a depth histogram
+open_ptrack::opt_utils::DepthStatistics* depth_statistics;
+float min_valid_ratio;	// boxes with less valid depth samples are rejected
+
+void camera_info_cb (const CameraInfo::ConstPtr & msg, int camera)
+{
+	Camera& cam = cameras[camera];
+	cam.intrinsics_matrix << msg->K[0], 0, msg->K[2], 0, msg->K[4], msg->K[5], 0, 0, 1;
+
+	cam._cx = msg->K[2];
+	cam._cy = msg->K[5];
+
+	cam._constant_x =  1.0f / msg->K[0];
+	cam._constant_y = 1.0f /  msg->K[4];
+
+	cam.camera_info_available_flag = true;
+}
+
+void dynamic_callback(yolo_detector::open_ptrack_yoloConfig &config, uint32_t level)
+{
+	std::cout << "Adjusting Parameters" <<  std::endl;
+	thresh = (float)config.ObjectThresh;
+	hier_thresh = (float)config.ObjectHier_Thresh;
+	median_factor = (float)config.ObjectMedian_Factor;
+	std::cout << "thresh:" << thresh << " hier_thresh:" << hier_thresh << " median_factor:" <<median_factor<<  std::endl;
+}
+
+// DetectionArray of the boxes detected in the current frame of cam
+void publish_detections(const Camera& cam)
+{
+	cv_bridge::CvImageConstPtr cv_ptr_depth;
+	try
+	{
+	    cv_ptr_depth = cv_bridge::toCvShare(cam.depth_image, encoding);
+	}
+	catch (cv_bridge::Exception& e)
+	{
+	    ROS_ERROR("cv_bridge exception: %s", e.what());
+	    return;
+	}
+	const cv::Mat& _depth_image = cv_ptr_depth->image;
+	int width = cam.rgb_image->width;
+	int height = cam.rgb_image->height;
+
+	DetectionArray::Ptr detection_array_msg(new DetectionArray);
+	detection_array_msg->header = cam.rgb_image->header;
+
+	for(int i = 0; i < 3; i++)
+	{
+		for(int j = 0; j < 3; j++)
+		{
+			detection_array_msg->intrinsic_matrix.push_back(cam.intrinsics_matrix(i, j));
+		}
+	}
+
+	detection_array_msg->confidence_type = std::string("yolo");
+	detection_array_msg->image_type = std::string("rgb");
+
+	for(int i = 0; i < detected.num; i++)
+	{
+		const adjBox& b = detected.boxes[i];
+		int medianX = b.x + (b.w / 2);
+		int medianY = b.y + (b.h / 2);
+		// If the detect box coordinat is near edge of image, it will return a error 'Out of im.size().'
+		if ( medianX < width*0.02 || medianX > width*0.98) continue;
+		if ( medianY < height*0.02 || medianY > height*0.98) continue;
+
+		int newX = medianX - (median_factor * (medianX - b.x));
+		int newY = medianY - (median_factor * (medianY - b.y));
+		int newWidth = 2 * (median_factor * (medianX - b.x));
+		int newHeight = 2 * (median_factor * (medianY - b.y));
+
+		cv::Rect rect(newX, newY, newWidth, newHeight);
+		open_ptrack::opt_utils::DepthStatistics::Result depth_stats;
+		// No valid depth in the box, the sensor got a wrong depth distance.
+		if (!depth_statistics->compute(_depth_image, rect, 1.0f / mm_factor, depth_stats) || depth_stats.valid_ratio < min_valid_ratio) {
+			continue;
+		}
+		float medianDepth = depth_stats.median;
+		if (medianDepth > 6.25) {
+			continue;
+		}
+
+		float mx =  (medianX - cam._cx) * medianDepth * cam._constant_x;
+		float my = (medianY - cam._cy) * medianDepth * cam._constant_y;
+
+		if(std::isfinite(medianDepth) && std::isfinite(mx) && std::isfinite(my))
+		{
+			Detection detection_msg;
+
+			detection_msg.box_3D.p1.x = mx;
+			detection_msg.box_3D.p1.y = my;
+			detection_msg.box_3D.p1.z = medianDepth;
+
+			detection_msg.box_3D.p2.x = mx;
+			detection_msg.box_3D.p2.y = my;
+			detection_msg.box_3D.p2.z = medianDepth;
+
+			detection_msg.box_2D.x = medianX;
+			detection_msg.box_2D.y = medianY;
+			detection_msg.box_2D.width = 0;
+			detection_msg.box_2D.height = 0;
+			detection_msg.height = 0;
+			detection_msg.confidence = 10;
+			detection_msg.distance = medianDepth;
+
+			detection_msg.centroid.x = mx;
+			detection_msg.centroid.y = my;
+			detection_msg.centroid.z = medianDepth;
+
+			detection_msg.top.x = 0;
+			detection_msg.top.y = 0;
+			detection_msg.top.z = 0;
+
+			detection_msg.bottom.x = 0;
+			detection_msg.bottom.y = 0;
+			detection_msg.bottom.z = 0;
+
+			detection_msg.object_name = std::string(names[b.classID]);
+
+			detection_array_msg->detections.push_back(detection_msg);
+		}
+	}
+
+	detection_pub.publish(detection_array_msg);
+}
+
+// Detect the waiting frames of all the cameras as one batch
+void run_batch()
+{
+	ros::Time begin = ros::Time::now();
+	int size = net->w*net->h*3;
+	std::vector<int> batch;		// camera of every image of the batch
+	for(int c = 0; c < cameras.size(); c++)
+	{
+		if(!cameras[c].rgb_image)
+			continue;
+
+		cv_bridge::CvImageConstPtr cv_ptr_rgb;
+		try
+		{
+			cv_ptr_rgb = cv_bridge::toCvShare(cameras[c].rgb_image, enc::BGR8);
+		}
+		catch (cv_bridge::Exception& e)
+		{
+			ROS_ERROR("cv_bridge exception: %s", e.what());
+			cameras[c].rgb_image.reset();
+			cameras[c].depth_image.reset();
+			continue;
+		}
+		const cv::Mat& rgb = cv_ptr_rgb->image;
+		image slot = net_input;
+		slot.data += batch.size()*size;
+		letterbox_bgr8_obj(rgb.data, rgb.cols, rgb.rows, rgb.step, slot);
+		batch.push_back(c);
+	}
+	pending_frames = 0;
+	if(batch.empty())
+		return;
+
+	if(net_batch != batch.size())
+	{
+		net_batch = batch.size();
+		set_batch_network(net, net_batch);
+	}
+	network_predict(net, net_input.data);
+
+	for(int b = 0; b < batch.size(); b++)
+	{
+		Camera& cam = cameras[batch[b]];
+		detected.num = max_detections;
+		get_yolo_detections_obj(net, b, cam.rgb_image->width, cam.rgb_image->height, boxes_y, probs, thresh, hier_thresh, names, &detected);
+		publish_detections(cam);
+		cam.rgb_image.reset();
+		cam.depth_image.reset();
+	}
+
+	double duration = ros::Time::now().toSec() - begin.toSec();
+	std::cout << "Yolo detection time of " << batch.size() << " cameras: " << duration << std::endl;
+}
+
+void callback(const Image::ConstPtr& rgb_image,
+         const Image::ConstPtr& depth_image, int camera)
+{
+	Camera& cam = cameras[camera];
+	if(detection_pub.getNumSubscribers() == 0 || !cam.camera_info_available_flag)
+		return;
+
+	// a newer frame of the same camera replaces the waiting one
+	if(!cam.rgb_image)
+	{
+		if(pending_frames == 0)
+			batch_start = ros::Time::now();
+		pending_frames++;
+	}
+	cam.rgb_image = rgb_image;
+	cam.depth_image = depth_image;
+
+	if(pending_frames == cameras.size())
+		run_batch();
+}
+
+void batch_timer_cb(const ros::TimerEvent&)
+{
+	if(pending_frames > 0 && (ros::Time::now() - batch_start).toSec() >= batch_window)
+		run_batch();
+}
+
+
+int main(int argc, char** argv)
+{
+    ros::init(argc, argv, "yolo_multi_camera_detector");
+    ros::NodeHandle nh("~");
+
+	std::vector<std::string> sensor_names;
+	nh.getParam("sensor_names", sensor_names);
+	if(sensor_names.empty())
+	{
+		ROS_ERROR("yolo_multi_camera_detector: no sensor_names");
+		return 1;
+	}
+	// topics of a camera are its name followed by these
+	std::string depth_image_topic;
+	nh.param("depth_image_topic", depth_image_topic, std::string("/sd/image_depth_rect"));
+	std::string rgb_image_topic;
+	nh.param("rgb_image_topic", rgb_image_topic, std::string("/sd/image_color_rect"));
+	std::string camera_info_topic;
+	nh.param("camera_info_topic", camera_info_topic, std::string("/sd/camera_info"));
+	std::string output_topic;
+	nh.param("output_topic", output_topic, std::string("/objects_detector/detections"));
+	nh.param("batch_window", batch_window, 0.03);
+
+	std::string encoding_param;
+	nh.param("encoding_type", encoding_param, std::string("16UC1"));
+
+	int in_mm;
+	nh.param("in_mm", in_mm, 0);
+
+	if(encoding_param.compare(std::string("32FC1")) == 0)
+	{
+		encoding = sensor_msgs::image_encodings::TYPE_32FC1;
+	}
+	else
+	{
+		encoding = sensor_msgs::image_encodings::TYPE_16UC1;
+	}
+
+	if(in_mm)
+	{
+		mm_factor = 1000.0f;
+	}
+	else
+	{
+		mm_factor = 1.0f;
+	}
+
+	double thresh_;
+	double hier_thresh_;
+	double median_factor_;
+	nh.param("thresh", thresh_, 0.25);
+	nh.param("hier_thresh", hier_thresh_, 0.5);
+	nh.param("median_factor", median_factor_, 0.1);
+	thresh = (float)thresh_;
+	hier_thresh = (float)hier_thresh_;
+	median_factor = (float)median_factor_;
+
+	// accuracy of the box depth: histogram bin (meters) and samples per box
+	double depth_resolution;
+	int depth_samples;
+	double min_valid_ratio_;
+	nh.param("depth_resolution", depth_resolution, 0.01);
+	nh.param("depth_samples", depth_samples, 1024);
+	nh.param("min_valid_ratio", min_valid_ratio_, 0.1);
+	depth_statistics = new open_ptrack::opt_utils::DepthStatistics(0.2f, 10.0f, depth_resolution, depth_samples);
+	min_valid_ratio = (float)min_valid_ratio_;
+
+	std::string cfgfile;
+	nh.param("yolo_cfg", cfgfile, std::string("cfg/yolo.cfg"));
+	std::string weightfile;
+	nh.param("weight_file", weightfile, std::string("yolo.weights"));
+	std::string namefile;
+	nh.param("name_file", namefile, std::string("data/coco.names"));
+
+	// one network for all the cameras, it can run any batch up to their number
+	net = parse_network_cfg_batch( (char*)cfgfile.c_str(), sensor_names.size() );
+	load_weights( net, (char*)weightfile.c_str() );
+	fuse_batchnorm( net );
+	std::string int8_weight_file;
+	nh.param("int8_weight_file", int8_weight_file, std::string(""));
+	if(!int8_weight_file.empty())
+		load_quantized_weights( net, (char*)int8_weight_file.c_str() );
+
+	boxes_y = init_boxes_obj(net);
+	probs = init_probs_obj(net);
+	net_input = make_image(net->w, net->h, 3*sensor_names.size());
+	detected.boxes = (adjBox*)calloc(max_detections, sizeof(adjBox));
+	names = get_labels((char*)namefile.c_str());
+
+	std::cout << "YOLO Set UP - objects, " << sensor_names.size() << " cameras" << std::endl;
+	std::cout << "thresh:" << thresh << " hier_thresh" << hier_thresh << std::endl;
+
+	detection_pub = nh.advertise<DetectionArray>(output_topic, 3 * sensor_names.size());
+
+	dynamic_reconfigure::Server<yolo_detector::open_ptrack_yoloConfig> server;
+	dynamic_reconfigure::Server<yolo_detector::open_ptrack_yoloConfig>::CallbackType f;
+	f = boost::bind(&dynamic_callback, _1, _2);
+	server.setCallback(f);
+
+	cameras.resize(sensor_names.size());
+	for(int c = 0; c < cameras.size(); c++)
+	{
+		Camera& cam = cameras[c];
+		cam.name = sensor_names[c];
+		cam.camera_info_available_flag = false;
+		std::string prefix = "/" + cam.name;
+
+		cam.rgb_image_sub.reset(new message_filters::Subscriber<Image>(nh, prefix + rgb_image_topic, 1));
+		cam.depth_image_sub.reset(new message_filters::Subscriber<Image>(nh, prefix + depth_image_topic, 1));
+		cam.camera_info_sub = nh.subscribe<CameraInfo>(prefix + camera_info_topic, 1, boost::bind(&camera_info_cb, _1, c));
+
+		cam.sync.reset(new Synchronizer<Sync1Policy>(Sync1Policy(10), *cam.rgb_image_sub, *cam.depth_image_sub));
+		cam.sync->registerCallback(boost::bind(&callback, _1, _2, c));
+	}
+
+	ros::Timer batch_timer = nh.createTimer(ros::Duration(batch_window / 4), batch_timer_cb);
+
+	ros::spin();
+
+	free_network(net);
+	return 0;
+}